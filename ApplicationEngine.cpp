@@ -1,12 +1,13 @@
 #include "ApplicationEngine.hpp"
-#include "SimpleRenderingSystem.hpp"
-#include "keyboardController.hpp"
-#include "mouseController.hpp"
+#include "weEngineJobSystem.hpp"
 
 //std
 #include "stdexcept"
 #include "array"
 #include "chrono"
+#include "iostream"
+#include "algorithm"
+#include "cmath"
 
 //glm
 #define GLM_FORCE_RADIANS
@@ -35,58 +36,517 @@ namespace weEngine
 	*/
 	void ApplicationEngine::run()
 	{
-		SimpleRenderingSystem renderSystem{ weEngineDevice, weEngineRenderer.getSwapChainRenderPass() };
-		weEngineCamera camera{};
-		
-		auto currentTime = std::chrono::high_resolution_clock::now();
+		globalUniforms = make_unique<weEngineGlobalUniforms>(weEngineDevice);
+
+		//The objects are culled and drawn on the GPU when the device allows it, otherwise they are drawn instanced from the CPU
+		if (ENABLE_GPU_DRIVEN_RENDERING && GpuDrivenRenderingSystem::isSupported(weEngineDevice))
+		{
+			gpuDrivenRenderSystem = make_unique<GpuDrivenRenderingSystem>(
+				weEngineDevice,
+				weEngineRenderer.getSwapChainRenderPass(),
+				globalUniforms->getDescriptorSetLayout(),
+				weEngineRenderer.isDepthSampleable());
+			std::cout << "Rendering path: GPU driven"
+				<< (weEngineDevice.getCapabilities().drawIndirectCount ? " (indirect count draws)" : " (plain indirect draws)") << std::endl;
+		}
+		else
+		{
+			renderSystem = make_unique<SimpleRenderingSystem>(weEngineDevice, weEngineRenderer.getSwapChainRenderPass(), globalUniforms->getDescriptorSetLayout());
+			std::cout << "Rendering path: CPU instanced" << std::endl;
+		}
 
-		auto cameraObject = weEngineGameObject::createGameObject();
-		KeyboardMovementController cameraController{};
-		MouseMovementController mouseController{};
+		//The camera looks from the entity the keyboard and the mouse move, it has no model so it is not drawn
+		world.createEntity(TransformComponent{}, PreviousTransformComponent{}, CameraControlComponent{});
+
+		/*
+		* Every iteration simulates a frame into a packet while the previous frames are recorded and submitted from the other packets,
+		* which adds one frame of latency, or two when the render thread has a packet queued. The tasks declare what they read and write,
+		* the graph orders the tasks touching the same resource.
+		*/
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
+		worldResource = frameGraph.addResource();
+		rendererResource = frameGraph.addResource();
+		for (PacketResources& resources : packetResources)
+		{
+			resources = { frameGraph.addResource(), frameGraph.addResource(), frameGraph.addResource(), frameGraph.addResource() };
+		}
+
+		//The render thread owns the renderer from here on, the main thread only polls the events and simulates
+		std::unique_ptr<weEngineRenderThread> renderThread;
+		if (ENABLE_RENDER_THREAD)
+		{
+			renderThread = make_unique<weEngineRenderThread>(FRAME_PACKET_COUNT, [this](uint32_t packetIndex) { recordFrame(framePackets[packetIndex]); });
+		}
+
+		uint64_t frameNumber = 0;
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		float screenAspectRatio = weEngineRenderer.getAspectRatio();
 
 		while (!weEngineWindow.shouldClose())
 		{
 			glfwPollEvents();
 
+			//Jobs that call GLFW or touch the window were queued for the main thread by the other threads
+			jobSystem.runMainThreadJobs();
+
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
 
-			float screenAspectRatio = weEngineRenderer.getAspectRatio();
+			/*
+			* The frame runs the whole ticks the simulation is behind, the rest of the time waits in the accumulator for the next frames
+			* and places the frame between the last two ticks. A frame too long for MAX_TICKS_PER_FRAME drops the ticks beyond them.
+			*/
+			const float tickTime = 1.0f / simulationTickRate;
+			tickAccumulator += frameTime;
+			const float dueTickCount = std::floor(tickAccumulator / tickTime);
+			tickAccumulator = std::max(tickAccumulator - dueTickCount * tickTime, 0.0f);
+			const uint32_t tickCount = static_cast<uint32_t>(std::min(dueTickCount, static_cast<float>(MAX_TICKS_PER_FRAME)));
+			droppedTickCount += static_cast<uint64_t>(dueTickCount) - tickCount;
+			tickNumber += tickCount;
 
-			cameraController.moveInPlaceXZ(weEngineWindow.getGLFWwindow(), frameTime, cameraObject);
-			mouseController.processMouseMovement(weEngineWindow.getGLFWwindow(), cameraObject);
+			//Read from the window rather than the swap chain, which the recording may recreate meanwhile. A minimized window keeps the last ratio
+			const VkExtent2D windowExtent = weEngineWindow.getExtent();
+			if (windowExtent.width > 0 && windowExtent.height > 0)
+			{
+				screenAspectRatio = static_cast<float>(windowExtent.width) / static_cast<float>(windowExtent.height);
+			}
 
+			frameGraph.clear();
 
-			camera.setViewYXZ(cameraObject.transformComp.translation, cameraObject.transformComp.rotation);
-			
-			camera.setPerspectiveProjection(glm::radians(50.0f), screenAspectRatio, 0.1f, 100.0f);
-			if (auto commandBuffer = weEngineRenderer.beginFrame())
+			uint32_t packetIndex = 0;
+			if (renderThread)
 			{
-				weEngineRenderer.beginSwapChainRenderPass(commandBuffer);
-				renderSystem.renderGameObjects(commandBuffer, gameObjects, camera);
-				weEngineRenderer.endSwapChainRenderPass(commandBuffer);
-				weEngineRenderer.endFrame();
+				packetIndex = renderThread->acquirePacket();
+			}
+			else
+			{
+				packetIndex = frameNumber % FRAME_PACKET_COUNT;
+
+				//Recording of the previous frame, added first since it is the older frame
+				if (frameNumber > 0)
+				{
+					const uint32_t recordedIndex = (frameNumber - 1) % FRAME_PACKET_COUNT;
+					const PacketResources& recorded = packetResources[recordedIndex];
+					frameGraph.addTask({ recorded.view, recorded.transforms, recorded.scene, recorded.objects }, { rendererResource }, [this, recordedIndex]()
+						{
+							recordFrame(framePackets[recordedIndex]);
+						});
+				}
+			}
+
+			weEngineFramePacket& packet = framePackets[packetIndex];
+			packet.frameNumber = frameNumber;
+			packet.frameTime = frameTime;
+			packet.tickNumber = tickNumber;
+			packet.tickCount = tickCount;
+			packet.interpolationAlpha = std::min(tickAccumulator / tickTime, 1.0f);
+			addSimulationTasks(packetIndex, tickCount, tickTime, screenAspectRatio);
+			frameGraph.execute(jobSystem);
+
+			//The simulation side prints its counters right away, the rendering systems once the packet is recorded
+			const bool isPrintingStatistics = glfwGetKey(weEngineWindow.getGLFWwindow(), GLFW_KEY_O) == GLFW_PRESS;
+			packet.isPrintingStatistics = isPrintingStatistics && !wasPrintingStatistics;
+			if (packet.isPrintingStatistics)
+			{
+				printSimulationStatistics(packet, renderThread.get());
 			}
+			wasPrintingStatistics = isPrintingStatistics;
+
+			if (renderThread)
+			{
+				renderThread->submitPacket(packetIndex);
+			}
+			frameNumber++;
 		}
 
+		if (renderThread)
+		{
+			renderThread->stop();
+		}
+		std::lock_guard<std::mutex> queueLock{ weEngineDevice.queueMutex() };
 		vkDeviceWaitIdle(weEngineDevice.device()); //Wait for the GPU to finish its operation before closing
 	}
 
+	void ApplicationEngine::setSimulationTickRate(float ticksPerSecond)
+	{
+		if (!(ticksPerSecond > 0.0f))
+		{
+			throw std::runtime_error("The simulation tick rate has to be positive");
+		}
+		simulationTickRate = ticksPerSecond;
+	}
+
+	/*
+	* The ticks read the input from GLFW so they run on the main thread, the other tasks only read the world and write their part of the packet.
+	* The mouse is read once per frame and turns the camera before the ticks, on both transforms the view is interpolated between,
+	* so a frame without ticks still turns and a frame with several does not turn again for each.
+	*/
+	void ApplicationEngine::addSimulationTasks(uint32_t packetIndex, uint32_t tickCount, float tickTime, float aspectRatio)
+	{
+		weEngineFramePacket& packet = framePackets[packetIndex];
+		const PacketResources& simulated = packetResources[packetIndex];
+
+		frameGraph.addTask({}, { worldResource, simulated.view }, [this, &packet, tickCount, tickTime, aspectRatio]()
+			{
+				const glm::vec3 mouseRotation = mouseController.readRotation(weEngineWindow.getGLFWwindow());
+				world.forEach<TransformComponent, PreviousTransformComponent, CameraControlComponent>([&](weEngineEntity, TransformComponent& transform, PreviousTransformComponent& previous, CameraControlComponent&)
+					{
+						mouseController.applyRotation(mouseRotation, transform);
+						mouseController.applyRotation(mouseRotation, previous.transform);
+					});
+
+				for (uint32_t tick = 0; tick < tickCount; tick++)
+				{
+					simulateTick(tickTime);
+				}
+
+				world.forEach<TransformComponent, PreviousTransformComponent, CameraControlComponent>([&](weEngineEntity, TransformComponent& transform, PreviousTransformComponent& previous, CameraControlComponent&)
+					{
+						const TransformComponent viewTransform = previous.transform.interpolate(transform, packet.interpolationAlpha);
+						packet.camera.setViewYXZ(viewTransform.translation, viewTransform.rotation);
+					});
+
+				packet.camera.setPerspectiveProjection(glm::radians(50.0f), aspectRatio, 0.1f, 100.0f);
+			}, weEngineTaskGraph::TaskAffinity::MAIN_THREAD);
+
+		frameGraph.addTask({ worldResource }, { simulated.transforms }, [this, &packet]() { updateTransforms(packet); });
+		frameGraph.addTask({ worldResource, simulated.transforms }, { simulated.scene }, [this, &packet]() { updateSceneBvh(packet); });
+		frameGraph.addTask({ worldResource }, { simulated.objects }, [this, &packet]() { extractRenderObjects(packet); });
+
+		frameGraph.addTask({ worldResource, simulated.view, simulated.transforms, simulated.scene }, {}, [this, &packet]()
+			{
+				const bool isPicking = glfwGetMouseButton(weEngineWindow.getGLFWwindow(), GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+				if (isPicking && !wasPicking)
+				{
+					pickGameObject(packet);
+				}
+				wasPicking = isPicking;
+			}, weEngineTaskGraph::TaskAffinity::MAIN_THREAD);
+	}
+
 	/*
-	* Creates the game objects for the app.
+	* The keyboard moves the camera by the tick time, the mouse already turned it for the whole frame.
+	*/
+	void ApplicationEngine::simulateTick(float tickTime)
+	{
+		world.parallelForEachChunk<TransformComponent, PreviousTransformComponent>([](uint32_t, const weEngineEntity*, uint32_t count, TransformComponent* transforms, PreviousTransformComponent* previousTransforms)
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					previousTransforms[i].transform = transforms[i];
+				}
+			});
+
+		world.forEach<TransformComponent, CameraControlComponent>([&](weEngineEntity, TransformComponent& transform, CameraControlComponent&)
+			{
+				cameraController.moveInPlaceXZ(weEngineWindow.getGLFWwindow(), tickTime, transform);
+			});
+	}
+
+	/*
+	* Only reads the packet, the world may change while the frame is recorded.
+	*/
+	void ApplicationEngine::recordFrame(weEngineFramePacket& packet)
+	{
+		if (auto commandBuffer = weEngineRenderer.beginFrame())
+		{
+			FrameInfo frameInfo{
+				weEngineRenderer.getCurrentFrameIndex(),
+				packet.frameTime,
+				commandBuffer,
+				packet.camera,
+				weEngineRenderer.getSwapChainExtent(),
+				&packet.sceneBvh,
+				&weEngineRenderer,
+				globalUniforms->getDescriptorSet(),
+				globalUniforms->getDynamicOffset(weEngineRenderer.getCurrentFrameIndex()),
+				&packet
+			};
+			globalUniforms->update(frameInfo.frameIndex, packet.camera);
+
+			if (gpuDrivenRenderSystem)
+			{
+				gpuDrivenRenderSystem->cullGameObjects(frameInfo);
+			}
+
+			weEngineRenderer.beginSwapChainRenderPass(commandBuffer, renderSystem ? renderSystem->getSubpassContents() : VK_SUBPASS_CONTENTS_INLINE);
+			if (gpuDrivenRenderSystem)
+			{
+				gpuDrivenRenderSystem->renderGameObjects(frameInfo);
+			}
+			else
+			{
+				renderSystem->renderGameObjects(frameInfo);
+			}
+			weEngineRenderer.endSwapChainRenderPass(commandBuffer);
+
+			//Draws the objects the depth of the frame shows in front of its occluders, that the depth of the previous frame hid
+			if (gpuDrivenRenderSystem && gpuDrivenRenderSystem->isOcclusionCullingEnabled())
+			{
+				gpuDrivenRenderSystem->cullOccludedObjects(
+					frameInfo,
+					weEngineRenderer.getCurrentDepthImage(),
+					weEngineRenderer.getCurrentDepthImageView());
+				weEngineRenderer.resumeSwapChainRenderPass(commandBuffer);
+				gpuDrivenRenderSystem->renderDisoccludedObjects(frameInfo);
+				weEngineRenderer.endSwapChainRenderPass(commandBuffer);
+			}
+			weEngineRenderer.endFrame();
+		}
+
+		if (packet.isPrintingStatistics)
+		{
+			printRenderStatistics();
+		}
+	}
+
+	void ApplicationEngine::printSimulationStatistics(const weEngineFramePacket& packet, const weEngineRenderThread* renderThread) const
+	{
+		std::cout << "Simulation: tick " << packet.tickNumber << " at " << simulationTickRate << " ticks per second, " << packet.tickCount
+			<< " ticks this frame, drawn at " << packet.interpolationAlpha << " of the last tick, " << droppedTickCount << " ticks dropped" << std::endl;
+
+		const weEngineWorld::Statistics worldStatistics = world.getStatistics();
+		std::cout << "World: " << worldStatistics.entityCount << " entities in " << worldStatistics.archetypeCount << " archetypes and "
+			<< worldStatistics.chunkCount << " chunks" << std::endl;
+
+		const weEngineTransformSystem::Statistics& transformStatistics = packet.transforms.getStatistics();
+		std::cout << "Transforms (" << weEngineTransformSystem::getKernelName() << "): " << transformStatistics.updatedCount << " of "
+			<< transformStatistics.transformCount << " matrices rebuilt in " << transformStatistics.batchCount << " batches by "
+			<< transformStatistics.updateTaskCount << " tasks in " << transformStatistics.updateMilliseconds << " ms" << std::endl;
+
+		//Task time above the execution time is the work the overlapping tasks did at the same time
+		const weEngineTaskGraph::Statistics& graphStatistics = frameGraph.getStatistics();
+		std::cout << "Frame graph: " << graphStatistics.taskCount << " tasks (" << graphStatistics.mainThreadTaskCount << " on the main thread) with "
+			<< graphStatistics.dependencyCount << " dependencies, executed in " << graphStatistics.executeMilliseconds << " ms for "
+			<< graphStatistics.taskMilliseconds << " ms of tasks" << std::endl;
+
+		//A game thread often waiting for packets is held back by the recording, an empty queue means the simulation is the slower side
+		if (renderThread)
+		{
+			const weEngineRenderThread::Statistics renderThreadStatistics = renderThread->getStatistics();
+			std::cout << "Render thread: " << renderThreadStatistics.renderedPacketCount << " packets rendered, "
+				<< renderThreadStatistics.queuedPacketCount << " queued, last recorded in " << renderThreadStatistics.renderMilliseconds << " ms, "
+				<< renderThreadStatistics.backPressureCount << " waits for a packet (last " << renderThreadStatistics.backPressureMilliseconds << " ms)" << std::endl;
+		}
+	}
+
+	//The occlusion buffer of the last frame drawn from the CPU is written next to the executable with its counters, the GPU path prints its counters
+	void ApplicationEngine::printRenderStatistics() const
+	{
+		if (renderSystem)
+		{
+			renderSystem->writeOcclusionDebugImage("occlusion.pgm");
+			const weEngineOcclusionCuller::Statistics& occlusionStatistics = renderSystem->getOcclusionStatistics();
+			std::cout << "Occlusion buffer written to occlusion.pgm (" << weEngineOcclusionCuller::getKernelName() << "): "
+				<< occlusionStatistics.occluderCount << " occluders, "
+				<< occlusionStatistics.rasterizedTriangleCount << " of " << occlusionStatistics.occluderTriangleCount << " triangles rasterized in "
+				<< occlusionStatistics.rasterizeMilliseconds << " ms, "
+				<< occlusionStatistics.occludedCount << " of " << occlusionStatistics.occludeeCount << " objects occluded in "
+				<< occlusionStatistics.testMilliseconds << " ms" << std::endl;
+
+			const SimpleRenderingSystem::Statistics& drawStatistics = renderSystem->getStatistics();
+			const weEngineRenderQueue::Statistics& queueStatistics = renderSystem->getRenderQueueStatistics();
+			std::cout << "Render queue: " << queueStatistics.entryCount << " draws sorted in " << queueStatistics.sortMilliseconds << " ms ("
+				<< queueStatistics.radixPassCount << " radix passes, " << queueStatistics.sortTaskCount << " tasks), "
+				<< drawStatistics.pipelineBindCount << " pipeline binds (" << drawStatistics.skippedPipelineBindCount << " skipped), "
+				<< drawStatistics.modelBindCount << " model binds (" << drawStatistics.skippedModelBindCount << " skipped), recorded in "
+				<< drawStatistics.recordMilliseconds << " ms by " << drawStatistics.recordingTaskCount << " tasks" << std::endl;
+		}
+		if (gpuDrivenRenderSystem)
+		{
+			const GpuDrivenRenderingSystem::Statistics& gpuStatistics = gpuDrivenRenderSystem->getStatistics();
+			std::cout << "GPU culling" << (gpuStatistics.occlusionCulling ? " with the depth pyramid: " : " without occlusion culling: ")
+				<< gpuStatistics.visibleDrawCount << " draws (" << gpuStatistics.disoccludedDrawCount << " in the second phase), "
+				<< gpuStatistics.retestedObjectCount << " objects retested, "
+				<< gpuStatistics.disoccludedObjectCount << " disoccluded" << std::endl;
+			if (gpuDrivenRenderSystem->isCullingValidationEnabled())
+			{
+				std::cout << "Culling validation: " << gpuStatistics.gpuFrustumObjectCount << " objects inside the frustum on the GPU, "
+					<< gpuStatistics.cpuFrustumObjectCount << " on the CPU, " << gpuStatistics.cullingMismatchCount << " frames differed" << std::endl;
+			}
+		}
+	}
+
+	/*
+	* Creates the entities of the app.
 	*/
 	void ApplicationEngine::loadGameObjects()
 	{
-		std::shared_ptr<weEngineModel> weEngineModel = weEngineModel::createModelFromFile(weEngineDevice, "models\\backpack\\backpack.obj");
+		weEngineModel::LoadSettings loadSettings{};
+		loadSettings.createOccluder = true;
+		std::shared_ptr<weEngineModel> weEngineModel = weEngineModel::createModelFromFile(weEngineDevice, "models\\backpack\\backpack.obj", loadSettings);
+
+		TransformComponent transform{};
+		transform.translation = { 0.0f, 0.0f, 2.5f };
+		transform.scale = { 1.0f, 1.0f, 1.0f };
+
+		world.createEntity(transform, ModelComponent{ weEngineModel }, ColorComponent{}, OccluderComponent{});
+	}
+
+	/*
+	* The transform system is indexed like the entities. A destroyed entity leaves its last transform behind, which is overwritten
+	* and marked dirty when the index is reused by an entity with another transform. The entities without a previous transform are
+	* not moved by the ticks and are drawn where they are, the interpolation leaves the ones that did not move unchanged so they stay clean.
+	*/
+	void ApplicationEngine::updateTransforms(weEngineFramePacket& packet)
+	{
+		weEngineTransformSystem& transformSystem = packet.transforms;
+		transformSystem.resize(world.getIndexCapacity());
+		world.forEachChunk<TransformComponent, ModelComponent, ColorComponent>([&](const weEngineEntity* entities, uint32_t count, TransformComponent* transforms, ModelComponent*, ColorComponent*)
+			{
+				//All the entities of a chunk have the same components
+				if (count == 0 || !world.hasComponent<PreviousTransformComponent>(entities[0]))
+				{
+					for (uint32_t i = 0; i < count; i++)
+					{
+						transformSystem.set(entities[i].index, transforms[i]);
+					}
+					return;
+				}
 
-		auto gameObj = weEngineGameObject::createGameObject();
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const PreviousTransformComponent* previous = world.getComponent<PreviousTransformComponent>(entities[i]);
+					transformSystem.set(entities[i].index, previous->transform.interpolate(transforms[i], packet.interpolationAlpha));
+				}
+			});
 
-		gameObj.model = weEngineModel;
-		gameObj.transformComp.translation = { 0.0f, 0.0f, 2.5f };
-		gameObj.transformComp.scale = { 1.0f, 1.0f, 1.0f };
-		
-		gameObjects.push_back(std::move(gameObj));
+		transformSystem.updateMatrices();
+	}
+
+	/*
+	* The leaves of the entities destroyed or no longer drawn are removed first, so an index reused by a new entity gets a new leaf.
+	* A moved entity refits the hierarchy only when it leaves the enlarged box of its leaf, and the hierarchy is rebuilt once enough leaves were refitted.
+	*/
+	void ApplicationEngine::updateSceneBvh(weEngineFramePacket& packet)
+	{
+		weEngineBvh& sceneBvh = packet.sceneBvh;
+		std::vector<uint32_t>& sceneProxies = packet.sceneProxies;
+		std::vector<weEngineEntity>& sceneEntities = packet.sceneEntities;
+		const weEngineTransformSystem& transformSystem = packet.transforms;
+
+		sceneProxies.resize(world.getIndexCapacity(), weEngineBvh::NULL_NODE);
+		sceneEntities.resize(world.getIndexCapacity());
+
+		for (uint32_t index = 0; index < sceneProxies.size(); index++)
+		{
+			if (sceneProxies[index] != weEngineBvh::NULL_NODE && !world.hasComponents<TransformComponent, ModelComponent, ColorComponent>(sceneEntities[index]))
+			{
+				sceneBvh.remove(sceneProxies[index]);
+				sceneProxies[index] = weEngineBvh::NULL_NODE;
+			}
+		}
+
+		for (uint32_t index : transformSystem.getUpdatedIndices())
+		{
+			if (sceneProxies[index] != weEngineBvh::NULL_NODE)
+			{
+				const weEngineModel::Bounds& bounds = world.getComponent<ModelComponent>(sceneEntities[index])->model->getBounds();
+				sceneBvh.update(sceneProxies[index], weEngineAabb{ bounds.minimum, bounds.maximum }.transform(transformSystem.getMatrix(index)));
+			}
+		}
+
+		world.forEachChunk<TransformComponent, ModelComponent, ColorComponent>([&](const weEngineEntity* entities, uint32_t count, TransformComponent*, ModelComponent* models, ColorComponent*)
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const uint32_t index = entities[i].index;
+					if (sceneProxies[index] == weEngineBvh::NULL_NODE)
+					{
+						const weEngineModel::Bounds& bounds = models[i].model->getBounds();
+						sceneProxies[index] = sceneBvh.insert(weEngineAabb{ bounds.minimum, bounds.maximum }.transform(transformSystem.getMatrix(index)), index);
+						sceneEntities[index] = entities[i];
+					}
+				}
+			});
+
+		sceneBvh.rebuildIfNeeded();
+	}
+
+	/*
+	* The objects are written in the order of the chunks, the chunks in parallel. A model is only copied when another model took
+	* the place of the object, so a scene that does not change keeps the reference counts of its models out of the loop.
+	*/
+	void ApplicationEngine::extractRenderObjects(weEngineFramePacket& packet)
+	{
+		packet.objects.resize(world.count<TransformComponent, ModelComponent, ColorComponent>());
+		packet.objectIndices.assign(world.getIndexCapacity(), weEngineFramePacket::NULL_OBJECT);
+
+		std::vector<uint32_t> chunkFirstObjects; //First object of every chunk of the query
+		uint32_t objectCount = 0;
+		world.forEachChunk<TransformComponent, ModelComponent, ColorComponent>([&](const weEngineEntity* entities, uint32_t count, TransformComponent*, ModelComponent*, ColorComponent*)
+			{
+				chunkFirstObjects.push_back(objectCount);
+				for (uint32_t i = 0; i < count; i++)
+				{
+					packet.objectIndices[entities[i].index] = objectCount++;
+				}
+			});
+
+		world.parallelForEachChunk<TransformComponent, ModelComponent, ColorComponent>([&](uint32_t chunkIndex, const weEngineEntity* entities, uint32_t count, TransformComponent* transforms, ModelComponent* models, ColorComponent* colors)
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					weEngineRenderObject& object = packet.objects[chunkFirstObjects[chunkIndex] + i];
+					object.entityIndex = entities[i].index;
+					if (object.model != models[i].model)
+					{
+						object.model = models[i].model;
+					}
+					object.color = colors[i].color;
+
+					const glm::vec3& scale = transforms[i].scale;
+					object.maxScale = std::max({ glm::abs(scale.x), glm::abs(scale.y), glm::abs(scale.z) });
+					object.isOccluder = world.hasComponent<OccluderComponent>(entities[i]);
+				}
+			});
+	}
+
+	/*
+	* Casts a ray from the camera through the cursor. The hierarchy finds the leaves on the ray, which are then tested with the exact box of their object.
+	*/
+	void ApplicationEngine::pickGameObject(const weEngineFramePacket& packet)
+	{
+		const weEngineCamera& camera = packet.camera;
+		double cursorX, cursorY;
+		int width, height;
+		glfwGetCursorPos(weEngineWindow.getGLFWwindow(), &cursorX, &cursorY);
+		glfwGetWindowSize(weEngineWindow.getGLFWwindow(), &width, &height);
+		if (width == 0 || height == 0)
+		{
+			return;
+		}
+
+		const glm::vec2 cursor{ 2.0f * static_cast<float>(cursorX) / width - 1.0f, 2.0f * static_cast<float>(cursorY) / height - 1.0f };
+		const glm::mat4 inverseProjectionView = glm::inverse(camera.getProjection() * camera.getView());
+		const glm::vec4 nearPoint = inverseProjectionView * glm::vec4(cursor, 0.0f, 1.0f);
+		const glm::vec4 farPoint = inverseProjectionView * glm::vec4(cursor, 1.0f, 1.0f);
+
+		const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		const glm::vec3 target = glm::vec3(farPoint) / farPoint.w;
+		const glm::vec3 direction = glm::normalize(target - origin);
+		const glm::vec3 inverseDirection = 1.0f / direction;
+
+		weEngineBvh::RayHit hit;
+		const bool found = packet.sceneBvh.raycast(origin, direction, glm::length(target - origin), [&](uint32_t objectIndex, float maxDistance)
+			{
+				const weEngineModel::Bounds& bounds = world.getComponent<ModelComponent>(world.getEntity(objectIndex))->model->getBounds();
+				const weEngineAabb objectBounds = weEngineAabb{ bounds.minimum, bounds.maximum }.transform(packet.transforms.getMatrix(objectIndex));
+
+				float distance;
+				return objectBounds.intersectRay(origin, inverseDirection, maxDistance, distance) ? distance : -1.0f;
+			}, hit);
+
+		if (found)
+		{
+			const weEngineEntity entity = world.getEntity(hit.userData);
+			std::cout << "Picked entity " << entity.index << " (generation " << entity.generation << ") at a distance of " << hit.distance << std::endl;
+		}
+		else
+		{
+			std::cout << "No entity under the cursor" << std::endl;
+		}
 	}
 
 
@@ -1,12 +1,22 @@
 #pragma once
 
 #include "weEngineWindow.hpp"
-#include "weEngineGameObject.hpp"
+#include "weEngineComponents.hpp"
+#include "weEngineWorld.hpp"
 #include "weEngineDevice.hpp"
 #include "weEngineRenderer.hpp"
 #include "weEngineCamera.hpp"
+#include "weEngineFramePacket.hpp"
+#include "weEngineTaskGraph.hpp"
+#include "weEngineRenderThread.hpp"
+#include "weEngineGlobalUniforms.hpp"
+#include "SimpleRenderingSystem.hpp"
+#include "GpuDrivenRenderingSystem.hpp"
+#include "keyboardController.hpp"
+#include "mouseController.hpp"
 
 //std
+#include "array"
 #include "memory"
 #include "vector"
 
@@ -24,19 +34,97 @@ namespace weEngine {
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
 
+		//Culls and draws the objects with compute and indirect draws when the device supports it
+		static constexpr bool ENABLE_GPU_DRIVEN_RENDERING = true;
+
+		//Records and submits the frames on a render thread fed with frame packets, otherwise the frame graph records them on the job system
+		static constexpr bool ENABLE_RENDER_THREAD = true;
+
 		ApplicationEngine();
 		~ApplicationEngine();
 
 		ApplicationEngine(const ApplicationEngine&) = delete;
 		ApplicationEngine& operator=(const ApplicationEngine&) = delete;
 
+		//Simulation ticks per second until setSimulationTickRate changes it
+		static constexpr float DEFAULT_SIMULATION_TICK_RATE = 60.0f;
+
+		//Ticks simulated at most by a frame, the time beyond them is dropped so a slow frame does not make the next ones slower still
+		static constexpr uint32_t MAX_TICKS_PER_FRAME = 5;
+
+		//Packets the frames are simulated into: one being simulated, one being recorded and, with the render thread, one queued
+		static constexpr uint32_t FRAME_PACKET_COUNT = 3;
+
 		void run();
+
+		//Simulation ticks per second, the world moves by the same steps whatever the frame rate. Takes effect from the next frame
+		void setSimulationTickRate(float ticksPerSecond);
+		float getSimulationTickRate() const { return simulationTickRate; }
 	private:
+		//Resources of the frame graph standing for the parts of a frame packet
+		struct PacketResources
+		{
+			weEngineTaskGraph::ResourceId view; //Camera and frame time
+			weEngineTaskGraph::ResourceId transforms;
+			weEngineTaskGraph::ResourceId scene; //Scene hierarchy and its proxies
+			weEngineTaskGraph::ResourceId objects;
+		};
+
 		void loadGameObjects();
 
+		//Adds the tasks simulating the ticks of a frame into the packet to the frame graph, the input is read on the main thread
+		void addSimulationTasks(uint32_t packetIndex, uint32_t tickCount, float tickTime, float aspectRatio);
+
+		//Moves the world by one tick of the simulation, keeping the transforms it started from
+		void simulateTick(float tickTime);
+
+		//Records and submits the frame of the packet, on the thread owning the renderer
+		void recordFrame(weEngineFramePacket& packet);
+
+		//Prints the counters of the world, the transforms and the frame graph, and of the render thread when there is one
+		void printSimulationStatistics(const weEngineFramePacket& packet, const weEngineRenderThread* renderThread) const;
+
+		//Prints the counters of the rendering systems and writes the occlusion buffer of the CPU path, on the thread owning the renderer
+		void printRenderStatistics() const;
+
+		//Copies the transforms of the drawn entities, interpolated between the last two ticks, into the transform system of the packet and rebuilds the world matrices of the ones that changed
+		void updateTransforms(weEngineFramePacket& packet);
+
+		//Inserts the new drawn entities into the scene hierarchy of the packet, removes the destroyed ones and updates the ones whose transform changed
+		void updateSceneBvh(weEngineFramePacket& packet);
+
+		//Copies the model, color and flags of the drawn entities into the packet
+		void extractRenderObjects(weEngineFramePacket& packet);
+
+		//Prints the entity under the cursor, found by casting a ray through the scene hierarchy of the packet
+		void pickGameObject(const weEngineFramePacket& packet);
+
 		weEngineWindow weEngineWindow{ WIDTH, HEIGHT, "Hello from Vulkan" };
 		weEngineDevice weEngineDevice{ weEngineWindow };
 		weEngineRenderer weEngineRenderer{weEngineWindow, weEngineDevice};
-		std::vector<weEngineGameObject> gameObjects;
+		weEngineWorld world;
+
+		std::array<weEngineFramePacket, FRAME_PACKET_COUNT> framePackets;
+
+		//Tasks of the frame, the resources stand for the world, the renderer and the parts of every packet
+		weEngineTaskGraph frameGraph;
+		weEngineTaskGraph::ResourceId worldResource = 0;
+		weEngineTaskGraph::ResourceId rendererResource = 0; //Swap chain, rendering systems and global uniforms
+		std::array<PacketResources, FRAME_PACKET_COUNT> packetResources{};
+
+		//Created by run, only used by the thread owning the renderer
+		std::unique_ptr<weEngineGlobalUniforms> globalUniforms; //Camera of every frame in flight, read by the vertex shaders of both rendering paths
+		std::unique_ptr<GpuDrivenRenderingSystem> gpuDrivenRenderSystem;
+		std::unique_ptr<SimpleRenderingSystem> renderSystem;
+
+		KeyboardMovementController cameraController{};
+		MouseMovementController mouseController{};
+		bool wasPicking = false;
+		bool wasPrintingStatistics = false;
+
+		float simulationTickRate = DEFAULT_SIMULATION_TICK_RATE;
+		float tickAccumulator = 0.0f; //Time the simulation is behind the frames, less than a tick after the ticks of a frame
+		uint64_t tickNumber = 0;
+		uint64_t droppedTickCount = 0; //Ticks skipped by the frames that were behind more than MAX_TICKS_PER_FRAME
 	};
 }
\ No newline at end of file
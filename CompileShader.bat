@@ -3,4 +3,6 @@ set "glslcLocation=C:\VulkanSDK\1.3.296.0\Bin\glslc.exe"
 echo %glslcLocation%
 %glslcLocation% shaders\simpleVertexShader.vert -o shaders\simpleVertexShader.vert.spv
 %glslcLocation% shaders\simpleFragmentShader.frag -o shaders\simpleFragmentShader.frag.spv
+%glslcLocation% shaders\cullObjects.comp -o shaders\cullObjects.comp.spv
+%glslcLocation% shaders\buildDepthPyramid.comp -o shaders\buildDepthPyramid.comp.spv
 pause
\ No newline at end of file
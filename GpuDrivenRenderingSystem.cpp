@@ -0,0 +1,1046 @@
+#include "GpuDrivenRenderingSystem.hpp"
+#include "weEngineSwapChain.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "stdexcept"
+#include "array"
+#include "algorithm"
+#include "cassert"
+#include "cstring"
+#include "iostream"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+using std::make_unique;
+
+
+namespace weEngine
+{
+	//Uniforms of the culling shader, laid out for std140
+	struct CullUniformData {
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 viewDepthPlane; //Gives the view space depth of a world position p as dot(xyz, p) + w
+		glm::mat4 viewProjection;
+		glm::mat4 previousViewProjection; //Camera of the depth the pyramid tested by the first phase was built from
+		glm::vec2 pyramidSize;
+		uint32_t pyramidLevelCount;
+		uint32_t objectCount;
+		float pixelsPerUnitAtUnitDepth;
+		float lodPixelError;
+		uint32_t isPerspective;
+		uint32_t testPreviousPyramid;
+		uint32_t commandCount; //Command slots of one phase
+		uint32_t modelCount;
+		uint32_t validateCulling; //Counts the objects whose box is inside the frustum, like weEngineFrustumCuller
+		uint32_t padding;
+	};
+
+	struct CullPushConstantData {
+		uint32_t phase;
+	};
+
+	struct PyramidPushConstantData {
+		uint32_t sourceSize[2];
+		uint32_t destinationSize[2];
+	};
+
+	static_assert(sizeof(GpuDrivenRenderingSystem::ObjectData) == 96, "ObjectData must match the std430 layout of the culling shader");
+	static_assert(sizeof(CullUniformData) == 288, "CullUniformData must match the std140 layout of the culling shader");
+
+	//Resources read and written by the culling shader
+	enum CullBinding : uint32_t
+	{
+		CULL_BINDING_OBJECTS,
+		CULL_BINDING_MODELS,
+		CULL_BINDING_LODS,
+		CULL_BINDING_RANGES,
+		CULL_BINDING_COMMANDS,
+		CULL_BINDING_COUNTS,
+		CULL_BINDING_RETEST,
+		CULL_BINDING_STORAGE_BUFFER_COUNT,
+		CULL_BINDING_UNIFORMS = CULL_BINDING_STORAGE_BUFFER_COUNT,
+		CULL_BINDING_PYRAMID
+	};
+
+	//Resources of the depth pyramid shader
+	enum PyramidBinding : uint32_t
+	{
+		PYRAMID_BINDING_SOURCE,
+		PYRAMID_BINDING_DESTINATION
+	};
+
+	//Retest count, disoccluded count and count of the objects whose box is inside the frustum, in front of the retested objects
+	static constexpr VkDeviceSize RETEST_HEADER_SIZE = sizeof(uint32_t) * 3;
+
+	static uint32_t previousPowerOfTwo(uint32_t value)
+	{
+		uint32_t power = 1;
+		while (power * 2 <= value)
+		{
+			power *= 2;
+		}
+		return power;
+	}
+
+	GpuDrivenRenderingSystem::GpuDrivenRenderingSystem(weEngine::weEngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, bool depthSampleable) :
+		weEngineDevice(device), occlusionCulling(ENABLE_OCCLUSION_CULLING && depthSampleable)
+	{
+		createDescriptors();
+		createPipelineLayouts(globalSetLayout);
+		createPipelines(renderPass);
+		createPyramidSampler();
+		frames.resize(weEngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		statistics.drawIndirectCount = weEngineDevice.getCapabilities().drawIndirectCount;
+		statistics.occlusionCulling = occlusionCulling;
+	}
+
+	GpuDrivenRenderingSystem::~GpuDrivenRenderingSystem()
+	{
+		for (FrameResources& frame : frames)
+		{
+			for (GpuBuffer* buffer : { &frame.objects, &frame.models, &frame.lods, &frame.ranges, &frame.commands, &frame.counts, &frame.retest, &frame.uniforms, &frame.readback })
+			{
+				if (buffer->buffer != VK_NULL_HANDLE)
+				{
+					weEngineDevice.destroyBuffer(buffer->buffer, buffer->allocation);
+				}
+			}
+		}
+		destroyDepthPyramid();
+		vkDestroySampler(weEngineDevice.device(), pyramidSampler, nullptr);
+		vkDestroyPipelineLayout(weEngineDevice.device(), cullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(weEngineDevice.device(), pyramidPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(weEngineDevice.device(), pipelineLayout, nullptr);
+	}
+
+	bool GpuDrivenRenderingSystem::isSupported(const weEngine::weEngineDevice& device)
+	{
+		const DeviceCapabilities& capabilities = device.getCapabilities();
+		return capabilities.drawIndirectFirstInstance && capabilities.graphicsQueueSupportsCompute;
+	}
+
+	/*
+	* Creates the layouts of the culling set and of the pyramid reduction set, and a pool holding a culling set and a reduction set
+	* per frame in flight, plus a reduction set per pyramid level
+	*/
+	void GpuDrivenRenderingSystem::createDescriptors()
+	{
+		weEngineDescriptorSetLayout::Builder layoutBuilder{ weEngineDevice };
+		for (uint32_t binding = 0; binding < CULL_BINDING_STORAGE_BUFFER_COUNT; binding++)
+		{
+			layoutBuilder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+		}
+		layoutBuilder.addBinding(CULL_BINDING_UNIFORMS, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+		layoutBuilder.addBinding(CULL_BINDING_PYRAMID, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);
+		cullSetLayout = layoutBuilder.build();
+
+		pyramidSetLayout = weEngineDescriptorSetLayout::Builder(weEngineDevice)
+			.addBinding(PYRAMID_BINDING_SOURCE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(PYRAMID_BINDING_DESTINATION, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		const uint32_t frameCount = weEngineSwapChain::MAX_FRAMES_IN_FLIGHT;
+		const uint32_t reduceSetCount = frameCount + MAX_PYRAMID_LEVELS - 1;
+		descriptorPool = weEngineDescriptorPool::Builder(weEngineDevice)
+			.setMaxSets(frameCount + reduceSetCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, CULL_BINDING_STORAGE_BUFFER_COUNT * frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount + reduceSetCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, reduceSetCount)
+			.build();
+	}
+
+	/*
+	* Creates the layouts of the culling pipeline, of the depth pyramid pipeline and of the graphics pipeline
+	*/
+	void GpuDrivenRenderingSystem::createPipelineLayouts(VkDescriptorSetLayout globalSetLayout)
+	{
+		VkPushConstantRange cullPushConstantRange{};
+		cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullPushConstantRange.size = sizeof(CullPushConstantData);
+		cullPushConstantRange.offset = 0;
+
+		const VkDescriptorSetLayout cullDescriptorSetLayout = cullSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo cullPipelineLayoutInfo{};
+		cullPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		cullPipelineLayoutInfo.setLayoutCount = 1;
+		cullPipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+		cullPipelineLayoutInfo.pushConstantRangeCount = 1;
+		cullPipelineLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+
+		if (vkCreatePipelineLayout(weEngineDevice.device(), &cullPipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+
+		VkPushConstantRange pyramidPushConstantRange{};
+		pyramidPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pyramidPushConstantRange.size = sizeof(PyramidPushConstantData);
+		pyramidPushConstantRange.offset = 0;
+
+		const VkDescriptorSetLayout pyramidDescriptorSetLayout = pyramidSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pyramidPipelineLayoutInfo{};
+		pyramidPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pyramidPipelineLayoutInfo.setLayoutCount = 1;
+		pyramidPipelineLayoutInfo.pSetLayouts = &pyramidDescriptorSetLayout;
+		pyramidPipelineLayoutInfo.pushConstantRangeCount = 1;
+		pyramidPipelineLayoutInfo.pPushConstantRanges = &pyramidPushConstantRange;
+
+		if (vkCreatePipelineLayout(weEngineDevice.device(), &pyramidPipelineLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &globalSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(weEngineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+	}
+
+	/*
+	* Creates the culling pipeline, the depth pyramid pipeline and the graphics pipeline. The graphics pipeline uses the simple shaders,
+	* with the object buffer as its instance buffer.
+	*/
+	void GpuDrivenRenderingSystem::createPipelines(VkRenderPass renderPass)
+	{
+		cullPipeline = make_unique<weEngineComputePipeline>(
+			weEngineDevice,
+			"shaders\\cullObjects.comp.spv",
+			cullPipelineLayout);
+
+		pyramidPipeline = make_unique<weEngineComputePipeline>(
+			weEngineDevice,
+			"shaders\\buildDepthPyramid.comp.spv",
+			pyramidPipelineLayout);
+
+		PipelineConfigInfo pipelineConfig{};
+		weEnginePipeline::defaultPipelineConfigInfo(
+			pipelineConfig
+		);
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+
+		constexpr auto attributeDescriptions = weEngineModel::VertexLayout::getAttributeDescriptions<VERTEX_ATTRIBUTES>();
+		pipelineConfig.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+
+		VkVertexInputBindingDescription instanceBinding{};
+		instanceBinding.binding = INSTANCE_BINDING;
+		instanceBinding.stride = sizeof(ObjectData);
+		instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		pipelineConfig.bindingDescriptions.push_back(instanceBinding);
+
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			pipelineConfig.attributeDescriptions.push_back({
+				INSTANCE_LOCATION + column,
+				INSTANCE_BINDING,
+				VK_FORMAT_R32G32B32A32_SFLOAT,
+				static_cast<uint32_t>(offsetof(ObjectData, transform) + sizeof(glm::vec4) * column) });
+		}
+		pipelineConfig.attributeDescriptions.push_back({
+			INSTANCE_LOCATION + 4,
+			INSTANCE_BINDING,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			static_cast<uint32_t>(offsetof(ObjectData, color)) });
+
+		weEnginePipeline = make_unique<weEngine::weEnginePipeline>(
+			weEngineDevice,
+			"shaders\\simpleVertexShader.vert.spv",
+			"shaders\\simpleFragmentShader.frag.spv",
+			pipelineConfig);
+	}
+
+	//The shaders read the texels with texelFetch, the sampler only has to be valid
+	void GpuDrivenRenderingSystem::createPyramidSampler()
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		if (vkCreateSampler(weEngineDevice.device(), &samplerInfo, nullptr, &pyramidSampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the depth pyramid sampler");
+		}
+	}
+
+	/*
+	* Creates the pyramid for a depth buffer of the given extent and leaves it in VK_IMAGE_LAYOUT_GENERAL, where the reduction writes
+	* and the culling reads it. The pyramid must not be in use by the GPU.
+	*/
+	void GpuDrivenRenderingSystem::createDepthPyramid(VkExtent2D sourceExtent)
+	{
+		destroyDepthPyramid();
+
+		depthExtent = sourceExtent;
+		pyramidExtent = { previousPowerOfTwo(sourceExtent.width), previousPowerOfTwo(sourceExtent.height) };
+		pyramidLevelCount = 1;
+		while (pyramidLevelCount < MAX_PYRAMID_LEVELS && (std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevelCount) > 0)
+		{
+			pyramidLevelCount++;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = pyramidExtent.width;
+		imageInfo.extent.height = pyramidExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = pyramidLevelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		weEngineDevice.createImageWithInfo(
+			imageInfo,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			pyramidImage,
+			pyramidAllocation,
+			"depth pyramid");
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramidImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = pyramidLevelCount;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(weEngineDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the depth pyramid view");
+		}
+
+		pyramidLevelViews.resize(pyramidLevelCount, VK_NULL_HANDLE);
+		for (uint32_t level = 0; level < pyramidLevelCount; level++)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(weEngineDevice.device(), &viewInfo, nullptr, &pyramidLevelViews[level]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create the depth pyramid level view");
+			}
+		}
+
+		//The sets of the levels are kept across pyramids, only overwritten
+		pyramidReduceSets.resize(std::max<size_t>(pyramidReduceSets.size(), pyramidLevelCount), VK_NULL_HANDLE);
+		for (uint32_t level = 1; level < pyramidLevelCount; level++)
+		{
+			VkDescriptorImageInfo sourceInfo{ pyramidSampler, pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+			weEngineDescriptorWriter writer{ *pyramidSetLayout, *descriptorPool };
+			writer.writeImage(PYRAMID_BINDING_SOURCE, &sourceInfo);
+			writer.writeImage(PYRAMID_BINDING_DESTINATION, &destinationInfo);
+			if (pyramidReduceSets[level] == VK_NULL_HANDLE)
+			{
+				if (!writer.build(pyramidReduceSets[level]))
+				{
+					throw std::runtime_error("Failed to allocate the depth pyramid descriptor set");
+				}
+			}
+			else
+			{
+				writer.overwrite(pyramidReduceSets[level]);
+			}
+		}
+
+		VkCommandBuffer commandBuffer = weEngineDevice.beginSingleTimeCommands();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramidImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = pyramidLevelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		weEngineDevice.endSingleTimeCommands(commandBuffer);
+
+		pyramidGeneration++;
+		hasPyramid = false;
+	}
+
+	void GpuDrivenRenderingSystem::destroyDepthPyramid()
+	{
+		for (VkImageView& view : pyramidLevelViews)
+		{
+			vkDestroyImageView(weEngineDevice.device(), view, nullptr);
+		}
+		pyramidLevelViews.clear();
+
+		if (pyramidView != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(weEngineDevice.device(), pyramidView, nullptr);
+			pyramidView = VK_NULL_HANDLE;
+		}
+		if (pyramidImage != VK_NULL_HANDLE)
+		{
+			weEngineDevice.destroyImage(pyramidImage, pyramidAllocation);
+			pyramidImage = VK_NULL_HANDLE;
+		}
+	}
+
+	/*
+	* Grows the buffer to hold at least size bytes, returns true when it was recreated and the descriptor set has to be written again.
+	* Growing is safe because the renderer waited for the previous use of the frame before it started recording it again.
+	*/
+	bool GpuDrivenRenderingSystem::reserveBuffer(GpuBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* name)
+	{
+		if (size <= buffer.size)
+		{
+			return false;
+		}
+
+		if (buffer.buffer != VK_NULL_HANDLE)
+		{
+			weEngineDevice.destroyBuffer(buffer.buffer, buffer.allocation);
+		}
+
+		buffer.size = std::max(size, buffer.size * 2);
+		weEngineDevice.createBuffer(
+			buffer.size,
+			usage,
+			properties,
+			buffer.buffer,
+			buffer.allocation,
+			weEngineMemoryUsage::LONG_LIVED,
+			name
+		);
+		return true;
+	}
+
+	void GpuDrivenRenderingSystem::writeDescriptorSet(FrameResources& frame)
+	{
+		std::array<VkDescriptorBufferInfo, CULL_BINDING_UNIFORMS + 1> bufferInfos{};
+		const std::array<const GpuBuffer*, CULL_BINDING_UNIFORMS + 1> buffers{
+			&frame.objects, &frame.models, &frame.lods, &frame.ranges, &frame.commands, &frame.counts, &frame.retest, &frame.uniforms };
+
+		weEngineDescriptorWriter writer{ *cullSetLayout, *descriptorPool };
+		for (uint32_t binding = 0; binding <= CULL_BINDING_UNIFORMS; binding++)
+		{
+			bufferInfos[binding].buffer = buffers[binding]->buffer;
+			bufferInfos[binding].offset = 0;
+			bufferInfos[binding].range = VK_WHOLE_SIZE;
+			writer.writeBuffer(binding, &bufferInfos[binding]);
+		}
+
+		VkDescriptorImageInfo pyramidInfo{ pyramidSampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+		writer.writeImage(CULL_BINDING_PYRAMID, &pyramidInfo);
+		frame.pyramidGeneration = pyramidGeneration;
+
+		if (frame.descriptorSet == VK_NULL_HANDLE)
+		{
+			if (!writer.build(frame.descriptorSet))
+			{
+				throw std::runtime_error("Failed to allocate the culling descriptor set");
+			}
+		}
+		else
+		{
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+
+	/*
+	* Copies the draw counts of both phases and the retest counts to the readback buffer, once the last culling phase of the frame was recorded
+	*/
+	void GpuDrivenRenderingSystem::copyStatistics(VkCommandBuffer commandBuffer, FrameResources& frame)
+	{
+		const VkDeviceSize countsSize = sizeof(uint32_t) * CULL_PHASE_COUNT * frame.batches.size();
+
+		VkBufferCopy countCopy{};
+		countCopy.size = countsSize;
+		vkCmdCopyBuffer(commandBuffer, frame.counts.buffer, frame.readback.buffer, 1, &countCopy);
+
+		VkBufferCopy retestCopy{};
+		retestCopy.dstOffset = countsSize;
+		retestCopy.size = RETEST_HEADER_SIZE;
+		vkCmdCopyBuffer(commandBuffer, frame.retest.buffer, frame.readback.buffer, 1, &retestCopy);
+
+		VkMemoryBarrier readbackBarrier{};
+		readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+		frame.readbackCount = static_cast<uint32_t>(frame.batches.size());
+	}
+
+	/*
+	* Sums the draw counts the culling left during the previous use of the frame, which completed before the frame was recorded again
+	*/
+	void GpuDrivenRenderingSystem::readBackStatistics(FrameResources& frame)
+	{
+		if (frame.readbackCount == 0)
+		{
+			return;
+		}
+
+		const uint32_t* counts = static_cast<const uint32_t*>(frame.readback.allocation.mappedData);
+		uint32_t phaseDrawCounts[CULL_PHASE_COUNT]{};
+		for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; phase++)
+		{
+			for (uint32_t i = 0; i < frame.readbackCount; i++)
+			{
+				phaseDrawCounts[phase] += counts[phase * frame.readbackCount + i];
+			}
+		}
+		const uint32_t* retestCounts = counts + CULL_PHASE_COUNT * frame.readbackCount;
+
+		statistics.visibleDrawCount = phaseDrawCounts[0] + phaseDrawCounts[1];
+		statistics.disoccludedDrawCount = phaseDrawCounts[1];
+		statistics.retestedObjectCount = retestCounts[0];
+		statistics.disoccludedObjectCount = retestCounts[1];
+
+		if (frame.validatedCulling)
+		{
+			//Objects right on a plane may fall on either side, the shader and the CPU round the transformed boxes differently
+			statistics.gpuFrustumObjectCount = retestCounts[2];
+			statistics.cpuFrustumObjectCount = frame.cpuFrustumObjectCount;
+			if (statistics.gpuFrustumObjectCount != statistics.cpuFrustumObjectCount)
+			{
+				statistics.cullingMismatchCount++;
+				std::cerr << "GPU culling found " << statistics.gpuFrustumObjectCount << " objects inside the frustum, the CPU culler found "
+					<< statistics.cpuFrustumObjectCount << std::endl;
+			}
+		}
+	}
+
+	/*
+	* Culls the world boxes of the objects the shader culls, the ones of the models with an index buffer, with weEngineFrustumCuller.
+	* Returns how many are inside the frustum.
+	*/
+	uint32_t GpuDrivenRenderingSystem::cullOnCpu(const weEngineFramePacket& packet, const std::array<glm::vec4, 6>& frustumPlanes)
+	{
+		validationCuller.clear();
+		validationCuller.reserve(packet.objects.size());
+		for (const weEngineRenderObject& renderObject : packet.objects)
+		{
+			if (renderObject.model->hasIndexBuffer())
+			{
+				const weEngineModel::Bounds& bounds = renderObject.model->getBounds();
+				validationCuller.addTransformedBox(packet.transforms.getMatrix(renderObject.entityIndex), bounds.minimum, bounds.maximum);
+			}
+		}
+
+		validationCuller.cull(frustumPlanes, validationVisibleIndices);
+		return validationCuller.getStatistics().visibleCount;
+	}
+
+	void GpuDrivenRenderingSystem::dispatchCulling(VkCommandBuffer commandBuffer, FrameResources& frame, uint32_t phase)
+	{
+		CullPushConstantData push{};
+		push.phase = phase;
+
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstantData), &push);
+		//The second phase does not know how many objects were kept, its invocations past the retest count return at once
+		vkCmdDispatch(commandBuffer, (frame.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GpuDrivenRenderingSystem::cullGameObjects(FrameInfo& frameInfo)
+	{
+		assert(frameInfo.packet != nullptr && "The objects are read from the frame packet");
+		const weEngineFramePacket& packet = *frameInfo.packet;
+
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		readBackStatistics(frame);
+		frame.readbackCount = 0;
+
+		//Without occlusion culling a single texel pyramid keeps the descriptor of the culling shader valid
+		const VkExtent2D sourceExtent = occlusionCulling ? frameInfo.extent : VkExtent2D{ 1, 1 };
+		if (pyramidImage == VK_NULL_HANDLE || sourceExtent.width != depthExtent.width || sourceExtent.height != depthExtent.height)
+		{
+			//The other frame in flight may still read the pyramid
+			{
+				std::lock_guard<std::mutex> queueLock{ weEngineDevice.queueMutex() };
+				vkDeviceWaitIdle(weEngineDevice.device());
+			}
+			createDepthPyramid(sourceExtent);
+		}
+
+		const VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		bool buffersChanged = reserveBuffer(
+			frame.objects,
+			sizeof(ObjectData) * std::max<size_t>(packet.objects.size(), MIN_OBJECT_CAPACITY),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			hostMemory,
+			"object buffer");
+
+		/*
+		* Gives every model an index in the order they are first seen, on this thread since the models are shared.
+		* The objects are written in the order of the packet, which keeps the objects of a chunk of the world together.
+		*/
+		modelIndices.clear();
+		frame.batches.clear();
+		frame.uncullableObjects.clear();
+		objectModelIndices.clear();
+
+		weEngineModel* lastModel = nullptr;
+		uint32_t lastModelIndex = 0;
+		const uint32_t objectCount = static_cast<uint32_t>(packet.objects.size());
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			weEngineModel* model = packet.objects[i].model.get();
+			assert(model != nullptr && "Drawn objects must have a model");
+			if (model != lastModel)
+			{
+				const auto inserted = modelIndices.emplace(model, static_cast<uint32_t>(frame.batches.size()));
+				if (inserted.second)
+				{
+					frame.batches.push_back({ model, 0, 0, 0 });
+				}
+				lastModel = model;
+				lastModelIndex = inserted.first->second;
+			}
+			frame.batches[lastModelIndex].objectCount++;
+			objectModelIndices.push_back(lastModelIndex);
+
+			if (!model->hasIndexBuffer())
+			{
+				frame.uncullableObjects.push_back({ model, i });
+			}
+		}
+
+		//The tasks write contiguous ranges of objects in parallel
+		ObjectData* objects = static_cast<ObjectData*>(frame.objects.allocation.mappedData);
+		const weEngineTransformSystem& transforms = packet.transforms;
+		const uint32_t writeTaskCount = (objectCount + MIN_OBJECTS_PER_WRITE_TASK - 1) / MIN_OBJECTS_PER_WRITE_TASK;
+		weEngineJobSystem::shared().parallelFor(writeTaskCount, [&](uint32_t task)
+			{
+				const uint32_t endObject = std::min(objectCount, (task + 1) * MIN_OBJECTS_PER_WRITE_TASK);
+				for (uint32_t i = task * MIN_OBJECTS_PER_WRITE_TASK; i < endObject; i++)
+				{
+					const weEngineRenderObject& renderObject = packet.objects[i];
+
+					ObjectData object{};
+					object.transform = transforms.getMatrix(renderObject.entityIndex) * renderObject.model->getDequantizationMatrix();
+					object.color = glm::vec4(renderObject.color, 1.0f);
+					object.modelIndex = objectModelIndices[i];
+					object.maxScale = renderObject.maxScale;
+					objects[i] = object; //Written at once, the buffer may be write combined
+				}
+			});
+
+		frame.objectCount = objectCount;
+		statistics.objectCount = objectCount;
+		statistics.modelCount = static_cast<uint32_t>(frame.batches.size());
+		if (objectCount == 0)
+		{
+			frame.commandCount = 0;
+			statistics.drawCommandCapacity = 0;
+			return;
+		}
+
+		//Every object of a model gets as many command slots as the level of the model with the most draw ranges
+		const DeviceCapabilities& capabilities = weEngineDevice.getCapabilities();
+		modelData.clear();
+		lodData.clear();
+		rangeData.clear();
+		uint32_t commandCount = 0;
+		frame.clearedCommands = false;
+		for (ModelBatch& batch : frame.batches)
+		{
+			const weEngineModel& model = *batch.model;
+
+			ModelData data{};
+			if (model.hasIndexBuffer())
+			{
+				const glm::mat4 quantization = glm::inverse(model.getDequantizationMatrix());
+				const glm::vec4 quantizedCenter = quantization * glm::vec4(model.getBoundingCenter(), 1.0f);
+				data.boundingSphere = glm::vec4(glm::vec3(quantizedCenter), model.getBoundingRadius());
+
+				//The dequantization only scales and translates, so the box stays axis aligned
+				const glm::vec3 boxMinimum = glm::vec3(quantization * glm::vec4(model.getBounds().minimum, 1.0f));
+				const glm::vec3 boxMaximum = glm::vec3(quantization * glm::vec4(model.getBounds().maximum, 1.0f));
+				data.boxCenter = glm::vec4(0.5f * (boxMinimum + boxMaximum), 0.0f);
+				data.boxExtent = glm::vec4(0.5f * glm::abs(boxMaximum - boxMinimum), 0.0f);
+				data.firstLod = static_cast<uint32_t>(lodData.size());
+				data.lodCount = model.getLodCount();
+
+				uint32_t maxRangeCount = 0;
+				for (uint32_t lod = 0; lod < model.getLodCount(); lod++)
+				{
+					const weEngineModel::LodLevel& level = model.getLod(lod);
+					lodData.push_back({ level.error, static_cast<uint32_t>(rangeData.size()), level.rangeCount, 0 });
+					for (uint32_t range = level.firstRange; range < level.firstRange + level.rangeCount; range++)
+					{
+						const weEngineModel::DrawRange& drawRange = model.getDrawRange(range);
+						rangeData.push_back({ drawRange.indexCount, drawRange.firstIndex, drawRange.vertexOffset, 0 });
+					}
+					maxRangeCount = std::max(maxRangeCount, level.rangeCount);
+				}
+
+				batch.commandOffset = commandCount;
+				batch.commandCapacity = batch.objectCount * maxRangeCount;
+				data.commandOffset = commandCount;
+				commandCount += batch.commandCapacity;
+
+				if (!capabilities.drawIndirectCount || batch.commandCapacity > weEngineDevice.properties.limits.maxDrawIndirectCount)
+				{
+					frame.clearedCommands = true;
+				}
+			}
+			modelData.push_back(data);
+		}
+		frame.commandCount = commandCount;
+		statistics.drawCommandCapacity = commandCount;
+
+		const VkDeviceSize modelCount = frame.batches.size();
+		const VkDeviceSize phaseCount = CULL_PHASE_COUNT;
+		buffersChanged |= reserveBuffer(frame.models, sizeof(ModelData) * modelCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, "culling model buffer");
+		buffersChanged |= reserveBuffer(frame.lods, sizeof(LodData) * std::max<size_t>(lodData.size(), 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, "culling lod buffer");
+		buffersChanged |= reserveBuffer(frame.ranges, sizeof(RangeData) * std::max<size_t>(rangeData.size(), 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, "culling range buffer");
+		buffersChanged |= reserveBuffer(
+			frame.commands,
+			sizeof(VkDrawIndexedIndirectCommand) * phaseCount * std::max<VkDeviceSize>(commandCount, 1),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			"indirect command buffer");
+		buffersChanged |= reserveBuffer(
+			frame.counts,
+			sizeof(uint32_t) * phaseCount * modelCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			"indirect count buffer");
+		buffersChanged |= reserveBuffer(
+			frame.retest,
+			RETEST_HEADER_SIZE + sizeof(uint32_t) * objectCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			"occlusion retest buffer");
+		buffersChanged |= reserveBuffer(frame.uniforms, sizeof(CullUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostMemory, "culling uniform buffer");
+		reserveBuffer(frame.readback, sizeof(uint32_t) * phaseCount * modelCount + RETEST_HEADER_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory, "draw count readback buffer");
+
+		if (buffersChanged || frame.pyramidGeneration != pyramidGeneration)
+		{
+			writeDescriptorSet(frame);
+		}
+
+		std::memcpy(frame.models.allocation.mappedData, modelData.data(), sizeof(ModelData) * modelData.size());
+		std::memcpy(frame.lods.allocation.mappedData, lodData.data(), sizeof(LodData) * lodData.size());
+		std::memcpy(frame.ranges.allocation.mappedData, rangeData.data(), sizeof(RangeData) * rangeData.size());
+
+		const VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		//The culling appends to the counts, and leaves the slots it does not fill at zero when every slot is drawn
+		vkCmdFillBuffer(commandBuffer, frame.counts.buffer, 0, sizeof(uint32_t) * phaseCount * modelCount, 0);
+		vkCmdFillBuffer(commandBuffer, frame.retest.buffer, 0, RETEST_HEADER_SIZE, 0);
+		if (frame.clearedCommands && commandCount > 0)
+		{
+			vkCmdFillBuffer(commandBuffer, frame.commands.buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * phaseCount * commandCount, 0);
+		}
+
+		//Also makes the pyramid built by the previous frame visible to the first phase
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		const glm::mat4& projection = frameInfo.camera.getProjection();
+		const glm::mat4& view = frameInfo.camera.getView();
+		const std::array<glm::vec4, 6> frustumPlanes = frameInfo.camera.getFrustumPlanes();
+
+		CullUniformData cullData{};
+		std::copy(frustumPlanes.begin(), frustumPlanes.end(), cullData.frustumPlanes);
+		cullData.viewDepthPlane = glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+		cullData.viewProjection = projection * view;
+		cullData.previousViewProjection = pyramidViewProjection;
+		cullData.pyramidSize = glm::vec2(static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height));
+		cullData.pyramidLevelCount = pyramidLevelCount;
+		cullData.objectCount = objectCount;
+		cullData.pixelsPerUnitAtUnitDepth = projection[1][1] * 0.5f * static_cast<float>(frameInfo.extent.height);
+		cullData.lodPixelError = LOD_PIXEL_ERROR;
+		cullData.isPerspective = projection[2][3] != 0.0f ? 1 : 0;
+		cullData.testPreviousPyramid = occlusionCulling && hasPyramid ? 1 : 0;
+		cullData.commandCount = commandCount;
+		cullData.modelCount = static_cast<uint32_t>(modelCount);
+		cullData.validateCulling = cullingValidation ? 1 : 0;
+		std::memcpy(frame.uniforms.allocation.mappedData, &cullData, sizeof(CullUniformData));
+
+		dispatchCulling(commandBuffer, frame, 0);
+
+		frame.validatedCulling = cullingValidation;
+		if (cullingValidation)
+		{
+			frame.cpuFrustumObjectCount = cullOnCpu(packet, frustumPlanes);
+		}
+
+		//With occlusion culling the statistics are copied once the second phase ran
+		if (!occlusionCulling)
+		{
+			copyStatistics(commandBuffer, frame);
+		}
+	}
+
+	/*
+	* Reduces the depth image to the first level of the pyramid, then every level to the next one. Each texel keeps the farthest depth
+	* of the texels it covers in the level below, so a box is occluded when its nearest depth is behind the texels under it.
+	*/
+	void GpuDrivenRenderingSystem::buildDepthPyramid(VkCommandBuffer commandBuffer, FrameResources& frame, VkImage depthImage, VkImageView depthImageView)
+	{
+		//The depth view belongs to the swap chain image of the frame, which changes from one use of the frame to the next
+		VkDescriptorImageInfo sourceInfo{ pyramidSampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, pyramidLevelViews[0], VK_IMAGE_LAYOUT_GENERAL };
+
+		weEngineDescriptorWriter writer{ *pyramidSetLayout, *descriptorPool };
+		writer.writeImage(PYRAMID_BINDING_SOURCE, &sourceInfo);
+		writer.writeImage(PYRAMID_BINDING_DESTINATION, &destinationInfo);
+		if (frame.depthReduceSet == VK_NULL_HANDLE)
+		{
+			if (!writer.build(frame.depthReduceSet))
+			{
+				throw std::runtime_error("Failed to allocate the depth pyramid descriptor set");
+			}
+		}
+		else
+		{
+			writer.overwrite(frame.depthReduceSet);
+		}
+
+		//The depth drawn by the main pass is read by the reduction, the retest list written by the first phase by the second one,
+		//and the pyramid read by the first phase is written again
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = depthImage;
+		depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		depthBarrier.subresourceRange.baseMipLevel = 0;
+		depthBarrier.subresourceRange.levelCount = 1;
+		depthBarrier.subresourceRange.baseArrayLayer = 0;
+		depthBarrier.subresourceRange.layerCount = 1;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 1, &depthBarrier);
+
+		pyramidPipeline->bind(commandBuffer);
+
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		VkExtent2D sourceSize = depthExtent;
+		VkExtent2D destinationSize = pyramidExtent;
+		for (uint32_t level = 0; level < pyramidLevelCount; level++)
+		{
+			const VkDescriptorSet set = level == 0 ? frame.depthReduceSet : pyramidReduceSets[level];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &set, 0, nullptr);
+
+			PyramidPushConstantData push{ { sourceSize.width, sourceSize.height }, { destinationSize.width, destinationSize.height } };
+			vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidPushConstantData), &push);
+			vkCmdDispatch(commandBuffer,
+				(destinationSize.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				(destinationSize.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				1);
+
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			sourceSize = destinationSize;
+			destinationSize = { std::max(destinationSize.width / 2, 1u), std::max(destinationSize.height / 2, 1u) };
+		}
+
+		//The resume render pass loads the depth again
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+	}
+
+	void GpuDrivenRenderingSystem::cullOccludedObjects(FrameInfo& frameInfo, VkImage depthImage, VkImageView depthImageView)
+	{
+		if (!occlusionCulling)
+		{
+			return;
+		}
+
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		const VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		buildDepthPyramid(commandBuffer, frame, depthImage, depthImageView);
+		pyramidViewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+		hasPyramid = true;
+
+		if (frame.objectCount == 0)
+		{
+			return;
+		}
+
+		dispatchCulling(commandBuffer, frame, 1);
+		copyStatistics(commandBuffer, frame);
+	}
+
+	/*
+	* Records the indirect draws of one culling phase. The counts and command slots of the second phase follow the ones of the first.
+	*/
+	void GpuDrivenRenderingSystem::drawPhase(FrameInfo& frameInfo, FrameResources& frame, uint32_t phase)
+	{
+		const VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		weEnginePipeline->bind(commandBuffer);
+
+		vkCmdBindDescriptorSets(commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			weEngineGlobalUniforms::GLOBAL_SET,
+			1,
+			&frameInfo.globalDescriptorSet,
+			1,
+			&frameInfo.globalDynamicOffset);
+
+		const VkDeviceSize objectOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BINDING, 1, &frame.objects.buffer, &objectOffset);
+
+		const DeviceCapabilities& capabilities = weEngineDevice.getCapabilities();
+		const uint32_t maxDrawIndirectCount = weEngineDevice.properties.limits.maxDrawIndirectCount;
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const uint32_t modelCount = static_cast<uint32_t>(frame.batches.size());
+		for (uint32_t modelIndex = 0; modelIndex < modelCount; modelIndex++)
+		{
+			const ModelBatch& batch = frame.batches[modelIndex];
+			if (batch.commandCapacity == 0)
+			{
+				continue;
+			}
+
+			batch.model->bind(commandBuffer);
+			const VkDeviceSize commandOffset = static_cast<VkDeviceSize>(phase * frame.commandCount + batch.commandOffset) * stride;
+
+			if (capabilities.drawIndirectCount && batch.commandCapacity <= maxDrawIndirectCount)
+			{
+				weEngineDevice.getCmdDrawIndexedIndirectCount()(
+					commandBuffer,
+					frame.commands.buffer,
+					commandOffset,
+					frame.counts.buffer,
+					sizeof(uint32_t) * (phase * modelCount + modelIndex),
+					batch.commandCapacity,
+					stride);
+				statistics.indirectDrawCalls++;
+				continue;
+			}
+
+			//Draws every slot, a draw count above one needs multiDrawIndirect
+			const uint32_t maxDrawCount = capabilities.multiDrawIndirect ? maxDrawIndirectCount : 1;
+			for (uint32_t firstDraw = 0; firstDraw < batch.commandCapacity; firstDraw += maxDrawCount)
+			{
+				vkCmdDrawIndexedIndirect(
+					commandBuffer,
+					frame.commands.buffer,
+					commandOffset + static_cast<VkDeviceSize>(firstDraw) * stride,
+					std::min(maxDrawCount, batch.commandCapacity - firstDraw),
+					stride);
+				statistics.indirectDrawCalls++;
+			}
+		}
+	}
+
+	void GpuDrivenRenderingSystem::renderGameObjects(FrameInfo& frameInfo)
+	{
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		statistics.indirectDrawCalls = 0;
+		if (frame.objectCount == 0)
+		{
+			return;
+		}
+
+		drawPhase(frameInfo, frame, 0);
+
+		//Models without an index buffer are not culled, they are drawn with the first phase
+		//They are in object order, the objects of a model usually follow each other so the model is bound once for them
+		const VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		weEngineModel* boundModel = nullptr;
+		for (const UncullableObject& object : frame.uncullableObjects)
+		{
+			if (object.model != boundModel)
+			{
+				object.model->bind(commandBuffer);
+				boundModel = object.model;
+			}
+			object.model->draw(commandBuffer, 0, 1, object.objectIndex);
+		}
+	}
+
+	void GpuDrivenRenderingSystem::renderDisoccludedObjects(FrameInfo& frameInfo)
+	{
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		if (!occlusionCulling || frame.objectCount == 0)
+		{
+			return;
+		}
+
+		drawPhase(frameInfo, frame, 1);
+	}
+}
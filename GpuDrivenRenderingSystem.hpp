@@ -0,0 +1,275 @@
+#pragma once
+
+#include "weEnginePipeline.hpp"
+#include "weEngineComponents.hpp"
+#include "weEngineDevice.hpp"
+#include "weEngineDescriptors.hpp"
+#include "weEngineFrameInfo.hpp"
+#include "weEngineGlobalUniforms.hpp"
+#include "weEngineFrustumCuller.hpp"
+
+//std
+#include "memory"
+#include "unordered_map"
+#include "vector"
+
+/*
+*
+* GpuDrivenRenderingSystem draws the in-game objects without recording a draw per object. The transform and model of every object
+* are written to a storage buffer, a compute shader tests their bounding spheres against the camera frustum, picks their detail level
+* and appends one indirect draw command per visible draw range. Every model is then drawn with a single vkCmdDrawIndexedIndirectCount,
+* so the commands recorded by the CPU only depend on the number of models.
+*
+* Without VK_KHR_draw_indirect_count the command buffer is cleared before the culling and every model is drawn with vkCmdDrawIndexedIndirect
+* over all of its command slots, the slots left empty by the culling are draws of zero indices.
+*
+* With occlusion culling the culling runs in two phases around the main render pass. The first phase draws the objects in front of
+* the depth pyramid of the previous frame and keeps the others. After the main pass, the depth it drew is reduced to a new pyramid,
+* and the second phase draws the kept objects that are in front of it in the resume render pass. An object appearing from behind
+* an occluder is therefore drawn on the frame it appears, and the pyramid is ready for the next frame.
+*
+*/
+
+namespace weEngine {
+	class GpuDrivenRenderingSystem
+	{
+	public:
+		//Occlusion culling needs a depth buffer the compute shaders can sample
+		GpuDrivenRenderingSystem(weEngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, bool depthSampleable);
+		~GpuDrivenRenderingSystem();
+
+		GpuDrivenRenderingSystem(const GpuDrivenRenderingSystem&) = delete;
+		GpuDrivenRenderingSystem& operator=(const GpuDrivenRenderingSystem&) = delete;
+
+		//The indirect commands pick the object with firstInstance, and the culling runs on the graphics queue
+		static bool isSupported(const weEngineDevice& device);
+
+		//Vertex attributes read by the simple vertex shader
+		static constexpr uint32_t VERTEX_ATTRIBUTES = VERTEX_POSITION_BIT | VERTEX_COLOR_BIT;
+
+		//Largest error, in pixels, a detail level may show on the screen. The levels are picked without hysteresis since the culling keeps no state.
+		static constexpr float LOD_PIXEL_ERROR = 1.0f;
+
+		static constexpr uint32_t INSTANCE_BINDING = 1;
+		static constexpr uint32_t INSTANCE_LOCATION = 4; //First location after the vertex attributes
+		static constexpr uint32_t CULL_GROUP_SIZE = 64; //local_size_x of the culling shader
+		static constexpr uint32_t PYRAMID_GROUP_SIZE = 8; //local_size_x and local_size_y of the depth pyramid shader
+		static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+		static constexpr uint32_t CULL_PHASE_COUNT = 2; //Before and after the depth pyramid of the frame is built
+
+		//Tests the objects inside the frustum against a depth pyramid, when the depth buffer can be sampled
+		static constexpr bool ENABLE_OCCLUSION_CULLING = true;
+
+		//Default of setCullingValidation
+	#ifdef NDEBUG
+		static constexpr bool ENABLE_CULLING_VALIDATION = false;
+	#else
+		static constexpr bool ENABLE_CULLING_VALIDATION = true;
+	#endif
+		static constexpr uint32_t MIN_OBJECT_CAPACITY = 1024;
+		//Objects written to the object buffer by one task
+		static constexpr uint32_t MIN_OBJECTS_PER_WRITE_TASK = 4096;
+
+		/*
+		* Per object data read by the culling shader. The vertex shader reads the transform and the color as instance attributes,
+		* the draw commands point at the object with firstInstance. Laid out for std430.
+		*/
+		struct ObjectData
+		{
+			glm::mat4 transform{ 1.0f }; //Includes the dequantization of the model
+			glm::vec4 color{ 0.0f };
+			uint32_t modelIndex = 0;
+			float maxScale = 1.0f; //Largest scale of the transform, applied to the bounding radius
+			uint32_t padding[2]{};
+		};
+
+		struct Statistics
+		{
+			uint32_t objectCount = 0;
+			uint32_t modelCount = 0;
+			uint32_t drawCommandCapacity = 0; //Command slots written by the culling, the largest number of draws
+			uint32_t indirectDrawCalls = 0; //Indirect draw commands recorded by the CPU
+			uint32_t visibleDrawCount = 0; //Draws left by the culling, read back MAX_FRAMES_IN_FLIGHT frames late
+			uint32_t disoccludedDrawCount = 0; //Part of visibleDrawCount drawn by the second phase
+			uint32_t retestedObjectCount = 0; //Objects behind the pyramid of the previous frame, tested again by the second phase
+			uint32_t disoccludedObjectCount = 0; //Retested objects found in front of the pyramid of their frame
+			uint32_t gpuFrustumObjectCount = 0; //Objects whose box the culling shader found inside the frustum, with the culling validation
+			uint32_t cpuFrustumObjectCount = 0; //Same count from weEngineFrustumCuller for the same frame
+			uint32_t cullingMismatchCount = 0; //Frames where the two counts differed
+			bool drawIndirectCount = false;
+			bool occlusionCulling = false;
+		};
+
+		/*
+		* Writes the objects of the frame packet and records the culling dispatch. Must be recorded outside of the render pass, before renderGameObjects.
+		*/
+		void cullGameObjects(FrameInfo& frameInfo);
+
+		//Records the indirect draws of the objects culled for the frame, inside the render pass
+		void renderGameObjects(FrameInfo& frameInfo);
+
+		bool isOcclusionCullingEnabled() const
+		{
+			return occlusionCulling;
+		}
+
+		/*
+		* Builds the depth pyramid from the depth drawn by the main render pass, then records the second culling phase over the objects
+		* the first phase found occluded. Must be recorded after the main render pass, the depth image is left in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL.
+		*/
+		void cullOccludedObjects(FrameInfo& frameInfo, VkImage depthImage, VkImageView depthImageView);
+
+		//Records the indirect draws of the second phase, inside the resume render pass
+		void renderDisoccludedObjects(FrameInfo& frameInfo);
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		//Culls the boxes of the objects with weEngineFrustumCuller too, and reports the frames where the culling shader found a different count
+		void setCullingValidation(bool enabled)
+		{
+			cullingValidation = enabled;
+		}
+
+		bool isCullingValidationEnabled() const
+		{
+			return cullingValidation;
+		}
+
+	private:
+		//Storage buffers read by the culling shader, laid out for std430
+		struct ModelData
+		{
+			glm::vec4 boundingSphere{ 0.0f }; //Center in quantized coordinates, radius in model units
+			glm::vec4 boxCenter{ 0.0f }; //Bounding box in quantized coordinates
+			glm::vec4 boxExtent{ 0.0f };
+			uint32_t firstLod = 0;
+			uint32_t lodCount = 0; //Zero for models the culling skips
+			uint32_t commandOffset = 0;
+			uint32_t padding = 0;
+		};
+
+		struct LodData
+		{
+			float error;
+			uint32_t firstRange;
+			uint32_t rangeCount;
+			uint32_t padding;
+		};
+
+		struct RangeData
+		{
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t padding;
+		};
+
+		struct GpuBuffer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			weEngineAllocation allocation{};
+			VkDeviceSize size = 0;
+		};
+
+		//Every model seen in the frame, in model index order
+		struct ModelBatch
+		{
+			weEngineModel* model;
+			uint32_t objectCount;
+			uint32_t commandOffset;
+			uint32_t commandCapacity;
+		};
+
+		//Object of a model without an index buffer, drawn directly
+		struct UncullableObject
+		{
+			weEngineModel* model;
+			uint32_t objectIndex;
+		};
+
+		//Buffers of one frame in flight, reused once the renderer waited for the previous use of the frame
+		struct FrameResources
+		{
+			GpuBuffer objects;
+			GpuBuffer models;
+			GpuBuffer lods;
+			GpuBuffer ranges;
+			GpuBuffer commands; //Command slots of the first phase, followed by the ones of the second phase
+			GpuBuffer counts; //Draw count of every model, per phase
+			GpuBuffer retest; //Objects the first phase leaves to the second one, after their count and the count of the disoccluded ones
+			GpuBuffer uniforms;
+			GpuBuffer readback; //Draw counts and retest counts copied back for the statistics
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkDescriptorSet depthReduceSet = VK_NULL_HANDLE; //Reduces the depth image of the frame to the first pyramid level
+			uint32_t pyramidGeneration = 0; //Pyramid the descriptor set points at
+
+			std::vector<ModelBatch> batches;
+			std::vector<UncullableObject> uncullableObjects;
+			uint32_t objectCount = 0;
+			uint32_t commandCount = 0;
+			uint32_t readbackCount = 0; //Models whose counts were copied back, zero when nothing was
+			uint32_t cpuFrustumObjectCount = 0; //Result of weEngineFrustumCuller, compared with the count of the shader once it is read back
+			bool validatedCulling = false; //The culling of the frame was validated, cpuFrustumObjectCount is set
+			bool clearedCommands = false; //Some model draws all of its command slots, so the empty ones were cleared
+		};
+
+		void createDescriptors();
+		void createPipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+		void createPipelines(VkRenderPass renderPass);
+		void createPyramidSampler();
+		void createDepthPyramid(VkExtent2D depthExtent);
+		void destroyDepthPyramid();
+		bool reserveBuffer(GpuBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* name);
+		void writeDescriptorSet(FrameResources& frame);
+		void buildDepthPyramid(VkCommandBuffer commandBuffer, FrameResources& frame, VkImage depthImage, VkImageView depthImageView);
+		void dispatchCulling(VkCommandBuffer commandBuffer, FrameResources& frame, uint32_t phase);
+		void copyStatistics(VkCommandBuffer commandBuffer, FrameResources& frame);
+		void readBackStatistics(FrameResources& frame);
+		uint32_t cullOnCpu(const weEngineFramePacket& packet, const std::array<glm::vec4, 6>& frustumPlanes);
+		void drawPhase(FrameInfo& frameInfo, FrameResources& frame, uint32_t phase);
+
+		weEngineDevice& weEngineDevice;
+
+		std::unique_ptr<weEngineDescriptorPool> descriptorPool;
+		std::unique_ptr<weEngineDescriptorSetLayout> cullSetLayout;
+		std::unique_ptr<weEngineDescriptorSetLayout> pyramidSetLayout;
+		VkPipelineLayout cullPipelineLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<weEngineComputePipeline> cullPipeline;
+		std::unique_ptr<weEngineComputePipeline> pyramidPipeline;
+		std::unique_ptr<weEnginePipeline> weEnginePipeline;
+
+		std::vector<FrameResources> frames;
+
+		//Depth pyramid shared by the frames: every frame reads the pyramid of the previous one before building its own, in submission order
+		bool occlusionCulling;
+		VkSampler pyramidSampler = VK_NULL_HANDLE;
+		VkImage pyramidImage = VK_NULL_HANDLE;
+		weEngineAllocation pyramidAllocation{};
+		VkImageView pyramidView = VK_NULL_HANDLE; //Every level, read by the culling
+		std::vector<VkImageView> pyramidLevelViews; //One level each, written and read by the reduction
+		std::vector<VkDescriptorSet> pyramidReduceSets; //Reduces level i - 1 to level i, the first one is unused
+		VkExtent2D depthExtent{ 0, 0 };
+		VkExtent2D pyramidExtent{ 0, 0 }; //First level, the largest power of two sizes below the depth extent
+		uint32_t pyramidLevelCount = 0;
+		uint32_t pyramidGeneration = 0; //Incremented when the pyramid is recreated
+		bool hasPyramid = false; //Set once a pyramid was built since it was created
+		glm::mat4 pyramidViewProjection{ 1.0f }; //Camera of the depth the pyramid was built from
+
+		//Scratch tables rebuilt every frame
+		std::unordered_map<weEngineModel*, uint32_t> modelIndices;
+		std::vector<uint32_t> objectModelIndices; //Model index of every object, in the order of the objects
+		std::vector<ModelData> modelData;
+		std::vector<LodData> lodData;
+		std::vector<RangeData> rangeData;
+		bool cullingValidation = ENABLE_CULLING_VALIDATION;
+		weEngineFrustumCuller validationCuller;
+		std::vector<uint32_t> validationVisibleIndices;
+
+		Statistics statistics{};
+	};
+}
@@ -1,8 +1,13 @@
 #include "SimpleRenderingSystem.hpp"
+#include "weEngineSwapChain.hpp"
+#include "weEngineRenderer.hpp"
+#include "weEngineJobSystem.hpp"
 
 //std
 #include "stdexcept"
 #include "array"
+#include "algorithm"
+#include "chrono"
 
 //glm
 #define GLM_FORCE_RADIANS
@@ -14,19 +19,19 @@ using std::make_unique;
 
 namespace weEngine
 {
-	struct SimplePushConstantData {
-		glm::mat4 transform{ 1.0f };
-		alignas(16) glm::vec3 color;
-	};
-
-	SimpleRenderingSystem::SimpleRenderingSystem(weEngine::weEngineDevice& device, VkRenderPass renderPass): weEngineDevice(device)
+	SimpleRenderingSystem::SimpleRenderingSystem(weEngine::weEngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout): weEngineDevice(device)
 	{
-		createPipelineLayout();
+		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
+		createInstanceBuffers();
 	}
 
 	SimpleRenderingSystem::~SimpleRenderingSystem()
 	{
+		for (size_t i = 0; i < instanceBuffers.size(); i++)
+		{
+			weEngineDevice.destroyBuffer(instanceBuffers[i], instanceAllocations[i]);
+		}
 		vkDestroyPipelineLayout(weEngineDevice.device(), pipelineLayout, nullptr);
 	}
 
@@ -35,20 +40,14 @@ namespace weEngine
 	* Creates a pipeline layout for the weEnginePipeline object
 	*/
 
-	void SimpleRenderingSystem::createPipelineLayout()
+	void SimpleRenderingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; //Set the push constant range for the vertex and fragment stage.
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-		pushConstantRange.offset = 0; //offset if we need to separate the data for vertex and fragment stages
-
-
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0; // Empty layout
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 1; // Preliminary data sent to the shader
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.setLayoutCount = 1; // The global uniforms, at weEngineGlobalUniforms::GLOBAL_SET
+		pipelineLayoutInfo.pSetLayouts = &globalSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 0; // The camera and the instances come from buffers, no shader reads push constants
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
 		if (vkCreatePipelineLayout(weEngineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -69,6 +68,30 @@ namespace weEngine
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
 
+		constexpr auto attributeDescriptions = weEngineModel::VertexLayout::getAttributeDescriptions<VERTEX_ATTRIBUTES>();
+		pipelineConfig.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+
+		//The instance data advances once per instance, a mat4 attribute takes one location per column
+		VkVertexInputBindingDescription instanceBinding{};
+		instanceBinding.binding = INSTANCE_BINDING;
+		instanceBinding.stride = sizeof(InstanceData);
+		instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		pipelineConfig.bindingDescriptions.push_back(instanceBinding);
+
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			pipelineConfig.attributeDescriptions.push_back({
+				INSTANCE_LOCATION + column,
+				INSTANCE_BINDING,
+				VK_FORMAT_R32G32B32A32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * column) });
+		}
+		pipelineConfig.attributeDescriptions.push_back({
+			INSTANCE_LOCATION + 4,
+			INSTANCE_BINDING,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			static_cast<uint32_t>(offsetof(InstanceData, color)) });
+
 		weEnginePipeline = make_unique<weEngine::weEnginePipeline>(
 			weEngineDevice,
 			"shaders\\simpleVertexShader.vert.spv",
@@ -76,33 +99,367 @@ namespace weEngine
 			pipelineConfig);
 	}
 	/*
-	* Renders the game objects
+	* Creates the instance buffers of the frames in flight. They are host visible and stay mapped, the CPU writes the instances directly into them.
+	*/
+	void SimpleRenderingSystem::createInstanceBuffers()
+	{
+		instanceBuffers.resize(weEngineSwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+		instanceAllocations.resize(weEngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		instanceCapacities.resize(weEngineSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+
+		for (int frameIndex = 0; frameIndex < weEngineSwapChain::MAX_FRAMES_IN_FLIGHT; frameIndex++)
+		{
+			reserveInstances(frameIndex, MIN_INSTANCE_CAPACITY);
+		}
+	}
+
+	/*
+	* Returns the mapped instance buffer of the frame, grown to hold at least instanceCount instances.
+	* Growing is safe because the renderer waited for the previous use of the frame before it started recording it again.
+	*/
+	SimpleRenderingSystem::InstanceData* SimpleRenderingSystem::reserveInstances(int frameIndex, uint32_t instanceCount)
+	{
+		if (instanceCount > instanceCapacities[frameIndex])
+		{
+			if (instanceBuffers[frameIndex] != VK_NULL_HANDLE)
+			{
+				weEngineDevice.destroyBuffer(instanceBuffers[frameIndex], instanceAllocations[frameIndex]);
+			}
+
+			const uint32_t capacity = std::max({ instanceCount, instanceCapacities[frameIndex] * 2, MIN_INSTANCE_CAPACITY });
+			weEngineDevice.createBuffer(
+				sizeof(InstanceData) * capacity,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				instanceBuffers[frameIndex],
+				instanceAllocations[frameIndex],
+				weEngineMemoryUsage::LONG_LIVED,
+				"instance buffer"
+			);
+			instanceCapacities[frameIndex] = capacity;
+		}
+
+		return static_cast<InstanceData*>(instanceAllocations[frameIndex].mappedData);
+	}
+
+	void SimpleRenderingSystem::renderGameObjects(FrameInfo& frameInfo)
+	{
+		assert(frameInfo.packet != nullptr && "The objects are read from the frame packet");
+		const weEngineFramePacket& packet = *frameInfo.packet;
+		const weEngineTransformSystem& transforms = packet.transforms;
+
+		const glm::mat4& projection = frameInfo.camera.getProjection();
+		const glm::mat4& view = frameInfo.camera.getView();
+
+		//Pixels covered by one unit at a depth of one unit (or at any depth for an orthographic projection)
+		const float pixelsPerUnitAtUnitDepth = projection[1][1] * 0.5f * static_cast<float>(frameInfo.extent.height);
+		const bool isPerspective = projection[2][3] != 0.0f;
+
+		const std::array<glm::vec4, 6> frustumPlanes = frameInfo.camera.getFrustumPlanes();
+
+		//With a scene hierarchy, only the objects whose enlarged boxes touch the frustum are tested with their exact boxes
+		cullCandidates.clear();
+		if (frameInfo.sceneBvh != nullptr)
+		{
+			frameInfo.sceneBvh->queryFrustum(frustumPlanes, cullCandidates);
+		}
+		else
+		{
+			for (const weEngineRenderObject& object : packet.objects)
+			{
+				cullCandidates.push_back(object.entityIndex);
+			}
+		}
+
+		frustumCuller.clear();
+		for (uint32_t objectIndex : cullCandidates)
+		{
+			const weEngineModel::Bounds& bounds = packet.getObject(objectIndex).model->getBounds();
+			frustumCuller.addTransformedBox(transforms.getMatrix(objectIndex), bounds.minimum, bounds.maximum);
+		}
+		frustumCuller.cull(frustumPlanes, visibleCandidates);
+
+		statistics.objectCount = frameInfo.sceneBvh != nullptr ? frameInfo.sceneBvh->getStatistics().leafCount : frustumCuller.getStatistics().testedCount;
+		statistics.culledCount = statistics.objectCount - frustumCuller.getStatistics().visibleCount;
+		statistics.occluderCount = 0;
+		statistics.occludedCount = 0;
+		statistics.drawCallCount = 0;
+
+		if (ENABLE_OCCLUSION_CULLING)
+		{
+			cullOccludedObjects(projection * view, packet);
+		}
+		statistics.drawnCount = static_cast<uint32_t>(visibleCandidates.size());
+		statistics.pipelineBindCount = 0;
+		statistics.skippedPipelineBindCount = 0;
+		statistics.modelBindCount = 0;
+		statistics.skippedModelBindCount = 0;
+		statistics.recordingTaskCount = 0;
+		statistics.recordMilliseconds = 0.0f;
+
+		//A single pipeline and no materials yet, the keys still order the draws by them first for when there are more
+		renderQueue.clear();
+		const uint32_t pipelineIndex = renderQueue.registerPipeline(weEnginePipeline.get());
+		const uint32_t materialIndex = 0;
+
+		lodLevels.resize(packet.objectIndices.size(), 0);
+		for (uint32_t candidate : visibleCandidates)
+		{
+			const uint32_t objectIndex = cullCandidates[candidate];
+			const weEngineRenderObject& object = packet.getObject(objectIndex);
+			const weEngineModel& model = *object.model;
+			uint32_t& lodLevel = lodLevels[objectIndex];
+
+			const glm::mat4& modelMatrix = transforms.getMatrix(objectIndex);
+			const glm::vec4 viewCenter = view * modelMatrix * glm::vec4(model.getBoundingCenter(), 1.0f);
+
+			if (model.getLodCount() > 1)
+			{
+				const float maxScale = object.maxScale;
+				const float distance = viewCenter.z - model.getBoundingRadius() * maxScale;
+
+				if (!isPerspective)
+				{
+					lodLevel = selectLod(model, lodLevel, pixelsPerUnitAtUnitDepth * maxScale);
+				}
+				else if (distance > 0.0f)
+				{
+					lodLevel = selectLod(model, lodLevel, pixelsPerUnitAtUnitDepth * maxScale / distance);
+				}
+				else
+				{
+					lodLevel = 0; //The camera is inside the bounding sphere
+				}
+			}
+			else
+			{
+				lodLevel = 0;
+			}
+
+			assert(lodLevel < (1u << weEngineSortKey::LOD_BITS) && "Detail level does not fit in the sort key");
+			const uint64_t key = weEngineSortKey::encode(
+				weEngineSortKey::PASS_OPAQUE,
+				pipelineIndex,
+				materialIndex,
+				renderQueue.registerModel(object.model.get()),
+				lodLevel,
+				weEngineSortKey::quantizeDepth(viewCenter.z));
+			renderQueue.push(key, objectIndex);
+		}
+
+		if (renderQueue.isEmpty())
+		{
+			return;
+		}
+
+		renderQueue.sort();
+		const std::vector<weEngineRenderQueue::Entry>& entries = renderQueue.getEntries();
+
+		//The instances are written in draw order, so every group of instances is a contiguous range of the buffer
+		InstanceData* instances = reserveInstances(frameInfo.frameIndex, static_cast<uint32_t>(entries.size()));
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const weEngineRenderObject& object = packet.getObject(entries[i].objectIndex);
+			instances[i].transform = transforms.getMatrix(entries[i].objectIndex) * object.model->getDequantizationMatrix();
+			instances[i].color = glm::vec4(object.color, 1.0f);
+		}
+
+		//Each run of keys with the same state is one instanced draw, the last group is followed by the entry count
+		drawGroups.clear();
+		for (uint32_t i = 0; i < entries.size(); i++)
+		{
+			if (i == 0 || !weEngineSortKey::isSameState(entries[i].key, entries[i - 1].key))
+			{
+				drawGroups.push_back(i);
+			}
+		}
+		drawGroups.push_back(static_cast<uint32_t>(entries.size()));
+		const uint32_t groupCount = static_cast<uint32_t>(drawGroups.size() - 1);
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		const VkBuffer instanceBuffer = instanceBuffers[frameInfo.frameIndex];
+
+		if (getSubpassContents() == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			recordCounters.assign(1, RecordCounters{});
+			recordDraws(frameInfo.commandBuffer, frameInfo, instanceBuffer, 0, groupCount, recordCounters[0]);
+		}
+		else
+		{
+			assert(frameInfo.renderer != nullptr && "Recording secondary command buffers needs the renderer of the frame");
+
+			//Every task records a contiguous range of draws into a secondary command buffer from the command pool of its slot
+			weEngineRenderer& renderer = *frameInfo.renderer;
+			const uint32_t taskCount = std::max(1u, std::min(renderer.getRecordingSlotCount(), groupCount / MIN_DRAWS_PER_RECORDING_TASK));
+			recordCounters.assign(taskCount, RecordCounters{});
+			recordedCommandBuffers.resize(taskCount);
+
+			weEngineJobSystem::shared().parallelFor(taskCount, [&](uint32_t task)
+				{
+					const uint32_t firstGroup = static_cast<uint32_t>(static_cast<uint64_t>(groupCount) * task / taskCount);
+					const uint32_t endGroup = static_cast<uint32_t>(static_cast<uint64_t>(groupCount) * (task + 1) / taskCount);
+
+					VkCommandBuffer commandBuffer = renderer.beginSecondaryCommandBuffer(task);
+					recordDraws(commandBuffer, frameInfo, instanceBuffer, firstGroup, endGroup, recordCounters[task]);
+					renderer.endSecondaryCommandBuffer(commandBuffer);
+					recordedCommandBuffers[task] = commandBuffer;
+				});
+
+			vkCmdExecuteCommands(frameInfo.commandBuffer, taskCount, recordedCommandBuffers.data());
+		}
+
+		statistics.recordingTaskCount = static_cast<uint32_t>(recordCounters.size());
+		for (const RecordCounters& counters : recordCounters)
+		{
+			statistics.pipelineBindCount += counters.pipelineBindCount;
+			statistics.skippedPipelineBindCount += counters.skippedPipelineBindCount;
+			statistics.modelBindCount += counters.modelBindCount;
+			statistics.skippedModelBindCount += counters.skippedModelBindCount;
+			statistics.drawCallCount += counters.drawCallCount;
+		}
+		statistics.recordMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	/*
+	* Records the draw groups [firstGroup, endGroup) of the sorted render queue. A command buffer starts without any bound state,
+	* so the first group binds everything, the next ones only what changed.
 	*/
-	void SimpleRenderingSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<weEngineGameObject>& gameObjects, const weEngineCamera& camera)
+	void SimpleRenderingSystem::recordDraws(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, VkBuffer instanceBuffer, uint32_t firstGroup, uint32_t endGroup, RecordCounters& counters) const
 	{
-		weEnginePipeline->bind(commandBuffer);
+		//The global set and the instance buffer stay bound across the pipelines, which all share the pipeline layout
+		vkCmdBindDescriptorSets(commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			weEngineGlobalUniforms::GLOBAL_SET,
+			1,
+			&frameInfo.globalDescriptorSet,
+			1,
+			&frameInfo.globalDynamicOffset);
 
-		auto projectionView = camera.getProjection() * camera.getView();
+		const VkDeviceSize instanceOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BINDING, 1, &instanceBuffer, &instanceOffset);
 
-		for (auto& gameObj : gameObjects)
+		const std::vector<weEngineRenderQueue::Entry>& entries = renderQueue.getEntries();
+		weEngine::weEnginePipeline* boundPipeline = nullptr;
+		weEngineModel* boundModel = nullptr;
+		for (uint32_t group = firstGroup; group < endGroup; group++)
 		{
+			const uint32_t groupStart = drawGroups[group];
+			const uint32_t groupEnd = drawGroups[group + 1];
 
-			SimplePushConstantData pushData{};
-			pushData.color = gameObj.color;
-			pushData.transform = projectionView * gameObj.transformComp.mat4();
+			const uint64_t key = entries[groupStart].key;
+			weEngine::weEnginePipeline* pipeline = renderQueue.getPipeline(key);
+			if (pipeline != boundPipeline)
+			{
+				pipeline->bind(commandBuffer);
+				boundPipeline = pipeline;
+				counters.pipelineBindCount++;
+			}
+			else
+			{
+				counters.skippedPipelineBindCount++;
+			}
 
-			vkCmdPushConstants(commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&pushData);
+			weEngineModel* model = renderQueue.getModel(key);
+			if (model != boundModel)
+			{
+				model->bind(commandBuffer);
+				boundModel = model;
+				counters.modelBindCount++;
+			}
+			else
+			{
+				counters.skippedModelBindCount++;
+			}
 
-			gameObj.model->bind(commandBuffer);
-			gameObj.model->draw(commandBuffer);
+			const uint32_t lod = weEngineSortKey::getLod(key);
+			model->draw(commandBuffer, lod, groupEnd - groupStart, groupStart);
+			counters.drawCallCount += model->getLod(lod).rangeCount;
+		}
+	}
+
+	/*
+	* The occluders are always drawn, so they are not tested themselves: a box shaped occluder would otherwise hide its own box.
+	* The other objects keep their order in visibleCandidates.
+	*/
+	void SimpleRenderingSystem::cullOccludedObjects(const glm::mat4& projectionView, const weEngineFramePacket& packet)
+	{
+		const weEngineTransformSystem& transforms = packet.transforms;
+		occlusionCuller.beginFrame(projectionView);
+		occludees.clear();
+		occludeeMinimums.clear();
+		occludeeMaximums.clear();
+
+		for (uint32_t candidate : visibleCandidates)
+		{
+			const uint32_t objectIndex = cullCandidates[candidate];
+			const weEngineRenderObject& object = packet.getObject(objectIndex);
+			const weEngineModel& model = *object.model;
+			if (model.getOccluderMesh() != nullptr && object.isOccluder)
+			{
+				occlusionCuller.addOccluder(*model.getOccluderMesh(), transforms.getMatrix(objectIndex));
+				continue;
+			}
+
+			const weEngineModel::Bounds& bounds = model.getBounds();
+			const weEngineAabb worldBounds = weEngineAabb{ bounds.minimum, bounds.maximum }.transform(transforms.getMatrix(objectIndex));
+			occludees.push_back(candidate);
+			occludeeMinimums.push_back(worldBounds.minimum);
+			occludeeMaximums.push_back(worldBounds.maximum);
+		}
+
+		statistics.occluderCount = occlusionCuller.getStatistics().occluderCount;
+		if (statistics.occluderCount == 0)
+		{
+			return;
+		}
+
+		occlusionCuller.rasterize();
+		occlusionCuller.cullBoxes(occludeeMinimums, occludeeMaximums, visibleOccludees);
+		statistics.occludedCount = occlusionCuller.getStatistics().occludedCount;
 
+		//Both lists are in increasing order, so the hidden objects are dropped in one merge pass
+		size_t write = 0;
+		size_t occludee = 0;
+		size_t visibleOccludee = 0;
+		for (uint32_t candidate : visibleCandidates)
+		{
+			if (occludee < occludees.size() && occludees[occludee] == candidate)
+			{
+				const bool isVisible = visibleOccludee < visibleOccludees.size() && visibleOccludees[visibleOccludee] == occludee;
+				visibleOccludee += isVisible ? 1 : 0;
+				occludee++;
+				if (!isVisible)
+				{
+					continue;
+				}
+			}
+			visibleCandidates[write++] = candidate;
+		}
+		visibleCandidates.resize(write);
+	}
+
+	/*
+	* Picks the coarsest detail level whose projected error stays below LOD_PIXEL_ERROR, starting from the level of the last frame.
+	* A finer level is taken as soon as the current one is over the limit, but a coarser level only once its error is below
+	* LOD_PIXEL_ERROR * (1 - LOD_HYSTERESIS), so an object sitting at the switching distance does not alternate between two levels.
+	*/
+	uint32_t SimpleRenderingSystem::selectLod(const weEngineModel& model, uint32_t currentLod, float pixelsPerUnit)
+	{
+		const uint32_t lodCount = model.getLodCount();
+		uint32_t lod = std::min(currentLod, lodCount - 1);
+
+		while (lod > 0 && model.getLodError(lod) * pixelsPerUnit > LOD_PIXEL_ERROR)
+		{
+			lod--;
+		}
+
+		while (lod + 1 < lodCount && model.getLodError(lod + 1) * pixelsPerUnit <= LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+		{
+			lod++;
 		}
 
+		return lod;
 	}
 
 }
\ No newline at end of file
@@ -1,12 +1,18 @@
 #pragma once
 
 #include "weEnginePipeline.hpp"
-#include "weEngineGameObject.hpp"
+#include "weEngineComponents.hpp"
 #include "weEngineDevice.hpp"
 #include "weEngineCamera.hpp"
+#include "weEngineFrameInfo.hpp"
+#include "weEngineFrustumCuller.hpp"
+#include "weEngineOcclusionCuller.hpp"
+#include "weEngineRenderQueue.hpp"
+#include "weEngineGlobalUniforms.hpp"
 
 //std
 #include "memory"
+#include "string"
 #include "vector"
 
 /*
@@ -20,20 +26,149 @@ namespace weEngine {
 	class SimpleRenderingSystem
 	{
 	public:
-		SimpleRenderingSystem(weEngineDevice& device, VkRenderPass renderPass);
+		SimpleRenderingSystem(weEngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
 		~SimpleRenderingSystem();
 
 		SimpleRenderingSystem(const SimpleRenderingSystem&) = delete;
 		SimpleRenderingSystem& operator=(const SimpleRenderingSystem&) = delete;
 
-		void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<weEngineGameObject>& gameObjects, const weEngineCamera& camera);
+		//Vertex attributes read by the simple vertex shader
+		static constexpr uint32_t VERTEX_ATTRIBUTES = VERTEX_POSITION_BIT | VERTEX_COLOR_BIT;
+
+		//Largest error, in pixels, a detail level may show on the screen
+		static constexpr float LOD_PIXEL_ERROR = 1.0f;
+		//Fraction of LOD_PIXEL_ERROR a coarser level must stay below before it replaces the current one
+		static constexpr float LOD_HYSTERESIS = 0.25f;
+
+		//Per instance data read by the vertex shader from the instance buffer, the transform includes the dequantization of the model
+		struct InstanceData
+		{
+			glm::mat4 transform{ 1.0f };
+			glm::vec4 color{ 0.0f };
+		};
+
+		static constexpr uint32_t INSTANCE_BINDING = 1;
+		static constexpr uint32_t INSTANCE_LOCATION = 4; //First location after the vertex attributes
+		static constexpr uint32_t MIN_INSTANCE_CAPACITY = 1024;
+
+		//Rasterizes the occluders inside the frustum on the CPU and skips the objects hidden behind them
+		static constexpr bool ENABLE_OCCLUSION_CULLING = true;
+
+		//Records the draws into secondary command buffers on the worker threads, the render pass must then be begun with getSubpassContents
+		static constexpr bool ENABLE_PARALLEL_RECORDING = true;
+		//Smallest number of instanced draws recorded by one task
+		static constexpr uint32_t MIN_DRAWS_PER_RECORDING_TASK = 64;
+
+		//Counts of the last rendered frame
+		struct Statistics
+		{
+			uint32_t objectCount = 0; //Objects with a model
+			uint32_t culledCount = 0; //Objects outside of the view frustum
+			uint32_t occluderCount = 0; //Objects inside the frustum rasterized as occluders
+			uint32_t occludedCount = 0; //Objects inside the frustum hidden behind the occluders
+			uint32_t drawnCount = 0;
+			uint32_t drawCallCount = 0; //Instanced draws, one per model, detail level and draw range
+
+			//Binds recorded for the instanced draws, and the ones skipped because the previous draw already bound the same state
+			uint32_t pipelineBindCount = 0;
+			uint32_t skippedPipelineBindCount = 0;
+			uint32_t modelBindCount = 0;
+			uint32_t skippedModelBindCount = 0;
+
+			uint32_t recordingTaskCount = 0; //Command buffers the draws were recorded into
+			float recordMilliseconds = 0.0f;
+		};
+
+		/*
+		* Draws the objects of the frame packet, grouped by model and detail level. The bounding boxes of the objects are culled against the view frustum first,
+		* then the boxes of the objects left are tested against the depth of the occluders. Every visible object is pushed to the render queue
+		* with a sort key, the sorted queue gives the order of the instance data in the instance buffer of the frame, then each run of keys
+		* with the same state is drawn with a single instanced draw per draw range, binding only the pipeline and model that changed.
+		*/
+		void renderGameObjects(FrameInfo& frameInfo);
+
+		//Contents of the render pass renderGameObjects records into
+		VkSubpassContents getSubpassContents() const
+		{
+			return ENABLE_PARALLEL_RECORDING ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		//Counters and timings of the sort of the last frame
+		const weEngineRenderQueue::Statistics& getRenderQueueStatistics() const
+		{
+			return renderQueue.getStatistics();
+		}
+
+		//Counters and timings of the occlusion culling of the last frame
+		const weEngineOcclusionCuller::Statistics& getOcclusionStatistics() const
+		{
+			return occlusionCuller.getStatistics();
+		}
+
+		//Writes the occlusion depth buffer of the last frame to an image, see weEngineOcclusionCuller::writeDebugImage
+		void writeOcclusionDebugImage(const std::string& filepath) const
+		{
+			occlusionCuller.writeDebugImage(filepath);
+		}
 
 	private:
-		void createPipelineLayout();
+		//Counters of one recording task, summed into the statistics once every task is done
+		struct RecordCounters
+		{
+			uint32_t pipelineBindCount = 0;
+			uint32_t skippedPipelineBindCount = 0;
+			uint32_t modelBindCount = 0;
+			uint32_t skippedModelBindCount = 0;
+			uint32_t drawCallCount = 0;
+		};
+
+		static uint32_t selectLod(const weEngineModel& model, uint32_t currentLod, float pixelsPerUnit);
+
+		//Removes from visibleCandidates the objects hidden behind the occluders among them
+		void cullOccludedObjects(const glm::mat4& projectionView, const weEngineFramePacket& packet);
+
+		void recordDraws(VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, VkBuffer instanceBuffer, uint32_t firstGroup, uint32_t endGroup, RecordCounters& counters) const;
+
+		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+		void createInstanceBuffers();
+		InstanceData* reserveInstances(int frameIndex, uint32_t instanceCount);
 		
 		weEngineDevice& weEngineDevice;
 		std::unique_ptr<weEnginePipeline> weEnginePipeline;
 		VkPipelineLayout pipelineLayout;
+
+		//One instance buffer per frame in flight, so a frame never overwrites the instances the GPU is still reading
+		std::vector<VkBuffer> instanceBuffers;
+		std::vector<weEngineAllocation> instanceAllocations;
+		std::vector<uint32_t> instanceCapacities;
+
+		//Detail level drawn on the last frame at the index of every entity, kept here since the recording never writes to the world
+		std::vector<uint32_t> lodLevels;
+
+		//Visible objects of the frame, sorted by pipeline, model, detail level and then front to back
+		weEngineRenderQueue renderQueue;
+		std::vector<uint32_t> drawGroups; //First entry of every run of keys with the same state, then the entry count
+		std::vector<RecordCounters> recordCounters;
+		std::vector<VkCommandBuffer> recordedCommandBuffers;
+
+		//Objects tested by the frustum culler, with their boxes in the same order
+		weEngineFrustumCuller frustumCuller;
+		std::vector<uint32_t> cullCandidates;
+		std::vector<uint32_t> visibleCandidates;
+
+		//Objects inside the frustum that are not occluders, with their world boxes in the same order, tested against the occluders
+		weEngineOcclusionCuller occlusionCuller;
+		std::vector<uint32_t> occludees;
+		std::vector<glm::vec3> occludeeMinimums;
+		std::vector<glm::vec3> occludeeMaximums;
+		std::vector<uint32_t> visibleOccludees;
+
+		Statistics statistics{};
 	};
 }
\ No newline at end of file
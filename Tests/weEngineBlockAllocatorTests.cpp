@@ -0,0 +1,248 @@
+#include "weEngineTest.hpp"
+#include "weEngineBlockAllocator.hpp"
+
+//std
+#include "algorithm"
+#include "map"
+#include "random"
+
+/*
+* Checks the block allocators weEngineMemoryAllocator sub-allocates the device memory with. They only deal with offsets,
+* so they run without a GPU.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		struct Allocation
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t handle;
+		};
+
+		//Live allocations by offset, to find the ones a new allocation would overlap
+		class AllocationMap
+		{
+		public:
+			bool overlaps(uint64_t offset, uint64_t size) const
+			{
+				auto next = allocations.lower_bound(offset);
+				if (next != allocations.end() && next->first < offset + size)
+				{
+					return true;
+				}
+				return next != allocations.begin() && std::prev(next)->first + std::prev(next)->second.size > offset;
+			}
+
+			void insert(const Allocation& allocation)
+			{
+				allocations[allocation.offset] = allocation;
+			}
+
+			void erase(uint64_t offset)
+			{
+				allocations.erase(offset);
+			}
+
+		private:
+			std::map<uint64_t, Allocation> allocations;
+		};
+	}
+
+	WE_TEST(tlsfAllocatorAlignsOffsets)
+	{
+		weEngineTlsfAllocator allocator{ 1 << 20 };
+		AllocationMap allocations;
+
+		//Odd sizes move the next free range off every alignment, so each allocation needs padding in front of it
+		for (uint64_t alignment = 1; alignment <= 4096; alignment *= 2)
+		{
+			for (uint64_t size : { uint64_t{ 1 }, uint64_t{ 3 }, uint64_t{ 257 }, alignment + 1 })
+			{
+				uint64_t offset;
+				uint32_t handle;
+				WE_CHECK(allocator.allocate(size, alignment, offset, handle));
+				WE_CHECK_EQUAL(offset % alignment, uint64_t{ 0 });
+				WE_CHECK(!allocations.overlaps(offset, size));
+				allocations.insert({ offset, size, handle });
+			}
+		}
+		WE_CHECK(allocator.validate());
+	}
+
+	WE_TEST(tlsfAllocatorSplitsAndMergesNeighbours)
+	{
+		weEngineTlsfAllocator allocator{ 4096 };
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 1u);
+		WE_CHECK_EQUAL(allocator.getLargestFreeRange(), uint64_t{ 4096 });
+
+		//Every allocation splits the free tail of the block
+		Allocation allocations[3];
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			allocations[i].size = 256;
+			WE_CHECK(allocator.allocate(allocations[i].size, 1, allocations[i].offset, allocations[i].handle));
+			WE_CHECK_EQUAL(allocations[i].offset, uint64_t{ 256 } * i);
+		}
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 1u);
+		WE_CHECK_EQUAL(allocator.getLargestFreeRange(), uint64_t{ 4096 - 768 });
+		WE_CHECK(allocator.validate());
+
+		//The middle range has allocated neighbours on both sides and stays on its own
+		allocator.free(allocations[1].handle);
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 2u);
+		WE_CHECK(allocator.validate());
+
+		//The first range merges with the free range after it
+		allocator.free(allocations[0].handle);
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 2u);
+		WE_CHECK(allocator.validate());
+
+		//An allocation the size of the merged range fits where the first two were
+		Allocation merged{ 0, 512, 0 };
+		WE_CHECK(allocator.allocate(merged.size, 1, merged.offset, merged.handle));
+		WE_CHECK_EQUAL(merged.offset, uint64_t{ 0 });
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 1u);
+		allocator.free(merged.handle);
+
+		//The last range merges with the free ranges on both sides, giving back the whole block
+		allocator.free(allocations[2].handle);
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 1u);
+		WE_CHECK_EQUAL(allocator.getLargestFreeRange(), uint64_t{ 4096 });
+		WE_CHECK(allocator.isEmpty());
+		WE_CHECK(allocator.validate());
+	}
+
+	WE_TEST(tlsfAllocatorRandomFragmentation)
+	{
+		constexpr uint64_t blockSize = 1 << 22;
+		weEngineTlsfAllocator allocator{ blockSize };
+		AllocationMap allocationMap;
+		std::vector<Allocation> allocations;
+
+		std::mt19937 random{ 42 };
+		std::uniform_int_distribution<uint64_t> sizeDistribution{ 1, 16384 };
+		std::uniform_int_distribution<uint32_t> alignmentDistribution{ 0, 8 };
+		std::uniform_int_distribution<uint32_t> operationDistribution{ 0, 99 };
+
+		uint64_t allocatedBytes = 0;
+		for (uint32_t operation = 0; operation < 20000; operation++)
+		{
+			//Allocates a bit more often than it frees, so the block fills up and allocations start to fail
+			if (allocations.empty() || operationDistribution(random) < 55)
+			{
+				Allocation allocation{ 0, sizeDistribution(random), 0 };
+				const uint64_t alignment = uint64_t{ 1 } << alignmentDistribution(random);
+				if (allocator.allocate(allocation.size, alignment, allocation.offset, allocation.handle))
+				{
+					WE_CHECK_EQUAL(allocation.offset % alignment, uint64_t{ 0 });
+					WE_CHECK(allocation.offset + allocation.size <= blockSize);
+					WE_CHECK(!allocationMap.overlaps(allocation.offset, allocation.size));
+					allocationMap.insert(allocation);
+					allocations.push_back(allocation);
+					allocatedBytes += allocation.size;
+				}
+				else
+				{
+					//The request is rounded up to the next size class, so it can fail with up to 1/32 more than it needs still free
+					const uint64_t neededSize = allocation.size + alignment - 1;
+					WE_CHECK(neededSize + std::max(neededSize / 32, uint64_t{ 8 }) > allocator.getLargestFreeRange());
+				}
+			}
+			else
+			{
+				const size_t index = std::uniform_int_distribution<size_t>{ 0, allocations.size() - 1 }(random);
+				allocator.free(allocations[index].handle);
+				allocationMap.erase(allocations[index].offset);
+				allocatedBytes -= allocations[index].size;
+				allocations[index] = allocations.back();
+				allocations.pop_back();
+			}
+
+			WE_CHECK_EQUAL(allocator.getAllocationCount(), static_cast<uint32_t>(allocations.size()));
+			WE_CHECK_EQUAL(allocator.getAllocatedBytes(), allocatedBytes);
+			WE_CHECK(allocator.validate());
+		}
+
+		for (const Allocation& allocation : allocations)
+		{
+			allocator.free(allocation.handle);
+		}
+		WE_CHECK(allocator.isEmpty());
+		WE_CHECK_EQUAL(allocator.getFreeRangeCount(), 1u);
+		WE_CHECK_EQUAL(allocator.getLargestFreeRange(), blockSize);
+		WE_CHECK(allocator.validate());
+	}
+
+	WE_TEST(tlsfAllocatorRunsOutOfSpace)
+	{
+		weEngineTlsfAllocator allocator{ 4096 };
+		uint64_t offset;
+		uint32_t handle;
+		WE_CHECK(!allocator.allocate(8192, 1, offset, handle));
+
+		std::vector<uint32_t> handles;
+		while (allocator.allocate(64, 64, offset, handle))
+		{
+			handles.push_back(handle);
+			WE_CHECK(handles.size() <= 4096 / 64);
+		}
+		WE_CHECK(!handles.empty());
+		WE_CHECK(allocator.getAllocatedBytes() <= allocator.getSize());
+		WE_CHECK(allocator.validate());
+
+		//Freeing one allocation makes room for another one of the same size
+		allocator.free(handles.back());
+		handles.pop_back();
+		WE_CHECK(allocator.allocate(64, 64, offset, handle));
+		WE_CHECK(allocator.validate());
+	}
+
+	WE_TEST(linearAllocatorAlignsAndResets)
+	{
+		weEngineLinearAllocator allocator{ 4096 };
+		uint64_t offsets[3];
+		uint32_t handles[3];
+		WE_CHECK(allocator.allocate(10, 1, offsets[0], handles[0]));
+		WE_CHECK(allocator.allocate(10, 256, offsets[1], handles[1]));
+		WE_CHECK(allocator.allocate(10, 16, offsets[2], handles[2]));
+		WE_CHECK_EQUAL(offsets[0], uint64_t{ 0 });
+		WE_CHECK_EQUAL(offsets[1], uint64_t{ 256 });
+		WE_CHECK_EQUAL(offsets[2], uint64_t{ 272 });
+		WE_CHECK_EQUAL(allocator.getAllocatedBytes(), uint64_t{ 30 });
+
+		//The head only goes back once every allocation has been freed
+		allocator.free(handles[0]);
+		allocator.free(handles[2]);
+		uint64_t offset;
+		uint32_t handle;
+		WE_CHECK(allocator.allocate(10, 1, offset, handle));
+		WE_CHECK_EQUAL(offset, uint64_t{ 282 });
+
+		allocator.free(handles[1]);
+		allocator.free(handle);
+		WE_CHECK(allocator.isEmpty());
+		WE_CHECK_EQUAL(allocator.getAllocatedBytes(), uint64_t{ 0 });
+		WE_CHECK(allocator.allocate(10, 1, offset, handle));
+		WE_CHECK_EQUAL(offset, uint64_t{ 0 });
+	}
+
+	WE_TEST(linearAllocatorRunsOutOfSpace)
+	{
+		weEngineLinearAllocator allocator{ 1024 };
+		uint64_t offset;
+		uint32_t handle;
+		WE_CHECK(!allocator.allocate(2048, 1, offset, handle));
+		WE_CHECK(allocator.allocate(1000, 1, offset, handle));
+		WE_CHECK(!allocator.allocate(100, 1, offset, handle));
+
+		//The padding counts too: 20 bytes fit in the 24 left, but not from the next offset aligned to 16
+		WE_CHECK(!allocator.allocate(20, 16, offset, handle));
+		WE_CHECK(allocator.allocate(24, 1, offset, handle));
+		WE_CHECK_EQUAL(offset, uint64_t{ 1000 });
+		WE_CHECK(!allocator.allocate(1, 1, offset, handle));
+		WE_CHECK_EQUAL(allocator.getAllocatedBytes(), uint64_t{ 1024 });
+	}
+}
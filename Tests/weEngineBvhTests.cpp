@@ -0,0 +1,213 @@
+#include "weEngineTest.hpp"
+#include "weEngineBvh.hpp"
+
+//std
+#include "algorithm"
+#include "limits"
+#include "random"
+
+/*
+* Checks the queries of the scene hierarchy against testing every box, after inserting, moving and removing leaves.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		struct BvhObject
+		{
+			weEngineAabb bounds;
+			uint32_t proxy = weEngineBvh::NULL_NODE; //NULL_NODE once removed
+		};
+
+		//Box with corners on the integer grid, so the axis aligned rays of the tests start on the planes of some boxes
+		weEngineAabb getRandomBox(std::mt19937& random)
+		{
+			std::uniform_int_distribution<int> positionDistribution{ -50, 50 };
+			std::uniform_int_distribution<int> sizeDistribution{ 1, 4 };
+			const glm::vec3 minimum{ positionDistribution(random), positionDistribution(random), positionDistribution(random) };
+			return { minimum, minimum + glm::vec3{ sizeDistribution(random), sizeDistribution(random), sizeDistribution(random) } };
+		}
+
+		std::vector<uint32_t> sorted(std::vector<uint32_t> values)
+		{
+			std::sort(values.begin(), values.end());
+			return values;
+		}
+
+		//The queries return the leaves whose enlarged boxes touch the volume, which contain the boxes given to the tree
+		template<typename Touches>
+		std::vector<uint32_t> findTouchingLeaves(const weEngineBvh& bvh, const std::vector<BvhObject>& objects, Touches&& touches)
+		{
+			std::vector<uint32_t> results;
+			for (uint32_t object = 0; object < objects.size(); object++)
+			{
+				if (objects[object].proxy != weEngineBvh::NULL_NODE)
+				{
+					WE_CHECK(bvh.getFatBounds(objects[object].proxy).contains(objects[object].bounds));
+					if (touches(bvh.getFatBounds(objects[object].proxy)))
+					{
+						results.push_back(object);
+					}
+				}
+			}
+			return results;
+		}
+
+		//Closest box hit by the ray, testing every box, infinite when none is
+		float findClosestHit(const std::vector<BvhObject>& objects, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+		{
+			float closestDistance = std::numeric_limits<float>::infinity();
+			for (const BvhObject& object : objects)
+			{
+				float distance;
+				if (object.proxy != weEngineBvh::NULL_NODE && object.bounds.intersectRay(origin, 1.0f / direction, maxDistance, distance))
+				{
+					closestDistance = std::min(closestDistance, distance);
+				}
+			}
+			return closestDistance;
+		}
+
+		void checkQueries(const weEngineBvh& bvh, const std::vector<BvhObject>& objects, std::mt19937& random)
+		{
+			std::uniform_real_distribution<float> positionDistribution{ -55.0f, 55.0f };
+			std::uniform_real_distribution<float> radiusDistribution{ 0.0f, 10.0f };
+			std::uniform_int_distribution<int> gridDistribution{ -50, 50 };
+			std::uniform_int_distribution<int> axisDistribution{ 0, 5 };
+
+			for (uint32_t query = 0; query < 20; query++)
+			{
+				const glm::vec3 center{ positionDistribution(random), positionDistribution(random), positionDistribution(random) };
+				const float radius = radiusDistribution(random);
+				std::vector<uint32_t> results;
+				bvh.querySphere(center, radius, results);
+				WE_CHECK(sorted(results) == findTouchingLeaves(bvh, objects, [&](const weEngineAabb& bounds)
+					{
+						const glm::vec3 offset = glm::clamp(center, bounds.minimum, bounds.maximum) - center;
+						return glm::dot(offset, offset) <= radius * radius;
+					}));
+
+				const weEngineAabb box{ center - glm::vec3{ radius }, center + glm::vec3{ radius, 0.5f * radius, 2.0f * radius } };
+				results.clear();
+				bvh.queryAabb(box, results);
+				WE_CHECK(sorted(results) == findTouchingLeaves(bvh, objects, [&](const weEngineAabb& bounds) { return bounds.overlaps(box); }));
+
+				//Rays in any direction, and rays along an axis starting on the grid the box corners are on
+				glm::vec3 origin = center;
+				glm::vec3 direction{ positionDistribution(random), positionDistribution(random), positionDistribution(random) };
+				if (query % 2 == 1)
+				{
+					origin = { gridDistribution(random), gridDistribution(random), gridDistribution(random) };
+					const int axis = axisDistribution(random);
+					direction = glm::vec3{ 0.0f };
+					direction[axis % 3] = axis < 3 ? 1.0f : -1.0f;
+				}
+				direction = glm::normalize(direction);
+
+				const float maxDistance = 80.0f;
+				const float expectedDistance = findClosestHit(objects, origin, direction, maxDistance);
+				weEngineBvh::RayHit hit{};
+				const bool found = bvh.raycast(origin, direction, maxDistance, [&](uint32_t object, float objectMaxDistance)
+					{
+						float distance;
+						return objects[object].bounds.intersectRay(origin, 1.0f / direction, objectMaxDistance, distance) ? distance : -1.0f;
+					}, hit);
+				WE_CHECK_EQUAL(found, expectedDistance <= maxDistance);
+				if (found)
+				{
+					WE_CHECK_EQUAL(hit.distance, expectedDistance);
+					float distance;
+					WE_CHECK(objects[hit.userData].bounds.intersectRay(origin, 1.0f / direction, maxDistance, distance) && distance == hit.distance);
+				}
+			}
+		}
+	}
+
+	WE_TEST(aabbRayOnSlabPlanes)
+	{
+		const weEngineAabb box{ glm::vec3{ 0.0f }, glm::vec3{ 1.0f } };
+		const glm::vec3 inverseZ = 1.0f / glm::vec3{ 0.0f, 0.0f, 1.0f };
+		const glm::vec3 inverseNegativeZeroZ = 1.0f / glm::vec3{ -0.0f, -0.0f, 1.0f };
+
+		//Rays along z whose origin lies on the planes of the x and y slabs hit the face, whatever the sign of the zero components
+		for (const glm::vec3& inverseDirection : { inverseZ, inverseNegativeZeroZ })
+		{
+			for (const glm::vec3& origin : { glm::vec3{ 0.0f, 0.5f, -1.0f }, glm::vec3{ 1.0f, 0.5f, -1.0f }, glm::vec3{ 0.5f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, -1.0f } })
+			{
+				float distance = -1.0f;
+				WE_CHECK(box.intersectRay(origin, inverseDirection, 10.0f, distance));
+				WE_CHECK_EQUAL(distance, 1.0f);
+			}
+
+			//Parallel to the slabs just outside of them, and a hit beyond the largest distance
+			float distance;
+			WE_CHECK(!box.intersectRay({ -0.001f, 0.5f, -1.0f }, inverseDirection, 10.0f, distance));
+			WE_CHECK(!box.intersectRay({ 0.5f, 1.001f, -1.0f }, inverseDirection, 10.0f, distance));
+			WE_CHECK(!box.intersectRay({ 0.5f, 0.5f, -1.0f }, inverseDirection, 0.5f, distance));
+		}
+
+		//The origin inside the box, and the box behind the ray
+		float distance = -1.0f;
+		WE_CHECK(box.intersectRay({ 0.5f, 0.5f, 0.5f }, inverseZ, 10.0f, distance));
+		WE_CHECK_EQUAL(distance, 0.0f);
+		WE_CHECK(!box.intersectRay({ 0.5f, 0.5f, 2.0f }, inverseZ, 10.0f, distance));
+	}
+
+	WE_TEST(bvhQueriesMatchBruteForce)
+	{
+		std::mt19937 random{ 23 };
+		std::uniform_int_distribution<int> operationDistribution{ 0, 9 };
+		std::uniform_real_distribution<float> moveDistribution{ -0.5f, 0.5f };
+
+		weEngineBvh bvh;
+		std::vector<BvhObject> objects;
+		checkQueries(bvh, objects, random);
+
+		for (uint32_t round = 0; round < 40; round++)
+		{
+			for (uint32_t operation = 0; operation < 100; operation++)
+			{
+				const uint32_t kind = operationDistribution(random);
+				if (kind < 4 || objects.empty())
+				{
+					BvhObject object{ getRandomBox(random) };
+					object.proxy = bvh.insert(object.bounds, static_cast<uint32_t>(objects.size()));
+					objects.push_back(object);
+					continue;
+				}
+
+				BvhObject& object = objects[std::uniform_int_distribution<size_t>{ 0, objects.size() - 1 }(random)];
+				if (object.proxy == weEngineBvh::NULL_NODE)
+				{
+					continue;
+				}
+				if (kind < 6)
+				{
+					bvh.remove(object.proxy);
+					object.proxy = weEngineBvh::NULL_NODE;
+				}
+				else
+				{
+					//Small moves stay inside the enlarged boxes, jumps refit the ancestors
+					const glm::vec3 offset = kind < 8
+						? glm::vec3{ moveDistribution(random), moveDistribution(random), moveDistribution(random) }
+						: getRandomBox(random).minimum - object.bounds.minimum;
+					object.bounds = { object.bounds.minimum + offset, object.bounds.maximum + offset };
+					bvh.update(object.proxy, object.bounds);
+				}
+			}
+
+			if (round % 10 == 9)
+			{
+				bvh.rebuild();
+			}
+			else
+			{
+				bvh.rebuildIfNeeded();
+			}
+			checkQueries(bvh, objects, random);
+		}
+		WE_CHECK(bvh.getStatistics().rebuildCount > 0);
+	}
+}
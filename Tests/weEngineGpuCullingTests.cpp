@@ -0,0 +1,145 @@
+#include "weEngineGpuTest.hpp"
+#include "GpuDrivenRenderingSystem.hpp"
+#include "weEngineDevice.hpp"
+#include "weEngineFrustumCuller.hpp"
+#include "weEngineGlobalUniforms.hpp"
+#include "weEngineSwapChain.hpp"
+
+//std
+#include "memory"
+#include "random"
+
+/*
+* Runs the culling dispatch of GpuDrivenRenderingSystem on a known scene and checks the counts it reads back against weEngineFrustumCuller.
+* Needs the compiled shaders, so it runs from the solution directory like the engine.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Box of the given half size around the origin, the model has a single detail level drawn with one range
+		std::shared_ptr<weEngineModel> createBoxModel(weEngineDevice& device, float halfSize)
+		{
+			weEngineModel::Builder builder{};
+			for (uint32_t corner = 0; corner < 8; corner++)
+			{
+				weEngineModel::Vertex vertex{};
+				vertex.position = {
+					(corner & 1) != 0 ? halfSize : -halfSize,
+					(corner & 2) != 0 ? halfSize : -halfSize,
+					(corner & 4) != 0 ? halfSize : -halfSize };
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+				builder.vertices.push_back(vertex);
+			}
+			builder.indices = {
+				0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+				0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+				0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+			builder.computeBounds();
+			return std::make_shared<weEngineModel>(device, builder);
+		}
+
+		//Smallest distance from the point to the planes, negative outside of the frustum
+		float getFrustumDistance(const std::array<glm::vec4, 6>& planes, const glm::vec3& point)
+		{
+			float distance = std::numeric_limits<float>::max();
+			for (const glm::vec4& plane : planes)
+			{
+				distance = std::min(distance, (glm::dot(glm::vec3(plane), point) + plane.w) / glm::length(glm::vec3(plane)));
+			}
+			return distance;
+		}
+
+		//Records the culling of the packet into the first frame in flight and waits for it
+		void cullFrame(weEngineDevice& device, GpuDrivenRenderingSystem& renderSystem, weEngineFramePacket& packet, VkExtent2D extent)
+		{
+			const VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+			FrameInfo frameInfo{ 0, 0.0f, commandBuffer, packet.camera, extent, nullptr, nullptr, VK_NULL_HANDLE, 0, &packet };
+			renderSystem.cullGameObjects(frameInfo);
+			device.endSingleTimeCommands(commandBuffer);
+		}
+	}
+
+	WE_GPU_TEST(gpuCullingMatchesFrustumCuller)
+	{
+		skipWithoutVulkanDevice();
+
+		weEngineWindow window{ 320, 240, "weEngine culling test" };
+		weEngineDevice device{ window };
+		if (!GpuDrivenRenderingSystem::isSupported(device))
+		{
+			skipTest("the device cannot run the GPU driven rendering system");
+		}
+
+		weEngineSwapChain swapChain{ device, window.getExtent() };
+		weEngineGlobalUniforms globalUniforms{ device };
+		const std::shared_ptr<weEngineModel> models[2] = { createBoxModel(device, 0.5f), createBoxModel(device, 1.0f) };
+
+		weEngineFramePacket packet{};
+		packet.camera.setPerspectiveProjection(glm::radians(50.0f), swapChain.extentAspectRatio(), 0.1f, 100.0f);
+		packet.camera.setViewYXZ({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.5f, 0.0f });
+		const std::array<glm::vec4, 6> frustumPlanes = packet.camera.getFrustumPlanes();
+
+		/*
+		* Objects around the camera, rotated so their boxes grow once transformed. The ones within a few units of a plane are left out:
+		* the shader draws the objects whose sphere is inside and counts the ones whose box is, the two only agree away from the planes.
+		*/
+		std::mt19937 random{ 17 };
+		std::uniform_real_distribution<float> positionDistribution{ -110.0f, 110.0f };
+		std::uniform_real_distribution<float> angleDistribution{ 0.0f, glm::two_pi<float>() };
+		uint32_t expectedVisibleCount = 0;
+		while (packet.objects.size() < 4000)
+		{
+			TransformComponent transform{};
+			transform.translation = { positionDistribution(random), positionDistribution(random) * 0.25f, positionDistribution(random) };
+			transform.rotation = { angleDistribution(random), angleDistribution(random), angleDistribution(random) };
+
+			const float distance = getFrustumDistance(frustumPlanes, transform.translation);
+			if (std::abs(distance) < 3.0f)
+			{
+				continue;
+			}
+			if (distance > 0.0f)
+			{
+				expectedVisibleCount++;
+			}
+
+			weEngineRenderObject renderObject{};
+			renderObject.entityIndex = packet.transforms.add(transform);
+			renderObject.model = models[packet.objects.size() % 2];
+			renderObject.color = { 1.0f, 1.0f, 1.0f };
+			packet.objects.push_back(renderObject);
+		}
+		packet.transforms.updateMatrices();
+		WE_CHECK(expectedVisibleCount > 0 && expectedVisibleCount < packet.objects.size());
+
+		weEngineFrustumCuller frustumCuller;
+		for (const weEngineRenderObject& renderObject : packet.objects)
+		{
+			const weEngineModel::Bounds& bounds = renderObject.model->getBounds();
+			frustumCuller.addTransformedBox(packet.transforms.getMatrix(renderObject.entityIndex), bounds.minimum, bounds.maximum);
+		}
+		std::vector<uint32_t> visibleIndices;
+		frustumCuller.cull(frustumPlanes, visibleIndices);
+		WE_CHECK_EQUAL(static_cast<uint32_t>(visibleIndices.size()), expectedVisibleCount);
+
+		//Without occlusion culling every object inside the frustum is drawn by the first phase
+		GpuDrivenRenderingSystem renderSystem{ device, swapChain.getRenderPass(), globalUniforms.getDescriptorSetLayout(), false };
+		renderSystem.setCullingValidation(true);
+		device.getUploadManager().waitIdle();
+
+		//The counts of a frame are read back when its resources are used again, by the next culling of the same frame in flight
+		cullFrame(device, renderSystem, packet, swapChain.getSwapChainExtent());
+		cullFrame(device, renderSystem, packet, swapChain.getSwapChainExtent());
+
+		const GpuDrivenRenderingSystem::Statistics& statistics = renderSystem.getStatistics();
+		WE_CHECK_EQUAL(statistics.objectCount, static_cast<uint32_t>(packet.objects.size()));
+		WE_CHECK_EQUAL(statistics.modelCount, 2u);
+		WE_CHECK_EQUAL(statistics.gpuFrustumObjectCount, expectedVisibleCount);
+		WE_CHECK_EQUAL(statistics.cpuFrustumObjectCount, expectedVisibleCount);
+		WE_CHECK_EQUAL(statistics.visibleDrawCount, expectedVisibleCount);
+		WE_CHECK_EQUAL(statistics.disoccludedDrawCount, 0u);
+		WE_CHECK_EQUAL(statistics.cullingMismatchCount, 0u);
+	}
+}
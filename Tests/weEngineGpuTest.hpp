@@ -0,0 +1,61 @@
+#pragma once
+
+#include "weEngineTest.hpp"
+#include "weEngineWindow.hpp"
+
+//std
+#include "cstdint"
+#include "vector"
+
+/*
+* Helpers of the GPU tests, which open a window and create a device like the engine does. A software device like lavapipe is enough.
+*/
+
+namespace weEngine
+{
+	/*
+	* Skips the calling test when GLFW cannot start, for example without a display, or when the Vulkan loader reports no physical device.
+	* Called first by every GPU test, so a machine without a GPU skips them instead of failing in the device constructor.
+	*/
+	inline void skipWithoutVulkanDevice()
+	{
+		if (glfwInit() != GLFW_TRUE)
+		{
+			skipTest("GLFW could not be initialized, there is no display");
+		}
+		if (glfwVulkanSupported() != GLFW_TRUE)
+		{
+			glfwTerminate();
+			skipTest("no Vulkan loader was found");
+		}
+
+		uint32_t extensionCount = 0;
+		const char** extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "weEngine tests";
+		appInfo.apiVersion = VK_API_VERSION_1_0;
+
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+		createInfo.enabledExtensionCount = extensionCount;
+		createInfo.ppEnabledExtensionNames = extensions;
+
+		VkInstance instance = VK_NULL_HANDLE;
+		uint32_t physicalDeviceCount = 0;
+		if (vkCreateInstance(&createInfo, nullptr, &instance) == VK_SUCCESS)
+		{
+			vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
+			vkDestroyInstance(instance, nullptr);
+		}
+
+		//The window of the test initializes GLFW again
+		glfwTerminate();
+		if (physicalDeviceCount == 0)
+		{
+			skipTest("no Vulkan device is present");
+		}
+	}
+}
@@ -0,0 +1,389 @@
+#include "weEngineTest.hpp"
+#include "weEngineJobSystem.hpp"
+#include "weEngineThreadPool.hpp"
+
+//std
+#include "atomic"
+#include "cmath"
+#include "iostream"
+#include "memory"
+#include "stdexcept"
+#include "thread"
+
+/*
+* Checks the work stealing deque and the job system on more threads than the machine may have, and measures the job system
+* against the thread pool it replaced.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Workers of the job systems the tests create, enough for the thieves to contend even on a single core
+		constexpr uint32_t TEST_WORKER_COUNT = 3;
+
+		//Counts how many times each index was visited
+		class VisitCounts
+		{
+		public:
+			explicit VisitCounts(uint32_t count) : count{ count }, visits{ new std::atomic<uint32_t>[count] }
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					visits[i].store(0, std::memory_order_relaxed);
+				}
+			}
+
+			void visit(uint32_t index)
+			{
+				visits[index].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			//True when every index was visited exactly once
+			bool isVisitedOnce() const
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (visits[i].load(std::memory_order_relaxed) != 1)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+		private:
+			uint32_t count;
+			std::unique_ptr<std::atomic<uint32_t>[]> visits;
+		};
+
+		//Some work for a task, so the tasks overlap between the threads
+		float spin(uint32_t iterationCount)
+		{
+			float value = 0.0f;
+			for (uint32_t i = 0; i < iterationCount; i++)
+			{
+				value += std::sqrt(static_cast<float>(i));
+			}
+			return value;
+		}
+	}
+
+	WE_TEST(workDequePopsNewestAndStealsOldest)
+	{
+		weEngineJob jobs[3];
+		weEngineJobSystem::WorkDeque deque;
+		WE_CHECK(deque.pop() == nullptr);
+		WE_CHECK(deque.steal() == nullptr);
+
+		for (weEngineJob& job : jobs)
+		{
+			WE_CHECK(deque.push(&job));
+		}
+		WE_CHECK(deque.steal() == &jobs[0]);
+		WE_CHECK(deque.pop() == &jobs[2]);
+		WE_CHECK(deque.pop() == &jobs[1]);
+		WE_CHECK(deque.pop() == nullptr);
+		WE_CHECK(deque.steal() == nullptr);
+	}
+
+	WE_TEST(workDequeRefusesJobsWhenFull)
+	{
+		std::vector<weEngineJob> jobs(weEngineJobSystem::DEQUE_CAPACITY + 1);
+		weEngineJobSystem::WorkDeque deque;
+		for (uint32_t i = 0; i < weEngineJobSystem::DEQUE_CAPACITY; i++)
+		{
+			WE_CHECK(deque.push(&jobs[i]));
+		}
+		WE_CHECK(!deque.push(&jobs.back()));
+
+		//A stolen job makes room again, and the indices wrap around the ring
+		WE_CHECK(deque.steal() == &jobs[0]);
+		WE_CHECK(deque.push(&jobs.back()));
+		WE_CHECK(deque.pop() == &jobs.back());
+	}
+
+	WE_TEST(workDequeTakesEveryJobOnceUnderContention)
+	{
+		//The owner pushes and pops while the thieves steal, the last job of the deque is raced for by both sides
+		constexpr uint32_t jobCount = 200000;
+		std::vector<weEngineJob> jobs(jobCount);
+		VisitCounts taken{ jobCount };
+		auto take = [&](weEngineJob* job)
+		{
+			taken.visit(static_cast<uint32_t>(job - jobs.data()));
+		};
+
+		weEngineJobSystem::WorkDeque deque;
+		std::atomic<bool> isPushing{ true };
+		std::atomic<uint32_t> takenCount{ 0 };
+		std::vector<std::thread> thieves;
+		for (uint32_t thief = 0; thief < TEST_WORKER_COUNT; thief++)
+		{
+			thieves.emplace_back([&]()
+				{
+					while (isPushing.load() || takenCount.load() < jobCount)
+					{
+						if (weEngineJob* job = deque.steal())
+						{
+							take(job);
+							takenCount++;
+						}
+						else
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+		}
+
+		uint32_t pushedCount = 0;
+		while (pushedCount < jobCount)
+		{
+			//Pushes a few jobs, then takes one back, and takes back until there is room when the deque is full
+			for (uint32_t i = 0; i < 3 && pushedCount < jobCount; i++)
+			{
+				if (deque.push(&jobs[pushedCount]))
+				{
+					pushedCount++;
+				}
+			}
+			if (weEngineJob* job = deque.pop())
+			{
+				take(job);
+				takenCount++;
+			}
+		}
+		isPushing = false;
+
+		while (weEngineJob* job = deque.pop())
+		{
+			take(job);
+			takenCount++;
+		}
+		for (std::thread& thief : thieves)
+		{
+			thief.join();
+		}
+
+		WE_CHECK_EQUAL(takenCount.load(), jobCount);
+		WE_CHECK(taken.isVisitedOnce());
+	}
+
+	WE_TEST(jobSystemRunsEveryJobOnce)
+	{
+		//More jobs than a deque holds, half of them pushed by the workers themselves
+		constexpr uint32_t jobCount = 20000;
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		VisitCounts ran{ 2 * jobCount };
+
+		weEngineJobCounter counter;
+		for (uint32_t i = 0; i < jobCount; i++)
+		{
+			jobSystem.run([&, i]()
+				{
+					ran.visit(i);
+					jobSystem.run([&, i]() { ran.visit(jobCount + i); }, &counter);
+				}, &counter);
+		}
+		jobSystem.wait(counter);
+
+		WE_CHECK(counter.isDone());
+		WE_CHECK(ran.isVisitedOnce());
+	}
+
+	WE_TEST(jobSystemHoldsDependentsUntilTheirCounter)
+	{
+		constexpr uint32_t jobCount = 64;
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+
+		//Each stage depends on the counter of the one before, a stage has to see every job of the previous one finished
+		std::atomic<uint32_t> finishedCounts[3]{};
+		std::atomic<bool> startedEarly{ false };
+		weEngineJobCounter counters[3];
+		for (uint32_t stage = 0; stage < 3; stage++)
+		{
+			for (uint32_t i = 0; i < jobCount; i++)
+			{
+				jobSystem.run([&, stage]()
+					{
+						if (stage > 0 && finishedCounts[stage - 1].load() != jobCount)
+						{
+							startedEarly = true;
+						}
+						spin(2000);
+						finishedCounts[stage]++;
+					}, &counters[stage], stage > 0 ? &counters[stage - 1] : nullptr);
+			}
+		}
+		jobSystem.wait(counters[2]);
+
+		WE_CHECK(!startedEarly.load());
+		for (uint32_t stage = 0; stage < 3; stage++)
+		{
+			WE_CHECK_EQUAL(finishedCounts[stage].load(), jobCount);
+			WE_CHECK(counters[stage].isDone());
+		}
+
+		//A dependency already done holds nothing
+		weEngineJobCounter counter;
+		bool ran = false;
+		jobSystem.run([&]() { ran = true; }, &counter, &counters[0]);
+		jobSystem.wait(counter);
+		WE_CHECK(ran);
+	}
+
+	WE_TEST(jobSystemRunsMainThreadJobsOnTheMainThread)
+	{
+		constexpr uint32_t jobCount = 256;
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		const std::thread::id mainThreadId = std::this_thread::get_id();
+		WE_CHECK(jobSystem.isMainThread());
+
+		//Queued by the workers, and run by the main thread while it waits
+		std::atomic<uint32_t> mainThreadRunCount{ 0 };
+		std::atomic<uint32_t> otherThreadRunCount{ 0 };
+		weEngineJobCounter counter;
+		for (uint32_t i = 0; i < jobCount; i++)
+		{
+			jobSystem.run([&]()
+				{
+					jobSystem.runOnMainThread([&]()
+						{
+							(std::this_thread::get_id() == mainThreadId ? mainThreadRunCount : otherThreadRunCount)++;
+						}, &counter);
+				}, &counter);
+		}
+		jobSystem.wait(counter);
+		WE_CHECK_EQUAL(mainThreadRunCount.load(), jobCount);
+		WE_CHECK_EQUAL(otherThreadRunCount.load(), 0u);
+
+		//Queued from another thread and run by runMainThreadJobs, the main loop way
+		weEngineJobCounter queuedCounter;
+		bool ranOnMainThread = false;
+		std::thread{ [&]() { jobSystem.runOnMainThread([&]() { ranOnMainThread = std::this_thread::get_id() == mainThreadId; }, &queuedCounter); } }.join();
+		WE_CHECK(!queuedCounter.isDone());
+		jobSystem.runMainThreadJobs();
+		WE_CHECK(queuedCounter.isDone());
+		WE_CHECK(ranOnMainThread);
+	}
+
+	WE_TEST(jobSystemParallelForRunsEveryTaskOnce)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+
+		//parallelFor has no grain size, every task is a job of its own. The sizes cover the serial cases, fewer tasks than threads,
+		//just more tasks than a deque holds, and many times that
+		for (uint32_t taskCount : { 0u, 1u, 2u, jobSystem.getThreadCount() - 1, weEngineJobSystem::DEQUE_CAPACITY + 1, 1000000u })
+		{
+			VisitCounts ran{ taskCount };
+			jobSystem.parallelFor(taskCount, [&](uint32_t taskIndex) { ran.visit(taskIndex); });
+			WE_CHECK(ran.isVisitedOnce());
+		}
+
+		//Nested in its own tasks
+		VisitCounts ran{ 64 * 64 };
+		jobSystem.parallelFor(64, [&](uint32_t outer)
+			{
+				jobSystem.parallelFor(64, [&](uint32_t inner) { ran.visit(outer * 64 + inner); });
+			});
+		WE_CHECK(ran.isVisitedOnce());
+	}
+
+	WE_TEST(jobSystemParallelForRethrowsAfterTheTasks)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+
+		std::atomic<uint32_t> runningCount{ 0 };
+		std::atomic<uint32_t> runningAtThrow{ 0 };
+		bool threw = false;
+		try
+		{
+			jobSystem.parallelFor(10000, [&](uint32_t taskIndex)
+				{
+					runningCount++;
+					spin(500);
+					runningCount--;
+					if (taskIndex % 1000 == 7)
+					{
+						throw std::runtime_error("task failed");
+					}
+				});
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+			runningAtThrow = runningCount.load();
+		}
+		WE_CHECK(threw);
+		WE_CHECK_EQUAL(runningAtThrow.load(), 0u);
+
+		//The job system is left usable
+		VisitCounts ran{ 1000 };
+		jobSystem.parallelFor(1000, [&](uint32_t taskIndex) { ran.visit(taskIndex); });
+		WE_CHECK(ran.isVisitedOnce());
+	}
+
+	WE_TEST(jobSystemGivesTheMainThreadBackToTheSharedOne)
+	{
+		//The test executable made the shared job system first, a job system created and destroyed since must not keep the main thread
+		weEngineJobSystem& shared = weEngineJobSystem::shared();
+		{
+			weEngineJobSystem jobSystem{ 1 };
+		}
+
+		bool ran = false;
+		weEngineJobCounter counter;
+		shared.runOnMainThread([&]() { ran = true; }, &counter);
+		shared.wait(counter);
+		WE_CHECK(ran);
+	}
+
+	WE_BENCHMARK(jobSystemParallelForAgainstThreadPool)
+	{
+		const uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		weEngineJobSystem jobSystem{ workerCount };
+		weEngineThreadPool threadPool{ workerCount };
+		std::cout << "Job system and thread pool with " << workerCount << " workers" << std::endl;
+
+		struct Workload
+		{
+			const char* name;
+			uint32_t taskCount;
+			uint32_t iterationsPerTask;
+		};
+
+		//Many small tasks measure the scheduling overhead, few large ones the balancing
+		const Workload workloads[] = {
+			{ "1M tasks of 10 iterations", 1000000, 10 },
+			{ "10k tasks of 1k iterations", 10000, 1000 },
+			{ "64 tasks of 100k iterations", 64, 100000 },
+		};
+
+		for (const Workload& workload : workloads)
+		{
+			std::vector<float> results(workload.taskCount);
+			auto task = [&](uint32_t taskIndex) { results[taskIndex] = spin(workload.iterationsPerTask); };
+
+			const float jobSystemMilliseconds = measureMilliseconds(5, [&]() { jobSystem.parallelFor(workload.taskCount, task); });
+			const float threadPoolMilliseconds = measureMilliseconds(5, [&]() { threadPool.parallelFor(workload.taskCount, task); });
+
+			std::cout << workload.name << ": job system " << jobSystemMilliseconds << " ms, thread pool " << threadPoolMilliseconds << " ms ("
+				<< threadPoolMilliseconds / jobSystemMilliseconds << "x)" << std::endl;
+		}
+
+		//Nested parallelFor, which the thread pool can only run serially on its workers
+		std::vector<float> results(256 * 256);
+		auto nestedTask = [&](auto& scheduler)
+		{
+			return [&](uint32_t outer)
+			{
+				scheduler.parallelFor(256, [&](uint32_t inner) { results[outer * 256 + inner] = spin(200); });
+			};
+		};
+		const float jobSystemMilliseconds = measureMilliseconds(5, [&]() { jobSystem.parallelFor(256, nestedTask(jobSystem)); });
+		const float threadPoolMilliseconds = measureMilliseconds(5, [&]() { threadPool.parallelFor(256, nestedTask(threadPool)); });
+		std::cout << "256 x 256 nested tasks: job system " << jobSystemMilliseconds << " ms, thread pool " << threadPoolMilliseconds << " ms ("
+			<< threadPoolMilliseconds / jobSystemMilliseconds << "x)" << std::endl;
+	}
+}
@@ -0,0 +1,107 @@
+#include "weEngineTest.hpp"
+#include "weEngineOcclusionCuller.hpp"
+
+//std
+#include "vector"
+
+//glm
+#include "glm/gtc/matrix_transform.hpp"
+
+/*
+* Checks the CPU occlusion culler on small scenes seen from a fixed camera. It rasterizes on the CPU, so it runs without a GPU.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Camera at the origin looking down -z, the depth goes from 0 on the near plane to 1 on the far plane
+		glm::mat4 getProjectionView()
+		{
+			const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 320.0f / 192.0f, 0.1f, 100.0f);
+			const glm::mat4 view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+			return projection * view;
+		}
+
+		//Unit square in the xy plane, centered on the origin, as two triangles
+		weEngineOccluderMesh createQuadOccluder()
+		{
+			weEngineOccluderMesh quad;
+			quad.positions = { { -0.5f, -0.5f, 0.0f }, { 0.5f, -0.5f, 0.0f }, { 0.5f, 0.5f, 0.0f }, { -0.5f, 0.5f, 0.0f } };
+			quad.indices = { 0, 1, 2, 0, 2, 3 };
+			return quad;
+		}
+
+		//Square of the given size facing the camera, its center at the given position
+		glm::mat4 getQuadTransform(const glm::vec3& center, float size)
+		{
+			return glm::scale(glm::translate(glm::mat4{ 1.0f }, center), glm::vec3{ size, size, 1.0f });
+		}
+
+		bool isBoxVisible(weEngineOcclusionCuller& culler, const glm::vec3& minimum, const glm::vec3& maximum)
+		{
+			std::vector<uint32_t> visibleIndices;
+			culler.cullBoxes({ minimum }, { maximum }, visibleIndices);
+			WE_CHECK_EQUAL(culler.isBoxVisible(minimum, maximum), !visibleIndices.empty());
+			return !visibleIndices.empty();
+		}
+	}
+
+	WE_TEST(occlusionCullerHidesBoxesBehindAWall)
+	{
+		const weEngineOccluderMesh quad = createQuadOccluder();
+		weEngineOcclusionCuller culler;
+		culler.beginFrame(getProjectionView());
+		culler.addOccluder(quad, getQuadTransform({ 0.0f, 0.0f, -5.0f }, 40.0f));
+		culler.rasterize();
+		WE_CHECK_EQUAL(culler.getStatistics().occluderCount, 1u);
+		WE_CHECK(culler.getStatistics().rasterizedTriangleCount > 0);
+
+		WE_CHECK(!isBoxVisible(culler, { -1.0f, -1.0f, -12.0f }, { 1.0f, 1.0f, -10.0f }));
+		WE_CHECK(isBoxVisible(culler, { -1.0f, -1.0f, -4.0f }, { 1.0f, 1.0f, -3.0f }));
+
+		//Partly in front of the wall, and crossing the near plane
+		WE_CHECK(isBoxVisible(culler, { -1.0f, -1.0f, -8.0f }, { 1.0f, 1.0f, -4.5f }));
+		WE_CHECK(isBoxVisible(culler, { -1.0f, -1.0f, -12.0f }, { 1.0f, 1.0f, 1.0f }));
+	}
+
+	WE_TEST(occlusionCullerSeesAroundASmallOccluder)
+	{
+		const weEngineOccluderMesh quad = createQuadOccluder();
+		weEngineOcclusionCuller culler;
+		culler.beginFrame(getProjectionView());
+		culler.addOccluder(quad, getQuadTransform({ 0.0f, 0.0f, -5.0f }, 1.0f));
+		culler.rasterize();
+
+		//Hidden right behind the occluder, visible beside it
+		WE_CHECK(!isBoxVisible(culler, { -0.2f, -0.2f, -12.0f }, { 0.2f, 0.2f, -10.0f }));
+		WE_CHECK(isBoxVisible(culler, { 4.0f, -0.2f, -12.0f }, { 4.4f, 0.2f, -10.0f }));
+	}
+
+	WE_TEST(occlusionCullerForgetsTheOccludersOfTheLastFrame)
+	{
+		const weEngineOccluderMesh quad = createQuadOccluder();
+		const glm::vec3 boxMinimum{ -1.0f, -1.0f, -12.0f };
+		const glm::vec3 boxMaximum{ 1.0f, 1.0f, -10.0f };
+
+		//The wall comes after a small occluder, so it is past the occluders of the next frame
+		weEngineOcclusionCuller culler;
+		culler.beginFrame(getProjectionView());
+		culler.addOccluder(quad, getQuadTransform({ 8.0f, 0.0f, -20.0f }, 1.0f));
+		culler.addOccluder(quad, getQuadTransform({ 0.0f, 0.0f, -5.0f }, 40.0f));
+		culler.rasterize();
+		WE_CHECK(!isBoxVisible(culler, boxMinimum, boxMaximum));
+
+		//The wall left the frame, nothing hides the box any more
+		culler.beginFrame(getProjectionView());
+		culler.addOccluder(quad, getQuadTransform({ 8.0f, 0.0f, -20.0f }, 1.0f));
+		culler.rasterize();
+		WE_CHECK_EQUAL(culler.getStatistics().occluderCount, 1u);
+		WE_CHECK(isBoxVisible(culler, boxMinimum, boxMaximum));
+
+		//No occluders at all
+		culler.beginFrame(getProjectionView());
+		culler.rasterize();
+		WE_CHECK(isBoxVisible(culler, boxMinimum, boxMaximum));
+	}
+}
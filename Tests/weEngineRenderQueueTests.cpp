@@ -0,0 +1,156 @@
+#include "weEngineTest.hpp"
+#include "weEngineJobSystem.hpp"
+#include "weEngineRenderQueue.hpp"
+
+//std
+#include "algorithm"
+#include "cmath"
+#include "limits"
+#include "random"
+
+/*
+* Checks the radix sort of the render queue against std::stable_sort and the depth quantization of the sort keys.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Workers of the job system the sorts are split across, so large queues take several tasks even on a single core
+		constexpr uint32_t TEST_WORKER_COUNT = 3;
+
+		/*
+		* Sorts the keys with the queue and with std::stable_sort over the same entries, the object indices give the push order
+		* so equal keys have to come out in the same order from both.
+		*/
+		void checkSort(weEngineJobSystem& jobSystem, const std::vector<uint64_t>& keys)
+		{
+			weEngineRenderQueue renderQueue;
+			std::vector<weEngineRenderQueue::Entry> expected;
+			for (uint32_t i = 0; i < keys.size(); i++)
+			{
+				renderQueue.push(keys[i], i);
+				expected.push_back({ keys[i], i, 0 });
+			}
+			renderQueue.sort(jobSystem);
+			std::stable_sort(expected.begin(), expected.end(), [](const weEngineRenderQueue::Entry& a, const weEngineRenderQueue::Entry& b) { return a.key < b.key; });
+
+			const std::vector<weEngineRenderQueue::Entry>& entries = renderQueue.getEntries();
+			WE_CHECK_EQUAL(entries.size(), expected.size());
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				if (entries[i].key != expected[i].key || entries[i].objectIndex != expected[i].objectIndex)
+				{
+					std::ostringstream message;
+					message << "Entry " << i << " of " << entries.size() << " is the object " << entries[i].objectIndex << " instead of " << expected[i].objectIndex;
+					failTest(__FILE__, __LINE__, message.str());
+				}
+			}
+			WE_CHECK_EQUAL(renderQueue.getStatistics().entryCount, static_cast<uint32_t>(keys.size()));
+		}
+
+		//Keys drawn from a few distinct values, so most of them repeat, spread over every byte
+		std::vector<uint64_t> getRandomKeys(std::mt19937_64& random, uint32_t count, uint32_t distinctCount)
+		{
+			std::vector<uint64_t> values(distinctCount);
+			for (uint64_t& value : values)
+			{
+				value = random();
+			}
+
+			std::uniform_int_distribution<uint32_t> valueDistribution{ 0, distinctCount - 1 };
+			std::vector<uint64_t> keys(count);
+			for (uint64_t& key : keys)
+			{
+				key = values[valueDistribution(random)];
+			}
+			return keys;
+		}
+	}
+
+	WE_TEST(renderQueueSortsSmallQueues)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		std::mt19937_64 random{ 31 };
+
+		checkSort(jobSystem, {});
+		checkSort(jobSystem, { 42 });
+		checkSort(jobSystem, { 7, 7, 7, 7 });
+		checkSort(jobSystem, { 3, 1, 2, 1, 3, 0 });
+		for (uint32_t count : { 2u, 17u, 255u, 1000u })
+		{
+			checkSort(jobSystem, getRandomKeys(random, count, std::max(1u, count / 4)));
+		}
+	}
+
+	WE_TEST(renderQueueSortsAcrossTasks)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		std::mt19937_64 random{ 37 };
+
+		//Not a multiple of the task size, so the last task gets fewer entries
+		const uint32_t count = weEngineRenderQueue::MIN_ENTRIES_PER_SORT_TASK * 5 + 123;
+		const std::vector<uint64_t> keys = getRandomKeys(random, count, 500);
+
+		weEngineRenderQueue renderQueue;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			renderQueue.push(keys[i], i);
+		}
+		renderQueue.sort(jobSystem);
+		WE_CHECK_EQUAL(renderQueue.getStatistics().sortTaskCount, TEST_WORKER_COUNT + 1);
+		WE_CHECK_EQUAL(renderQueue.getStatistics().radixPassCount, 8u);
+
+		checkSort(jobSystem, keys);
+	}
+
+	WE_TEST(renderQueueSortsKeysDifferingInTheHighByte)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		std::mt19937_64 random{ 41 };
+
+		//Only the top byte varies, the other passes are skipped
+		const uint32_t count = weEngineRenderQueue::MIN_ENTRIES_PER_SORT_TASK * 3;
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys)
+		{
+			key = (random() & 0xff00000000000000ull) | 0x0012345678abcdefull;
+		}
+
+		weEngineRenderQueue renderQueue;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			renderQueue.push(keys[i], i);
+		}
+		renderQueue.sort(jobSystem);
+		WE_CHECK_EQUAL(renderQueue.getStatistics().radixPassCount, 1u);
+
+		checkSort(jobSystem, keys);
+	}
+
+	WE_TEST(sortKeyQuantizesDepthInOrder)
+	{
+		//Zero, negative and NaN depths come first
+		WE_CHECK_EQUAL(weEngineSortKey::quantizeDepth(0.0f), 0u);
+		WE_CHECK_EQUAL(weEngineSortKey::quantizeDepth(-0.0f), 0u);
+		WE_CHECK_EQUAL(weEngineSortKey::quantizeDepth(-5.0f), 0u);
+		WE_CHECK_EQUAL(weEngineSortKey::quantizeDepth(std::numeric_limits<float>::quiet_NaN()), 0u);
+
+		//Never decreases with the depth, and keeps depths a tenth of a percent apart in order at every distance
+		uint32_t previous = 0;
+		for (float depth = 1e-6f; depth < 1e30f; depth *= 1.001f)
+		{
+			const uint32_t quantized = weEngineSortKey::quantizeDepth(depth);
+			WE_CHECK(quantized > previous);
+			WE_CHECK(quantized < (1u << weEngineSortKey::DEPTH_BITS));
+			previous = quantized;
+		}
+		WE_CHECK(weEngineSortKey::quantizeDepth(std::numeric_limits<float>::infinity()) < (1u << weEngineSortKey::DEPTH_BITS));
+
+		//The depth only fills its own field of the key
+		const uint64_t key = weEngineSortKey::encode(0, 1, 2, 3, 4, weEngineSortKey::quantizeDepth(std::numeric_limits<float>::max()));
+		WE_CHECK_EQUAL(weEngineSortKey::getPipeline(key), 1u);
+		WE_CHECK_EQUAL(weEngineSortKey::getModel(key), 3u);
+		WE_CHECK_EQUAL(weEngineSortKey::getLod(key), 4u);
+	}
+}
@@ -0,0 +1,279 @@
+#include "weEngineTest.hpp"
+#include "weEngineJobSystem.hpp"
+#include "weEngineTaskGraph.hpp"
+
+//std
+#include "algorithm"
+#include "atomic"
+#include "chrono"
+#include "functional"
+#include "initializer_list"
+#include "memory"
+#include "thread"
+#include "vector"
+
+/*
+* Checks the order the task graph runs its tasks in against the hazards on their resources, and the threads it runs them on.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		constexpr uint32_t TEST_WORKER_COUNT = 3;
+
+		/*
+		* Adds tasks to the graph keeping what they access, and records when and where each one ran. The start and end of a task are
+		* taken from one counter, so a task ended before another started when its end is below the start of the other.
+		*/
+		class TaskRecorder
+		{
+		public:
+			explicit TaskRecorder(weEngineTaskGraph& taskGraph) : taskGraph{ taskGraph }
+			{
+			}
+
+			weEngineTaskGraph::TaskId addTask(std::initializer_list<weEngineTaskGraph::ResourceId> reads, std::initializer_list<weEngineTaskGraph::ResourceId> writes,
+				std::function<void()> work = {}, weEngineTaskGraph::TaskAffinity affinity = weEngineTaskGraph::TaskAffinity::ANY_THREAD)
+			{
+				const uint32_t index = static_cast<uint32_t>(records.size());
+				records.push_back(std::make_unique<Record>());
+				records.back()->reads = reads;
+				records.back()->writes = writes;
+				return taskGraph.addTask(reads, writes, [this, index, work]()
+					{
+						Record& record = *records[index];
+						record.thread = std::this_thread::get_id();
+						record.start = clock.fetch_add(1, std::memory_order_acq_rel);
+						if (work)
+						{
+							work();
+						}
+						record.end = clock.fetch_add(1, std::memory_order_acq_rel);
+						record.runCount++;
+					}, affinity);
+			}
+
+			void execute(weEngineJobSystem& jobSystem)
+			{
+				for (std::unique_ptr<Record>& record : records)
+				{
+					record->runCount = 0;
+				}
+				taskGraph.execute(jobSystem);
+			}
+
+			/*
+			* Every task ran once, and after every earlier task writing what it reads or reading or writing what it writes.
+			* Found by comparing every pair of tasks, independently of the edges the graph keeps.
+			*/
+			void checkHazardOrder() const
+			{
+				for (uint32_t task = 0; task < records.size(); task++)
+				{
+					WE_CHECK_EQUAL(records[task]->runCount, 1u);
+					for (uint32_t earlier = 0; earlier < task; earlier++)
+					{
+						if (hasHazard(*records[earlier], *records[task]) && !(records[earlier]->end < records[task]->start))
+						{
+							std::ostringstream message;
+							message << "Task " << task << " started before the task " << earlier << " it has a hazard with ended";
+							failTest(__FILE__, __LINE__, message.str());
+						}
+					}
+				}
+			}
+
+			std::thread::id getThread(weEngineTaskGraph::TaskId task) const
+			{
+				return records[task]->thread;
+			}
+
+		private:
+			struct Record
+			{
+				std::vector<weEngineTaskGraph::ResourceId> reads;
+				std::vector<weEngineTaskGraph::ResourceId> writes;
+				std::thread::id thread;
+				uint32_t start = 0;
+				uint32_t end = 0;
+				uint32_t runCount = 0;
+			};
+
+			static bool contains(const std::vector<weEngineTaskGraph::ResourceId>& resources, weEngineTaskGraph::ResourceId resource)
+			{
+				return std::find(resources.begin(), resources.end(), resource) != resources.end();
+			}
+
+			static bool hasHazard(const Record& earlier, const Record& later)
+			{
+				for (weEngineTaskGraph::ResourceId resource : later.writes)
+				{
+					if (contains(earlier.reads, resource) || contains(earlier.writes, resource))
+					{
+						return true;
+					}
+				}
+				for (weEngineTaskGraph::ResourceId resource : later.reads)
+				{
+					if (contains(earlier.writes, resource))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			weEngineTaskGraph& taskGraph;
+			std::vector<std::unique_ptr<Record>> records;
+			std::atomic<uint32_t> clock{ 0 };
+		};
+
+		//Some work for a task, so the tasks without a hazard between them get a chance to overlap
+		void work()
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+
+		/*
+		* Tasks calling arrive wait until count tasks arrived, for at most a few seconds so a graph running them one after the other
+		* fails the test instead of hanging.
+		*/
+		class Rendezvous
+		{
+		public:
+			explicit Rendezvous(uint32_t count) : count{ count }
+			{
+			}
+
+			void arrive()
+			{
+				arrived.fetch_add(1, std::memory_order_acq_rel);
+				const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+				while (arrived.load(std::memory_order_acquire) < count && std::chrono::steady_clock::now() < deadline)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			bool isComplete() const
+			{
+				return arrived.load(std::memory_order_acquire) >= count;
+			}
+
+		private:
+			uint32_t count;
+			std::atomic<uint32_t> arrived{ 0 };
+		};
+	}
+
+	WE_TEST(taskGraphWritersRunAfterReadersAndWriters)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		weEngineTaskGraph taskGraph;
+		const weEngineTaskGraph::ResourceId resource = taskGraph.addResource();
+
+		//A writer, three readers of what it wrote, and a writer after them
+		TaskRecorder recorder{ taskGraph };
+		recorder.addTask({}, { resource }, work);
+		for (uint32_t reader = 0; reader < 3; reader++)
+		{
+			recorder.addTask({ resource }, {}, work);
+		}
+		recorder.addTask({}, { resource }, work);
+		recorder.addTask({ resource }, {}, work);
+
+		//Both writers and the readers between them, and the last reader on the second writer
+		recorder.execute(jobSystem);
+		recorder.checkHazardOrder();
+		WE_CHECK_EQUAL(taskGraph.getStatistics().taskCount, 6u);
+		WE_CHECK_EQUAL(taskGraph.getStatistics().dependencyCount, 3u + 3u + 1u + 1u);
+	}
+
+	WE_TEST(taskGraphOrdersTasksOnSeveralResources)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		weEngineTaskGraph taskGraph;
+		const weEngineTaskGraph::ResourceId transforms = taskGraph.addResource();
+		const weEngineTaskGraph::ResourceId bounds = taskGraph.addResource();
+		const weEngineTaskGraph::ResourceId drawList = taskGraph.addResource();
+		const weEngineTaskGraph::ResourceId statistics = taskGraph.addResource();
+
+		//Filled again with the same tasks, as every frame does, the resources are kept by clear
+		for (uint32_t frame = 0; frame < 20; frame++)
+		{
+			taskGraph.clear();
+			TaskRecorder recorder{ taskGraph };
+			recorder.addTask({}, { transforms }, work);
+			recorder.addTask({ transforms }, { bounds }, work);
+			recorder.addTask({ transforms }, { statistics }, work);
+			recorder.addTask({ bounds, transforms }, { drawList }, work);
+			recorder.addTask({ drawList }, {}, work);
+			recorder.addTask({}, { transforms }, work);
+			recorder.addTask({ drawList }, { statistics }, work);
+			recorder.addTask({ transforms, bounds }, {}, work);
+			recorder.addTask({}, { bounds, drawList }, work);
+			recorder.addTask({ statistics }, {}, work, weEngineTaskGraph::TaskAffinity::MAIN_THREAD);
+			recorder.execute(jobSystem);
+			recorder.checkHazardOrder();
+		}
+	}
+
+	WE_TEST(taskGraphRunsReadersTogether)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		weEngineTaskGraph taskGraph;
+		const weEngineTaskGraph::ResourceId shared = taskGraph.addResource();
+		const weEngineTaskGraph::ResourceId other = taskGraph.addResource();
+
+		/*
+		* The readers of the resource and a writer of another one only finish once they are all running, which they can only do at the same time.
+		* There are as many of them as workers, the main thread waiting on the graph may run one of them too.
+		*/
+		Rendezvous rendezvous{ TEST_WORKER_COUNT };
+		TaskRecorder recorder{ taskGraph };
+		recorder.addTask({}, { shared }, work);
+		for (uint32_t reader = 0; reader < TEST_WORKER_COUNT - 1; reader++)
+		{
+			recorder.addTask({ shared }, {}, [&rendezvous]() { rendezvous.arrive(); });
+		}
+		recorder.addTask({}, { other }, [&rendezvous]() { rendezvous.arrive(); });
+		recorder.addTask({ shared, other }, {}, work);
+
+		recorder.execute(jobSystem);
+		WE_CHECK(rendezvous.isComplete());
+		recorder.checkHazardOrder();
+	}
+
+	WE_TEST(taskGraphRunsMainThreadTasksOnTheMainThread)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		weEngineTaskGraph taskGraph;
+		const weEngineTaskGraph::ResourceId input = taskGraph.addResource();
+		const weEngineTaskGraph::ResourceId frame = taskGraph.addResource();
+		const std::thread::id mainThread = std::this_thread::get_id();
+
+		//Main thread tasks at the start, between worker tasks and at the end of the graph
+		TaskRecorder recorder{ taskGraph };
+		std::vector<weEngineTaskGraph::TaskId> mainThreadTasks;
+		mainThreadTasks.push_back(recorder.addTask({}, { input }, work, weEngineTaskGraph::TaskAffinity::MAIN_THREAD));
+		recorder.addTask({ input }, { frame }, work);
+		for (uint32_t task = 0; task < 4; task++)
+		{
+			mainThreadTasks.push_back(recorder.addTask({ frame }, {}, work, weEngineTaskGraph::TaskAffinity::MAIN_THREAD));
+			recorder.addTask({ frame }, {}, work);
+		}
+		mainThreadTasks.push_back(recorder.addTask({}, { frame, input }, work, weEngineTaskGraph::TaskAffinity::MAIN_THREAD));
+
+		for (uint32_t execution = 0; execution < 5; execution++)
+		{
+			recorder.execute(jobSystem);
+			recorder.checkHazardOrder();
+			for (weEngineTaskGraph::TaskId task : mainThreadTasks)
+			{
+				WE_CHECK(recorder.getThread(task) == mainThread);
+			}
+			WE_CHECK_EQUAL(taskGraph.getStatistics().mainThreadTaskCount, static_cast<uint32_t>(mainThreadTasks.size()));
+		}
+	}
+}
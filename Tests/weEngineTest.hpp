@@ -0,0 +1,145 @@
+#pragma once
+
+/*
+* Small harness of the engine tests. Every test file registers its cases with WE_TEST, WE_GPU_TEST and WE_BENCHMARK,
+* the test executable runs the tests by default, the GPU tests with --gpu and the benchmarks with --benchmark.
+* A failed check throws, so a case stops at its first failure and the next case still runs. A case missing something it needs,
+* like a GPU test on a machine without a Vulkan device, throws from skipTest and is reported as skipped.
+*/
+
+//std
+#include "algorithm"
+#include "chrono"
+#include "cstdint"
+#include "sstream"
+#include "stdexcept"
+#include "string"
+#include "vector"
+
+namespace weEngine
+{
+	enum class weEngineTestKind
+	{
+		TEST, //Runs without a window or a GPU
+		GPU_TEST, //Opens a window and creates a device
+		BENCHMARK,
+	};
+
+	struct weEngineTestCase
+	{
+		const char* name;
+		weEngineTestKind kind;
+		void (*function)();
+	};
+
+	//Every case of the executable, in the order the files registered them
+	std::vector<weEngineTestCase>& getTestCases();
+
+	struct weEngineTestRegistration
+	{
+		weEngineTestRegistration(const char* name, weEngineTestKind kind, void (*function)())
+		{
+			getTestCases().push_back({ name, kind, function });
+		}
+	};
+
+	class weEngineTestFailure : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	class weEngineTestSkipped : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	inline void skipTest(const std::string& reason)
+	{
+		throw weEngineTestSkipped(reason);
+	}
+
+	inline void failTest(const char* file, int line, const std::string& message)
+	{
+		std::ostringstream stream;
+		stream << file << "(" << line << "): " << message;
+		throw weEngineTestFailure(stream.str());
+	}
+
+	/*
+	* Runs the function repetitionCount times and returns the fastest run in milliseconds, the slower runs are the ones
+	* disturbed by the rest of the system.
+	*/
+	template<typename Function>
+	float measureMilliseconds(uint32_t repetitionCount, Function&& function)
+	{
+		float bestMilliseconds = 0.0f;
+		for (uint32_t repetition = 0; repetition < repetitionCount; repetition++)
+		{
+			const auto startTime = std::chrono::high_resolution_clock::now();
+			function();
+			const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			bestMilliseconds = repetition == 0 ? milliseconds : std::min(bestMilliseconds, milliseconds);
+		}
+		return bestMilliseconds;
+	}
+}
+
+#define WE_TEST_CASE(name, kind) \
+	static void name(); \
+	static const weEngine::weEngineTestRegistration name##Registration{ #name, kind, &name }; \
+	static void name()
+
+#define WE_TEST(name) WE_TEST_CASE(name, weEngine::weEngineTestKind::TEST)
+#define WE_GPU_TEST(name) WE_TEST_CASE(name, weEngine::weEngineTestKind::GPU_TEST)
+#define WE_BENCHMARK(name) WE_TEST_CASE(name, weEngine::weEngineTestKind::BENCHMARK)
+
+#define WE_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			weEngine::failTest(__FILE__, __LINE__, "Check failed: " #condition); \
+		} \
+	} while (false)
+
+//Compares with operator== and prints both values when they differ
+#define WE_CHECK_EQUAL(actual, expected) \
+	do \
+	{ \
+		const auto& actualValue = (actual); \
+		const auto& expectedValue = (expected); \
+		if (!(actualValue == expectedValue)) \
+		{ \
+			std::ostringstream checkStream; \
+			checkStream << "Check failed: " #actual " == " #expected " (" << actualValue << " != " << expectedValue << ")"; \
+			weEngine::failTest(__FILE__, __LINE__, checkStream.str()); \
+		} \
+	} while (false)
+
+#define WE_CHECK_THROWS(statement) \
+	do \
+	{ \
+		bool threw = false; \
+		try \
+		{ \
+			statement; \
+		} \
+		catch (const weEngine::weEngineTestFailure&) \
+		{ \
+			throw; \
+		} \
+		catch (const weEngine::weEngineTestSkipped&) \
+		{ \
+			throw; \
+		} \
+		catch (...) \
+		{ \
+			threw = true; \
+		} \
+		if (!threw) \
+		{ \
+			weEngine::failTest(__FILE__, __LINE__, "Expected an exception from: " #statement); \
+		} \
+	} while (false)
@@ -0,0 +1,85 @@
+#include "weEngineTest.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "cstdlib"
+#include "cstring"
+#include "exception"
+#include "iostream"
+
+/*
+* Entry point of the test executable.
+*
+* usage: VulkanGameEngineTests [--gpu] [--benchmark] [filter]
+* --gpu also runs the tests that open a window and create a device, --benchmark runs the benchmarks instead of the tests.
+* Only the cases whose name contains the filter run.
+*/
+
+namespace weEngine
+{
+	std::vector<weEngineTestCase>& getTestCases()
+	{
+		static std::vector<weEngineTestCase> testCases;
+		return testCases;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool runGpuTests = false;
+	bool runBenchmarks = false;
+	const char* filter = "";
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--gpu") == 0)
+		{
+			runGpuTests = true;
+		}
+		else if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			runBenchmarks = true;
+		}
+		else
+		{
+			filter = argv[i];
+		}
+	}
+
+	//The main thread of the shared job system is the first thread using it, the cases may create job systems of their own afterwards
+	weEngine::weEngineJobSystem::shared();
+
+	uint32_t passedCount = 0;
+	uint32_t failedCount = 0;
+	uint32_t skippedCount = 0;
+	for (const weEngine::weEngineTestCase& testCase : weEngine::getTestCases())
+	{
+		const bool isSelected = runBenchmarks
+			? testCase.kind == weEngine::weEngineTestKind::BENCHMARK
+			: testCase.kind == weEngine::weEngineTestKind::TEST || (runGpuTests && testCase.kind == weEngine::weEngineTestKind::GPU_TEST);
+		if (!isSelected || std::strstr(testCase.name, filter) == nullptr)
+		{
+			continue;
+		}
+
+		std::cout << "[ RUN  ] " << testCase.name << std::endl;
+		try
+		{
+			testCase.function();
+			std::cout << "[ PASS ] " << testCase.name << std::endl;
+			passedCount++;
+		}
+		catch (const weEngine::weEngineTestSkipped& e)
+		{
+			std::cout << "[ SKIP ] " << testCase.name << ": " << e.what() << std::endl;
+			skippedCount++;
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "[ FAIL ] " << testCase.name << ": " << e.what() << std::endl;
+			failedCount++;
+		}
+	}
+
+	std::cout << passedCount << " passed, " << failedCount << " failed, " << skippedCount << " skipped" << std::endl;
+	return failedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
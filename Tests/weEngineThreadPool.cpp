@@ -0,0 +1,111 @@
+#include "weEngineThreadPool.hpp"
+
+//std
+#include "algorithm"
+
+namespace weEngine
+{
+	//Set on the worker threads so nested parallelFor calls run inline instead of waiting on themselves
+	static thread_local bool isPoolWorker = false;
+
+	weEngineThreadPool::weEngineThreadPool(uint32_t workerCount)
+	{
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	weEngineThreadPool::~weEngineThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	weEngineThreadPool& weEngineThreadPool::shared()
+	{
+		static weEngineThreadPool pool{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+		return pool;
+	}
+
+	/*
+	* Runs task(i) for every i in [0, taskCount) on the workers and the calling thread. Returns once every task has finished.
+	*/
+	void weEngineThreadPool::parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task)
+	{
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		if (taskCount == 1 || workers.empty() || isPoolWorker)
+		{
+			for (uint32_t i = 0; i < taskCount; i++)
+			{
+				task(i);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> submitLock(submitMutex);
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			currentTask = &task;
+			currentTaskCount = taskCount;
+			nextTask.store(0, std::memory_order_relaxed);
+			activeWorkers = static_cast<uint32_t>(workers.size());
+			generation++;
+		}
+		workAvailable.notify_all();
+
+		runTasks();
+
+		std::unique_lock<std::mutex> lock(stateMutex);
+		workFinished.wait(lock, [this]() { return activeWorkers == 0; });
+		currentTask = nullptr;
+	}
+
+	void weEngineThreadPool::workerLoop()
+	{
+		isPoolWorker = true;
+		uint64_t seenGeneration = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(stateMutex);
+				workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+				if (stopping)
+				{
+					return;
+				}
+				seenGeneration = generation;
+			}
+
+			runTasks();
+
+			{
+				std::lock_guard<std::mutex> lock(stateMutex);
+				activeWorkers--;
+			}
+			workFinished.notify_one();
+		}
+	}
+
+	void weEngineThreadPool::runTasks()
+	{
+		for (uint32_t i = nextTask.fetch_add(1); i < currentTaskCount; i = nextTask.fetch_add(1))
+		{
+			(*currentTask)(i);
+		}
+	}
+}
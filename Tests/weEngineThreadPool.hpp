@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+* weEngineThreadPool keeps a set of worker threads alive so CPU heavy work (like model loading) can be split across the cores
+* without creating new threads every time.
+*
+* The engine now schedules its work with weEngineJobSystem, the pool is only kept by the tests as the baseline of its benchmarks.
+*/
+
+//std
+#include "atomic"
+#include "condition_variable"
+#include "cstdint"
+#include "functional"
+#include "mutex"
+#include "thread"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineThreadPool
+	{
+	public:
+		explicit weEngineThreadPool(uint32_t workerCount);
+		~weEngineThreadPool();
+
+		weEngineThreadPool(const weEngineThreadPool&) = delete;
+		weEngineThreadPool& operator=(const weEngineThreadPool&) = delete;
+
+		//Pool shared by the engine, with one worker per core besides the calling thread
+		static weEngineThreadPool& shared();
+
+		//Number of threads taking part in parallelFor, including the calling thread
+		uint32_t getThreadCount() const
+		{
+			return static_cast<uint32_t>(workers.size()) + 1;
+		}
+
+		void parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task);
+
+	private:
+		void workerLoop();
+		void runTasks();
+
+		std::vector<std::thread> workers;
+
+		std::mutex submitMutex;
+		std::mutex stateMutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workFinished;
+
+		const std::function<void(uint32_t)>* currentTask = nullptr;
+		uint32_t currentTaskCount = 0;
+		uint64_t generation = 0;
+		uint32_t activeWorkers = 0;
+		bool stopping = false;
+
+		std::atomic<uint32_t> nextTask{ 0 };
+	};
+}
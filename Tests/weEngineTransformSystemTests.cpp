@@ -0,0 +1,168 @@
+#include "weEngineTest.hpp"
+#include "weEngineTransformSystem.hpp"
+
+//std
+#include "cmath"
+#include "iostream"
+#include "random"
+
+/*
+* Checks the matrices of the transform system against TransformComponent::mat4, which the kernel replaces, and measures both.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//The kernel is about one unit in the last place off, the tolerance is relative to the scale of the column
+		constexpr float MATRIX_TOLERANCE = 1e-5f;
+
+		TransformComponent getRandomTransform(std::mt19937& random, float maxAngle)
+		{
+			std::uniform_real_distribution<float> angleDistribution{ -maxAngle, maxAngle };
+			std::uniform_real_distribution<float> scaleDistribution{ 0.1f, 10.0f };
+			std::uniform_real_distribution<float> translationDistribution{ -100.0f, 100.0f };
+
+			TransformComponent transform{};
+			transform.translation = { translationDistribution(random), translationDistribution(random), translationDistribution(random) };
+			transform.rotation = { angleDistribution(random), angleDistribution(random), angleDistribution(random) };
+			transform.scale = { scaleDistribution(random), scaleDistribution(random), scaleDistribution(random) };
+			return transform;
+		}
+
+		//Updates the system holding the transforms and compares every element of every matrix with mat4
+		void checkMatrices(const std::vector<TransformComponent>& transforms)
+		{
+			weEngineTransformSystem transformSystem;
+			for (const TransformComponent& transform : transforms)
+			{
+				transformSystem.add(transform);
+			}
+			transformSystem.updateMatrices();
+
+			for (uint32_t index = 0; index < transforms.size(); index++)
+			{
+				TransformComponent transform = transforms[index];
+				const glm::mat4 expected = transform.mat4();
+				const glm::mat4& actual = transformSystem.getMatrix(index);
+				for (int column = 0; column < 4; column++)
+				{
+					const float scale = column < 3 ? std::abs(transform.scale[column]) : 1.0f;
+					for (int row = 0; row < 4; row++)
+					{
+						if (!(std::abs(actual[column][row] - expected[column][row]) <= MATRIX_TOLERANCE * scale))
+						{
+							std::ostringstream message;
+							message << "Matrix " << index << " with the angles (" << transform.rotation.x << ", " << transform.rotation.y << ", " << transform.rotation.z
+								<< ") differs at column " << column << " row " << row << ": " << actual[column][row] << " != " << expected[column][row];
+							failTest(__FILE__, __LINE__, message.str());
+						}
+					}
+				}
+			}
+		}
+	}
+
+	WE_TEST(transformSystemMatchesMat4)
+	{
+		//A count which is not a multiple of the batch size, so the last group is partly padding
+		std::mt19937 random{ 3 };
+		std::vector<TransformComponent> transforms;
+		for (uint32_t i = 0; i < 4099; i++)
+		{
+			transforms.push_back(getRandomTransform(random, glm::two_pi<float>() * 4.0f));
+		}
+		checkMatrices(transforms);
+	}
+
+	WE_TEST(transformSystemMatchesMat4AtSpecialAngles)
+	{
+		const float angles[] = {
+			0.0f, -0.0f, glm::half_pi<float>(), glm::pi<float>(), -glm::pi<float>(), glm::two_pi<float>(),
+			100.0f, -1000.0f, 8191.0f, 8192.0f, 8193.0f, -8193.0f,
+		};
+
+		std::vector<TransformComponent> transforms;
+		for (float angle : angles)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				TransformComponent transform{};
+				transform.rotation[axis] = angle;
+				transform.scale = { 1.0f, 2.0f, 3.0f };
+				transforms.push_back(transform);
+			}
+		}
+		checkMatrices(transforms);
+	}
+
+	WE_TEST(transformSystemMatchesMat4AtLargeAngles)
+	{
+		//The octant of the kernel overflows 32 bits past 1.7e9, the groups holding such angles have to be built another way
+		const float largeAngles[] = { 1e4f, -1e4f, 1e6f, 1e9f, -1e9f, 3e9f, -3e9f, 1e30f };
+
+		std::mt19937 random{ 5 };
+		std::vector<TransformComponent> transforms;
+		for (float angle : largeAngles)
+		{
+			//The large angle shares its group with ordinary ones, on every axis
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (uint32_t lane = 0; lane < weEngineTransformSystem::BATCH_SIZE; lane++)
+				{
+					TransformComponent transform = getRandomTransform(random, glm::pi<float>());
+					if (lane == axis % weEngineTransformSystem::BATCH_SIZE)
+					{
+						transform.rotation[axis] = angle;
+					}
+					transforms.push_back(transform);
+				}
+			}
+		}
+		checkMatrices(transforms);
+	}
+
+	WE_BENCHMARK(transformSystemUpdate)
+	{
+		std::cout << "Transform system kernel: " << weEngineTransformSystem::getKernelName() << std::endl;
+
+		for (uint32_t transformCount : { 10000u, 100000u, 1000000u })
+		{
+			std::mt19937 random{ 11 };
+			std::vector<TransformComponent> transforms;
+			transforms.reserve(transformCount);
+			weEngineTransformSystem transformSystem;
+			for (uint32_t i = 0; i < transformCount; i++)
+			{
+				transforms.push_back(getRandomTransform(random, glm::two_pi<float>()));
+				transformSystem.add(transforms.back());
+			}
+
+			//Every matrix is rebuilt by each update, the update times itself without the marking
+			float systemMilliseconds = 0.0f;
+			for (uint32_t repetition = 0; repetition < 5; repetition++)
+			{
+				for (uint32_t index = 0; index < transformCount; index++)
+				{
+					transformSystem.markDirty(index);
+				}
+				transformSystem.updateMatrices();
+				const float milliseconds = transformSystem.getStatistics().updateMilliseconds;
+				systemMilliseconds = repetition == 0 ? milliseconds : std::min(systemMilliseconds, milliseconds);
+			}
+
+			std::vector<glm::mat4> matrices(transformCount);
+			const float mat4Milliseconds = measureMilliseconds(5, [&]()
+				{
+					for (uint32_t index = 0; index < transformCount; index++)
+					{
+						matrices[index] = transforms[index].mat4();
+					}
+				});
+
+			std::cout << transformCount << " transforms: transform system " << systemMilliseconds << " ms ("
+				<< transformSystem.getStatistics().updateTaskCount << " tasks), TransformComponent::mat4 " << mat4Milliseconds << " ms ("
+				<< mat4Milliseconds / systemMilliseconds << "x)" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,216 @@
+#include "weEngineGpuTest.hpp"
+#include "weEngineDevice.hpp"
+#include "weEngineModel.hpp"
+#include "weEngineUploadManager.hpp"
+
+//std
+#include "atomic"
+#include "exception"
+#include "memory"
+#include "thread"
+
+/*
+* Checks the upload manager when models are created and destroyed on the main thread and on a loading thread at the same time,
+* with a third thread flushing like the render thread does before every frame.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Flat quad grid of gridSize x gridSize quads, large enough for the bigger ones to fill several upload batches together
+		weEngineModel::Builder createGridBuilder(uint32_t gridSize)
+		{
+			weEngineModel::Builder builder{};
+			for (uint32_t y = 0; y <= gridSize; y++)
+			{
+				for (uint32_t x = 0; x <= gridSize; x++)
+				{
+					weEngineModel::Vertex vertex{};
+					vertex.position = { static_cast<float>(x), 0.0f, static_cast<float>(y) };
+					vertex.color = { 1.0f, 1.0f, 1.0f };
+					vertex.normal = { 0.0f, 1.0f, 0.0f };
+					builder.vertices.push_back(vertex);
+				}
+			}
+
+			for (uint32_t y = 0; y < gridSize; y++)
+			{
+				for (uint32_t x = 0; x < gridSize; x++)
+				{
+					const uint32_t corner = y * (gridSize + 1) + x;
+					builder.indices.insert(builder.indices.end(), { corner, corner + 1, corner + gridSize + 2, corner, corner + gridSize + 2, corner + gridSize + 1 });
+				}
+			}
+			return builder;
+		}
+
+		/*
+		* Creates modelCount models of varying sizes, keeping the last few alive so the destructors of the older ones wait on tickets
+		* while the other thread keeps recording copies into the same batches
+		*/
+		void loadAndDestroyModels(weEngineDevice& device, uint32_t modelCount, uint32_t firstGridSize)
+		{
+			std::vector<std::unique_ptr<weEngineModel>> models;
+			for (uint32_t i = 0; i < modelCount; i++)
+			{
+				const weEngineModel::Builder builder = createGridBuilder(firstGridSize + (i * 7) % 64);
+				models.push_back(std::make_unique<weEngineModel>(device, builder));
+				if (models.size() > 4)
+				{
+					models.erase(models.begin());
+				}
+			}
+		}
+	}
+
+	WE_GPU_TEST(uploadManagerLoadsModelsFromTwoThreads)
+	{
+		skipWithoutVulkanDevice();
+
+		constexpr uint32_t modelCount = 200;
+
+		weEngineWindow window{ 320, 240, "weEngine upload test" };
+		weEngineDevice device{ window };
+		weEngineUploadManager& uploadManager = device.getUploadManager();
+
+		const uint64_t uploadCountBefore = uploadManager.getStatistics().uploadCount;
+		const uint32_t allocationCountBefore = device.getMemoryAllocator().getStatistics().allocationCount;
+
+		std::atomic<bool> isLoading{ true };
+		std::thread flushThread{ [&]()
+			{
+				while (isLoading.load())
+				{
+					uploadManager.flush();
+					std::this_thread::yield();
+				}
+			} };
+
+		std::exception_ptr loaderException;
+		std::thread loaderThread{ [&]()
+			{
+				try
+				{
+					loadAndDestroyModels(device, modelCount, 8);
+				}
+				catch (...)
+				{
+					loaderException = std::current_exception();
+				}
+			} };
+
+		std::exception_ptr mainException;
+		try
+		{
+			loadAndDestroyModels(device, modelCount, 16);
+		}
+		catch (...)
+		{
+			mainException = std::current_exception();
+		}
+
+		loaderThread.join();
+		isLoading = false;
+		flushThread.join();
+
+		if (mainException)
+		{
+			std::rethrow_exception(mainException);
+		}
+		if (loaderException)
+		{
+			std::rethrow_exception(loaderException);
+		}
+
+		//Both the vertices and the indices of every model went through the manager, and every buffer was freed again
+		uploadManager.waitIdle();
+		WE_CHECK_EQUAL(uploadManager.getStatistics().uploadCount - uploadCountBefore, uint64_t{ 2 * 2 * modelCount });
+		WE_CHECK_EQUAL(device.getMemoryAllocator().getStatistics().allocationCount, allocationCountBefore);
+	}
+
+	WE_GPU_TEST(uploadManagerTicketsCompleteAcrossThreads)
+	{
+		skipWithoutVulkanDevice();
+
+		constexpr uint32_t uploadCount = 2000;
+		constexpr VkDeviceSize uploadSize = 64 * 1024;
+
+		weEngineWindow window{ 320, 240, "weEngine upload test" };
+		weEngineDevice device{ window };
+		weEngineUploadManager& uploadManager = device.getUploadManager();
+
+		VkBuffer buffers[2];
+		weEngineAllocation allocations[2];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			device.createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers[i], allocations[i], weEngineMemoryUsage::LONG_LIVED, "upload test buffer");
+		}
+
+		//Every thread waits on each of its tickets, alternately right away and after polling, while the other thread records more copies
+		const std::vector<uint8_t> data(uploadSize, 0x5a);
+		auto uploadFromThread = [&](uint32_t thread, std::atomic<uint32_t>& completedCount)
+		{
+			for (uint32_t i = 0; i < uploadCount; i++)
+			{
+				const weEngineUploadTicket ticket = uploadManager.upload(buffers[thread], 0, data.data(), uploadSize);
+				if (i % 2 == 0)
+				{
+					uploadManager.wait(ticket);
+				}
+				else
+				{
+					uploadManager.flush();
+					while (!uploadManager.isComplete(ticket))
+					{
+						std::this_thread::yield();
+					}
+				}
+				completedCount++;
+			}
+		};
+
+		std::atomic<uint32_t> completedCounts[2]{};
+		std::exception_ptr otherException;
+		std::thread otherThread{ [&]()
+			{
+				try
+				{
+					uploadFromThread(1, completedCounts[1]);
+				}
+				catch (...)
+				{
+					otherException = std::current_exception();
+				}
+			} };
+
+		std::exception_ptr mainException;
+		try
+		{
+			uploadFromThread(0, completedCounts[0]);
+		}
+		catch (...)
+		{
+			mainException = std::current_exception();
+		}
+
+		otherThread.join();
+		if (mainException)
+		{
+			std::rethrow_exception(mainException);
+		}
+		if (otherException)
+		{
+			std::rethrow_exception(otherException);
+		}
+
+		WE_CHECK_EQUAL(completedCounts[0].load(), uploadCount);
+		WE_CHECK_EQUAL(completedCounts[1].load(), uploadCount);
+
+		uploadManager.waitIdle();
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			device.destroyBuffer(buffers[i], allocations[i]);
+		}
+	}
+}
@@ -0,0 +1,222 @@
+#include "weEngineTest.hpp"
+#include "weEngineVertexHashMap.hpp"
+#include "weEngineUtils.hpp"
+
+//std
+#include "fstream"
+#include "iostream"
+#include "random"
+#include "unordered_map"
+
+//glm
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/gtx/hash.hpp"
+
+//TinyObjLoader, implemented by weEngineModel.cpp
+#include "tinyobjloader/tiny_obj_loader.h"
+
+/*
+* Checks the vertex welding of the model loader against std::unordered_map, which it replaced, and measures both
+* on the backpack model and on a synthetic mesh of 10M indices.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		//Hash the loader used with std::unordered_map before the flat table
+		struct ChainedVertexHash
+		{
+			size_t operator()(const weEngineModel::Vertex& vertex) const
+			{
+				size_t seed = 0;
+				hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+				return seed;
+			}
+		};
+
+		using VertexStream = std::vector<weEngineModel::Vertex>;
+
+		struct WeldedMesh
+		{
+			std::vector<weEngineModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		template<typename GetVertex>
+		WeldedMesh weldWithHashMap(size_t indexCount, GetVertex&& getVertex)
+		{
+			WeldedMesh mesh;
+			mesh.indices.reserve(indexCount);
+			weEngineVertexHashMap uniqueVertices{ indexCount };
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				mesh.indices.push_back(uniqueVertices.findOrInsert(getVertex(i), mesh.vertices));
+			}
+			return mesh;
+		}
+
+		template<typename GetVertex>
+		WeldedMesh weldWithUnorderedMap(size_t indexCount, GetVertex&& getVertex)
+		{
+			WeldedMesh mesh;
+			mesh.indices.reserve(indexCount);
+			std::unordered_map<weEngineModel::Vertex, uint32_t, ChainedVertexHash> uniqueVertices;
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				const weEngineModel::Vertex vertex = getVertex(i);
+				auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(mesh.vertices.size()));
+				if (inserted.second)
+				{
+					mesh.vertices.push_back(vertex);
+				}
+				mesh.indices.push_back(inserted.first->second);
+			}
+			return mesh;
+		}
+
+		bool isSameMesh(const WeldedMesh& a, const WeldedMesh& b)
+		{
+			return a.indices == b.indices && a.vertices.size() == b.vertices.size() && std::equal(a.vertices.begin(), a.vertices.end(), b.vertices.begin());
+		}
+
+		/*
+		* Vertex of the corner of a grid of gridSize x gridSize quads, every quad is two triangles listed with their own corners
+		* like the faces of an OBJ file, so every inner corner appears six times.
+		*/
+		weEngineModel::Vertex getGridVertex(uint32_t gridSize, size_t index)
+		{
+			static constexpr uint32_t QUAD_CORNERS[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+			const size_t quad = index / 6;
+			const uint32_t x = static_cast<uint32_t>(quad % gridSize) + QUAD_CORNERS[index % 6][0];
+			const uint32_t y = static_cast<uint32_t>(quad / gridSize) + QUAD_CORNERS[index % 6][1];
+
+			weEngineModel::Vertex vertex{};
+			vertex.position = { static_cast<float>(x), 0.0f, static_cast<float>(y) };
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+			vertex.normal = { 0.0f, 1.0f, 0.0f };
+			vertex.uv = { static_cast<float>(x) / gridSize, static_cast<float>(y) / gridSize };
+			return vertex;
+		}
+
+		//Face vertices of every shape of the OBJ file in order, like the loader reads them before welding. Empty when the file is missing.
+		VertexStream readObjVertexStream(const std::string& filepath)
+		{
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string err, warn;
+
+			VertexStream stream;
+			if (!std::ifstream{ filepath } || !tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+			{
+				return stream;
+			}
+
+			for (const tinyobj::shape_t& shape : shapes)
+			{
+				for (const tinyobj::index_t& index : shape.mesh.indices)
+				{
+					weEngineModel::Vertex vertex{};
+					vertex.color = { 1.0f, 1.0f, 1.0f };
+					if (index.vertex_index >= 0)
+					{
+						vertex.position = { attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2] };
+					}
+					if (index.normal_index >= 0)
+					{
+						vertex.normal = { attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2] };
+					}
+					if (index.texcoord_index >= 0)
+					{
+						vertex.uv = { attrib.texcoords[2 * index.texcoord_index + 0], attrib.texcoords[2 * index.texcoord_index + 1] };
+					}
+					stream.push_back(vertex);
+				}
+			}
+			return stream;
+		}
+
+		template<typename GetVertex>
+		void benchmarkWelding(const char* name, size_t indexCount, GetVertex&& getVertex)
+		{
+			WeldedMesh hashMapMesh;
+			WeldedMesh unorderedMapMesh;
+			const float hashMapMilliseconds = measureMilliseconds(3, [&]() { hashMapMesh = weldWithHashMap(indexCount, getVertex); });
+			const float unorderedMapMilliseconds = measureMilliseconds(3, [&]() { unorderedMapMesh = weldWithUnorderedMap(indexCount, getVertex); });
+			WE_CHECK(isSameMesh(hashMapMesh, unorderedMapMesh));
+
+			std::cout << name << ": " << indexCount << " indices welded into " << hashMapMesh.vertices.size() << " vertices, flat table "
+				<< hashMapMilliseconds << " ms, std::unordered_map " << unorderedMapMilliseconds << " ms ("
+				<< unorderedMapMilliseconds / hashMapMilliseconds << "x)" << std::endl;
+		}
+	}
+
+	WE_TEST(vertexHashMapMatchesUnorderedMap)
+	{
+		//Few distinct values so the vertices repeat, and the table grows past the size it was created with
+		std::mt19937 random{ 7 };
+		std::uniform_int_distribution<int> distribution{ 0, 3 };
+		auto randomValue = [&]() { return static_cast<float>(distribution(random)); };
+
+		VertexStream stream(20000);
+		for (weEngineModel::Vertex& vertex : stream)
+		{
+			vertex.position = { randomValue(), randomValue(), randomValue() };
+			vertex.normal = { randomValue(), 0.0f, 0.0f };
+			vertex.uv = { randomValue() * 0.5f, 0.0f };
+		}
+
+		WeldedMesh hashMapMesh;
+		hashMapMesh.indices.reserve(stream.size());
+		weEngineVertexHashMap uniqueVertices{ 4 };
+		for (const weEngineModel::Vertex& vertex : stream)
+		{
+			hashMapMesh.indices.push_back(uniqueVertices.findOrInsert(vertex, hashMapMesh.vertices));
+		}
+
+		const WeldedMesh unorderedMapMesh = weldWithUnorderedMap(stream.size(), [&](size_t i) { return stream[i]; });
+		WE_CHECK(isSameMesh(hashMapMesh, unorderedMapMesh));
+	}
+
+	WE_TEST(vertexHashMapWeldsNegativeZero)
+	{
+		weEngineModel::Vertex positiveZero{};
+		weEngineModel::Vertex negativeZero{};
+		negativeZero.position.x = -0.0f;
+		negativeZero.uv.y = -0.0f;
+
+		WE_CHECK_EQUAL(weEngineVertexHashMap::hashVertex(positiveZero), weEngineVertexHashMap::hashVertex(negativeZero));
+
+		std::vector<weEngineModel::Vertex> vertices;
+		weEngineVertexHashMap uniqueVertices{ 2 };
+		WE_CHECK_EQUAL(uniqueVertices.findOrInsert(positiveZero, vertices), 0u);
+		WE_CHECK_EQUAL(uniqueVertices.findOrInsert(negativeZero, vertices), 0u);
+		WE_CHECK_EQUAL(vertices.size(), size_t{ 1 });
+	}
+
+	WE_BENCHMARK(vertexWeldingBackpack)
+	{
+		//The executable runs from the solution directory or from the Tests directory
+		VertexStream stream = readObjVertexStream("models/backpack/backpack.obj");
+		if (stream.empty())
+		{
+			stream = readObjVertexStream("../models/backpack/backpack.obj");
+		}
+		if (stream.empty())
+		{
+			std::cout << "models/backpack/backpack.obj not found, skipped" << std::endl;
+			return;
+		}
+
+		benchmarkWelding("Backpack", stream.size(), [&](size_t i) { return stream[i]; });
+	}
+
+	WE_BENCHMARK(vertexWeldingSyntheticGrid)
+	{
+		//1291 x 1291 quads give 10M indices for 1.67M vertices, the vertices are built on the fly to keep the stream out of memory
+		constexpr uint32_t gridSize = 1291;
+		benchmarkWelding("Synthetic grid", size_t{ gridSize } * gridSize * 6, [](size_t i) { return getGridVertex(gridSize, i); });
+	}
+}
@@ -0,0 +1,199 @@
+#include "weEngineTest.hpp"
+#include "weEngineJobSystem.hpp"
+#include "weEngineWorld.hpp"
+
+//std
+#include "algorithm"
+#include "string"
+#include "utility"
+#include "vector"
+
+/*
+* Checks the generational handles of the world, the moves of entities between archetypes and the registration of component types.
+*/
+
+namespace weEngine
+{
+	namespace
+	{
+		constexpr uint32_t TEST_WORKER_COUNT = 3;
+
+		struct PositionComponent
+		{
+			float x = 0.0f;
+			float y = 0.0f;
+		};
+
+		struct HealthComponent
+		{
+			int value = 0;
+		};
+
+		//Owns memory, so a row moved without its move constructor would leave a string pointing at the old chunk
+		struct NameComponent
+		{
+			std::string name;
+		};
+
+		//A distinct type for every index, registered by the tasks of the registration test
+		template<uint32_t N>
+		struct RegisteredComponent
+		{
+			uint32_t value = N;
+		};
+
+		template<uint32_t... Ns>
+		std::vector<uint32_t (*)()> getRegistrations(std::integer_sequence<uint32_t, Ns...>)
+		{
+			return { &weEngineWorld::getComponentId<RegisteredComponent<Ns>>... };
+		}
+
+		std::string getName(uint32_t index)
+		{
+			return "entity with a name too long for the small string buffer " + std::to_string(index);
+		}
+
+		//Every live entity still has the values it was created with, whatever archetype it was moved to
+		void checkValues(weEngineWorld& world, const std::vector<weEngineEntity>& entities)
+		{
+			for (uint32_t i = 0; i < entities.size(); i++)
+			{
+				const PositionComponent* position = world.getComponent<PositionComponent>(entities[i]);
+				const NameComponent* name = world.getComponent<NameComponent>(entities[i]);
+				WE_CHECK(position != nullptr && position->x == static_cast<float>(i) && position->y == -static_cast<float>(i));
+				WE_CHECK(name != nullptr && name->name == getName(i));
+
+				const HealthComponent* health = world.getComponent<HealthComponent>(entities[i]);
+				WE_CHECK_EQUAL(health != nullptr, i % 3 == 0);
+				if (health != nullptr)
+				{
+					WE_CHECK_EQUAL(health->value, static_cast<int>(i) * 10);
+				}
+			}
+		}
+	}
+
+	WE_TEST(worldDestroyedHandlesStopResolving)
+	{
+		weEngineWorld world;
+		const weEngineEntity first = world.createEntity(PositionComponent{ 1.0f, 2.0f });
+		const weEngineEntity second = world.createEntity(PositionComponent{ 3.0f, 4.0f });
+		WE_CHECK(world.isAlive(first) && world.isAlive(second));
+
+		world.destroyEntity(first);
+		WE_CHECK(!world.isAlive(first));
+		WE_CHECK(world.getComponent<PositionComponent>(first) == nullptr);
+		WE_CHECK(!world.hasComponent<PositionComponent>(first));
+		WE_CHECK(world.getEntity(first.index).isNull());
+		WE_CHECK_EQUAL(world.count<PositionComponent>(), 1u);
+
+		//The other entity was moved into the freed row and still resolves to its own values
+		WE_CHECK(world.isAlive(second));
+		WE_CHECK(world.getEntity(second.index) == second);
+		WE_CHECK_EQUAL(world.getComponent<PositionComponent>(second)->x, 3.0f);
+		WE_CHECK_EQUAL(world.getStatistics().entityCount, 1u);
+	}
+
+	WE_TEST(worldReusedIndicesGetANewGeneration)
+	{
+		weEngineWorld world;
+		const weEngineEntity first = world.createEntity(HealthComponent{ 1 });
+		world.destroyEntity(first);
+
+		const weEngineEntity reused = world.createEntity(HealthComponent{ 2 });
+		WE_CHECK_EQUAL(reused.index, first.index);
+		WE_CHECK(reused.generation != first.generation);
+		WE_CHECK(reused != first);
+
+		//The stale handle does not resolve to the new entity living at its index
+		WE_CHECK(!world.isAlive(first));
+		WE_CHECK(world.getComponent<HealthComponent>(first) == nullptr);
+		WE_CHECK(world.isAlive(reused));
+		WE_CHECK(world.getEntity(first.index) == reused);
+		WE_CHECK_EQUAL(world.getComponent<HealthComponent>(reused)->value, 2);
+
+		//Every reuse of the index gets a generation different from all the earlier ones
+		std::vector<uint32_t> generations{ first.generation, reused.generation };
+		weEngineEntity entity = reused;
+		for (uint32_t i = 0; i < 10; i++)
+		{
+			world.destroyEntity(entity);
+			entity = world.createEntity(HealthComponent{ 3 });
+			WE_CHECK_EQUAL(entity.index, first.index);
+			WE_CHECK(std::find(generations.begin(), generations.end(), entity.generation) == generations.end());
+			generations.push_back(entity.generation);
+		}
+	}
+
+	WE_TEST(worldMovesKeepComponentValues)
+	{
+		//Enough entities for several chunks, so moving one swaps the last row of its chunk into its place
+		const uint32_t entityCount = 2000;
+		weEngineWorld world;
+		std::vector<weEngineEntity> entities;
+		for (uint32_t i = 0; i < entityCount; i++)
+		{
+			entities.push_back(world.createEntity(PositionComponent{ static_cast<float>(i), -static_cast<float>(i) }, NameComponent{ getName(i) }));
+		}
+
+		//Every third entity moves to the archetype with health and back, then to it again
+		for (uint32_t i = 0; i < entityCount; i += 3)
+		{
+			world.addComponent(entities[i], HealthComponent{ -1 });
+		}
+		for (uint32_t i = 0; i < entityCount; i += 3)
+		{
+			world.removeComponent<HealthComponent>(entities[i]);
+		}
+		for (uint32_t i = 0; i < entityCount; i += 3)
+		{
+			world.addComponent(entities[i], HealthComponent{ static_cast<int>(i) * 10 });
+		}
+		WE_CHECK_EQUAL((world.count<PositionComponent, NameComponent>()), entityCount);
+		WE_CHECK_EQUAL(world.count<HealthComponent>(), (entityCount + 2) / 3);
+		WE_CHECK_EQUAL(world.getStatistics().archetypeCount, 2u);
+		checkValues(world, entities);
+
+		//Adding a component the entity has replaces its value without moving it
+		world.addComponent(entities[0], HealthComponent{ 0 });
+		WE_CHECK_EQUAL(world.count<HealthComponent>(), (entityCount + 2) / 3);
+		checkValues(world, entities);
+
+		//The queries see the same values as the handles
+		uint32_t visited = 0;
+		world.forEach<PositionComponent, NameComponent>([&](weEngineEntity entity, PositionComponent& position, NameComponent& name)
+			{
+				const uint32_t i = static_cast<uint32_t>(position.x);
+				WE_CHECK(entities[i] == entity && name.name == getName(i));
+				visited++;
+			});
+		WE_CHECK_EQUAL(visited, entityCount);
+	}
+
+	WE_TEST(worldRegistersComponentTypesFromWorkers)
+	{
+		weEngineJobSystem jobSystem{ TEST_WORKER_COUNT };
+		const std::vector<uint32_t (*)()> registrations = getRegistrations(std::make_integer_sequence<uint32_t, 16>{});
+
+		//Types first used by several tasks at once get distinct ids, and the same id for every caller
+		std::vector<uint32_t> ids(registrations.size() * 4);
+		jobSystem.parallelFor(static_cast<uint32_t>(ids.size()), [&](uint32_t task)
+			{
+				ids[task] = registrations[task % registrations.size()]();
+			});
+
+		std::vector<uint32_t> distinctIds(ids.begin(), ids.begin() + registrations.size());
+		std::sort(distinctIds.begin(), distinctIds.end());
+		WE_CHECK(std::adjacent_find(distinctIds.begin(), distinctIds.end()) == distinctIds.end());
+		for (uint32_t task = 0; task < ids.size(); task++)
+		{
+			WE_CHECK_EQUAL(ids[task], registrations[task % registrations.size()]());
+			WE_CHECK(ids[task] < weEngineWorld::MAX_COMPONENT_TYPES);
+		}
+
+		//The registered types can be used by the world afterwards
+		weEngineWorld world;
+		const weEngineEntity entity = world.createEntity(RegisteredComponent<3>{}, RegisteredComponent<11>{});
+		WE_CHECK_EQUAL(world.getComponent<RegisteredComponent<11>>(entity)->value, 11u);
+	}
+}
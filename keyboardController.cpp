@@ -11,7 +11,7 @@
 
 namespace weEngine
 {
-	void KeyboardMovementController::moveInPlaceXZ(GLFWwindow* window, float dt, weEngineGameObject& gameObj)
+	void KeyboardMovementController::moveInPlaceXZ(GLFWwindow* window, float dt, TransformComponent& transform)
 	{
 		glm::vec3 rotation{ 0.0f };
 
@@ -38,12 +38,12 @@ namespace weEngine
 
 		//Ensuring that the rotation vector is nonzero
 		if (glm::dot(rotation, rotation) > std::numeric_limits<float>::epsilon())
-			gameObj.transformComp.rotation += turnSpeed * dt * glm::normalize(rotation);
+			transform.rotation += turnSpeed * dt * glm::normalize(rotation);
 
-		gameObj.transformComp.rotation.x = glm::clamp(gameObj.transformComp.rotation.x, -1.5f, 1.5f);
-		gameObj.transformComp.rotation.y = glm::mod(gameObj.transformComp.rotation.y, glm::two_pi<float>());
+		transform.rotation.x = glm::clamp(transform.rotation.x, -1.5f, 1.5f);
+		transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
 
-		float yaw = gameObj.transformComp.rotation.y;
+		float yaw = transform.rotation.y;
 		const glm::vec3 forwardDir{sin(yaw), 0.0f, cos(yaw)};
 		const glm::vec3 rightDir{ forwardDir.z, 0.0f, -forwardDir.x};
 		const glm::vec3 upDir{ 0.0f, -1.0f, 0.0f };
@@ -65,6 +65,6 @@ namespace weEngine
 
 		//Ensuring that the moveDir vector is nonzero
 		if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon())
-			gameObj.transformComp.translation += turnSpeed * dt * glm::normalize(moveDir);
+			transform.translation += turnSpeed * dt * glm::normalize(moveDir);
 	}
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "weEngineGameObject.hpp"
+#include "weEngineComponents.hpp"
 #include "weEngineWindow.hpp"
 
 namespace weEngine
@@ -24,7 +24,7 @@ namespace weEngine
 		};
 
 
-		void moveInPlaceXZ(GLFWwindow* window, float dt, weEngineGameObject& gameObj);
+		void moveInPlaceXZ(GLFWwindow* window, float dt, TransformComponent& transform);
 
 		KeyMappings keys{};
 		float movementSpeed{ 3.0f };
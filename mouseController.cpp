@@ -11,9 +11,10 @@
 namespace weEngine
 {
 
-	void MouseMovementController::processMouseMovement(GLFWwindow* window, weEngineGameObject& gameObj)
+	glm::vec3 MouseMovementController::readRotation(GLFWwindow* window)
 	{
-		
+		glm::vec3 rotation{ 0.0f };
+
 		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
 		{
 			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -30,22 +31,19 @@ namespace weEngine
 				firstTimeMovingMouse = false;
 			}
 
-			glm::vec3 rotation{ 0.0f };
-			rotation.y = static_cast<float>(mouseX) - lastX;
-			rotation.x = static_cast<float>(mouseY) - lastY;
+			glm::vec3 delta{ 0.0f };
+			delta.y = static_cast<float>(mouseX) - lastX;
+			delta.x = static_cast<float>(mouseY) - lastY;
 
 			lastX = static_cast<float>(mouseX);
 			lastY = static_cast<float>(mouseY);
 
-			rotation.y *= 1.0f;
-			rotation.x *= -1.0f;
+			delta.y *= 1.0f;
+			delta.x *= -1.0f;
 
 			//Ensuring that the rotation vector is nonzero
-			if (glm::dot(rotation, rotation) > std::numeric_limits<float>::epsilon())
-				gameObj.transformComp.rotation += mouseSensitivity * glm::normalize(rotation);
-
-			gameObj.transformComp.rotation.x = glm::clamp(gameObj.transformComp.rotation.x, -1.5f, 1.5f);
-			gameObj.transformComp.rotation.y = glm::mod(gameObj.transformComp.rotation.y, glm::two_pi<float>());
+			if (glm::dot(delta, delta) > std::numeric_limits<float>::epsilon())
+				rotation = mouseSensitivity * glm::normalize(delta);
 
 		}
 
@@ -55,5 +53,13 @@ namespace weEngine
 			firstTimeMovingMouse = true;
 		}
 
+		return rotation;
+	}
+
+	void MouseMovementController::applyRotation(const glm::vec3& rotation, TransformComponent& transform) const
+	{
+		transform.rotation += rotation;
+		transform.rotation.x = glm::clamp(transform.rotation.x, MIN_PITCH, MAX_PITCH);
+		transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
 	}
 }
\ No newline at end of file
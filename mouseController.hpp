@@ -1,6 +1,6 @@
 #pragma once
 
-#include "weEngineGameObject.hpp"
+#include "weEngineComponents.hpp"
 #include "weEngineWindow.hpp"
 
 namespace weEngine
@@ -8,7 +8,11 @@ namespace weEngine
 	class MouseMovementController
 	{
 	public:
-		void processMouseMovement(GLFWwindow* window, weEngineGameObject& gameObj);
+		//Reads the cursor once and returns the rotation it asks for since the last call, zero while the left button is released
+		glm::vec3 readRotation(GLFWwindow* window);
+
+		//Turns the transform by a rotation read before, keeping the pitch in range
+		void applyRotation(const glm::vec3& rotation, TransformComponent& transform) const;
 
 		float mouseSensitivity{ 0.05f };
 
@@ -0,0 +1,13 @@
+#version 450
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragInstanceColor;
+
+layout (location = 0) out vec4 outColor;
+
+
+void main()
+{
+	//The color of the object tints the colors of its model
+	outColor = vec4(fragColor * fragInstanceColor, 1.0);
+}
\ No newline at end of file
@@ -3,17 +3,24 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
 
-layout (location = 0) out vec3 fragColor;
+//Per instance attributes, the transform takes the locations 4 to 7
+layout (location = 4) in mat4 instanceTransform;
+layout (location = 8) in vec4 instanceColor;
 
-layout (push_constant) uniform Push {
-	mat4 transform;
-	vec3 color;
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragInstanceColor;
 
-} push;
+//Camera of the frame, the slot of the frame is selected with the dynamic offset of the set
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+} ubo;
 
 
 void main()
 {
-	gl_Position = push.transform * vec4(position, 1.0);
+	gl_Position = ubo.projectionView * instanceTransform * vec4(position, 1.0);
 	fragColor = color;
+	fragInstanceColor = instanceColor.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,430 @@
+#include "weEngineBlockAllocator.hpp"
+
+//std
+#include "cassert"
+
+#ifdef _MSC_VER
+#include "intrin.h"
+#endif
+
+namespace weEngine
+{
+	namespace
+	{
+		uint32_t findMostSignificantBit(uint64_t value)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+		}
+
+		uint32_t findLeastSignificantBit(uint64_t value)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+		}
+	}
+
+	weEngineTlsfAllocator::weEngineTlsfAllocator(uint64_t size) : weEngineBlockAllocator(size)
+	{
+		for (uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; firstLevel++)
+		{
+			for (uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; secondLevel++)
+			{
+				freeLists[firstLevel][secondLevel] = NONE;
+			}
+		}
+
+		insertFreeRange(createRange(0, size));
+	}
+
+	/*
+	* Takes the first range of the smallest size class guaranteed to fit the size plus the worst case alignment padding.
+	* The padding in front of the aligned offset and the unused tail both go back to the free lists as ranges of their own.
+	*/
+	bool weEngineTlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two.");
+		size = size > 0 ? size : 1;
+
+		const uint32_t range = findFreeRange(size + alignment - 1);
+		if (range == NONE)
+		{
+			return false;
+		}
+		removeFreeRange(range);
+
+		//The neighbours of a free range are never free, so the padding and the tail never have to be merged
+		const uint64_t padding = alignUp(ranges[range].offset, alignment) - ranges[range].offset;
+		if (padding > 0)
+		{
+			const uint32_t front = createRange(ranges[range].offset, padding);
+			ranges[front].previousPhysical = ranges[range].previousPhysical;
+			ranges[front].nextPhysical = range;
+			if (ranges[range].previousPhysical != NONE)
+			{
+				ranges[ranges[range].previousPhysical].nextPhysical = front;
+			}
+			ranges[range].previousPhysical = front;
+			ranges[range].offset += padding;
+			ranges[range].size -= padding;
+			insertFreeRange(front);
+		}
+
+		if (ranges[range].size > size)
+		{
+			const uint32_t tail = createRange(ranges[range].offset + size, ranges[range].size - size);
+			ranges[tail].previousPhysical = range;
+			ranges[tail].nextPhysical = ranges[range].nextPhysical;
+			if (ranges[range].nextPhysical != NONE)
+			{
+				ranges[ranges[range].nextPhysical].previousPhysical = tail;
+			}
+			ranges[range].nextPhysical = tail;
+			ranges[range].size = size;
+			insertFreeRange(tail);
+		}
+
+		ranges[range].free = false;
+		allocationCount++;
+		allocatedBytes += size;
+
+		offset = ranges[range].offset;
+		handle = range;
+		return true;
+	}
+
+	/*
+	* Returns the range to the free lists, merged with the free ranges directly before and after it
+	*/
+	void weEngineTlsfAllocator::free(uint32_t handle)
+	{
+		assert(handle < ranges.size() && !ranges[handle].free && "Freeing a range which is not allocated.");
+
+		uint32_t range = handle;
+		allocationCount--;
+		allocatedBytes -= ranges[range].size;
+		ranges[range].free = true;
+
+		const uint32_t previous = ranges[range].previousPhysical;
+		if (previous != NONE && ranges[previous].free)
+		{
+			removeFreeRange(previous);
+			ranges[previous].size += ranges[range].size;
+			ranges[previous].nextPhysical = ranges[range].nextPhysical;
+			if (ranges[range].nextPhysical != NONE)
+			{
+				ranges[ranges[range].nextPhysical].previousPhysical = previous;
+			}
+			releaseRange(range);
+			range = previous;
+		}
+
+		const uint32_t next = ranges[range].nextPhysical;
+		if (next != NONE && ranges[next].free)
+		{
+			removeFreeRange(next);
+			ranges[range].size += ranges[next].size;
+			ranges[range].nextPhysical = ranges[next].nextPhysical;
+			if (ranges[next].nextPhysical != NONE)
+			{
+				ranges[ranges[next].nextPhysical].previousPhysical = range;
+			}
+			releaseRange(next);
+		}
+
+		insertFreeRange(range);
+	}
+
+	uint64_t weEngineTlsfAllocator::getLargestFreeRange() const
+	{
+		if (firstLevelBitmap == 0)
+		{
+			return 0;
+		}
+
+		const uint32_t firstLevel = findMostSignificantBit(firstLevelBitmap);
+		const uint32_t secondLevel = findMostSignificantBit(secondLevelBitmaps[firstLevel]);
+
+		uint64_t largest = 0;
+		for (uint32_t range = freeLists[firstLevel][secondLevel]; range != NONE; range = ranges[range].nextFree)
+		{
+			largest = ranges[range].size > largest ? ranges[range].size : largest;
+		}
+		return largest;
+	}
+
+	uint32_t weEngineTlsfAllocator::getFreeRangeCount() const
+	{
+		uint32_t count = 0;
+		for (uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; firstLevel++)
+		{
+			for (uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; secondLevel++)
+			{
+				for (uint32_t range = freeLists[firstLevel][secondLevel]; range != NONE; range = ranges[range].nextFree)
+				{
+					count++;
+				}
+			}
+		}
+		return count;
+	}
+
+	bool weEngineTlsfAllocator::validate() const
+	{
+		//Walk the block from the range at offset 0
+		uint32_t first = NONE;
+		for (uint32_t range = 0; range < ranges.size(); range++)
+		{
+			if (ranges[range].size > 0 && ranges[range].offset == 0 && ranges[range].previousPhysical == NONE)
+			{
+				first = range;
+			}
+		}
+
+		uint64_t offset = 0;
+		uint64_t usedBytes = 0;
+		uint32_t usedCount = 0;
+		uint32_t freeCount = 0;
+		bool previousFree = false;
+		for (uint32_t range = first; range != NONE; range = ranges[range].nextPhysical)
+		{
+			const Range& current = ranges[range];
+			if (current.offset != offset || current.size == 0 || (current.free && previousFree))
+			{
+				return false;
+			}
+
+			if (current.nextPhysical != NONE && ranges[current.nextPhysical].previousPhysical != range)
+			{
+				return false;
+			}
+
+			if (current.free)
+			{
+				freeCount++;
+			}
+			else
+			{
+				usedCount++;
+				usedBytes += current.size;
+			}
+
+			offset += current.size;
+			previousFree = current.free;
+		}
+
+		if (offset != size || usedCount != allocationCount || usedBytes != allocatedBytes || freeCount != getFreeRangeCount())
+		{
+			return false;
+		}
+
+		//Every listed range has to be free, in the right size class, and its class has to be marked in the bitmaps
+		for (uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; firstLevel++)
+		{
+			for (uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; secondLevel++)
+			{
+				const bool listed = freeLists[firstLevel][secondLevel] != NONE;
+				const bool marked = (secondLevelBitmaps[firstLevel] & (1u << secondLevel)) != 0;
+				if (listed != marked || (listed && (firstLevelBitmap & (1ull << firstLevel)) == 0))
+				{
+					return false;
+				}
+
+				for (uint32_t range = freeLists[firstLevel][secondLevel]; range != NONE; range = ranges[range].nextFree)
+				{
+					uint32_t rangeFirstLevel;
+					uint32_t rangeSecondLevel;
+					mapping(ranges[range].size, rangeFirstLevel, rangeSecondLevel);
+					if (!ranges[range].free || rangeFirstLevel != firstLevel || rangeSecondLevel != secondLevel)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/*
+	* Size class of a free range: the first level is the highest set bit, the second level the next SECOND_LEVEL_LOG2 bits
+	*/
+	void weEngineTlsfAllocator::mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+	{
+		if (size < SMALL_SIZE)
+		{
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size >> (FIRST_LEVEL_SHIFT - SECOND_LEVEL_LOG2));
+			return;
+		}
+
+		const uint32_t mostSignificantBit = findMostSignificantBit(size);
+		secondLevel = static_cast<uint32_t>(size >> (mostSignificantBit - SECOND_LEVEL_LOG2)) ^ SECOND_LEVEL_COUNT;
+		firstLevel = mostSignificantBit - FIRST_LEVEL_SHIFT + 1;
+	}
+
+	/*
+	* Rounds the size up to the next size class boundary so any range of the class found is large enough
+	*/
+	uint32_t weEngineTlsfAllocator::findFreeRange(uint64_t size) const
+	{
+		if (size < SMALL_SIZE)
+		{
+			size += (SMALL_SIZE >> SECOND_LEVEL_LOG2) - 1;
+		}
+		else
+		{
+			size += (1ull << (findMostSignificantBit(size) - SECOND_LEVEL_LOG2)) - 1;
+		}
+
+		if (size > this->size)
+		{
+			return NONE;
+		}
+
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		mapping(size, firstLevel, secondLevel);
+
+		uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			const uint64_t firstLevelMap = firstLevelBitmap & (~0ull << (firstLevel + 1));
+			if (firstLevelMap == 0)
+			{
+				return NONE;
+			}
+
+			firstLevel = findLeastSignificantBit(firstLevelMap);
+			secondLevelMap = secondLevelBitmaps[firstLevel];
+		}
+
+		return freeLists[firstLevel][findLeastSignificantBit(secondLevelMap)];
+	}
+
+	void weEngineTlsfAllocator::insertFreeRange(uint32_t range)
+	{
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		mapping(ranges[range].size, firstLevel, secondLevel);
+
+		const uint32_t head = freeLists[firstLevel][secondLevel];
+		ranges[range].free = true;
+		ranges[range].previousFree = NONE;
+		ranges[range].nextFree = head;
+		if (head != NONE)
+		{
+			ranges[head].previousFree = range;
+		}
+
+		freeLists[firstLevel][secondLevel] = range;
+		firstLevelBitmap |= 1ull << firstLevel;
+		secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+	}
+
+	void weEngineTlsfAllocator::removeFreeRange(uint32_t range)
+	{
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		mapping(ranges[range].size, firstLevel, secondLevel);
+
+		const uint32_t previous = ranges[range].previousFree;
+		const uint32_t next = ranges[range].nextFree;
+		if (previous != NONE)
+		{
+			ranges[previous].nextFree = next;
+		}
+		else
+		{
+			freeLists[firstLevel][secondLevel] = next;
+		}
+
+		if (next != NONE)
+		{
+			ranges[next].previousFree = previous;
+		}
+
+		if (freeLists[firstLevel][secondLevel] == NONE)
+		{
+			secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (secondLevelBitmaps[firstLevel] == 0)
+			{
+				firstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+
+		ranges[range].previousFree = NONE;
+		ranges[range].nextFree = NONE;
+	}
+
+	uint32_t weEngineTlsfAllocator::createRange(uint64_t offset, uint64_t size)
+	{
+		uint32_t range;
+		if (!unusedRanges.empty())
+		{
+			range = unusedRanges.back();
+			unusedRanges.pop_back();
+		}
+		else
+		{
+			range = static_cast<uint32_t>(ranges.size());
+			ranges.emplace_back();
+		}
+
+		ranges[range] = { offset, size, NONE, NONE, NONE, NONE, false };
+		return range;
+	}
+
+	void weEngineTlsfAllocator::releaseRange(uint32_t range)
+	{
+		ranges[range].size = 0;
+		ranges[range].free = false;
+		unusedRanges.push_back(range);
+	}
+
+	bool weEngineLinearAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two.");
+		size = size > 0 ? size : 1;
+
+		const uint64_t alignedOffset = alignUp(head, alignment);
+		if (alignedOffset > this->size || size > this->size - alignedOffset)
+		{
+			return false;
+		}
+
+		head = alignedOffset + size;
+		allocationCount++;
+		allocatedBytes += size;
+
+		offset = alignedOffset;
+		handle = static_cast<uint32_t>(allocationSizes.size());
+		allocationSizes.push_back(size);
+		return true;
+	}
+
+	void weEngineLinearAllocator::free(uint32_t handle)
+	{
+		assert(handle < allocationSizes.size() && allocationSizes[handle] != 0 && "Freeing a range which is not allocated.");
+
+		allocatedBytes -= allocationSizes[handle];
+		allocationSizes[handle] = 0;
+		allocationCount--;
+
+		if (allocationCount == 0)
+		{
+			allocationSizes.clear();
+			head = 0;
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+* Block allocators place allocations inside a range of a fixed size and only deal with offsets, they never touch the memory itself.
+* weEngineMemoryAllocator uses them to sub-allocate VkDeviceMemory blocks, which keeps them usable (and testable) without a GPU.
+*/
+
+//std
+#include "cstdint"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineBlockAllocator
+	{
+	public:
+		explicit weEngineBlockAllocator(uint64_t size) : size{ size }
+		{
+		}
+
+		virtual ~weEngineBlockAllocator() = default;
+
+		weEngineBlockAllocator(const weEngineBlockAllocator&) = delete;
+		weEngineBlockAllocator& operator=(const weEngineBlockAllocator&) = delete;
+
+		/*
+		* Finds room for size bytes at an offset aligned to alignment (a power of two). Returns false when the range has no room left,
+		* otherwise writes the offset and a handle which has to be passed to free.
+		*/
+		virtual bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) = 0;
+		virtual void free(uint32_t handle) = 0;
+
+		uint64_t getSize() const
+		{
+			return size;
+		}
+
+		uint32_t getAllocationCount() const
+		{
+			return allocationCount;
+		}
+
+		uint64_t getAllocatedBytes() const
+		{
+			return allocatedBytes;
+		}
+
+		bool isEmpty() const
+		{
+			return allocationCount == 0;
+		}
+
+	protected:
+		static uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		const uint64_t size;
+		uint32_t allocationCount = 0;
+		uint64_t allocatedBytes = 0;
+	};
+
+	/*
+	* Two-Level Segregated Fit allocator (Masmano et al. 2004) for long-lived allocations. Free ranges are sorted into lists by size class,
+	* two bitmaps find the smallest non empty class that fits in constant time, and freed ranges merge with their free neighbours.
+	*/
+	class weEngineTlsfAllocator : public weEngineBlockAllocator
+	{
+	public:
+		explicit weEngineTlsfAllocator(uint64_t size);
+
+		bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) override;
+		void free(uint32_t handle) override;
+
+		//Size of the largest free range. An allocation always succeeds when its size plus the alignment padding, rounded up to the next size class (at most 1/32 more), fits in it.
+		uint64_t getLargestFreeRange() const;
+		uint32_t getFreeRangeCount() const;
+
+		//Checks that the ranges cover the whole block without overlap, that no two free ranges touch and that the free lists match the ranges
+		bool validate() const;
+
+	private:
+		//Every power of two is split into 2^SECOND_LEVEL_LOG2 size classes. Sizes below 2^FIRST_LEVEL_SHIFT all go to the first level.
+		static constexpr uint32_t SECOND_LEVEL_LOG2 = 5;
+		static constexpr uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_LOG2;
+		static constexpr uint32_t FIRST_LEVEL_SHIFT = 8;
+		static constexpr uint64_t SMALL_SIZE = 1ull << FIRST_LEVEL_SHIFT;
+		static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - FIRST_LEVEL_SHIFT + 1;
+		static constexpr uint32_t NONE = ~0u;
+
+		//A range of the block, either free or allocated, linked to its neighbours in memory and to the other ranges of its free list
+		struct Range
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t previousPhysical;
+			uint32_t nextPhysical;
+			uint32_t previousFree;
+			uint32_t nextFree;
+			bool free;
+		};
+
+		static void mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+		uint32_t findFreeRange(uint64_t size) const;
+		void insertFreeRange(uint32_t range);
+		void removeFreeRange(uint32_t range);
+		uint32_t createRange(uint64_t offset, uint64_t size);
+		void releaseRange(uint32_t range);
+
+		std::vector<Range> ranges;
+		std::vector<uint32_t> unusedRanges;
+
+		uint64_t firstLevelBitmap = 0;
+		uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT]{};
+		uint32_t freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+	};
+
+	/*
+	* Bump allocator for transient allocations like staging buffers. Freeing only counts the live allocations,
+	* the whole range is reused once every allocation made from it has been freed.
+	*/
+	class weEngineLinearAllocator : public weEngineBlockAllocator
+	{
+	public:
+		explicit weEngineLinearAllocator(uint64_t size) : weEngineBlockAllocator(size)
+		{
+		}
+
+		bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) override;
+		void free(uint32_t handle) override;
+
+	private:
+		std::vector<uint64_t> allocationSizes;
+		uint64_t head = 0;
+	};
+}
@@ -0,0 +1,652 @@
+#include "weEngineBvh.hpp"
+
+//std
+#include "algorithm"
+#include "cassert"
+#include "cmath"
+
+namespace weEngine
+{
+	weEngineAabb weEngineAabb::transform(const glm::mat4& matrix) const
+	{
+		const glm::mat3 absoluteMatrix{
+			glm::abs(glm::vec3(matrix[0])),
+			glm::abs(glm::vec3(matrix[1])),
+			glm::abs(glm::vec3(matrix[2]))
+		};
+
+		const glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+		const glm::vec3 extent = absoluteMatrix * getExtent();
+		return { center - extent, center + extent };
+	}
+
+	/*
+	* Slab test: the ray is inside the box between the largest entry distance and the smallest exit distance of the three axes.
+	* A zero direction component gives an infinite inverse, and an origin on the slab plane of that axis would give 0 * inf = NaN,
+	* so the axes the ray is parallel to are only checked for the origin lying between their planes.
+	*/
+	bool weEngineAabb::intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const
+	{
+		float entryDistance = 0.0f;
+		float exitDistance = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (std::isinf(inverseDirection[axis]))
+			{
+				if (origin[axis] < minimum[axis] || origin[axis] > maximum[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			const float t1 = (minimum[axis] - origin[axis]) * inverseDirection[axis];
+			const float t2 = (maximum[axis] - origin[axis]) * inverseDirection[axis];
+			entryDistance = std::max(entryDistance, std::min(t1, t2));
+			exitDistance = std::min(exitDistance, std::max(t1, t2));
+		}
+
+		//Also rejects the boxes entered past maxDistance, the exit distance starts there
+		if (exitDistance < entryDistance)
+		{
+			return false;
+		}
+
+		distance = entryDistance;
+		return true;
+	}
+
+	uint32_t weEngineBvh::insert(const weEngineAabb& bounds, uint32_t userData)
+	{
+		const uint32_t leaf = allocateNode();
+		nodes[leaf].bounds = fatten(bounds);
+		nodes[leaf].userData = userData;
+		insertLeaf(leaf);
+
+		statistics.leafCount++;
+		return leaf;
+	}
+
+	void weEngineBvh::remove(uint32_t proxy)
+	{
+		assert(nodes[proxy].isLeaf() && "Removing a node which is not a leaf");
+
+		removeLeaf(proxy);
+		freeNode(proxy);
+		statistics.leafCount--;
+	}
+
+	bool weEngineBvh::update(uint32_t proxy, const weEngineAabb& bounds)
+	{
+		if (nodes[proxy].bounds.contains(bounds))
+		{
+			return false;
+		}
+
+		nodes[proxy].bounds = fatten(bounds);
+		refitAncestors(nodes[proxy].parent);
+		statistics.refitCount++;
+		return true;
+	}
+
+	/*
+	* Rebuilds the internal nodes top down. Every node splits its leaves where the binned surface area heuristic is the lowest,
+	* leaves whose centers cannot be told apart are split in two halves. The leaf nodes are kept, so their proxies stay valid.
+	*/
+	void weEngineBvh::rebuild()
+	{
+		statistics.refitCount = 0;
+		statistics.rebuildCount++;
+		if (root == NULL_NODE)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> leaves;
+		leaves.reserve(statistics.leafCount);
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const uint32_t node = stack.back();
+			stack.pop_back();
+			if (nodes[node].isLeaf())
+			{
+				leaves.push_back(node);
+			}
+			else
+			{
+				stack.push_back(nodes[node].left);
+				stack.push_back(nodes[node].right);
+				freeNode(node);
+			}
+		}
+
+		struct BuildTask
+		{
+			uint32_t begin;
+			uint32_t end;
+			uint32_t parent;
+			bool isLeft;
+		};
+
+		struct Bin
+		{
+			weEngineAabb bounds;
+			uint32_t count = 0;
+		};
+
+		std::vector<BuildTask> tasks;
+		tasks.push_back({ 0, static_cast<uint32_t>(leaves.size()), NULL_NODE, false });
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			uint32_t node;
+			if (task.end - task.begin == 1)
+			{
+				node = leaves[task.begin];
+			}
+			else
+			{
+				weEngineAabb bounds = nodes[leaves[task.begin]].bounds;
+				weEngineAabb centerBounds{ bounds.getCenter(), bounds.getCenter() };
+				for (uint32_t i = task.begin + 1; i < task.end; i++)
+				{
+					const weEngineAabb& leafBounds = nodes[leaves[i]].bounds;
+					bounds = weEngineAabb::merge(bounds, leafBounds);
+					centerBounds.minimum = glm::min(centerBounds.minimum, leafBounds.getCenter());
+					centerBounds.maximum = glm::max(centerBounds.maximum, leafBounds.getCenter());
+				}
+
+				int bestAxis = -1;
+				uint32_t bestSplit = 0;
+				float bestCost = 0.0f;
+				const glm::vec3 centerExtent = centerBounds.maximum - centerBounds.minimum;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (centerExtent[axis] <= 0.0f)
+					{
+						continue;
+					}
+
+					std::array<Bin, SAH_BIN_COUNT> bins{};
+					const float binScale = SAH_BIN_COUNT / centerExtent[axis];
+					for (uint32_t i = task.begin; i < task.end; i++)
+					{
+						const weEngineAabb& leafBounds = nodes[leaves[i]].bounds;
+						const uint32_t bin = std::min(SAH_BIN_COUNT - 1, static_cast<uint32_t>((leafBounds.getCenter()[axis] - centerBounds.minimum[axis]) * binScale));
+						bins[bin].bounds = bins[bin].count == 0 ? leafBounds : weEngineAabb::merge(bins[bin].bounds, leafBounds);
+						bins[bin].count++;
+					}
+
+					//Area and count of the bins right of every split, then sweep from the left
+					std::array<float, SAH_BIN_COUNT> rightAreas{};
+					std::array<uint32_t, SAH_BIN_COUNT> rightCounts{};
+					Bin right{};
+					for (uint32_t bin = SAH_BIN_COUNT - 1; bin > 0; bin--)
+					{
+						if (bins[bin].count > 0)
+						{
+							right.bounds = right.count == 0 ? bins[bin].bounds : weEngineAabb::merge(right.bounds, bins[bin].bounds);
+							right.count += bins[bin].count;
+						}
+						rightAreas[bin] = right.count > 0 ? right.bounds.getSurfaceArea() : 0.0f;
+						rightCounts[bin] = right.count;
+					}
+
+					Bin left{};
+					for (uint32_t split = 1; split < SAH_BIN_COUNT; split++)
+					{
+						if (bins[split - 1].count > 0)
+						{
+							left.bounds = left.count == 0 ? bins[split - 1].bounds : weEngineAabb::merge(left.bounds, bins[split - 1].bounds);
+							left.count += bins[split - 1].count;
+						}
+						if (left.count == 0 || rightCounts[split] == 0)
+						{
+							continue;
+						}
+
+						const float cost = left.count * left.bounds.getSurfaceArea() + rightCounts[split] * rightAreas[split];
+						if (bestAxis < 0 || cost < bestCost)
+						{
+							bestAxis = axis;
+							bestSplit = split;
+							bestCost = cost;
+						}
+					}
+				}
+
+				uint32_t middle;
+				if (bestAxis < 0)
+				{
+					middle = task.begin + (task.end - task.begin) / 2;
+				}
+				else
+				{
+					const float binScale = SAH_BIN_COUNT / centerExtent[bestAxis];
+					const auto split = std::partition(leaves.begin() + task.begin, leaves.begin() + task.end, [&](uint32_t leaf)
+						{
+							const uint32_t bin = std::min(SAH_BIN_COUNT - 1, static_cast<uint32_t>((nodes[leaf].bounds.getCenter()[bestAxis] - centerBounds.minimum[bestAxis]) * binScale));
+							return bin < bestSplit;
+						});
+					middle = static_cast<uint32_t>(split - leaves.begin());
+				}
+
+				node = allocateNode();
+				nodes[node].bounds = bounds;
+				tasks.push_back({ task.begin, middle, node, true });
+				tasks.push_back({ middle, task.end, node, false });
+			}
+
+			nodes[node].parent = task.parent;
+			if (task.parent == NULL_NODE)
+			{
+				root = node;
+			}
+			else if (task.isLeft)
+			{
+				nodes[task.parent].left = node;
+			}
+			else
+			{
+				nodes[task.parent].right = node;
+			}
+		}
+	}
+
+	bool weEngineBvh::rebuildIfNeeded()
+	{
+		const float refitLimit = std::max(1.0f, REBUILD_REFIT_RATIO * statistics.leafCount);
+		if (statistics.refitCount < refitLimit)
+		{
+			return false;
+		}
+
+		rebuild();
+		return true;
+	}
+
+	float weEngineBvh::computeCost() const
+	{
+		if (root == NULL_NODE || nodes[root].isLeaf())
+		{
+			return 0.0f;
+		}
+
+		float internalArea = 0.0f;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			if (!node.isLeaf())
+			{
+				internalArea += node.bounds.getSurfaceArea();
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+
+		const float rootArea = nodes[root].bounds.getSurfaceArea();
+		return rootArea > 0.0f ? internalArea / rootArea : 0.0f;
+	}
+
+	/*
+	* Subtrees entirely inside every plane are added without testing their nodes
+	*/
+	void weEngineBvh::queryFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& results) const
+	{
+		statistics.lastQueryVisitedNodes = 0;
+		if (root == NULL_NODE)
+		{
+			return;
+		}
+
+		std::array<glm::vec3, 6> absoluteNormals;
+		for (size_t plane = 0; plane < planes.size(); plane++)
+		{
+			absoluteNormals[plane] = glm::abs(glm::vec3(planes[plane]));
+		}
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const uint32_t node = stack.back();
+			stack.pop_back();
+			statistics.lastQueryVisitedNodes++;
+
+			const glm::vec3 center = nodes[node].bounds.getCenter();
+			const glm::vec3 extent = nodes[node].bounds.getExtent();
+			bool outside = false;
+			bool inside = true;
+			for (size_t plane = 0; plane < planes.size(); plane++)
+			{
+				const float signedDistance = glm::dot(glm::vec3(planes[plane]), center) + planes[plane].w;
+				const float radius = glm::dot(absoluteNormals[plane], extent);
+				if (signedDistance + radius < 0.0f)
+				{
+					outside = true;
+					break;
+				}
+				inside = inside && signedDistance - radius >= 0.0f;
+			}
+
+			if (outside)
+			{
+				continue;
+			}
+
+			if (nodes[node].isLeaf())
+			{
+				results.push_back(nodes[node].userData);
+			}
+			else if (inside)
+			{
+				collectLeaves(node, results);
+			}
+			else
+			{
+				stack.push_back(nodes[node].left);
+				stack.push_back(nodes[node].right);
+			}
+		}
+	}
+
+	void weEngineBvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const
+	{
+		statistics.lastQueryVisitedNodes = 0;
+		if (root == NULL_NODE)
+		{
+			return;
+		}
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			statistics.lastQueryVisitedNodes++;
+
+			const glm::vec3 offset = glm::clamp(center, node.bounds.minimum, node.bounds.maximum) - center;
+			if (glm::dot(offset, offset) > radius * radius)
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				results.push_back(node.userData);
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	void weEngineBvh::queryAabb(const weEngineAabb& bounds, std::vector<uint32_t>& results) const
+	{
+		statistics.lastQueryVisitedNodes = 0;
+		if (root == NULL_NODE)
+		{
+			return;
+		}
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			statistics.lastQueryVisitedNodes++;
+
+			if (!node.bounds.overlaps(bounds))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				results.push_back(node.userData);
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	bool weEngineBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const RayCallback& callback, RayHit& hit) const
+	{
+		statistics.lastQueryVisitedNodes = 0;
+		float distance;
+		const glm::vec3 inverseDirection = 1.0f / direction;
+		if (root == NULL_NODE || !nodes[root].bounds.intersectRay(origin, inverseDirection, maxDistance, distance))
+		{
+			return false;
+		}
+
+		bool found = false;
+		float closestDistance = maxDistance;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			statistics.lastQueryVisitedNodes++;
+
+			//Tested again since a closer hit may have been found after the node was pushed
+			if (!node.bounds.intersectRay(origin, inverseDirection, closestDistance, distance))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				const float hitDistance = callback(node.userData, closestDistance);
+				if (hitDistance >= 0.0f && hitDistance <= closestDistance)
+				{
+					closestDistance = hitDistance;
+					hit = { node.userData, hitDistance };
+					found = true;
+				}
+				continue;
+			}
+
+			//The closer child is pushed last so it is visited first
+			float leftDistance, rightDistance;
+			const bool hitsLeft = nodes[node.left].bounds.intersectRay(origin, inverseDirection, closestDistance, leftDistance);
+			const bool hitsRight = nodes[node.right].bounds.intersectRay(origin, inverseDirection, closestDistance, rightDistance);
+			if (hitsLeft && hitsRight)
+			{
+				const bool leftFirst = leftDistance <= rightDistance;
+				stack.push_back(leftFirst ? node.right : node.left);
+				stack.push_back(leftFirst ? node.left : node.right);
+			}
+			else if (hitsLeft)
+			{
+				stack.push_back(node.left);
+			}
+			else if (hitsRight)
+			{
+				stack.push_back(node.right);
+			}
+		}
+
+		return found;
+	}
+
+	uint32_t weEngineBvh::allocateNode()
+	{
+		uint32_t node;
+		if (freeList != NULL_NODE)
+		{
+			node = freeList;
+			freeList = nodes[node].parent;
+			nodes[node] = Node{};
+		}
+		else
+		{
+			node = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+
+		statistics.nodeCount++;
+		return node;
+	}
+
+	void weEngineBvh::freeNode(uint32_t node)
+	{
+		nodes[node].parent = freeList;
+		freeList = node;
+		statistics.nodeCount--;
+	}
+
+	/*
+	* Walks down to the sibling which makes the tree grow the least: the area of the new parent plus the area every ancestor gains.
+	*/
+	void weEngineBvh::insertLeaf(uint32_t leaf)
+	{
+		if (root == NULL_NODE)
+		{
+			root = leaf;
+			nodes[leaf].parent = NULL_NODE;
+			return;
+		}
+
+		const weEngineAabb leafBounds = nodes[leaf].bounds;
+		uint32_t sibling = root;
+		while (!nodes[sibling].isLeaf())
+		{
+			const Node& node = nodes[sibling];
+			const float area = node.bounds.getSurfaceArea();
+			const float combinedArea = weEngineAabb::merge(node.bounds, leafBounds).getSurfaceArea();
+
+			//Making the leaf a sibling of this node, or moving down and growing this node
+			const float cost = 2.0f * combinedArea;
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](uint32_t child)
+			{
+				const float childCombinedArea = weEngineAabb::merge(nodes[child].bounds, leafBounds).getSurfaceArea();
+				return nodes[child].isLeaf()
+					? childCombinedArea + inheritanceCost
+					: childCombinedArea - nodes[child].bounds.getSurfaceArea() + inheritanceCost;
+			};
+
+			const float leftCost = childCost(node.left);
+			const float rightCost = childCost(node.right);
+			if (cost < leftCost && cost < rightCost)
+			{
+				break;
+			}
+			sibling = leftCost < rightCost ? node.left : node.right;
+		}
+
+		const uint32_t oldParent = nodes[sibling].parent;
+		const uint32_t newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].bounds = weEngineAabb::merge(nodes[sibling].bounds, leafBounds);
+		nodes[newParent].left = sibling;
+		nodes[newParent].right = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE)
+		{
+			root = newParent;
+		}
+		else
+		{
+			if (nodes[oldParent].left == sibling)
+			{
+				nodes[oldParent].left = newParent;
+			}
+			else
+			{
+				nodes[oldParent].right = newParent;
+			}
+			refitAncestors(oldParent);
+		}
+	}
+
+	//The sibling of the leaf takes the place of their parent
+	void weEngineBvh::removeLeaf(uint32_t leaf)
+	{
+		if (leaf == root)
+		{
+			root = NULL_NODE;
+			return;
+		}
+
+		const uint32_t parent = nodes[leaf].parent;
+		const uint32_t grandParent = nodes[parent].parent;
+		const uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+		nodes[sibling].parent = grandParent;
+		if (grandParent == NULL_NODE)
+		{
+			root = sibling;
+		}
+		else
+		{
+			if (nodes[grandParent].left == parent)
+			{
+				nodes[grandParent].left = sibling;
+			}
+			else
+			{
+				nodes[grandParent].right = sibling;
+			}
+			refitAncestors(grandParent);
+		}
+		freeNode(parent);
+	}
+
+	void weEngineBvh::refitAncestors(uint32_t node)
+	{
+		while (node != NULL_NODE)
+		{
+			nodes[node].bounds = weEngineAabb::merge(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+			node = nodes[node].parent;
+		}
+	}
+
+	void weEngineBvh::collectLeaves(uint32_t node, std::vector<uint32_t>& results) const
+	{
+		//Appended to the end of the shared stack, above the entries of the query calling it
+		const size_t base = stack.size();
+		stack.push_back(node);
+		while (stack.size() > base)
+		{
+			const Node& current = nodes[stack.back()];
+			stack.pop_back();
+			statistics.lastQueryVisitedNodes++;
+
+			if (current.isLeaf())
+			{
+				results.push_back(current.userData);
+			}
+			else
+			{
+				stack.push_back(current.left);
+				stack.push_back(current.right);
+			}
+		}
+	}
+
+	weEngineAabb weEngineBvh::fatten(const weEngineAabb& bounds)
+	{
+		const glm::vec3 margin = glm::max((bounds.maximum - bounds.minimum) * FAT_MARGIN, glm::vec3{ MIN_FAT_MARGIN });
+		return { bounds.minimum - margin, bounds.maximum + margin };
+	}
+}
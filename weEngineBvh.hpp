@@ -0,0 +1,175 @@
+#pragma once
+
+/*
+* weEngineBvh is a dynamic bounding volume hierarchy over axis aligned boxes, used to find the objects of the scene
+* inside a frustum, a sphere or a box, or hit by a ray, without testing every object.
+*
+* Leaves are inserted where they increase the surface area of the tree the least. Their boxes are enlarged by a margin,
+* so an object moving inside its enlarged box does not touch the tree, and one leaving it only refits the boxes of its ancestors.
+* Refits keep the topology, which gets worse as objects move, so the tree is rebuilt top down with a binned surface area heuristic
+* once enough leaves were refitted. Leaf proxies stay valid across rebuilds.
+*/
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "array"
+#include "cstdint"
+#include "functional"
+#include "vector"
+
+namespace weEngine
+{
+	struct weEngineAabb
+	{
+		glm::vec3 minimum{ 0.0f };
+		glm::vec3 maximum{ 0.0f };
+
+		glm::vec3 getCenter() const
+		{
+			return 0.5f * (minimum + maximum);
+		}
+
+		glm::vec3 getExtent() const
+		{
+			return 0.5f * (maximum - minimum);
+		}
+
+		float getSurfaceArea() const
+		{
+			const glm::vec3 size = maximum - minimum;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		bool contains(const weEngineAabb& other) const
+		{
+			return glm::all(glm::lessThanEqual(minimum, other.minimum)) && glm::all(glm::greaterThanEqual(maximum, other.maximum));
+		}
+
+		bool overlaps(const weEngineAabb& other) const
+		{
+			return glm::all(glm::lessThanEqual(minimum, other.maximum)) && glm::all(glm::greaterThanEqual(maximum, other.minimum));
+		}
+
+		static weEngineAabb merge(const weEngineAabb& a, const weEngineAabb& b)
+		{
+			return { glm::min(a.minimum, b.minimum), glm::max(a.maximum, b.maximum) };
+		}
+
+		//Box bounding this box once transformed
+		weEngineAabb transform(const glm::mat4& matrix) const;
+
+		//Distance along the ray to the box, zero when the origin is inside. Returns false when the ray misses it before maxDistance.
+		bool intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const;
+	};
+
+	class weEngineBvh
+	{
+	public:
+		static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+		//Leaf boxes are enlarged by this fraction of their size, and at least by MIN_FAT_MARGIN, on every side
+		static constexpr float FAT_MARGIN = 0.1f;
+		static constexpr float MIN_FAT_MARGIN = 0.01f;
+
+		//The tree is rebuilt once the leaves refitted since the last rebuild reach this fraction of the leaves
+		static constexpr float REBUILD_REFIT_RATIO = 0.25f;
+
+		static constexpr uint32_t SAH_BIN_COUNT = 12;
+
+		struct RayHit
+		{
+			uint32_t userData = 0;
+			float distance = 0.0f;
+		};
+
+		/*
+		* Tests the ray against the object of a leaf whose box the ray hits. Returns the distance to the object, or a negative value when it is missed.
+		*/
+		using RayCallback = std::function<float(uint32_t userData, float maxDistance)>;
+
+		struct Statistics
+		{
+			uint32_t leafCount = 0;
+			uint32_t nodeCount = 0;
+			uint32_t refitCount = 0; //Leaves refitted since the last rebuild
+			uint32_t rebuildCount = 0;
+			uint32_t lastQueryVisitedNodes = 0;
+		};
+
+		weEngineBvh() = default;
+
+		weEngineBvh(const weEngineBvh&) = delete;
+		weEngineBvh& operator=(const weEngineBvh&) = delete;
+
+		//Adds a leaf for the box and returns its proxy
+		uint32_t insert(const weEngineAabb& bounds, uint32_t userData);
+		void remove(uint32_t proxy);
+
+		//Moves the leaf to its new box, returns true when it left its enlarged box and was refitted
+		bool update(uint32_t proxy, const weEngineAabb& bounds);
+
+		void rebuild();
+		//Rebuilds the tree when enough leaves were refitted, returns true if it did
+		bool rebuildIfNeeded();
+
+		//Surface area heuristic cost of the tree: the area of the internal nodes relative to the root
+		float computeCost() const;
+
+		//The queries append the user data of the leaves whose enlarged boxes touch the volume, callers refine them with the exact bounds
+		void queryFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& results) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const;
+		void queryAabb(const weEngineAabb& bounds, std::vector<uint32_t>& results) const;
+
+		//Finds the closest object hit by the ray, the leaves are visited front to back so far subtrees are skipped
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const RayCallback& callback, RayHit& hit) const;
+
+		uint32_t getUserData(uint32_t proxy) const
+		{
+			return nodes[proxy].userData;
+		}
+
+		const weEngineAabb& getFatBounds(uint32_t proxy) const
+		{
+			return nodes[proxy].bounds;
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+	private:
+		struct Node
+		{
+			weEngineAabb bounds;
+			uint32_t parent = NULL_NODE; //Next free node while the node is in the free list
+			uint32_t left = NULL_NODE;
+			uint32_t right = NULL_NODE;
+			uint32_t userData = 0;
+
+			bool isLeaf() const
+			{
+				return left == NULL_NODE;
+			}
+		};
+
+		uint32_t allocateNode();
+		void freeNode(uint32_t node);
+		void insertLeaf(uint32_t leaf);
+		void removeLeaf(uint32_t leaf);
+		void refitAncestors(uint32_t node);
+		void collectLeaves(uint32_t node, std::vector<uint32_t>& results) const;
+		static weEngineAabb fatten(const weEngineAabb& bounds);
+
+		std::vector<Node> nodes;
+		uint32_t root = NULL_NODE;
+		uint32_t freeList = NULL_NODE;
+
+		mutable std::vector<uint32_t> stack; //Traversal stack shared by the queries
+		mutable Statistics statistics{};
+	};
+}
@@ -97,4 +97,31 @@ namespace weEngine
 		viewMatrix[3][1] = -glm::dot(v, position);
 		viewMatrix[3][2] = -glm::dot(w, position);
 	}
+
+	/*
+	* Extracts the frustum planes from the rows of projection * view. The clip space depth goes from 0 to 1, so the near plane is the third row alone.
+	*/
+	std::array<glm::vec4, 6> weEngineCamera::getFrustumPlanes() const
+	{
+		const glm::mat4 projectionView = projectionMatrix * viewMatrix;
+		const glm::vec4 rowX{ projectionView[0][0], projectionView[1][0], projectionView[2][0], projectionView[3][0] };
+		const glm::vec4 rowY{ projectionView[0][1], projectionView[1][1], projectionView[2][1], projectionView[3][1] };
+		const glm::vec4 rowZ{ projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2] };
+		const glm::vec4 rowW{ projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3] };
+
+		std::array<glm::vec4, 6> planes{
+			rowW + rowX,
+			rowW - rowX,
+			rowW + rowY,
+			rowW - rowY,
+			rowZ,
+			rowW - rowZ
+		};
+
+		for (glm::vec4& plane : planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return planes;
+	}
 }
\ No newline at end of file
@@ -14,6 +14,9 @@
 #include "glm/gtc/constants.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+//std
+#include "array"
+
 namespace weEngine
 {
 	class weEngineCamera
@@ -38,6 +41,12 @@ namespace weEngine
 		{
 			return viewMatrix;
 		}
+
+		/*
+		* Returns the planes of the view frustum in world space as (normal, distance), with normalized normals pointing inside.
+		* A point p is inside a plane when dot(normal, p) + distance >= 0. The order is left, right, bottom, top, near, far.
+		*/
+		std::array<glm::vec4, 6> getFrustumPlanes() const;
 	private:
 		glm::mat4 projectionMatrix{ 1.0f };
 		glm::mat4 viewMatrix{ 1.0f };
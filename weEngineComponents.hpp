@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+* Components the entities of the world are made of. An entity is drawn when it has a TransformComponent, a ModelComponent and a ColorComponent.
+*/
+
+#include "weEngineModel.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+//std
+#include "memory"
+namespace weEngine
+{
+	struct TransformComponent
+	{
+		glm::vec3 translation{};
+		glm::vec3 scale{ 1.0f, 1.0f, 1.0f };
+		glm::vec3 rotation{};
+
+		/*
+		* Represents the transform matrix for a gameobject Uses the Tait-Bryan angle Y1X2Z3
+		* https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+		*/
+		glm::mat4 mat4()
+		{
+			const float c3 = glm::cos(rotation.z);
+			const float s3 = glm::sin(rotation.z);
+			const float c2 = glm::cos(rotation.x);
+			const float s2 = glm::sin(rotation.x);
+			const float c1 = glm::cos(rotation.y);
+			const float s1 = glm::sin(rotation.y);
+			return glm::mat4{
+				{
+					scale.x * (c1 * c3 + s1 * s2 * s3),
+					scale.x * (c2 * s3),
+					scale.x * (c1 * s2 * s3 - c3 * s1),
+					0.0f,
+				},
+				{
+					scale.y * (c3 * s1 * s2 - c1 * s3),
+					scale.y * (c2 * c3),
+					scale.y * (c1 * c3 * s2 + s1 * s3),
+					0.0f,
+				},
+				{
+					scale.z * (c2 * s1),
+					scale.z * (-s2),
+					scale.z * (c1 * c2),
+					0.0f,
+				},
+				{translation.x, translation.y, translation.z, 1.0f} };
+		}
+
+		/*
+		* Transform at alpha between this one and the next. The angles turn the short way, so a yaw wrapping around two pi does not spin
+		* the whole circle, and a transform equal to the next one is returned unchanged.
+		*/
+		TransformComponent interpolate(const TransformComponent& next, float alpha) const
+		{
+			glm::vec3 rotationDelta = next.rotation - rotation;
+			rotationDelta -= glm::two_pi<float>() * glm::round(rotationDelta / glm::two_pi<float>());
+
+			TransformComponent transform{};
+			transform.translation = translation + (next.translation - translation) * alpha;
+			transform.scale = scale + (next.scale - scale) * alpha;
+			transform.rotation = rotation + rotationDelta * alpha;
+			return transform;
+		}
+	};
+
+	//Transform of the entity before the last simulation tick, the drawn transform is interpolated from it to the TransformComponent
+	struct PreviousTransformComponent
+	{
+		TransformComponent transform{};
+	};
+
+	struct ModelComponent
+	{
+		std::shared_ptr<weEngineModel> model{}; //Never null, entities without a model have no ModelComponent
+	};
+
+	struct ColorComponent
+	{
+		glm::vec3 color{ 1.0f }; //Multiplied with the vertex colors by the fragment shader, white keeps them
+	};
+
+	//Tag of the entities rasterized by the occlusion culling when their model has an occluder mesh
+	struct OccluderComponent
+	{
+	};
+
+	//Tag of the entities moved by the keyboard and the mouse, the camera follows them
+	struct CameraControlComponent
+	{
+	};
+}
@@ -0,0 +1,187 @@
+#include "weEngineDescriptors.hpp"
+
+//std
+#include "cassert"
+#include "stdexcept"
+
+namespace weEngine
+{
+	weEngineDescriptorSetLayout::Builder& weEngineDescriptorSetLayout::Builder::addBinding(
+		uint32_t binding,
+		VkDescriptorType descriptorType,
+		VkShaderStageFlags stageFlags,
+		uint32_t count)
+	{
+		assert(bindings.count(binding) == 0 && "Binding already in use");
+
+		VkDescriptorSetLayoutBinding layoutBinding{};
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorType = descriptorType;
+		layoutBinding.descriptorCount = count;
+		layoutBinding.stageFlags = stageFlags;
+		bindings[binding] = layoutBinding;
+		return *this;
+	}
+
+	std::unique_ptr<weEngineDescriptorSetLayout> weEngineDescriptorSetLayout::Builder::build() const
+	{
+		return std::make_unique<weEngineDescriptorSetLayout>(weEngineDevice, bindings);
+	}
+
+	weEngineDescriptorSetLayout::weEngineDescriptorSetLayout(weEngine::weEngineDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+		: weEngineDevice{ device }, bindings{ bindings }
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+		for (const auto& binding : bindings)
+		{
+			setLayoutBindings.push_back(binding.second);
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+		descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+		descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+
+		if (vkCreateDescriptorSetLayout(weEngineDevice.device(), &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout");
+		}
+	}
+
+	weEngineDescriptorSetLayout::~weEngineDescriptorSetLayout()
+	{
+		vkDestroyDescriptorSetLayout(weEngineDevice.device(), descriptorSetLayout, nullptr);
+	}
+
+	weEngineDescriptorPool::Builder& weEngineDescriptorPool::Builder::addPoolSize(VkDescriptorType descriptorType, uint32_t count)
+	{
+		poolSizes.push_back({ descriptorType, count });
+		return *this;
+	}
+
+	weEngineDescriptorPool::Builder& weEngineDescriptorPool::Builder::setPoolFlags(VkDescriptorPoolCreateFlags flags)
+	{
+		poolFlags = flags;
+		return *this;
+	}
+
+	weEngineDescriptorPool::Builder& weEngineDescriptorPool::Builder::setMaxSets(uint32_t count)
+	{
+		maxSets = count;
+		return *this;
+	}
+
+	std::unique_ptr<weEngineDescriptorPool> weEngineDescriptorPool::Builder::build() const
+	{
+		return std::make_unique<weEngineDescriptorPool>(weEngineDevice, maxSets, poolFlags, poolSizes);
+	}
+
+	weEngineDescriptorPool::weEngineDescriptorPool(
+		weEngine::weEngineDevice& device,
+		uint32_t maxSets,
+		VkDescriptorPoolCreateFlags poolFlags,
+		const std::vector<VkDescriptorPoolSize>& poolSizes) : weEngineDevice{ device }
+	{
+		VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+		descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		descriptorPoolInfo.pPoolSizes = poolSizes.data();
+		descriptorPoolInfo.maxSets = maxSets;
+		descriptorPoolInfo.flags = poolFlags;
+
+		if (vkCreateDescriptorPool(weEngineDevice.device(), &descriptorPoolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor pool");
+		}
+	}
+
+	weEngineDescriptorPool::~weEngineDescriptorPool()
+	{
+		vkDestroyDescriptorPool(weEngineDevice.device(), descriptorPool, nullptr);
+	}
+
+	bool weEngineDescriptorPool::allocateDescriptorSet(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet) const
+	{
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+		allocInfo.descriptorSetCount = 1;
+
+		return vkAllocateDescriptorSets(weEngineDevice.device(), &allocInfo, &descriptorSet) == VK_SUCCESS;
+	}
+
+	void weEngineDescriptorPool::freeDescriptorSets(std::vector<VkDescriptorSet>& descriptorSets) const
+	{
+		vkFreeDescriptorSets(
+			weEngineDevice.device(),
+			descriptorPool,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data());
+	}
+
+	void weEngineDescriptorPool::resetPool()
+	{
+		vkResetDescriptorPool(weEngineDevice.device(), descriptorPool, 0);
+	}
+
+	weEngineDescriptorWriter::weEngineDescriptorWriter(weEngineDescriptorSetLayout& setLayout, weEngineDescriptorPool& pool)
+		: setLayout{ setLayout }, pool{ pool }
+	{
+	}
+
+	weEngineDescriptorWriter& weEngineDescriptorWriter::writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain the specified binding");
+
+		const VkDescriptorSetLayoutBinding& bindingDescription = setLayout.bindings[binding];
+		assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.descriptorType = bindingDescription.descriptorType;
+		write.dstBinding = binding;
+		write.pBufferInfo = bufferInfo;
+		write.descriptorCount = 1;
+
+		writes.push_back(write);
+		return *this;
+	}
+
+	weEngineDescriptorWriter& weEngineDescriptorWriter::writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo)
+	{
+		assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain the specified binding");
+
+		const VkDescriptorSetLayoutBinding& bindingDescription = setLayout.bindings[binding];
+		assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.descriptorType = bindingDescription.descriptorType;
+		write.dstBinding = binding;
+		write.pImageInfo = imageInfo;
+		write.descriptorCount = 1;
+
+		writes.push_back(write);
+		return *this;
+	}
+
+	bool weEngineDescriptorWriter::build(VkDescriptorSet& set)
+	{
+		if (!pool.allocateDescriptorSet(setLayout.getDescriptorSetLayout(), set))
+		{
+			return false;
+		}
+		overwrite(set);
+		return true;
+	}
+
+	void weEngineDescriptorWriter::overwrite(VkDescriptorSet& set)
+	{
+		for (VkWriteDescriptorSet& write : writes)
+		{
+			write.dstSet = set;
+		}
+		vkUpdateDescriptorSets(pool.weEngineDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+}
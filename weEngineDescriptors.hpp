@@ -0,0 +1,122 @@
+#pragma once
+
+/*
+* Descriptor helpers: weEngineDescriptorSetLayout describes the bindings of a set, weEngineDescriptorPool allocates sets
+* and weEngineDescriptorWriter fills them with buffers and images.
+*/
+
+#include "weEngineDevice.hpp"
+
+//std
+#include "memory"
+#include "unordered_map"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineDescriptorSetLayout
+	{
+	public:
+		class Builder
+		{
+		public:
+			Builder(weEngineDevice& device) : weEngineDevice{ device } {}
+
+			Builder& addBinding(
+				uint32_t binding,
+				VkDescriptorType descriptorType,
+				VkShaderStageFlags stageFlags,
+				uint32_t count = 1);
+			std::unique_ptr<weEngineDescriptorSetLayout> build() const;
+
+		private:
+			weEngineDevice& weEngineDevice;
+			std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+		};
+
+		weEngineDescriptorSetLayout(weEngineDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+		~weEngineDescriptorSetLayout();
+
+		weEngineDescriptorSetLayout(const weEngineDescriptorSetLayout&) = delete;
+		weEngineDescriptorSetLayout& operator=(const weEngineDescriptorSetLayout&) = delete;
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const
+		{
+			return descriptorSetLayout;
+		}
+
+	private:
+		weEngineDevice& weEngineDevice;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+
+		friend class weEngineDescriptorWriter;
+	};
+
+	class weEngineDescriptorPool
+	{
+	public:
+		class Builder
+		{
+		public:
+			Builder(weEngineDevice& device) : weEngineDevice{ device } {}
+
+			Builder& addPoolSize(VkDescriptorType descriptorType, uint32_t count);
+			Builder& setPoolFlags(VkDescriptorPoolCreateFlags flags);
+			Builder& setMaxSets(uint32_t count);
+			std::unique_ptr<weEngineDescriptorPool> build() const;
+
+		private:
+			weEngineDevice& weEngineDevice;
+			std::vector<VkDescriptorPoolSize> poolSizes{};
+			uint32_t maxSets = 1000;
+			VkDescriptorPoolCreateFlags poolFlags = 0;
+		};
+
+		weEngineDescriptorPool(
+			weEngineDevice& device,
+			uint32_t maxSets,
+			VkDescriptorPoolCreateFlags poolFlags,
+			const std::vector<VkDescriptorPoolSize>& poolSizes);
+		~weEngineDescriptorPool();
+
+		weEngineDescriptorPool(const weEngineDescriptorPool&) = delete;
+		weEngineDescriptorPool& operator=(const weEngineDescriptorPool&) = delete;
+
+		//Returns false when the pool is out of sets or descriptors
+		bool allocateDescriptorSet(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet) const;
+
+		//Only valid for pools created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+		void freeDescriptorSets(std::vector<VkDescriptorSet>& descriptorSets) const;
+
+		void resetPool();
+
+	private:
+		weEngineDevice& weEngineDevice;
+		VkDescriptorPool descriptorPool;
+
+		friend class weEngineDescriptorWriter;
+	};
+
+	/*
+	* Collects the writes of a descriptor set. The buffer and image infos are referenced until build or overwrite is called.
+	*/
+	class weEngineDescriptorWriter
+	{
+	public:
+		weEngineDescriptorWriter(weEngineDescriptorSetLayout& setLayout, weEngineDescriptorPool& pool);
+
+		weEngineDescriptorWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo);
+		weEngineDescriptorWriter& writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo);
+
+		//Allocates a set from the pool and writes it
+		bool build(VkDescriptorSet& set);
+		//Writes an existing set, which must not be in use by the GPU
+		void overwrite(VkDescriptorSet& set);
+
+	private:
+		weEngineDescriptorSetLayout& setLayout;
+		weEngineDescriptorPool& pool;
+		std::vector<VkWriteDescriptorSet> writes;
+	};
+}
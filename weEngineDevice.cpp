@@ -1,4 +1,5 @@
 #include "weEngineDevice.hpp"
+#include "weEngineUploadManager.hpp"
 
 // std headers
 #include <cstring>
@@ -60,9 +61,16 @@ namespace weEngine {
       pickPhysicalDevice();
       createLogicalDevice();
       createCommandPool();
+      memoryAllocator = std::make_unique<weEngineMemoryAllocator>(physicalDevice, device_);
+      uploadManager = std::make_unique<weEngineUploadManager>(*this);
     }
 
     weEngineDevice::~weEngineDevice() {
+      uploadManager.reset();
+
+      // Reports the buffers and images which were never destroyed
+      memoryAllocator.reset();
+
       vkDestroyCommandPool(device_, commandPool, nullptr);
       vkDestroyDevice(device_, nullptr);
 
@@ -152,7 +160,7 @@ namespace weEngine {
       QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
       std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-      std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+      std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
       float queuePriority = 1.0f;
       for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -164,8 +172,28 @@ namespace weEngine {
         queueCreateInfos.push_back(queueCreateInfo);
       }
 
+      VkPhysicalDeviceFeatures supportedFeatures;
+      vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
       VkPhysicalDeviceFeatures deviceFeatures = {};
       deviceFeatures.samplerAnisotropy = VK_TRUE;
+      deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+      deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+      capabilities.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+      capabilities.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+      uint32_t queueFamilyCount = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+      std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+      vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+      capabilities.graphicsQueueSupportsCompute = (queueFamilies[indices.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+
+      // The application targets Vulkan 1.0, so the count variant of the indirect draws comes from the extension
+      std::vector<const char *> enabledExtensions = deviceExtensions;
+      if (isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+        enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        capabilities.drawIndirectCount = true;
+      }
 
       VkDeviceCreateInfo createInfo = {};
       createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -174,8 +202,8 @@ namespace weEngine {
       createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
       createInfo.pEnabledFeatures = &deviceFeatures;
-      createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-      createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+      createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
       // might not really be necessary anymore because device specific validation layers
       // have been deprecated
@@ -192,6 +220,17 @@ namespace weEngine {
 
       vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
       vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+      vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+
+      if (capabilities.drawIndirectCount) {
+        cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            device_,
+            "vkCmdDrawIndexedIndirectCountKHR");
+        capabilities.drawIndirectCount = cmdDrawIndexedIndirectCount != nullptr;
+      }
+
+      std::cout << "Transfer queue family: " << indices.transferFamily
+                << (indices.hasDedicatedTransferFamily() ? " (dedicated)" : " (shared with graphics)") << std::endl;
     }
 
     void weEngineDevice::createCommandPool() {
@@ -342,6 +381,25 @@ namespace weEngine {
       return requiredExtensions.empty();
     }
 
+    bool weEngineDevice::isDeviceExtensionSupported(VkPhysicalDevice device, const char *extensionName) {
+      uint32_t extensionCount;
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+      std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+      vkEnumerateDeviceExtensionProperties(
+          device,
+          nullptr,
+          &extensionCount,
+          availableExtensions.data());
+
+      for (const auto &extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+          return true;
+        }
+      }
+      return false;
+    }
+
     QueueFamilyIndices weEngineDevice::findQueueFamilies(VkPhysicalDevice device) {
       QueueFamilyIndices indices;
 
@@ -370,6 +428,25 @@ namespace weEngine {
         i++;
       }
 
+      // Uploads prefer a family which can only transfer (the copy engine of most discrete GPUs), then any non graphics family
+      // with transfer support, and fall back to the graphics queue
+      indices.transferFamily = indices.graphicsFamily;
+      uint32_t bestTransferScore = 0;
+      for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        const VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (queueFamilies[family].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+          continue;
+        }
+
+        // Compute queues always support transfers even when they do not report the transfer bit
+        const bool canTransfer = (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) != 0;
+        const uint32_t score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+        if (canTransfer && score > bestTransferScore) {
+          indices.transferFamily = family;
+          bestTransferScore = score;
+        }
+      }
+
       return indices;
     }
 
@@ -415,6 +492,14 @@ namespace weEngine {
       throw std::runtime_error("failed to find supported format!");
     }
 
+    bool weEngineDevice::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+      VkFormatProperties props;
+      vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+      const VkFormatFeatureFlags supported =
+          tiling == VK_IMAGE_TILING_LINEAR ? props.linearTilingFeatures : props.optimalTilingFeatures;
+      return (supported & features) == features;
+    }
+
     uint32_t weEngineDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
       VkPhysicalDeviceMemoryProperties memProperties;
       vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -428,12 +513,18 @@ namespace weEngine {
       throw std::runtime_error("failed to find suitable memory type!");
     }
 
+    /*
+    * Creates a buffer bound to memory from the device memory allocator. Staging buffers and other short lived buffers
+    * should pass weEngineMemoryUsage::TRANSIENT, the name identifies the buffer in the leak report.
+    */
     void weEngineDevice::createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory) {
+        weEngineAllocation &bufferAllocation,
+        weEngineMemoryUsage memoryUsage,
+        const char *name) {
       VkBufferCreateInfo bufferInfo{};
       bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
       bufferInfo.size = size;
@@ -447,16 +538,20 @@ namespace weEngine {
       VkMemoryRequirements memRequirements;
       vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+      bufferAllocation = memoryAllocator->allocate(
+          memRequirements,
+          findMemoryType(memRequirements.memoryTypeBits, properties),
+          weEngineResourceType::BUFFER,
+          memoryUsage,
+          name);
 
-      if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-      }
+      vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset);
+    }
 
-      vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    void weEngineDevice::destroyBuffer(VkBuffer &buffer, weEngineAllocation &bufferAllocation) {
+      vkDestroyBuffer(device_, buffer, nullptr);
+      memoryAllocator->free(bufferAllocation);
+      buffer = VK_NULL_HANDLE;
     }
 
     VkCommandBuffer weEngineDevice::beginSingleTimeCommands() {
@@ -485,9 +580,19 @@ namespace weEngine {
       submitInfo.commandBufferCount = 1;
       submitInfo.pCommandBuffers = &commandBuffer;
 
-      vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-      vkQueueWaitIdle(graphicsQueue_);
+      // Waits for this submission only instead of the whole queue
+      VkFenceCreateInfo fenceInfo{};
+      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      VkFence fence;
+      vkCreateFence(device_, &fenceInfo, nullptr, &fence);
+
+      {
+        std::lock_guard<std::mutex> queueLock{queueMutex_};
+        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+      }
+      vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
 
+      vkDestroyFence(device_, fence, nullptr);
       vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
@@ -534,7 +639,8 @@ namespace weEngine {
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory) {
+        weEngineAllocation &imageAllocation,
+        const char *name) {
       if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
       }
@@ -542,18 +648,22 @@ namespace weEngine {
       VkMemoryRequirements memRequirements;
       vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-      if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-      }
+      imageAllocation = memoryAllocator->allocate(
+          memRequirements,
+          findMemoryType(memRequirements.memoryTypeBits, properties),
+          weEngineResourceType::IMAGE,
+          weEngineMemoryUsage::LONG_LIVED,
+          name);
 
-      if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+      if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
         throw std::runtime_error("failed to bind image memory!");
       }
     }
 
+    void weEngineDevice::destroyImage(VkImage &image, weEngineAllocation &imageAllocation) {
+      vkDestroyImage(device_, image, nullptr);
+      memoryAllocator->free(imageAllocation);
+      image = VK_NULL_HANDLE;
+    }
+
 }  // namespace weEngine
\ No newline at end of file
@@ -1,13 +1,18 @@
 #pragma once
 
+#include "weEngineMemoryAllocator.hpp"
 #include "weEngineWindow.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace weEngine {
 
+    class weEngineUploadManager;
+
     struct SwapChainSupportDetails 
     {
          VkSurfaceCapabilitiesKHR capabilities;
@@ -19,11 +24,22 @@ namespace weEngine {
     {
          uint32_t graphicsFamily;
          uint32_t presentFamily;
+         uint32_t transferFamily; // Dedicated transfer family when the device has one, the graphics family otherwise
          bool graphicsFamilyHasValue = false;
          bool presentFamilyHasValue = false;
+         bool hasDedicatedTransferFamily() const { return transferFamily != graphicsFamily; }
          bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // Optional features used by the GPU driven rendering, enabled when the physical device supports them
+    struct DeviceCapabilities
+    {
+         bool multiDrawIndirect = false;
+         bool drawIndirectFirstInstance = false;
+         bool drawIndirectCount = false; // VK_KHR_draw_indirect_count
+         bool graphicsQueueSupportsCompute = false;
+    };
+
     class weEngineDevice 
     {
      public:
@@ -47,12 +63,16 @@ namespace weEngine {
           VkSurfaceKHR surface() { return surface_; }
           VkQueue graphicsQueue() { return graphicsQueue_; }
           VkQueue presentQueue() { return presentQueue_; }
+          VkQueue transferQueue() { return transferQueue_; }
+          // Queues are externally synchronized, every submit, present and vkDeviceWaitIdle locks this so they can come from several threads
+          std::mutex &queueMutex() { return queueMutex_; }
 
           SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
           uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
           QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
           VkFormat findSupportedFormat(
               const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+          bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
           // Buffer Helper Functions
           void createBuffer(
@@ -60,7 +80,10 @@ namespace weEngine {
               VkBufferUsageFlags usage,
               VkMemoryPropertyFlags properties,
               VkBuffer &buffer,
-              VkDeviceMemory &bufferMemory);
+              weEngineAllocation &bufferAllocation,
+              weEngineMemoryUsage memoryUsage = weEngineMemoryUsage::LONG_LIVED,
+              const char *name = "buffer");
+          void destroyBuffer(VkBuffer &buffer, weEngineAllocation &bufferAllocation);
           VkCommandBuffer beginSingleTimeCommands();
           void endSingleTimeCommands(VkCommandBuffer commandBuffer);
           void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -71,7 +94,16 @@ namespace weEngine {
               const VkImageCreateInfo &imageInfo,
               VkMemoryPropertyFlags properties,
               VkImage &image,
-              VkDeviceMemory &imageMemory);
+              weEngineAllocation &imageAllocation,
+              const char *name = "image");
+          void destroyImage(VkImage &image, weEngineAllocation &imageAllocation);
+
+          const DeviceCapabilities &getCapabilities() const { return capabilities; }
+          // Null unless capabilities.drawIndirectCount is set
+          PFN_vkCmdDrawIndexedIndirectCountKHR getCmdDrawIndexedIndirectCount() const { return cmdDrawIndexedIndirectCount; }
+
+          weEngineMemoryAllocator &getMemoryAllocator() { return *memoryAllocator; }
+          weEngineUploadManager &getUploadManager() { return *uploadManager; }
 
           VkPhysicalDeviceProperties properties;
 
@@ -91,6 +123,7 @@ namespace weEngine {
           void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
           void hasGflwRequiredInstanceExtensions();
           bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+          bool isDeviceExtensionSupported(VkPhysicalDevice device, const char *extensionName);
           SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
           VkInstance instance;
@@ -103,6 +136,16 @@ namespace weEngine {
           VkSurfaceKHR surface_;
           VkQueue graphicsQueue_;
           VkQueue presentQueue_;
+          VkQueue transferQueue_;
+          std::mutex queueMutex_;
+
+          DeviceCapabilities capabilities{};
+          PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+          // Owns every buffer and image memory block, destroyed right before the device
+          std::unique_ptr<weEngineMemoryAllocator> memoryAllocator;
+          // Batches the copies into device local buffers, destroyed before the memory allocator
+          std::unique_ptr<weEngineUploadManager> uploadManager;
 
           const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
           const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
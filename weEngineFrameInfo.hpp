@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+* FrameInfo groups the state of the frame being recorded that the rendering systems need
+*/
+
+#include "weEngineCamera.hpp"
+#include "weEngineDevice.hpp"
+#include "weEngineBvh.hpp"
+#include "weEngineFramePacket.hpp"
+
+namespace weEngine
+{
+	class weEngineRenderer;
+
+	struct FrameInfo
+	{
+		int frameIndex;
+		float frameTime;
+		VkCommandBuffer commandBuffer;
+		weEngineCamera& camera;
+		VkExtent2D extent;
+		const weEngineBvh* sceneBvh = nullptr; //Hierarchy of the objects of the packet, null to test every object. The user data of its leaves are entity indices
+		weEngineRenderer* renderer = nullptr; //Gives the secondary command buffers of the frame
+		VkDescriptorSet globalDescriptorSet = VK_NULL_HANDLE; //Camera uniforms, bound at weEngineGlobalUniforms::GLOBAL_SET
+		uint32_t globalDynamicOffset = 0; //Slot of the frame in the global uniform ring
+		const weEngineFramePacket* packet = nullptr; //Objects, world matrices and camera of the frame, written by its simulation
+	};
+}
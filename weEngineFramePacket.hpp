@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+* weEngineFramePacket holds everything the recording of a frame reads, written by the simulation of the frame. The engine keeps a few
+* packets: the simulation of a frame writes one while the recording of the previous frames reads the others, so neither waits for the other
+* and the world can change while a frame is recorded. A packet is not written again until its frame is recorded.
+*
+* The packets are used in turn, so the transforms and the scene hierarchy of a packet are updated with the changes since the last frame
+* that used the packet, and the dirty tracking of the transforms and the refits of the hierarchy stay incremental.
+*/
+
+#include "weEngineCamera.hpp"
+#include "weEngineModel.hpp"
+#include "weEngineBvh.hpp"
+#include "weEngineTransformSystem.hpp"
+#include "weEngineWorld.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "cstdint"
+#include "memory"
+#include "vector"
+
+namespace weEngine
+{
+	//Drawn entity as the recording sees it, copied from its components at the end of the simulation
+	struct weEngineRenderObject
+	{
+		uint32_t entityIndex = 0;
+		std::shared_ptr<weEngineModel> model{}; //Keeps the model alive until the frame is recorded, even if the entity is destroyed meanwhile
+		glm::vec3 color{};
+		float maxScale = 1.0f; //Largest absolute scale of the transform, scales the errors of the detail levels
+		bool isOccluder = false; //Rasterized by the occlusion culling when its model has an occluder mesh
+	};
+
+	struct weEngineFramePacket
+	{
+		static constexpr uint32_t NULL_OBJECT = UINT32_MAX;
+
+		uint64_t frameNumber = 0;
+		float frameTime = 0.0f;
+		uint64_t tickNumber = 0; //Last simulation tick of the frame
+		uint32_t tickCount = 0; //Simulation ticks run by the frame, none when the frame was shorter than what was left of a tick
+		float interpolationAlpha = 0.0f; //Position of the frame between the last two ticks, the drawn transforms are interpolated by it
+		weEngineCamera camera{};
+		bool isPrintingStatistics = false; //The counters of the rendering systems are printed once the frame is recorded
+
+		weEngineTransformSystem transforms; //World matrices of the drawn entities, at the index of the entity
+
+		weEngineBvh sceneBvh; //Hierarchy of the drawn entities, the user data of its leaves are entity indices
+		std::vector<uint32_t> sceneProxies; //Leaf of every entity index, NULL_NODE for the indices without a drawn entity
+		std::vector<weEngineEntity> sceneEntities; //Entity the leaf at the same index was inserted for
+
+		std::vector<weEngineRenderObject> objects; //Drawn entities in the order of the chunks of the world
+		std::vector<uint32_t> objectIndices; //Position in objects of every entity index, NULL_OBJECT for the indices without a drawn entity
+
+		//Drawn entity at the entity index
+		const weEngineRenderObject& getObject(uint32_t entityIndex) const
+		{
+			return objects[objectIndices[entityIndex]];
+		}
+	};
+}
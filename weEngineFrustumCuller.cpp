@@ -0,0 +1,188 @@
+#include "weEngineFrustumCuller.hpp"
+
+#if defined(__AVX__)
+#define WE_ENGINE_CULL_AVX
+#include "immintrin.h"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WE_ENGINE_CULL_SSE
+#include "emmintrin.h"
+#endif
+
+namespace weEngine
+{
+	void weEngineFrustumCuller::clear()
+	{
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		extentX.clear();
+		extentY.clear();
+		extentZ.clear();
+	}
+
+	void weEngineFrustumCuller::reserve(size_t count)
+	{
+		centerX.reserve(count);
+		centerY.reserve(count);
+		centerZ.reserve(count);
+		extentX.reserve(count);
+		extentY.reserve(count);
+		extentZ.reserve(count);
+	}
+
+	/*
+	* The extent of the transformed box on each world axis is the sum of the local extents scaled by the absolute values of the matrix row
+	*/
+	uint32_t weEngineFrustumCuller::addTransformedBox(const glm::mat4& transform, const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		const glm::vec3 center = 0.5f * (minimum + maximum);
+		const glm::vec3 extent = 0.5f * (maximum - minimum);
+
+		const glm::mat3 absoluteTransform{
+			glm::abs(glm::vec3(transform[0])),
+			glm::abs(glm::vec3(transform[1])),
+			glm::abs(glm::vec3(transform[2]))
+		};
+
+		return addBox(glm::vec3(transform * glm::vec4(center, 1.0f)), absoluteTransform * extent);
+	}
+
+	uint32_t weEngineFrustumCuller::addBox(const glm::vec3& center, const glm::vec3& extent)
+	{
+		const uint32_t index = getBoxCount();
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+		return index;
+	}
+
+	/*
+	* A box is outside when, for one of the planes, its center is further behind the plane than the projection of its extent on the plane normal.
+	* The visible indices are compacted without branches: every lane writes its index and only advances the count when it is visible.
+	*/
+	void weEngineFrustumCuller::cull(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visibleIndices)
+	{
+		const uint32_t count = getBoxCount();
+		visibleIndices.resize(count);
+		uint32_t visibleCount = 0;
+		uint32_t i = 0;
+
+#if defined(WE_ENGINE_CULL_AVX)
+		__m256 normalX[6], normalY[6], normalZ[6], distance[6], absoluteX[6], absoluteY[6], absoluteZ[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			normalX[plane] = _mm256_set1_ps(planes[plane].x);
+			normalY[plane] = _mm256_set1_ps(planes[plane].y);
+			normalZ[plane] = _mm256_set1_ps(planes[plane].z);
+			distance[plane] = _mm256_set1_ps(planes[plane].w);
+			absoluteX[plane] = _mm256_set1_ps(glm::abs(planes[plane].x));
+			absoluteY[plane] = _mm256_set1_ps(glm::abs(planes[plane].y));
+			absoluteZ[plane] = _mm256_set1_ps(glm::abs(planes[plane].z));
+		}
+
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 cx = _mm256_loadu_ps(centerX.data() + i);
+			const __m256 cy = _mm256_loadu_ps(centerY.data() + i);
+			const __m256 cz = _mm256_loadu_ps(centerZ.data() + i);
+			const __m256 ex = _mm256_loadu_ps(extentX.data() + i);
+			const __m256 ey = _mm256_loadu_ps(extentY.data() + i);
+			const __m256 ez = _mm256_loadu_ps(extentZ.data() + i);
+
+			__m256 outside = _mm256_setzero_ps();
+			for (int plane = 0; plane < 6; plane++)
+			{
+				const __m256 signedDistance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(normalX[plane], cx), _mm256_mul_ps(normalY[plane], cy)),
+					_mm256_add_ps(_mm256_mul_ps(normalZ[plane], cz), distance[plane]));
+				const __m256 radius = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(absoluteX[plane], ex), _mm256_mul_ps(absoluteY[plane], ey)),
+					_mm256_mul_ps(absoluteZ[plane], ez));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(signedDistance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				visibleIndices[visibleCount] = i + lane;
+				visibleCount += (visibleMask >> lane) & 1u;
+			}
+		}
+#elif defined(WE_ENGINE_CULL_SSE)
+		__m128 normalX[6], normalY[6], normalZ[6], distance[6], absoluteX[6], absoluteY[6], absoluteZ[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			normalX[plane] = _mm_set1_ps(planes[plane].x);
+			normalY[plane] = _mm_set1_ps(planes[plane].y);
+			normalZ[plane] = _mm_set1_ps(planes[plane].z);
+			distance[plane] = _mm_set1_ps(planes[plane].w);
+			absoluteX[plane] = _mm_set1_ps(glm::abs(planes[plane].x));
+			absoluteY[plane] = _mm_set1_ps(glm::abs(planes[plane].y));
+			absoluteZ[plane] = _mm_set1_ps(glm::abs(planes[plane].z));
+		}
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 cx = _mm_loadu_ps(centerX.data() + i);
+			const __m128 cy = _mm_loadu_ps(centerY.data() + i);
+			const __m128 cz = _mm_loadu_ps(centerZ.data() + i);
+			const __m128 ex = _mm_loadu_ps(extentX.data() + i);
+			const __m128 ey = _mm_loadu_ps(extentY.data() + i);
+			const __m128 ez = _mm_loadu_ps(extentZ.data() + i);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int plane = 0; plane < 6; plane++)
+			{
+				const __m128 signedDistance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(normalX[plane], cx), _mm_mul_ps(normalY[plane], cy)),
+					_mm_add_ps(_mm_mul_ps(normalZ[plane], cz), distance[plane]));
+				const __m128 radius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(absoluteX[plane], ex), _mm_mul_ps(absoluteY[plane], ey)),
+					_mm_mul_ps(absoluteZ[plane], ez));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(signedDistance, radius), _mm_setzero_ps()));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu;
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				visibleIndices[visibleCount] = i + lane;
+				visibleCount += (visibleMask >> lane) & 1u;
+			}
+		}
+#endif
+
+		//Boxes left over by the vector loop
+		for (; i < count; i++)
+		{
+			bool outside = false;
+			for (const glm::vec4& plane : planes)
+			{
+				const float signedDistance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+				const float radius = glm::abs(plane.x) * extentX[i] + glm::abs(plane.y) * extentY[i] + glm::abs(plane.z) * extentZ[i];
+				outside |= signedDistance + radius < 0.0f;
+			}
+
+			visibleIndices[visibleCount] = i;
+			visibleCount += outside ? 0u : 1u;
+		}
+
+		visibleIndices.resize(visibleCount);
+		statistics.testedCount = count;
+		statistics.visibleCount = visibleCount;
+		statistics.culledCount = count - visibleCount;
+	}
+
+	const char* weEngineFrustumCuller::getKernelName()
+	{
+#if defined(WE_ENGINE_CULL_AVX)
+		return "AVX";
+#elif defined(WE_ENGINE_CULL_SSE)
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+* weEngineFrustumCuller tests world space bounding boxes against the six planes of a view frustum.
+* The boxes are stored as a structure of arrays, so the kernel tests eight boxes per instruction when the engine is compiled with AVX,
+* four with SSE, and one at a time on other architectures.
+*/
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "array"
+#include "cstdint"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineFrustumCuller
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t testedCount = 0;
+			uint32_t visibleCount = 0;
+			uint32_t culledCount = 0;
+		};
+
+		void clear();
+		void reserve(size_t count);
+
+		//Adds the box bounding the local box [minimum, maximum] once transformed, returns its index
+		uint32_t addTransformedBox(const glm::mat4& transform, const glm::vec3& minimum, const glm::vec3& maximum);
+		uint32_t addBox(const glm::vec3& center, const glm::vec3& extent);
+
+		/*
+		* Tests every box against the planes, given as returned by weEngineCamera::getFrustumPlanes. The indices of the boxes
+		* at least partly inside the frustum are written to visibleIndices in increasing order.
+		*/
+		void cull(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visibleIndices);
+
+		uint32_t getBoxCount() const
+		{
+			return static_cast<uint32_t>(centerX.size());
+		}
+
+		//Counts of the last cull
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		//Name of the instruction set the kernel was compiled for
+		static const char* getKernelName();
+
+	private:
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+
+		Statistics statistics{};
+	};
+}
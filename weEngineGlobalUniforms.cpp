@@ -0,0 +1,63 @@
+#include "weEngineGlobalUniforms.hpp"
+#include "weEngineSwapChain.hpp"
+
+//std
+#include "algorithm"
+#include "cstring"
+#include "stdexcept"
+
+namespace weEngine
+{
+	weEngineGlobalUniforms::weEngineGlobalUniforms(weEngine::weEngineDevice& device) : weEngineDevice(device)
+	{
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(weEngineDevice.properties.limits.minUniformBufferOffsetAlignment, 1);
+		slotSize = (sizeof(GlobalUbo) + alignment - 1) / alignment * alignment;
+
+		weEngineDevice.createBuffer(
+			slotSize * weEngineSwapChain::MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer,
+			allocation,
+			weEngineMemoryUsage::LONG_LIVED,
+			"global uniform buffer"
+		);
+
+		setLayout = weEngineDescriptorSetLayout::Builder(weEngineDevice)
+			.addBinding(GLOBAL_UBO_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+
+		descriptorPool = weEngineDescriptorPool::Builder(weEngineDevice)
+			.setMaxSets(1)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+			.build();
+
+		//The range is one slot, the dynamic offset moves it to the slot of the frame
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(GlobalUbo);
+
+		weEngineDescriptorWriter writer{ *setLayout, *descriptorPool };
+		writer.writeBuffer(GLOBAL_UBO_BINDING, &bufferInfo);
+		if (!writer.build(descriptorSet))
+		{
+			throw std::runtime_error("Failed to allocate the global descriptor set");
+		}
+	}
+
+	weEngineGlobalUniforms::~weEngineGlobalUniforms()
+	{
+		weEngineDevice.destroyBuffer(buffer, allocation);
+	}
+
+	void weEngineGlobalUniforms::update(int frameIndex, const weEngineCamera& camera)
+	{
+		GlobalUbo ubo{};
+		ubo.projection = camera.getProjection();
+		ubo.view = camera.getView();
+		ubo.projectionView = ubo.projection * ubo.view;
+
+		std::memcpy(static_cast<char*>(allocation.mappedData) + getDynamicOffset(frameIndex), &ubo, sizeof(GlobalUbo));
+	}
+}
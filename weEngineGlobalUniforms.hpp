@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+* weEngineGlobalUniforms holds the uniforms shared by every draw of a frame, the camera matrices, in a ring of one slot per frame in flight.
+* The ring is a single persistently mapped buffer behind a single descriptor set: the slot of a frame is picked with the dynamic offset
+* given when the set is bound, so a frame writes its slot while the GPU still reads the slot of the previous frame.
+*/
+
+#include "weEngineDevice.hpp"
+#include "weEngineDescriptors.hpp"
+#include "weEngineCamera.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "memory"
+
+namespace weEngine
+{
+	//Laid out for std140, read by the vertex shaders from set GLOBAL_SET
+	struct GlobalUbo
+	{
+		glm::mat4 projection{ 1.0f };
+		glm::mat4 view{ 1.0f };
+		glm::mat4 projectionView{ 1.0f }; //Computed once per frame instead of once per vertex
+	};
+
+	class weEngineGlobalUniforms
+	{
+	public:
+		//Set index of the global uniforms in the pipeline layouts of the rendering systems
+		static constexpr uint32_t GLOBAL_SET = 0;
+		static constexpr uint32_t GLOBAL_UBO_BINDING = 0;
+
+		explicit weEngineGlobalUniforms(weEngineDevice& device);
+		~weEngineGlobalUniforms();
+
+		weEngineGlobalUniforms(const weEngineGlobalUniforms&) = delete;
+		weEngineGlobalUniforms& operator=(const weEngineGlobalUniforms&) = delete;
+
+		//Writes the camera of the frame to its slot, the renderer must have waited for the previous use of the frame
+		void update(int frameIndex, const weEngineCamera& camera);
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const
+		{
+			return setLayout->getDescriptorSetLayout();
+		}
+
+		VkDescriptorSet getDescriptorSet() const
+		{
+			return descriptorSet;
+		}
+
+		//Offset of the slot of the frame, to pass to vkCmdBindDescriptorSets
+		uint32_t getDynamicOffset(int frameIndex) const
+		{
+			return static_cast<uint32_t>(slotSize * frameIndex);
+		}
+
+	private:
+		weEngineDevice& weEngineDevice;
+
+		std::unique_ptr<weEngineDescriptorSetLayout> setLayout;
+		std::unique_ptr<weEngineDescriptorPool> descriptorPool;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		weEngineAllocation allocation{};
+		VkDeviceSize slotSize = 0; //sizeof(GlobalUbo) rounded up to minUniformBufferOffsetAlignment
+	};
+}
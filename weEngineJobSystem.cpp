@@ -0,0 +1,415 @@
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "algorithm"
+#include "cassert"
+
+namespace weEngine
+{
+	//Job system and deque of the calling thread, set on the main thread by the constructor and on the workers when they start
+	static thread_local const weEngineJobSystem* threadJobSystem = nullptr;
+	static thread_local uint32_t threadDequeIndex = 0;
+
+	/*
+	* The deque of "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli) with a fixed capacity.
+	* The last job is the only one the owner and a thief can both take, they race for it on top.
+	*/
+	bool weEngineJobSystem::WorkDeque::push(weEngineJob* job)
+	{
+		const int64_t currentBottom = bottom.load(std::memory_order_relaxed);
+		const int64_t currentTop = top.load(std::memory_order_acquire);
+		if (currentBottom - currentTop >= static_cast<int64_t>(DEQUE_CAPACITY))
+		{
+			return false;
+		}
+
+		jobs[currentBottom & (DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(currentBottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	weEngineJob* weEngineJobSystem::WorkDeque::pop()
+	{
+		const int64_t newBottom = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(newBottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t currentTop = top.load(std::memory_order_relaxed);
+
+		if (currentTop > newBottom)
+		{
+			bottom.store(newBottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		weEngineJob* job = jobs[newBottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (currentTop == newBottom)
+		{
+			if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				job = nullptr;
+			}
+			bottom.store(newBottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	weEngineJob* weEngineJobSystem::WorkDeque::steal()
+	{
+		int64_t currentTop = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t currentBottom = bottom.load(std::memory_order_acquire);
+		if (currentTop >= currentBottom)
+		{
+			return nullptr;
+		}
+
+		weEngineJob* job = jobs[currentTop & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		return job;
+	}
+
+	weEngineJobSystem::weEngineJobSystem(uint32_t workerCount) : mainThreadId(std::this_thread::get_id())
+	{
+		static_assert((DEQUE_CAPACITY & (DEQUE_CAPACITY - 1)) == 0, "The deque capacity must be a power of two");
+
+		previousThreadJobSystem = threadJobSystem;
+		previousThreadDequeIndex = threadDequeIndex;
+		threadJobSystem = this;
+		threadDequeIndex = 0;
+
+		for (uint32_t i = 0; i < workerCount + 1; i++)
+		{
+			deques.push_back(std::make_unique<WorkDeque>());
+		}
+
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back([this, i]() { workerLoop(i + 1); });
+		}
+	}
+
+	weEngineJobSystem::~weEngineJobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		//Jobs nobody waited for are dropped without running
+		for (auto& deque : deques)
+		{
+			while (weEngineJob* job = deque->steal())
+			{
+				delete job;
+			}
+		}
+		for (weEngineJob* job : sharedJobs)
+		{
+			delete job;
+		}
+		for (weEngineJob* job : mainThreadJobs)
+		{
+			delete job;
+		}
+
+		//A job system created and destroyed on top of the shared one leaves the main thread to the shared one again
+		if (threadJobSystem == this)
+		{
+			threadJobSystem = previousThreadJobSystem;
+			threadDequeIndex = previousThreadDequeIndex;
+		}
+	}
+
+	weEngineJobSystem& weEngineJobSystem::shared()
+	{
+		static weEngineJobSystem jobSystem{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+		return jobSystem;
+	}
+
+	uint32_t weEngineJobSystem::getThreadIndex() const
+	{
+		return threadJobSystem == this ? threadDequeIndex : NO_DEQUE;
+	}
+
+	void weEngineJobSystem::run(std::function<void()> function, weEngineJobCounter* counter, weEngineJobCounter* dependency)
+	{
+		submit(new weEngineJob{ std::move(function), counter, false }, counter, dependency);
+	}
+
+	void weEngineJobSystem::runOnMainThread(std::function<void()> function, weEngineJobCounter* counter, weEngineJobCounter* dependency)
+	{
+		submit(new weEngineJob{ std::move(function), counter, true }, counter, dependency);
+	}
+
+	/*
+	* The counter is incremented before the job can run. A job with a pending dependency is parked in it, the thread decrementing
+	* the dependency to zero takes the parked jobs under the same lock, so a job is never parked after the jobs were released.
+	*/
+	void weEngineJobSystem::submit(weEngineJob* job, weEngineJobCounter* counter, weEngineJobCounter* dependency)
+	{
+		if (counter != nullptr)
+		{
+			counter->pendingCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (dependency != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(dependency->waitingMutex);
+			if (dependency->pendingCount.load(std::memory_order_acquire) != 0)
+			{
+				dependency->waitingJobs.push_back(job);
+				return;
+			}
+		}
+
+		submit(job);
+	}
+
+	void weEngineJobSystem::submit(weEngineJob* job)
+	{
+		if (job->isMainThreadOnly)
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			mainThreadJobs.push_back(job);
+			return;
+		}
+
+		//Counted before being pushed, so a worker never sees the count drop below the jobs it can find
+		queuedJobCount.fetch_add(1);
+
+		const uint32_t threadIndex = getThreadIndex();
+		if (threadIndex == NO_DEQUE || !deques[threadIndex]->push(job))
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			sharedJobs.push_back(job);
+		}
+
+		if (sleepingWorkerCount.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			workAvailable.notify_one();
+		}
+	}
+
+	weEngineJob* weEngineJobSystem::findJob()
+	{
+		const uint32_t threadIndex = getThreadIndex();
+		if (threadIndex != NO_DEQUE)
+		{
+			if (weEngineJob* job = deques[threadIndex]->pop())
+			{
+				queuedJobCount.fetch_sub(1);
+				return job;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			if (threadIndex == 0 && !mainThreadJobs.empty())
+			{
+				weEngineJob* job = mainThreadJobs.front();
+				mainThreadJobs.pop_front();
+				return job;
+			}
+			if (!sharedJobs.empty())
+			{
+				weEngineJob* job = sharedJobs.front();
+				sharedJobs.pop_front();
+				queuedJobCount.fetch_sub(1);
+				return job;
+			}
+		}
+
+		//Starts with the next deque so the thieves spread over the victims
+		const uint32_t dequeCount = static_cast<uint32_t>(deques.size());
+		const uint32_t firstVictim = threadIndex == NO_DEQUE ? 0 : threadIndex + 1;
+		for (uint32_t i = 0; i < dequeCount; i++)
+		{
+			const uint32_t victim = (firstVictim + i) % dequeCount;
+			if (victim == threadIndex)
+			{
+				continue;
+			}
+			if (weEngineJob* job = deques[victim]->steal())
+			{
+				queuedJobCount.fetch_sub(1);
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	void weEngineJobSystem::execute(weEngineJob* job)
+	{
+		job->function();
+
+		weEngineJobCounter* counter = job->counter;
+		delete job;
+		if (counter == nullptr)
+		{
+			return;
+		}
+
+		//Jobs that do not bring the counter to zero leave without the lock
+		uint32_t pendingCount = counter->pendingCount.load(std::memory_order_relaxed);
+		while (pendingCount > 1)
+		{
+			if (counter->pendingCount.compare_exchange_weak(pendingCount, pendingCount - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+
+		//The last job releases the parked jobs under the lock, wait takes the lock too before returning, so the counter outlives the unlock
+		std::vector<weEngineJob*> releasedJobs;
+		{
+			std::lock_guard<std::mutex> lock(counter->waitingMutex);
+			if (counter->pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				releasedJobs.swap(counter->waitingJobs);
+			}
+		}
+		for (weEngineJob* releasedJob : releasedJobs)
+		{
+			submit(releasedJob);
+		}
+	}
+
+	void weEngineJobSystem::wait(weEngineJobCounter& counter)
+	{
+		while (!counter.isDone())
+		{
+			if (weEngineJob* job = findJob())
+			{
+				execute(job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		//The last job may still hold the lock of the counter
+		std::lock_guard<std::mutex> lock(counter.waitingMutex);
+	}
+
+	void weEngineJobSystem::runMainThreadJobs()
+	{
+		assert(isMainThread() && "Main thread jobs can only run on the main thread");
+
+		std::deque<weEngineJob*> jobs;
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			jobs.swap(mainThreadJobs);
+		}
+		for (weEngineJob* job : jobs)
+		{
+			execute(job);
+		}
+	}
+
+	void weEngineJobSystem::parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task)
+	{
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		if (taskCount == 1 || workers.empty())
+		{
+			for (uint32_t i = 0; i < taskCount; i++)
+			{
+				task(i);
+			}
+			return;
+		}
+
+		//The jobs catch the exceptions, a job throwing out of execute would never decrement the counter
+		std::atomic<bool> failed{ false };
+		std::mutex failureMutex;
+		std::exception_ptr failure;
+		auto runTask = [&](uint32_t taskIndex)
+		{
+			if (failed.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+
+			try
+			{
+				task(taskIndex);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(failureMutex);
+				if (!failure)
+				{
+					failure = std::current_exception();
+				}
+				failed.store(true, std::memory_order_relaxed);
+			}
+		};
+
+		//Keeps the first half and pushes the second one until a single task is left, the oldest jobs of the deque are the largest ranges
+		weEngineJobCounter counter;
+		auto runRange = [&](uint32_t begin, uint32_t end, const auto& self) -> void
+		{
+			while (end - begin > 1)
+			{
+				const uint32_t middle = begin + (end - begin) / 2;
+				run([&self, middle, end]() { self(middle, end, self); }, &counter);
+				end = middle;
+			}
+			runTask(begin);
+		};
+
+		runRange(0, taskCount, runRange);
+		wait(counter);
+
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	void weEngineJobSystem::workerLoop(uint32_t threadIndex)
+	{
+		threadJobSystem = this;
+		threadDequeIndex = threadIndex;
+
+		uint32_t idleCount = 0;
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			if (weEngineJob* job = findJob())
+			{
+				execute(job);
+				idleCount = 0;
+				continue;
+			}
+
+			if (++idleCount < SPIN_COUNT)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			idleCount = 0;
+
+			//Counted as sleeping before checking the queue, a thread queuing a job after the check sees the count and wakes it
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkerCount.fetch_add(1);
+			workAvailable.wait(lock, [this]() { return stopping.load() || queuedJobCount.load() > 0; });
+			sleepingWorkerCount.fetch_sub(1);
+		}
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+/*
+* weEngineJobSystem is the task scheduler of the engine. Every worker thread, and the main thread, owns a Chase-Lev deque: the owner
+* pushes and pops jobs at the bottom, the other threads steal the oldest jobs from the top when they run out of work, so a job that
+* splits its work keeps the pieces on the same core until another core is idle.
+*
+* A job can signal a counter when it finishes and depend on a counter, it is then held by that counter until it reaches zero.
+* Waiting on a counter runs other jobs meanwhile instead of blocking, so jobs can wait on the jobs they started.
+* Jobs touching GLFW or anything else bound to the main thread are queued apart and only run by the main thread, in runMainThreadJobs
+* or while it waits. The main thread is the thread that first uses the job system. Threads that are neither the main thread nor
+* workers hand their jobs to a shared queue the workers also take from.
+*/
+
+//std
+#include "atomic"
+#include "condition_variable"
+#include "cstdint"
+#include "deque"
+#include "exception"
+#include "functional"
+#include "memory"
+#include "mutex"
+#include "thread"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineJobSystem;
+	struct weEngineJob;
+
+	//Number of jobs still to finish, jobs depending on the counter start once it reaches zero. Destroy it only after waiting on it.
+	class weEngineJobCounter
+	{
+	public:
+		weEngineJobCounter() = default;
+
+		weEngineJobCounter(const weEngineJobCounter&) = delete;
+		weEngineJobCounter& operator=(const weEngineJobCounter&) = delete;
+
+		bool isDone() const
+		{
+			return pendingCount.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		friend class weEngineJobSystem;
+
+		std::atomic<uint32_t> pendingCount{ 0 };
+		std::mutex waitingMutex;
+		std::vector<weEngineJob*> waitingJobs; //Jobs depending on the counter, pushed when it reaches zero
+	};
+
+	struct weEngineJob
+	{
+		std::function<void()> function;
+		weEngineJobCounter* counter = nullptr; //Decremented once the function returned
+		bool isMainThreadOnly = false;
+	};
+
+	class weEngineJobSystem
+	{
+	public:
+		//Jobs a deque holds, the jobs pushed to a full deque go to the shared queue
+		static constexpr uint32_t DEQUE_CAPACITY = 4096;
+
+		//Jobs a worker looks for before sleeping
+		static constexpr uint32_t SPIN_COUNT = 64;
+
+		explicit weEngineJobSystem(uint32_t workerCount);
+		~weEngineJobSystem();
+
+		weEngineJobSystem(const weEngineJobSystem&) = delete;
+		weEngineJobSystem& operator=(const weEngineJobSystem&) = delete;
+
+		//Job system shared by the engine, with one worker per core besides the main thread
+		static weEngineJobSystem& shared();
+
+		//Number of threads taking part in parallelFor, including the calling thread
+		uint32_t getThreadCount() const
+		{
+			return static_cast<uint32_t>(workers.size()) + 1;
+		}
+
+		bool isMainThread() const
+		{
+			return std::this_thread::get_id() == mainThreadId;
+		}
+
+		//Runs the function on any thread, once the dependency reached zero, then decrements the counter
+		void run(std::function<void()> function, weEngineJobCounter* counter = nullptr, weEngineJobCounter* dependency = nullptr);
+
+		//Same as run, but the function only runs on the main thread
+		void runOnMainThread(std::function<void()> function, weEngineJobCounter* counter = nullptr, weEngineJobCounter* dependency = nullptr);
+
+		//Runs jobs until the counter reaches zero
+		void wait(weEngineJobCounter& counter);
+
+		//Runs the main thread jobs queued so far, called by the main loop once per frame
+		void runMainThreadJobs();
+
+		/*
+		* Runs task(i) for every i in [0, taskCount) and returns once every task has finished. The range is split in halves as jobs,
+		* an idle thread steals the largest half left, so the calling thread only runs the tasks nobody took.
+		* A task throwing skips the tasks not started yet, the first exception is thrown again once the started tasks are done.
+		*/
+		void parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task);
+
+		//Chase-Lev deque, only its owner pushes and pops at the bottom, any thread steals at the top. Public for the tests.
+		class WorkDeque
+		{
+		public:
+			bool push(weEngineJob* job);
+			weEngineJob* pop();
+			weEngineJob* steal();
+
+		private:
+			std::atomic<int64_t> top{ 0 };
+			std::atomic<int64_t> bottom{ 0 };
+			std::unique_ptr<std::atomic<weEngineJob*>[]> jobs{ new std::atomic<weEngineJob*>[DEQUE_CAPACITY] };
+		};
+
+	private:
+
+		void workerLoop(uint32_t threadIndex);
+
+		//Queues a job whose dependency is done
+		void submit(weEngineJob* job);
+		void submit(weEngineJob* job, weEngineJobCounter* counter, weEngineJobCounter* dependency);
+
+		//Finds a job for the calling thread: its own deque, the main thread queue on the main thread, the shared queue, then the other deques
+		weEngineJob* findJob();
+		void execute(weEngineJob* job);
+
+		//Index of the deque of the calling thread, NO_DEQUE for the threads outside the job system
+		uint32_t getThreadIndex() const;
+
+		static constexpr uint32_t NO_DEQUE = UINT32_MAX;
+
+		std::thread::id mainThreadId;
+
+		//Job system the creating thread used before this one, given back to it by the destructor
+		const weEngineJobSystem* previousThreadJobSystem = nullptr;
+		uint32_t previousThreadDequeIndex = 0;
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<WorkDeque>> deques; //The main thread owns the first one, worker i owns deque i + 1
+
+		std::mutex sharedMutex;
+		std::deque<weEngineJob*> sharedJobs; //Jobs of the threads without a deque, and jobs that did not fit in a full deque
+		std::deque<weEngineJob*> mainThreadJobs;
+
+		std::atomic<uint32_t> queuedJobCount{ 0 }; //Jobs in the deques and the shared queue, for the workers to know when to sleep
+		std::atomic<uint32_t> sleepingWorkerCount{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable workAvailable;
+		std::atomic<bool> stopping{ false };
+	};
+}
@@ -0,0 +1,307 @@
+#include "weEngineMemoryAllocator.hpp"
+
+//std
+#include "algorithm"
+#include "iostream"
+#include "stdexcept"
+
+namespace weEngine
+{
+	namespace
+	{
+		constexpr uint32_t RESOURCE_TYPE_COUNT = 2;
+		constexpr uint32_t MEMORY_USAGE_COUNT = 2;
+
+		const char* getUsageName(weEngineMemoryUsage usage)
+		{
+			return usage == weEngineMemoryUsage::TRANSIENT ? "transient" : "long-lived";
+		}
+	}
+
+	weEngineMemoryAllocator::weEngineMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : device{ device }
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+		pools.resize(static_cast<size_t>(memoryProperties.memoryTypeCount) * RESOURCE_TYPE_COUNT * MEMORY_USAGE_COUNT);
+		for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < memoryProperties.memoryTypeCount; memoryTypeIndex++)
+		{
+			const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			const VkDeviceSize blockSize = heapSize <= SMALL_HEAP_SIZE ? heapSize / 8 : BLOCK_SIZE;
+
+			for (uint32_t resourceType = 0; resourceType < RESOURCE_TYPE_COUNT; resourceType++)
+			{
+				getPool(memoryTypeIndex, static_cast<weEngineResourceType>(resourceType), weEngineMemoryUsage::LONG_LIVED).blockSize = blockSize;
+				getPool(memoryTypeIndex, static_cast<weEngineResourceType>(resourceType), weEngineMemoryUsage::TRANSIENT).blockSize = std::min(blockSize, TRANSIENT_BLOCK_SIZE);
+			}
+		}
+	}
+
+	/*
+	* Reports the allocations that were never freed and releases every block. Must run before the VkDevice is destroyed.
+	*/
+	weEngineMemoryAllocator::~weEngineMemoryAllocator()
+	{
+		printStatistics();
+		reportLeaks();
+
+		for (Pool& pool : pools)
+		{
+			for (std::unique_ptr<weEngineMemoryBlock>& block : pool.blocks)
+			{
+				freeDeviceMemory(block->memory, block->mappedData != nullptr);
+			}
+			pool.blocks.clear();
+		}
+	}
+
+	weEngineAllocation weEngineMemoryAllocator::allocate(
+		const VkMemoryRequirements& requirements,
+		uint32_t memoryTypeIndex,
+		weEngineResourceType resourceType,
+		weEngineMemoryUsage usage,
+		const char* name)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		Pool& pool = getPool(memoryTypeIndex, resourceType, usage);
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+		weEngineAllocation allocation{};
+		allocation.size = requirements.size;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+
+		if (requirements.size > pool.blockSize / 2)
+		{
+			allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mappedData);
+			if (allocation.memory == VK_NULL_HANDLE)
+			{
+				throw std::runtime_error("failed to allocate dedicated device memory!");
+			}
+
+			statistics.dedicatedAllocationCount++;
+			statistics.dedicatedBytes += requirements.size;
+		}
+		else
+		{
+			weEngineMemoryBlock* block = nullptr;
+			uint64_t offset = 0;
+			for (std::unique_ptr<weEngineMemoryBlock>& candidate : pool.blocks)
+			{
+				if (candidate->allocator->allocate(requirements.size, alignment, offset, allocation.handle))
+				{
+					block = candidate.get();
+					break;
+				}
+			}
+
+			if (block == nullptr)
+			{
+				std::unique_ptr<weEngineMemoryBlock> newBlock = createBlock(pool, requirements.size + alignment - 1, memoryTypeIndex, usage);
+				if (newBlock == nullptr || !newBlock->allocator->allocate(requirements.size, alignment, offset, allocation.handle))
+				{
+					throw std::runtime_error("failed to allocate device memory block!");
+				}
+
+				block = newBlock.get();
+				pool.blocks.push_back(std::move(newBlock));
+			}
+
+			allocation.memory = block->memory;
+			allocation.offset = offset;
+			allocation.block = block;
+			if (block->mappedData != nullptr)
+			{
+				allocation.mappedData = static_cast<uint8_t*>(block->mappedData) + offset;
+			}
+		}
+
+		allocation.id = nextAllocationId++;
+		liveAllocations.emplace(allocation.id, AllocationRecord{ name != nullptr ? name : "unnamed", requirements.size, memoryTypeIndex, resourceType, usage });
+
+		statistics.allocationCount++;
+		statistics.allocatedBytes += requirements.size;
+		statistics.peakAllocatedBytes = std::max(statistics.peakAllocatedBytes, statistics.allocatedBytes);
+		statistics.totalAllocationCount++;
+		return allocation;
+	}
+
+	/*
+	* Returns the allocation to its block. Empty blocks are released as long as their pool keeps at least one block.
+	*/
+	void weEngineMemoryAllocator::free(weEngineAllocation& allocation)
+	{
+		if (allocation.id == 0)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		const auto record = liveAllocations.find(allocation.id);
+		if (record == liveAllocations.end())
+		{
+			throw std::runtime_error("freeing device memory which was not allocated by this allocator!");
+		}
+
+		if (allocation.block == nullptr)
+		{
+			freeDeviceMemory(allocation.memory, allocation.mappedData != nullptr);
+			statistics.dedicatedAllocationCount--;
+			statistics.dedicatedBytes -= allocation.size;
+		}
+		else
+		{
+			allocation.block->allocator->free(allocation.handle);
+
+			Pool& pool = getPool(record->second.memoryTypeIndex, record->second.resourceType, record->second.usage);
+			if (allocation.block->allocator->isEmpty() && pool.blocks.size() > 1)
+			{
+				const auto block = std::find_if(pool.blocks.begin(), pool.blocks.end(),
+					[&allocation](const std::unique_ptr<weEngineMemoryBlock>& candidate) { return candidate.get() == allocation.block; });
+
+				statistics.blockCount--;
+				statistics.blockBytes -= (*block)->allocator->getSize();
+				freeDeviceMemory((*block)->memory, (*block)->mappedData != nullptr);
+				pool.blocks.erase(block);
+			}
+		}
+
+		statistics.allocationCount--;
+		statistics.allocatedBytes -= allocation.size;
+		liveAllocations.erase(record);
+		allocation = weEngineAllocation{};
+	}
+
+	weEngineMemoryAllocator::Statistics weEngineMemoryAllocator::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return statistics;
+	}
+
+	void weEngineMemoryAllocator::printStatistics() const
+	{
+		const Statistics current = getStatistics();
+		std::cout << "Device memory: " << current.allocationCount << " allocations (" << current.allocatedBytes / 1024 << " KiB)"
+			<< " in " << current.blockCount << " blocks (" << current.blockBytes / 1024 << " KiB)"
+			<< " and " << current.dedicatedAllocationCount << " dedicated allocations (" << current.dedicatedBytes / 1024 << " KiB)"
+			<< ", peak " << current.peakAllocatedBytes / 1024 << " KiB"
+			<< ", " << current.totalAllocationCount << " allocations served by " << current.totalDeviceAllocationCount << " vkAllocateMemory calls" << std::endl;
+	}
+
+	bool weEngineMemoryAllocator::reportLeaks() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (liveAllocations.empty())
+		{
+			return false;
+		}
+
+		//Sorted by id so the report follows the allocation order
+		std::vector<std::pair<uint64_t, const AllocationRecord*>> leaks;
+		for (const auto& allocation : liveAllocations)
+		{
+			leaks.emplace_back(allocation.first, &allocation.second);
+		}
+		std::sort(leaks.begin(), leaks.end());
+
+		std::cerr << "Device memory leak: " << leaks.size() << " allocations were not freed" << std::endl;
+		for (const auto& leak : leaks)
+		{
+			std::cerr << "  #" << leak.first << " " << leak.second->name << ": " << leak.second->size << " bytes"
+				<< ", memory type " << leak.second->memoryTypeIndex << ", " << getUsageName(leak.second->usage)
+				<< (leak.second->resourceType == weEngineResourceType::IMAGE ? " image" : " buffer") << std::endl;
+		}
+		return true;
+	}
+
+	weEngineMemoryAllocator::Pool& weEngineMemoryAllocator::getPool(uint32_t memoryTypeIndex, weEngineResourceType resourceType, weEngineMemoryUsage usage)
+	{
+		return pools[(memoryTypeIndex * RESOURCE_TYPE_COUNT + static_cast<uint32_t>(resourceType)) * MEMORY_USAGE_COUNT + static_cast<uint32_t>(usage)];
+	}
+
+	/*
+	* Calls vkAllocateMemory and maps the memory when it is host visible. Returns VK_NULL_HANDLE when the heap is out of memory.
+	*/
+	VkDeviceMemory weEngineMemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData)
+	{
+		if (deviceAllocationCount >= maxMemoryAllocationCount)
+		{
+			throw std::runtime_error("reached maxMemoryAllocationCount!");
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+
+		*mappedData = nullptr;
+		if (isHostVisible(memoryTypeIndex) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(device, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+
+		deviceAllocationCount++;
+		statistics.totalDeviceAllocationCount++;
+		return memory;
+	}
+
+	void weEngineMemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, bool mapped)
+	{
+		if (mapped)
+		{
+			vkUnmapMemory(device, memory);
+		}
+		vkFreeMemory(device, memory, nullptr);
+		deviceAllocationCount--;
+	}
+
+	/*
+	* Allocates a block of the pool size, halving it down to minimumSize while the heap cannot fit it
+	*/
+	std::unique_ptr<weEngineMemoryBlock> weEngineMemoryAllocator::createBlock(const Pool& pool, VkDeviceSize minimumSize, uint32_t memoryTypeIndex, weEngineMemoryUsage usage)
+	{
+		for (VkDeviceSize size = pool.blockSize; size >= minimumSize; size /= 2)
+		{
+			void* mappedData = nullptr;
+			const VkDeviceMemory memory = allocateDeviceMemory(size, memoryTypeIndex, &mappedData);
+			if (memory == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			std::unique_ptr<weEngineMemoryBlock> block = std::make_unique<weEngineMemoryBlock>();
+			block->memory = memory;
+			block->mappedData = mappedData;
+			if (usage == weEngineMemoryUsage::TRANSIENT)
+			{
+				block->allocator = std::make_unique<weEngineLinearAllocator>(size);
+			}
+			else
+			{
+				block->allocator = std::make_unique<weEngineTlsfAllocator>(size);
+			}
+
+			statistics.blockCount++;
+			statistics.blockBytes += size;
+			return block;
+		}
+
+		return nullptr;
+	}
+
+	bool weEngineMemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+	{
+		return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+}
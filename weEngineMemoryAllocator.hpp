@@ -0,0 +1,143 @@
+#pragma once
+
+/*
+* weEngineMemoryAllocator sub-allocates buffers and images from large VkDeviceMemory blocks instead of calling vkAllocateMemory
+* for every resource, which is slow and limited to maxMemoryAllocationCount allocations per device.
+*
+* Every memory type has its own pools of blocks. Long-lived resources are placed with a TLSF allocator, transient resources
+* (staging buffers) are bumped linearly through a block that is reused once all of its allocations are freed.
+* Buffers and images never share a block, so bufferImageGranularity never has to be considered.
+* Host visible blocks stay mapped for their whole lifetime.
+*/
+
+#include "weEngineBlockAllocator.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+//std
+#include "cstdint"
+#include "memory"
+#include "mutex"
+#include "string"
+#include "unordered_map"
+#include "vector"
+
+namespace weEngine
+{
+	enum class weEngineMemoryUsage : uint8_t
+	{
+		LONG_LIVED,
+		TRANSIENT,
+	};
+
+	enum class weEngineResourceType : uint8_t
+	{
+		BUFFER,
+		IMAGE,
+	};
+
+	struct weEngineMemoryBlock;
+
+	//Memory given to a single buffer or image. Pass it back to weEngineMemoryAllocator::free (or to weEngineDevice) to release it.
+	struct weEngineAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mappedData = nullptr; //Start of the allocation when its memory is host visible
+		uint32_t memoryTypeIndex = 0;
+
+		weEngineMemoryBlock* block = nullptr; //Null for dedicated allocations
+		uint32_t handle = 0;
+		uint64_t id = 0;
+	};
+
+	struct weEngineMemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mappedData = nullptr;
+		std::unique_ptr<weEngineBlockAllocator> allocator;
+	};
+
+	class weEngineMemoryAllocator
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t blockCount = 0;
+			VkDeviceSize blockBytes = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			VkDeviceSize dedicatedBytes = 0;
+			uint32_t allocationCount = 0; //Live allocations, in blocks or dedicated
+			VkDeviceSize allocatedBytes = 0;
+			VkDeviceSize peakAllocatedBytes = 0;
+			uint64_t totalAllocationCount = 0; //Allocations made since the allocator was created
+			uint64_t totalDeviceAllocationCount = 0; //Calls to vkAllocateMemory since the allocator was created
+		};
+
+		//Preferred size of new blocks, heaps of at most SMALL_HEAP_SIZE use an eighth of the heap instead
+		static constexpr VkDeviceSize BLOCK_SIZE = 64ull * 1024 * 1024;
+		static constexpr VkDeviceSize TRANSIENT_BLOCK_SIZE = 16ull * 1024 * 1024;
+		static constexpr VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+		weEngineMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+		~weEngineMemoryAllocator();
+
+		weEngineMemoryAllocator(const weEngineMemoryAllocator&) = delete;
+		weEngineMemoryAllocator& operator=(const weEngineMemoryAllocator&) = delete;
+
+		/*
+		* Allocates memory for a resource with the given requirements. Resources larger than half a block get a dedicated allocation.
+		* The name is only kept to identify the allocation in the leak report.
+		*/
+		weEngineAllocation allocate(
+			const VkMemoryRequirements& requirements,
+			uint32_t memoryTypeIndex,
+			weEngineResourceType resourceType,
+			weEngineMemoryUsage usage,
+			const char* name);
+		void free(weEngineAllocation& allocation);
+
+		Statistics getStatistics() const;
+		void printStatistics() const;
+
+		//Prints every allocation which has not been freed yet, returns false when there are none
+		bool reportLeaks() const;
+
+	private:
+		struct Pool
+		{
+			std::vector<std::unique_ptr<weEngineMemoryBlock>> blocks;
+			VkDeviceSize blockSize = 0;
+		};
+
+		//Identifies a live allocation in the leak report
+		struct AllocationRecord
+		{
+			std::string name;
+			VkDeviceSize size;
+			uint32_t memoryTypeIndex;
+			weEngineResourceType resourceType;
+			weEngineMemoryUsage usage;
+		};
+
+		Pool& getPool(uint32_t memoryTypeIndex, weEngineResourceType resourceType, weEngineMemoryUsage usage);
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+		void freeDeviceMemory(VkDeviceMemory memory, bool mapped);
+		std::unique_ptr<weEngineMemoryBlock> createBlock(const Pool& pool, VkDeviceSize minimumSize, uint32_t memoryTypeIndex, weEngineMemoryUsage usage);
+		bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		uint32_t maxMemoryAllocationCount;
+
+		std::vector<Pool> pools; //Indexed by memory type, resource type and usage
+		std::unordered_map<uint64_t, AllocationRecord> liveAllocations;
+		uint64_t nextAllocationId = 1;
+		uint32_t deviceAllocationCount = 0;
+		Statistics statistics{};
+
+		mutable std::mutex mutex;
+	};
+}
@@ -0,0 +1,342 @@
+#include "weEngineMeshCache.hpp"
+#include "weEngineUtils.hpp"
+
+//std
+#include "filesystem"
+#include "fstream"
+#include "iostream"
+#include "vector"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include "windows.h"
+#else
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "unistd.h"
+#endif
+
+/*
+* Implementation of the binary mesh cache. A cache file is considered stale when the size of the source model changed,
+* or when its modification time changed and the hash of its contents no longer matches.
+*/
+
+namespace weEngine
+{
+	weEngineMeshCache::weEngineMeshCache(const std::string& sourcePath, uint32_t settingsKey) :
+		sourcePath{ sourcePath }, cachePath{ sourcePath + EXTENSION }, settingsKey{ settingsKey }
+	{
+	}
+
+	weEngineMeshCache::~weEngineMeshCache()
+	{
+		unmapFile();
+	}
+
+	/*
+	* Maps the cache file of the source model. Returns false and reports the reason when the cache is missing or stale.
+	*/
+	bool weEngineMeshCache::load()
+	{
+		unmapFile();
+
+		if (!readSourceInfo())
+		{
+			return false;
+		}
+
+		std::string reason;
+		if (!readHeader(reason))
+		{
+			std::cout << "Mesh cache miss: " << cachePath << " (" << reason << ")" << std::endl;
+			return false;
+		}
+
+		if (!mapFile())
+		{
+			std::cout << "Mesh cache miss: " << cachePath << " (failed to map the cache file)" << std::endl;
+			return false;
+		}
+
+		std::cout << "Mesh cache hit: " << cachePath << " (" << header.vertexCount << " vertices, " << header.indexCount << " indices)" << std::endl;
+		return true;
+	}
+
+	/*
+	* Writes the builder data to the cache file. Writes to a temporary file first so an interrupted write never leaves a broken cache behind.
+	*/
+	void weEngineMeshCache::store(const weEngineModel::Builder& builder)
+	{
+		unmapFile();
+
+		if (!readSourceInfo())
+		{
+			return;
+		}
+
+		Header newHeader{};
+		newHeader.magic = MAGIC;
+		newHeader.version = VERSION;
+		newHeader.vertexStride = sizeof(weEngineModel::Vertex);
+		newHeader.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		newHeader.indexCount = static_cast<uint32_t>(builder.indices.size());
+		newHeader.lodStride = sizeof(weEngineModel::LodLevel);
+		newHeader.lodCount = static_cast<uint32_t>(builder.lods.size());
+		newHeader.rangeStride = sizeof(weEngineModel::DrawRange);
+		newHeader.rangeCount = static_cast<uint32_t>(builder.ranges.size());
+		newHeader.settingsKey = settingsKey;
+		newHeader.sourceSize = sourceSize;
+		newHeader.sourceWriteTime = sourceWriteTime;
+		newHeader.sourceHash = getSourceHash();
+
+		const std::string temporaryPath = cachePath + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cerr << "Failed to write mesh cache " << temporaryPath << std::endl;
+				return;
+			}
+
+			file.write(reinterpret_cast<const char*>(&newHeader), sizeof(newHeader));
+			file.write(reinterpret_cast<const char*>(builder.vertices.data()), sizeof(weEngineModel::Vertex) * builder.vertices.size());
+			file.write(reinterpret_cast<const char*>(builder.indices.data()), sizeof(uint32_t) * builder.indices.size());
+			file.write(reinterpret_cast<const char*>(builder.lods.data()), sizeof(weEngineModel::LodLevel) * builder.lods.size());
+			file.write(reinterpret_cast<const char*>(builder.ranges.data()), sizeof(weEngineModel::DrawRange) * builder.ranges.size());
+
+			if (!file.good())
+			{
+				std::cerr << "Failed to write mesh cache " << temporaryPath << std::endl;
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, cachePath, error);
+		if (error)
+		{
+			std::cerr << "Failed to write mesh cache " << cachePath << ": " << error.message() << std::endl;
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+
+		header = newHeader;
+		std::cout << "Mesh cache written: " << cachePath << std::endl;
+	}
+
+	/*
+	* Returns a view of the mapped mesh, only valid while the cache stays mapped
+	*/
+	weEngineModel::MeshData weEngineMeshCache::getMeshData() const
+	{
+		weEngineModel::MeshData meshData{};
+		meshData.vertices = getVertices();
+		meshData.vertexCount = header.vertexCount;
+		meshData.indices = getIndices();
+		meshData.indexCount = header.indexCount;
+		meshData.lods = getLods();
+		meshData.lodCount = header.lodCount;
+		meshData.ranges = getRanges();
+		meshData.rangeCount = header.rangeCount;
+		return meshData;
+	}
+
+	/*
+	* Reads the size and the last modification time of the source model
+	*/
+	bool weEngineMeshCache::readSourceInfo()
+	{
+		std::error_code error;
+		const auto size = std::filesystem::file_size(sourcePath, error);
+		if (error)
+		{
+			return false;
+		}
+
+		const auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+		if (error)
+		{
+			return false;
+		}
+
+		sourceSize = static_cast<uint64_t>(size);
+		sourceWriteTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return true;
+	}
+
+	/*
+	* Hashes the contents of the source model. The hash is only computed once per cache object.
+	*/
+	uint64_t weEngineMeshCache::getSourceHash()
+	{
+		if (hasSourceHash)
+		{
+			return sourceHash;
+		}
+
+		std::ifstream file(sourcePath, std::ios::binary);
+		std::vector<char> contents(static_cast<size_t>(sourceSize));
+		file.read(contents.data(), contents.size());
+
+		sourceHash = hashBytes(contents.data(), static_cast<size_t>(file.gcount()));
+		hasSourceHash = true;
+		return sourceHash;
+	}
+
+	/*
+	* Reads and validates the header of the cache file against the source model
+	*/
+	bool weEngineMeshCache::readHeader(std::string& reason)
+	{
+		std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			reason = "no cache file";
+			return false;
+		}
+
+		const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+		if (fileSize < sizeof(Header) || !file.read(reinterpret_cast<char*>(&header), sizeof(Header)))
+		{
+			reason = "truncated header";
+			return false;
+		}
+
+		if (header.magic != MAGIC || header.version != VERSION ||
+			header.vertexStride != sizeof(weEngineModel::Vertex) || header.lodStride != sizeof(weEngineModel::LodLevel) ||
+			header.rangeStride != sizeof(weEngineModel::DrawRange))
+		{
+			reason = "outdated cache version";
+			return false;
+		}
+
+		if (header.settingsKey != settingsKey)
+		{
+			reason = "load settings changed";
+			return false;
+		}
+
+		if (fileSize != getPayloadSize())
+		{
+			reason = "truncated payload";
+			return false;
+		}
+
+		if (header.sourceSize != sourceSize)
+		{
+			reason = "source size changed";
+			return false;
+		}
+
+		if (header.sourceWriteTime != sourceWriteTime)
+		{
+			if (header.sourceHash != getSourceHash())
+			{
+				reason = "source contents changed";
+				return false;
+			}
+
+			//Only the modification time changed, keep the cache and skip hashing on the next load
+			file.close();
+			header.sourceWriteTime = sourceWriteTime;
+			rewriteHeader();
+		}
+
+		return true;
+	}
+
+	void weEngineMeshCache::rewriteHeader()
+	{
+		std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		if (file.is_open())
+		{
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		}
+	}
+
+	/*
+	* Size of the whole cache file described by the header
+	*/
+	uint64_t weEngineMeshCache::getPayloadSize() const
+	{
+		return sizeof(Header) +
+			static_cast<uint64_t>(header.vertexCount) * sizeof(weEngineModel::Vertex) +
+			static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t) +
+			static_cast<uint64_t>(header.lodCount) * sizeof(weEngineModel::LodLevel) +
+			static_cast<uint64_t>(header.rangeCount) * sizeof(weEngineModel::DrawRange);
+	}
+
+	/*
+	* Maps the whole cache file as read only memory
+	*/
+	bool weEngineMeshCache::mapFile()
+	{
+		mappedSize = static_cast<size_t>(getPayloadSize());
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, mappedSize);
+		if (view == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		fileHandle = file;
+		mappingHandle = mapping;
+		mappedData = static_cast<const uint8_t*>(view);
+#else
+		int file = open(cachePath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		void* view = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+
+		madvise(view, mappedSize, MADV_SEQUENTIAL);
+		mappedData = static_cast<const uint8_t*>(view);
+#endif
+		return true;
+	}
+
+	void weEngineMeshCache::unmapFile()
+	{
+		if (mappedData == nullptr)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(mappedData);
+		CloseHandle(static_cast<HANDLE>(mappingHandle));
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+		munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+#endif
+		mappedData = nullptr;
+		mappedSize = 0;
+		fileHandle = nullptr;
+		mappingHandle = nullptr;
+	}
+}
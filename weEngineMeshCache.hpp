@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+* weEngineMeshCache stores the deduplicated vertices and indices of a model inside a binary file next to the source model.
+* The file is memory-mapped on later loads so the model can be uploaded without parsing the .obj file again.
+*/
+
+#include "weEngineModel.hpp"
+
+//std
+#include "cstdint"
+#include "string"
+
+namespace weEngine
+{
+	class weEngineMeshCache
+	{
+	public:
+		static constexpr uint32_t MAGIC = 0x434D4557; // "WEMC"
+		static constexpr uint32_t VERSION = 4; // Increment whenever the layout of the file or the loader output changes
+		static constexpr const char* EXTENSION = ".wemesh";
+
+		//Header at the start of every cache file. The vertices, the indices, the detail levels and the draw ranges directly follow it.
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexStride;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t lodStride;
+			uint32_t lodCount;
+			uint32_t rangeStride;
+			uint32_t rangeCount;
+			uint32_t settingsKey;
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+			uint64_t sourceHash;
+		};
+
+		weEngineMeshCache(const std::string& sourcePath, uint32_t settingsKey);
+		~weEngineMeshCache();
+
+		weEngineMeshCache(const weEngineMeshCache&) = delete;
+		weEngineMeshCache& operator=(const weEngineMeshCache&) = delete;
+
+		bool load();
+		void store(const weEngineModel::Builder& builder);
+
+		const weEngineModel::Vertex* getVertices() const
+		{
+			return reinterpret_cast<const weEngineModel::Vertex*>(mappedData + sizeof(Header));
+		}
+
+		uint32_t getVertexCount() const
+		{
+			return header.vertexCount;
+		}
+
+		const uint32_t* getIndices() const
+		{
+			return reinterpret_cast<const uint32_t*>(mappedData + sizeof(Header) + sizeof(weEngineModel::Vertex) * header.vertexCount);
+		}
+
+		uint32_t getIndexCount() const
+		{
+			return header.indexCount;
+		}
+
+		const weEngineModel::LodLevel* getLods() const
+		{
+			return reinterpret_cast<const weEngineModel::LodLevel*>(getIndices() + header.indexCount);
+		}
+
+		uint32_t getLodCount() const
+		{
+			return header.lodCount;
+		}
+
+		const weEngineModel::DrawRange* getRanges() const
+		{
+			return reinterpret_cast<const weEngineModel::DrawRange*>(getLods() + header.lodCount);
+		}
+
+		uint32_t getRangeCount() const
+		{
+			return header.rangeCount;
+		}
+
+		weEngineModel::MeshData getMeshData() const;
+
+		const std::string& getCachePath() const
+		{
+			return cachePath;
+		}
+
+	private:
+		bool readSourceInfo();
+		uint64_t getSourceHash();
+		bool readHeader(std::string& reason);
+		void rewriteHeader();
+		uint64_t getPayloadSize() const;
+		bool mapFile();
+		void unmapFile();
+
+		std::string sourcePath;
+		std::string cachePath;
+		uint32_t settingsKey;
+
+		uint64_t sourceSize = 0;
+		int64_t sourceWriteTime = 0;
+		uint64_t sourceHash = 0;
+		bool hasSourceHash = false;
+
+		Header header{};
+		const uint8_t* mappedData = nullptr;
+		size_t mappedSize = 0;
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+	};
+}
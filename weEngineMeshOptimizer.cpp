@@ -0,0 +1,550 @@
+#include "weEngineMeshOptimizer.hpp"
+
+//std
+#include "algorithm"
+#include "iomanip"
+#include "iostream"
+#include "numeric"
+
+/*
+* Implementation of the mesh optimizer. The vertex cache optimization follows "Fast Triangle Reordering for Vertex Locality
+* and Reduced Overdraw" (Sander, Nehab, Barczak 2007).
+*/
+
+namespace weEngine
+{
+	/*
+	* Runs the enabled optimization steps on the builder and reports the cache statistics of the full resolution level before and after.
+	* The triangles of every detail level are reordered separately, the vertices are ordered by their first use across all levels.
+	*/
+	void weEngineMeshOptimizer::optimize(weEngineModel::Builder& builder, const weEngineModel::LoadSettings& settings, const std::string& name)
+	{
+		if (builder.indices.empty() || (!settings.optimizeVertexCache && !settings.optimizeVertexFetch))
+		{
+			return;
+		}
+
+		std::vector<weEngineModel::LodLevel> lods = builder.lods;
+		if (lods.empty())
+		{
+			lods.push_back({ 0, static_cast<uint32_t>(builder.indices.size()), 0.0f, 0, 0 });
+		}
+
+		auto getLodIndices = [&builder](const weEngineModel::LodLevel& lod)
+		{
+			return std::vector<uint32_t>(builder.indices.begin() + lod.firstIndex, builder.indices.begin() + lod.firstIndex + lod.indexCount);
+		};
+
+		const CacheStatistics before = analyzeVertexCache(getLodIndices(lods[0]), builder.vertices.size(), settings.vertexCacheSize);
+
+		if (settings.optimizeVertexCache)
+		{
+			for (const weEngineModel::LodLevel& lod : lods)
+			{
+				std::vector<uint32_t> lodIndices = getLodIndices(lod);
+				std::vector<uint32_t> clusterStarts;
+				optimizeVertexCache(lodIndices, builder.vertices.size(), settings.vertexCacheSize, &clusterStarts);
+
+				if (settings.optimizeOverdraw)
+				{
+					optimizeOverdraw(lodIndices, builder.vertices, clusterStarts, settings.vertexCacheSize, settings.overdrawThreshold);
+				}
+
+				std::copy(lodIndices.begin(), lodIndices.end(), builder.indices.begin() + lod.firstIndex);
+			}
+		}
+
+		if (settings.optimizeVertexFetch)
+		{
+			//Coarser levels go first so every level uses a prefix of the vertices, which lets the coarse levels keep 16 bit indices
+			std::vector<uint32_t> fetchOrder;
+			fetchOrder.reserve(builder.indices.size());
+			for (auto lod = lods.rbegin(); lod != lods.rend(); ++lod)
+			{
+				fetchOrder.insert(fetchOrder.end(), builder.indices.begin() + lod->firstIndex, builder.indices.begin() + lod->firstIndex + lod->indexCount);
+			}
+
+			optimizeVertexFetch(builder.vertices, fetchOrder);
+
+			size_t fetchOffset = 0;
+			for (auto lod = lods.rbegin(); lod != lods.rend(); ++lod)
+			{
+				std::copy(fetchOrder.begin() + fetchOffset, fetchOrder.begin() + fetchOffset + lod->indexCount, builder.indices.begin() + lod->firstIndex);
+				fetchOffset += lod->indexCount;
+			}
+		}
+
+		const CacheStatistics after = analyzeVertexCache(getLodIndices(lods[0]), builder.vertices.size(), settings.vertexCacheSize);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "Mesh optimizer: " << name
+			<< " ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr
+			<< " (FIFO cache of " << settings.vertexCacheSize << ")" << std::endl;
+		std::cout.unsetf(std::ios::floatfield);
+	}
+
+	/*
+	* Simulates a FIFO post-transform cache of cacheSize entries over the index buffer
+	*/
+	weEngineMeshOptimizer::CacheStatistics weEngineMeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		CacheStatistics statistics{};
+		if (indices.empty())
+		{
+			return statistics;
+		}
+
+		//A vertex is in the cache while fewer than cacheSize misses happened since it was last loaded
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+		size_t misses = 0;
+		size_t referencedVertices = 0;
+
+		for (uint32_t index : indices)
+		{
+			if (cacheTimestamps[index] == 0)
+			{
+				referencedVertices++;
+			}
+
+			if (timestamp - cacheTimestamps[index] > cacheSize)
+			{
+				cacheTimestamps[index] = timestamp++;
+				misses++;
+			}
+		}
+
+		statistics.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		statistics.atvr = static_cast<float>(misses) / static_cast<float>(referencedVertices);
+		return statistics;
+	}
+
+	/*
+	* Reorders the triangles with Tipsify. The triangles around a fanning vertex are emitted together, the next fanning vertex
+	* is the neighbour that is still in the cache and will stay there the longest. When no neighbour qualifies the search restarts
+	* from a recently used vertex; the triangle offsets where this happens are returned in clusterStarts.
+	*/
+	void weEngineMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* clusterStarts)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		//Triangles around every vertex
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t index : indices)
+		{
+			adjacencyOffsets[index + 1]++;
+		}
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+		}
+
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEndStack;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		if (clusterStarts != nullptr)
+		{
+			clusterStarts->clear();
+		}
+
+		uint32_t timestamp = cacheSize + 1;
+		uint32_t cursor = 0;
+
+		//Finds the next vertex that still has triangles left, first among the recently emitted ones then in input order
+		auto skipDeadEnd = [&]() -> int64_t
+		{
+			while (!deadEndStack.empty())
+			{
+				const uint32_t vertex = deadEndStack.back();
+				deadEndStack.pop_back();
+				if (liveTriangles[vertex] > 0)
+				{
+					return vertex;
+				}
+			}
+
+			while (cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					return cursor;
+				}
+				cursor++;
+			}
+
+			return -1;
+		};
+
+		int64_t fanningVertex = skipDeadEnd();
+		bool startsCluster = true;
+		while (fanningVertex >= 0)
+		{
+			if (startsCluster && clusterStarts != nullptr)
+			{
+				clusterStarts->push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+
+			candidates.clear();
+			for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++)
+			{
+				const uint32_t triangle = adjacency[i];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					deadEndStack.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+
+					if (timestamp - cacheTimestamps[vertex] > cacheSize)
+					{
+						cacheTimestamps[vertex] = timestamp++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			//Prefer the candidate that entered the cache first, as long as all its triangles fit before it is evicted
+			int64_t bestVertex = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0)
+				{
+					continue;
+				}
+
+				int64_t priority = 0;
+				if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+				{
+					priority = timestamp - cacheTimestamps[vertex];
+				}
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					bestVertex = vertex;
+				}
+			}
+
+			startsCluster = bestVertex < 0;
+			fanningVertex = startsCluster ? skipDeadEnd() : bestVertex;
+		}
+
+		indices.swap(output);
+	}
+
+	/*
+	* Splits the clusters produced by the vertex cache optimization further, as long as the pieces keep a cache efficiency close to
+	* the whole cluster (threshold), then sorts the pieces so the ones facing away from the center of the mesh are drawn first.
+	* Triangles drawn first are then more likely to occlude the ones drawn after them from any view direction.
+	*/
+	void weEngineMeshOptimizer::optimizeOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<weEngineModel::Vertex>& vertices,
+		const std::vector<uint32_t>& hardClusterStarts,
+		uint32_t cacheSize,
+		float threshold)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0 || hardClusterStarts.empty())
+		{
+			return;
+		}
+
+		std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+		uint32_t timestamp = cacheSize + 1;
+
+		auto countMisses = [&](uint32_t triangle)
+		{
+			uint32_t misses = 0;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				if (timestamp - cacheTimestamps[vertex] > cacheSize)
+				{
+					cacheTimestamps[vertex] = timestamp++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+
+		auto flushCache = [&]()
+		{
+			timestamp += cacheSize + 1;
+		};
+
+		//Soft boundaries inside every hard cluster
+		std::vector<uint32_t> clusterStarts;
+		for (size_t cluster = 0; cluster < hardClusterStarts.size(); cluster++)
+		{
+			const uint32_t start = hardClusterStarts[cluster];
+			const uint32_t end = cluster + 1 < hardClusterStarts.size() ? hardClusterStarts[cluster + 1] : triangleCount;
+
+			flushCache();
+			uint32_t clusterMisses = 0;
+			for (uint32_t triangle = start; triangle < end; triangle++)
+			{
+				clusterMisses += countMisses(triangle);
+			}
+			const float clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+			flushCache();
+			clusterStarts.push_back(start);
+			uint32_t pieceStart = start;
+			uint32_t pieceMisses = 0;
+			for (uint32_t triangle = start; triangle < end; triangle++)
+			{
+				pieceMisses += countMisses(triangle);
+
+				const float pieceAcmr = static_cast<float>(pieceMisses) / static_cast<float>(triangle - pieceStart + 1);
+				if (triangle + 1 < end && pieceAcmr <= threshold * clusterAcmr)
+				{
+					clusterStarts.push_back(triangle + 1);
+					pieceStart = triangle + 1;
+					pieceMisses = 0;
+					flushCache();
+				}
+			}
+		}
+
+		//Area weighted centroid of the whole mesh
+		glm::vec3 meshCentroid{ 0.0f };
+		float meshArea = 0.0f;
+		std::vector<glm::vec3> triangleCentroids(triangleCount);
+		std::vector<glm::vec3> triangleNormals(triangleCount);
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			const glm::vec3& a = vertices[indices[triangle * 3 + 0]].position;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].position;
+
+			triangleNormals[triangle] = glm::cross(b - a, c - a); //length is twice the area
+			triangleCentroids[triangle] = (a + b + c) / 3.0f;
+
+			const float area = glm::length(triangleNormals[triangle]);
+			meshCentroid += triangleCentroids[triangle] * area;
+			meshArea += area;
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3{ 0.0f };
+
+		struct ClusterKey
+		{
+			float sortKey;
+			uint32_t start;
+			uint32_t end;
+		};
+
+		std::vector<ClusterKey> clusters(clusterStarts.size());
+		for (size_t cluster = 0; cluster < clusterStarts.size(); cluster++)
+		{
+			const uint32_t start = clusterStarts[cluster];
+			const uint32_t end = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : triangleCount;
+
+			glm::vec3 centroid{ 0.0f };
+			glm::vec3 normal{ 0.0f };
+			float area = 0.0f;
+			for (uint32_t triangle = start; triangle < end; triangle++)
+			{
+				const float triangleArea = glm::length(triangleNormals[triangle]);
+				centroid += triangleCentroids[triangle] * triangleArea;
+				normal += triangleNormals[triangle];
+				area += triangleArea;
+			}
+
+			const float normalLength = glm::length(normal);
+			centroid = area > 0.0f ? centroid / area : centroid;
+			normal = normalLength > 0.0f ? normal / normalLength : normal;
+
+			clusters[cluster] = { glm::dot(centroid - meshCentroid, normal), start, end };
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterKey& a, const ClusterKey& b)
+		{
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		for (const ClusterKey& cluster : clusters)
+		{
+			output.insert(output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+		}
+		indices.swap(output);
+	}
+
+	/*
+	* Moves the vertices in the order of their first use by the index buffer. Vertices no triangle uses are dropped.
+	*/
+	void weEngineMeshOptimizer::optimizeVertexFetch(std::vector<weEngineModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t UNUSED = ~0u;
+
+		std::vector<uint32_t> remap(vertices.size(), UNUSED);
+		std::vector<weEngineModel::Vertex> output;
+		output.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UNUSED)
+			{
+				remap[index] = static_cast<uint32_t>(output.size());
+				output.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(output);
+	}
+
+	/*
+	* Splits the detail levels that use too many vertices for 16 bit indices into sub-meshes. The triangles of such a level are
+	* grouped in order until a group reaches maxRangeVertexCount vertices, and every group gets its own copy of its vertices so its
+	* indices can be made relative to the start of the copy. Levels that already fit are drawn as one range.
+	* Since optimize orders the vertices by the coarsest level using them, the coarse levels fit without copies.
+	* Leaves the builder untouched and returns false when the copies would cost more memory than 32 bit indices.
+	*/
+	bool weEngineMeshOptimizer::splitDrawRanges(weEngineModel::Builder& builder, uint32_t maxRangeVertexCount)
+	{
+		constexpr uint32_t UNUSED = ~0u;
+
+		std::vector<weEngineModel::LodLevel> lods = builder.lods;
+		if (lods.empty())
+		{
+			lods.push_back({ 0, static_cast<uint32_t>(builder.indices.size()), 0.0f, 0, 0 });
+		}
+
+		const uint32_t sourceVertexCount = static_cast<uint32_t>(builder.vertices.size());
+		std::vector<weEngineModel::Vertex> vertices = builder.vertices;
+		std::vector<uint32_t> indices = builder.indices;
+		std::vector<weEngineModel::DrawRange> ranges;
+
+		//Slot of every source vertex inside the current group, valid when its group stamp matches
+		std::vector<uint32_t> groupSlots(sourceVertexCount, UNUSED);
+		std::vector<uint32_t> groupStamps(sourceVertexCount, UNUSED);
+		uint32_t groupStamp = 0;
+
+		for (weEngineModel::LodLevel& lod : lods)
+		{
+			lod.firstRange = static_cast<uint32_t>(ranges.size());
+			const uint32_t lodEnd = lod.firstIndex + lod.indexCount;
+
+			const uint32_t maxIndex = lod.indexCount > 0 ? *std::max_element(indices.begin() + lod.firstIndex, indices.begin() + lodEnd) : 0;
+			if (maxIndex < maxRangeVertexCount)
+			{
+				ranges.push_back({ lod.firstIndex, lod.indexCount, 0 });
+				lod.rangeCount = 1;
+				continue;
+			}
+
+			uint32_t groupStart = lod.firstIndex;
+			uint32_t groupVertexStart = static_cast<uint32_t>(vertices.size());
+			for (uint32_t i = lod.firstIndex; i < lodEnd; i += 3)
+			{
+				uint32_t newVertexCount = 0;
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					newVertexCount += groupStamps[indices[i + corner]] != groupStamp ? 1 : 0;
+				}
+
+				if (static_cast<uint32_t>(vertices.size()) - groupVertexStart + newVertexCount > maxRangeVertexCount)
+				{
+					ranges.push_back({ groupStart, i - groupStart, static_cast<int32_t>(groupVertexStart) });
+					groupStart = i;
+					groupVertexStart = static_cast<uint32_t>(vertices.size());
+					groupStamp++;
+				}
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t vertex = indices[i + corner];
+					if (groupStamps[vertex] != groupStamp)
+					{
+						groupStamps[vertex] = groupStamp;
+						groupSlots[vertex] = static_cast<uint32_t>(vertices.size()) - groupVertexStart;
+						vertices.push_back(builder.vertices[vertex]);
+					}
+					indices[i + corner] = groupSlots[vertex];
+				}
+			}
+
+			ranges.push_back({ groupStart, lodEnd - groupStart, static_cast<int32_t>(groupVertexStart) });
+			groupStamp++;
+			lod.rangeCount = static_cast<uint32_t>(ranges.size()) - lod.firstRange;
+		}
+
+		//Drop the source vertices only the split levels used, and move every range by the vertices dropped before it
+		std::vector<bool> used(vertices.size(), false);
+		for (const weEngineModel::DrawRange& range : ranges)
+		{
+			for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+			{
+				used[indices[i] + range.vertexOffset] = true;
+			}
+		}
+
+		std::vector<uint32_t> usedBefore(vertices.size() + 1, 0);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			usedBefore[i + 1] = usedBefore[i] + (used[i] ? 1 : 0);
+		}
+
+		const uint64_t splitSize = static_cast<uint64_t>(weEngineModel::VertexLayout::STRIDE) * usedBefore.back() + sizeof(uint16_t) * indices.size();
+		const uint64_t sourceSize = static_cast<uint64_t>(weEngineModel::VertexLayout::STRIDE) * sourceVertexCount + sizeof(uint32_t) * indices.size();
+		if (splitSize >= sourceSize)
+		{
+			return false;
+		}
+
+		for (weEngineModel::DrawRange& range : ranges)
+		{
+			const uint32_t newOffset = usedBefore[range.vertexOffset];
+			for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+			{
+				indices[i] = usedBefore[indices[i] + range.vertexOffset] - newOffset;
+			}
+			range.vertexOffset = static_cast<int32_t>(newOffset);
+		}
+
+		size_t writeOffset = 0;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (used[i])
+			{
+				vertices[writeOffset++] = vertices[i];
+			}
+		}
+		vertices.resize(writeOffset);
+
+		builder.vertices = std::move(vertices);
+		builder.indices = std::move(indices);
+		builder.lods = std::move(lods);
+		builder.ranges = std::move(ranges);
+		return true;
+	}
+}
\ No newline at end of file
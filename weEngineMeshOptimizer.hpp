@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+* weEngineMeshOptimizer reorders the triangles and vertices of a loaded model before it is uploaded to the GPU.
+* The triangles are reordered for the post-transform vertex cache (Tipsify), optionally clustered to reduce overdraw,
+* and the vertices are placed in the order they are first used so vertex fetches stay close in memory.
+*/
+
+#include "weEngineModel.hpp"
+
+//std
+#include "cstdint"
+#include "string"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineMeshOptimizer
+	{
+	public:
+		//Average cache miss ratio (misses per triangle) and average transform to vertex ratio (misses per referenced vertex)
+		struct CacheStatistics
+		{
+			float acmr = 0.0f;
+			float atvr = 0.0f;
+		};
+
+		static void optimize(weEngineModel::Builder& builder, const weEngineModel::LoadSettings& settings, const std::string& name);
+
+		static CacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+		static void optimizeVertexCache(
+			std::vector<uint32_t>& indices,
+			size_t vertexCount,
+			uint32_t cacheSize,
+			std::vector<uint32_t>* clusterStarts = nullptr);
+
+		static void optimizeOverdraw(
+			std::vector<uint32_t>& indices,
+			const std::vector<weEngineModel::Vertex>& vertices,
+			const std::vector<uint32_t>& hardClusterStarts,
+			uint32_t cacheSize,
+			float threshold);
+
+		static void optimizeVertexFetch(std::vector<weEngineModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		static bool splitDrawRanges(weEngineModel::Builder& builder, uint32_t maxRangeVertexCount);
+	};
+}
@@ -0,0 +1,620 @@
+#include "weEngineMeshSimplifier.hpp"
+
+//std
+#include "algorithm"
+#include "cmath"
+#include "iostream"
+#include "numeric"
+
+/*
+* Implementation of the mesh simplifier. Collapses are done in passes: every pass ranks all the edges of the current mesh by
+* their quadric error, then performs the cheapest ones that don't touch a position already moved in the same pass.
+*/
+
+namespace weEngine
+{
+	//Edges on open borders weigh more than the faces around them so the silhouette of the border is kept
+	static constexpr double BORDER_WEIGHT = 10.0;
+
+	//A collapse is rejected when it rotates the normal of a neighbouring triangle by more than ~75 degrees
+	static constexpr float MIN_NORMAL_COSINE = 0.25f;
+
+	void weEngineMeshSimplifier::Quadric::addPlane(const glm::dvec3& normal, double distance, double planeWeight)
+	{
+		a00 += planeWeight * normal.x * normal.x;
+		a11 += planeWeight * normal.y * normal.y;
+		a22 += planeWeight * normal.z * normal.z;
+		a01 += planeWeight * normal.x * normal.y;
+		a02 += planeWeight * normal.x * normal.z;
+		a12 += planeWeight * normal.y * normal.z;
+		b0 += planeWeight * normal.x * distance;
+		b1 += planeWeight * normal.y * distance;
+		b2 += planeWeight * normal.z * distance;
+		c += planeWeight * distance * distance;
+		weight += planeWeight;
+	}
+
+	void weEngineMeshSimplifier::Quadric::add(const Quadric& other)
+	{
+		a00 += other.a00;
+		a11 += other.a11;
+		a22 += other.a22;
+		a01 += other.a01;
+		a02 += other.a02;
+		a12 += other.a12;
+		b0 += other.b0;
+		b1 += other.b1;
+		b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	/*
+	* Returns the weighted average of the squared distances between the position and the planes of the quadric
+	*/
+	double weEngineMeshSimplifier::Quadric::evaluate(const glm::vec3& position) const
+	{
+		if (weight <= 0.0)
+		{
+			return 0.0;
+		}
+
+		const double x = position.x;
+		const double y = position.y;
+		const double z = position.z;
+		const double result =
+			a00 * x * x + a11 * y * y + a22 * z * z +
+			2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+			2.0 * (b0 * x + b1 * y + b2 * z) +
+			c;
+
+		return std::max(result, 0.0) / weight;
+	}
+
+	weEngineMeshSimplifier::weEngineMeshSimplifier(const std::vector<weEngineModel::Vertex>& vertices, const std::vector<uint32_t>& indices) :
+		vertices{ vertices }, indices{ indices }
+	{
+		buildPositionRemap();
+		buildEdges();
+		classifyVertices();
+		buildQuadrics();
+	}
+
+	float weEngineMeshSimplifier::simplify(size_t targetIndexCount, float errorLimit)
+	{
+		const double errorLimitSquared = static_cast<double>(errorLimit) * static_cast<double>(errorLimit);
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> collapseRemap(vertices.size());
+
+		while (indices.size() > targetIndexCount)
+		{
+			buildTriangleAdjacency();
+
+			collapses.clear();
+			rankCollapses(collapses);
+			if (collapses.empty())
+			{
+				break;
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.error < b.error;
+			});
+
+			std::iota(collapseRemap.begin(), collapseRemap.end(), 0u);
+
+			const size_t triangleGoal = std::max<size_t>((indices.size() - targetIndexCount) / 3, 1);
+			if (performCollapses(collapses, triangleGoal, errorLimitSquared, collapseRemap) == 0)
+			{
+				break;
+			}
+
+			applyCollapses(collapseRemap);
+		}
+
+		return getError();
+	}
+
+	float weEngineMeshSimplifier::getError() const
+	{
+		return static_cast<float>(std::sqrt(maxErrorSquared));
+	}
+
+	/*
+	* Builds the detail levels of the builder mesh. Each level targets lodIndexRatio of the indices of the previous level and
+	* continues simplifying from it, so the reported error of a level includes the error of the levels before it.
+	* Stops early when the error would exceed lodMaxError (relative to the radius of the mesh) or when a level barely shrinks.
+	*/
+	void weEngineMeshSimplifier::generateLods(weEngineModel::Builder& builder, const weEngineModel::LoadSettings& settings, const std::string& name)
+	{
+		builder.lods.clear();
+		builder.lods.push_back({ 0, static_cast<uint32_t>(builder.indices.size()), 0.0f, 0, 0 });
+
+		if (settings.lodLevelCount <= 1 || builder.indices.empty())
+		{
+			return;
+		}
+
+		glm::vec3 minimum = builder.vertices[0].position;
+		glm::vec3 maximum = builder.vertices[0].position;
+		for (const weEngineModel::Vertex& vertex : builder.vertices)
+		{
+			minimum = glm::min(minimum, vertex.position);
+			maximum = glm::max(maximum, vertex.position);
+		}
+		const float radius = 0.5f * glm::length(maximum - minimum);
+
+		weEngineMeshSimplifier simplifier{ builder.vertices, builder.indices };
+		while (builder.lods.size() < settings.lodLevelCount)
+		{
+			const uint32_t previousCount = builder.lods.back().indexCount;
+			const size_t targetCount = static_cast<size_t>(previousCount * settings.lodIndexRatio) / 3 * 3;
+
+			const float error = simplifier.simplify(targetCount, settings.lodMaxError * radius);
+			const std::vector<uint32_t>& lodIndices = simplifier.getIndices();
+			if (lodIndices.empty() || lodIndices.size() * 10 > static_cast<size_t>(previousCount) * 9)
+			{
+				break;
+			}
+
+			builder.lods.push_back({ static_cast<uint32_t>(builder.indices.size()), static_cast<uint32_t>(lodIndices.size()), error, 0, 0 });
+			builder.indices.insert(builder.indices.end(), lodIndices.begin(), lodIndices.end());
+		}
+
+		std::cout << "Mesh LOD: " << name << " " << builder.lods.size() << " levels (";
+		for (size_t i = 0; i < builder.lods.size(); i++)
+		{
+			std::cout << (i > 0 ? ", " : "") << builder.lods[i].indexCount / 3;
+		}
+		std::cout << " triangles), max error " << builder.lods.back().error << std::endl;
+	}
+
+	/*
+	* Groups the vertices by position. Every vertex points to the first vertex of its group, and the vertices of a group are linked in a ring.
+	*/
+	void weEngineMeshSimplifier::buildPositionRemap()
+	{
+		const size_t vertexCount = vertices.size();
+
+		std::vector<uint32_t> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = vertices[a].position;
+			const glm::vec3& pb = vertices[b].position;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		});
+
+		positionRemap.resize(vertexCount);
+		wedges.resize(vertexCount);
+
+		for (size_t groupBegin = 0; groupBegin < vertexCount;)
+		{
+			size_t groupEnd = groupBegin + 1;
+			while (groupEnd < vertexCount && vertices[order[groupEnd]].position == vertices[order[groupBegin]].position)
+			{
+				groupEnd++;
+			}
+
+			for (size_t i = groupBegin; i < groupEnd; i++)
+			{
+				positionRemap[order[i]] = order[groupBegin];
+				wedges[order[i]] = order[i + 1 < groupEnd ? i + 1 : groupBegin];
+			}
+			groupBegin = groupEnd;
+		}
+	}
+
+	/*
+	* Lists the outgoing half edges of every vertex of the original mesh
+	*/
+	void weEngineMeshSimplifier::buildEdges()
+	{
+		edgeOffsets.assign(vertices.size() + 1, 0);
+		for (uint32_t index : indices)
+		{
+			edgeOffsets[index + 1]++;
+		}
+		std::partial_sum(edgeOffsets.begin(), edgeOffsets.end(), edgeOffsets.begin());
+
+		edgeTargets.resize(indices.size());
+		std::vector<uint32_t> fillOffsets(edgeOffsets.begin(), edgeOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t from = indices[i + corner];
+				const uint32_t to = indices[i + (corner + 1) % 3];
+				edgeTargets[fillOffsets[from]++] = to;
+			}
+		}
+	}
+
+	bool weEngineMeshSimplifier::hasEdge(uint32_t from, uint32_t to) const
+	{
+		for (uint32_t i = edgeOffsets[from]; i < edgeOffsets[from + 1]; i++)
+		{
+			if (edgeTargets[i] == to)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	* Checks for an edge between any vertex at the position of from and any vertex at the position of to
+	*/
+	bool weEngineMeshSimplifier::hasPositionEdge(uint32_t from, uint32_t to) const
+	{
+		const uint32_t toPosition = positionRemap[to];
+
+		uint32_t wedge = from;
+		do
+		{
+			for (uint32_t i = edgeOffsets[wedge]; i < edgeOffsets[wedge + 1]; i++)
+			{
+				if (positionRemap[edgeTargets[i]] == toPosition)
+				{
+					return true;
+				}
+			}
+			wedge = wedges[wedge];
+		} while (wedge != from);
+
+		return false;
+	}
+
+	/*
+	* Follows the open edges (edges without a twin going the other way) around every vertex and classifies the positions.
+	* An open edge is a border when no triangle uses it the other way between the same positions, otherwise it is an attribute seam.
+	*/
+	void weEngineMeshSimplifier::classifyVertices()
+	{
+		const size_t vertexCount = vertices.size();
+		loop.assign(vertexCount, NONE);
+		loopback.assign(vertexCount, NONE);
+		std::vector<bool> complex(vertexCount, false);
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t from = indices[i + corner];
+				const uint32_t to = indices[i + (corner + 1) % 3];
+				if (hasEdge(to, from))
+				{
+					continue;
+				}
+
+				//More than one open edge leaving or entering a vertex makes it a non manifold vertex
+				complex[from] = complex[from] || (loop[from] != NONE && loop[from] != to);
+				complex[to] = complex[to] || (loopback[to] != NONE && loopback[to] != from);
+				loop[from] = to;
+				loopback[to] = from;
+			}
+		}
+
+		kinds.assign(vertexCount, LOCKED);
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			if (positionRemap[vertex] != vertex)
+			{
+				continue;
+			}
+
+			VertexKind kind = LOCKED;
+			const uint32_t twin = wedges[vertex];
+			if (twin == vertex)
+			{
+				if (complex[vertex])
+				{
+					kind = LOCKED;
+				}
+				else if (loop[vertex] == NONE && loopback[vertex] == NONE)
+				{
+					kind = MANIFOLD;
+				}
+				else if (loop[vertex] != NONE && loopback[vertex] != NONE &&
+					!hasPositionEdge(loop[vertex], vertex) && !hasPositionEdge(vertex, loopback[vertex]))
+				{
+					kind = BORDER;
+				}
+			}
+			else if (wedges[twin] == vertex && !complex[vertex] && !complex[twin])
+			{
+				//Both wedges need an open edge on each side, and the matching edges must exist on the other side of the seam
+				bool isSeam = true;
+				for (uint32_t wedge : { vertex, twin })
+				{
+					isSeam = isSeam && loop[wedge] != NONE && loopback[wedge] != NONE &&
+						hasPositionEdge(loop[wedge], wedge) && hasPositionEdge(wedge, loopback[wedge]);
+				}
+				kind = isSeam ? SEAM : LOCKED;
+			}
+
+			uint32_t wedge = vertex;
+			do
+			{
+				kinds[wedge] = kind;
+				wedge = wedges[wedge];
+			} while (wedge != vertex);
+		}
+	}
+
+	/*
+	* Accumulates the plane of every triangle into its three positions, weighted by the area of the triangle.
+	* Open edges also add a plane perpendicular to their triangle so that borders and seams keep their shape.
+	*/
+	void weEngineMeshSimplifier::buildQuadrics()
+	{
+		quadrics.assign(vertices.size(), Quadric{});
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const glm::dvec3 p0 = vertices[indices[i + 0]].position;
+			const glm::dvec3 p1 = vertices[indices[i + 1]].position;
+			const glm::dvec3 p2 = vertices[indices[i + 2]].position;
+
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double doubleArea = glm::length(normal);
+			if (doubleArea == 0.0)
+			{
+				continue;
+			}
+			normal /= doubleArea;
+
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				quadrics[positionRemap[indices[i + corner]]].addPlane(normal, -glm::dot(normal, p0), 0.5 * doubleArea);
+			}
+
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t from = indices[i + corner];
+				const uint32_t to = indices[i + (corner + 1) % 3];
+				if (hasEdge(to, from))
+				{
+					continue;
+				}
+
+				const glm::dvec3 edgeFrom = vertices[from].position;
+				const glm::dvec3 edge = glm::dvec3(vertices[to].position) - edgeFrom;
+				const double edgeLength = glm::length(edge);
+				if (edgeLength == 0.0)
+				{
+					continue;
+				}
+
+				const glm::dvec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+				const double edgeWeight = edgeLength * edgeLength * BORDER_WEIGHT;
+				quadrics[positionRemap[from]].addPlane(edgeNormal, -glm::dot(edgeNormal, edgeFrom), edgeWeight);
+				quadrics[positionRemap[to]].addPlane(edgeNormal, -glm::dot(edgeNormal, edgeFrom), edgeWeight);
+			}
+		}
+	}
+
+	/*
+	* Checks if the source vertex may move onto the target vertex. Seam collapses also need the twin of the source to have an open edge
+	* to the twin of the target, so both sides of the seam stay connected.
+	*/
+	bool weEngineMeshSimplifier::canCollapse(uint32_t source, uint32_t target) const
+	{
+		switch (kinds[source])
+		{
+		case MANIFOLD:
+			return true;
+
+		case BORDER:
+			return kinds[target] == BORDER && (loop[source] == target || loopback[source] == target);
+
+		case SEAM:
+		{
+			if (kinds[target] != SEAM || (loop[source] != target && loopback[source] != target))
+			{
+				return false;
+			}
+
+			const uint32_t sourceTwin = wedges[source];
+			const uint32_t targetTwin = wedges[target];
+			return loop[sourceTwin] == targetTwin || loopback[sourceTwin] == targetTwin;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	/*
+	* Checks if moving the source position onto the target position flips or folds any triangle that stays after the collapse
+	*/
+	bool weEngineMeshSimplifier::hasTriangleFlips(uint32_t sourcePosition, uint32_t targetPosition, const std::vector<uint32_t>& collapseRemap) const
+	{
+		const glm::vec3& sourcePoint = vertices[sourcePosition].position;
+		const glm::vec3& targetPoint = vertices[targetPosition].position;
+
+		for (uint32_t i = triangleOffsets[sourcePosition]; i < triangleOffsets[sourcePosition + 1]; i++)
+		{
+			const size_t triangle = triangleList[i];
+
+			uint32_t corners[3];
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				corners[corner] = positionRemap[collapseRemap[indices[triangle * 3 + corner]]];
+			}
+
+			if (corners[0] == targetPosition || corners[1] == targetPosition || corners[2] == targetPosition)
+			{
+				continue;
+			}
+
+			const size_t sourceCorner = corners[0] == sourcePosition ? 0 : corners[1] == sourcePosition ? 1 : 2;
+			const glm::vec3& b = vertices[corners[(sourceCorner + 1) % 3]].position;
+			const glm::vec3& c = vertices[corners[(sourceCorner + 2) % 3]].position;
+
+			const glm::vec3 normalBefore = glm::cross(b - sourcePoint, c - sourcePoint);
+			const glm::vec3 normalAfter = glm::cross(b - targetPoint, c - targetPoint);
+			const float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+			if (lengths > 0.0f && glm::dot(normalBefore, normalAfter) < MIN_NORMAL_COSINE * lengths)
+			{
+				return true;
+			}
+			if (lengths == 0.0f && glm::length(normalBefore) > 0.0f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/*
+	* Lists the triangles of the current mesh around every position
+	*/
+	void weEngineMeshSimplifier::buildTriangleAdjacency()
+	{
+		triangleOffsets.assign(vertices.size() + 1, 0);
+		for (uint32_t index : indices)
+		{
+			triangleOffsets[positionRemap[index] + 1]++;
+		}
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+		triangleList.resize(indices.size());
+		std::vector<uint32_t> fillOffsets(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			triangleList[fillOffsets[positionRemap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	/*
+	* Lists the allowed collapse of every edge of the current mesh, in the direction with the smallest error
+	*/
+	void weEngineMeshSimplifier::rankCollapses(std::vector<Collapse>& collapses) const
+	{
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a = indices[i + corner];
+				const uint32_t b = indices[i + (corner + 1) % 3];
+				if (positionRemap[a] == positionRemap[b])
+				{
+					continue;
+				}
+
+				const bool canCollapseAB = canCollapse(a, b);
+				const bool canCollapseBA = canCollapse(b, a);
+				if (!canCollapseAB && !canCollapseBA)
+				{
+					continue;
+				}
+
+				const double errorAB = canCollapseAB ? quadrics[positionRemap[a]].evaluate(vertices[b].position) : 0.0;
+				const double errorBA = canCollapseBA ? quadrics[positionRemap[b]].evaluate(vertices[a].position) : 0.0;
+
+				if (canCollapseAB && (!canCollapseBA || errorAB <= errorBA))
+				{
+					collapses.push_back({ a, b, static_cast<float>(errorAB) });
+				}
+				else
+				{
+					collapses.push_back({ b, a, static_cast<float>(errorBA) });
+				}
+			}
+		}
+	}
+
+	/*
+	* Performs the sorted collapses until triangleGoal triangles are removed or the error limit is reached.
+	* Positions touched by a collapse are locked for the rest of the pass, since the errors of their other edges are outdated.
+	*/
+	size_t weEngineMeshSimplifier::performCollapses(const std::vector<Collapse>& collapses, size_t triangleGoal, double errorLimit, std::vector<uint32_t>& collapseRemap)
+	{
+		std::vector<bool> locked(vertices.size(), false);
+		size_t collapseCount = 0;
+		size_t removedTriangles = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > errorLimit || removedTriangles >= triangleGoal)
+			{
+				break;
+			}
+
+			const uint32_t sourcePosition = positionRemap[collapse.source];
+			const uint32_t targetPosition = positionRemap[collapse.target];
+			if (locked[sourcePosition] || locked[targetPosition])
+			{
+				continue;
+			}
+
+			if (hasTriangleFlips(sourcePosition, targetPosition, collapseRemap))
+			{
+				continue;
+			}
+
+			collapseRemap[collapse.source] = collapse.target;
+			if (kinds[collapse.source] == SEAM)
+			{
+				collapseRemap[wedges[collapse.source]] = wedges[collapse.target];
+			}
+
+			quadrics[targetPosition].add(quadrics[sourcePosition]);
+			locked[sourcePosition] = true;
+			locked[targetPosition] = true;
+
+			maxErrorSquared = std::max(maxErrorSquared, static_cast<double>(collapse.error));
+			removedTriangles += kinds[collapse.source] == BORDER ? 1 : 2;
+			collapseCount++;
+		}
+
+		return collapseCount;
+	}
+
+	/*
+	* Rewrites the indices after the collapses of a pass, drops the triangles that became degenerate and reconnects the open edge loops
+	*/
+	void weEngineMeshSimplifier::applyCollapses(const std::vector<uint32_t>& collapseRemap)
+	{
+		size_t writeOffset = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const uint32_t a = collapseRemap[indices[i + 0]];
+			const uint32_t b = collapseRemap[indices[i + 1]];
+			const uint32_t c = collapseRemap[indices[i + 2]];
+			if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[a] == positionRemap[c])
+			{
+				continue;
+			}
+
+			indices[writeOffset + 0] = a;
+			indices[writeOffset + 1] = b;
+			indices[writeOffset + 2] = c;
+			writeOffset += 3;
+		}
+		indices.resize(writeOffset);
+
+		//When the next vertex of a loop collapsed onto this vertex, the loop continues from the vertex after it
+		for (uint32_t vertex = 0; vertex < vertices.size(); vertex++)
+		{
+			if (loop[vertex] != NONE)
+			{
+				const uint32_t next = loop[vertex];
+				loop[vertex] = collapseRemap[next] == vertex ? (loop[next] != NONE ? collapseRemap[loop[next]] : NONE) : collapseRemap[next];
+			}
+
+			if (loopback[vertex] != NONE)
+			{
+				const uint32_t previous = loopback[vertex];
+				loopback[vertex] = collapseRemap[previous] == vertex ? (loopback[previous] != NONE ? collapseRemap[loopback[previous]] : NONE) : collapseRemap[previous];
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+* weEngineMeshSimplifier reduces the triangle count of a model with quadric error metric edge collapses (Garland, Heckbert 1997).
+* Vertices are only ever collapsed onto other vertices, so every simplified index list still refers to the original vertex array.
+* Vertices that share a position but not their attributes (UV or normal seams) only move along the seam, together with their twin,
+* and vertices on open borders only move along the border.
+*/
+
+#include "weEngineModel.hpp"
+
+//std
+#include "cstdint"
+#include "string"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineMeshSimplifier
+	{
+	public:
+		weEngineMeshSimplifier(const std::vector<weEngineModel::Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		weEngineMeshSimplifier(const weEngineMeshSimplifier&) = delete;
+		weEngineMeshSimplifier& operator=(const weEngineMeshSimplifier&) = delete;
+
+		/*
+		* Collapses edges until at most targetIndexCount indices are left or the next collapse would exceed errorLimit.
+		* Can be called again with a smaller target to continue from the current result. Returns the error reached so far.
+		*/
+		float simplify(size_t targetIndexCount, float errorLimit);
+
+		const std::vector<uint32_t>& getIndices() const
+		{
+			return indices;
+		}
+
+		//Largest distance (in model units) between the simplified surface and the original one, as estimated by the quadrics
+		float getError() const;
+
+		//Appends the detail levels of the builder mesh to its index list, level 0 being the full resolution mesh
+		static void generateLods(weEngineModel::Builder& builder, const weEngineModel::LoadSettings& settings, const std::string& name);
+
+	private:
+		//How a position may move during a collapse
+		enum VertexKind : uint8_t
+		{
+			MANIFOLD, //Inside a surface without attribute discontinuity, can collapse onto any neighbour
+			BORDER, //On an open border, can only collapse along the border
+			SEAM, //On an attribute seam with two wedges, both wedges collapse along the seam
+			LOCKED, //Corners, non manifold or complex seams
+		};
+
+		//Symmetric 4x4 matrix of the squared distance to a set of planes, scaled by the total weight of the planes
+		struct Quadric
+		{
+			double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+			double a01 = 0.0, a02 = 0.0, a12 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const glm::dvec3& normal, double distance, double planeWeight);
+			void add(const Quadric& other);
+			double evaluate(const glm::vec3& position) const;
+		};
+
+		struct Collapse
+		{
+			uint32_t source;
+			uint32_t target;
+			float error; //Squared error of moving the source position onto the target position
+		};
+
+		static constexpr uint32_t NONE = ~0u;
+
+		void buildPositionRemap();
+		void buildEdges();
+		void classifyVertices();
+		void buildQuadrics();
+
+		bool hasEdge(uint32_t from, uint32_t to) const;
+		bool hasPositionEdge(uint32_t from, uint32_t to) const;
+		bool canCollapse(uint32_t source, uint32_t target) const;
+		bool hasTriangleFlips(uint32_t sourcePosition, uint32_t targetPosition, const std::vector<uint32_t>& collapseRemap) const;
+
+		void buildTriangleAdjacency();
+		void rankCollapses(std::vector<Collapse>& collapses) const;
+		size_t performCollapses(const std::vector<Collapse>& collapses, size_t triangleGoal, double errorLimit, std::vector<uint32_t>& collapseRemap);
+		void applyCollapses(const std::vector<uint32_t>& collapseRemap);
+
+		const std::vector<weEngineModel::Vertex>& vertices;
+		std::vector<uint32_t> indices;
+
+		std::vector<uint32_t> positionRemap; //First vertex sharing the position of every vertex
+		std::vector<uint32_t> wedges; //Next vertex sharing the same position, forming a ring
+
+		std::vector<uint32_t> edgeOffsets; //Outgoing edges of every vertex in the original mesh
+		std::vector<uint32_t> edgeTargets;
+
+		std::vector<uint32_t> loop; //Target of the open edge leaving a vertex
+		std::vector<uint32_t> loopback; //Source of the open edge entering a vertex
+		std::vector<VertexKind> kinds;
+		std::vector<Quadric> quadrics; //Indexed by position
+
+		std::vector<uint32_t> triangleOffsets; //Triangles around every position in the current mesh
+		std::vector<uint32_t> triangleList;
+
+		double maxErrorSquared = 0.0;
+	};
+}
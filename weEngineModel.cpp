@@ -1,153 +1,235 @@
 #include "weEngineModel.hpp"
+#include "weEngineMeshCache.hpp"
+#include "weEngineMeshOptimizer.hpp"
+#include "weEngineMeshSimplifier.hpp"
+#include "weEngineOcclusionCuller.hpp"
+#include "weEngineJobSystem.hpp"
 #include "weEngineUtils.hpp"
+#include "weEngineVertexHashMap.hpp"
 
 //std
+#include "algorithm"
 #include "cassert"
 #include "cstring"
-#include "unordered_map"
-
-//GLM
-#define GLM_ENABLE_EXPERIMENTAL
-#include "glm/gtx/hash.hpp"
+#include "iostream"
 
 //TinyObjLoader
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tinyobjloader/tiny_obj_loader.h"
 
-namespace std
+namespace weEngine
 {
-	template<>
-	struct hash<weEngine::weEngineModel::Vertex> 
+	weEngineModel::weEngineModel(weEngine::weEngineDevice& device, const weEngineModel::Builder& modelBuilder) :
+		weEngineModel(device, modelBuilder.getMeshData())
 	{
-		size_t operator()(weEngine::weEngineModel::Vertex const& vertex) const
-		{
-			size_t seed = 0;
-			weEngine::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-
-			return seed;
-		}
-	};
-}
-
+	}
 
-namespace weEngine
-{
-	weEngineModel::weEngineModel(weEngine::weEngineDevice& device, const weEngineModel::Builder& modelBuilder) :weEngineDevice(device)
+	weEngineModel::weEngineModel(weEngine::weEngineDevice& device, const MeshData& meshData) :weEngineDevice(device)
 	{
-		createVertexBuffers(modelBuilder.vertices);
-		createIndexBuffers(modelBuilder.indices);
+		bounds = meshData.bounds != nullptr ? *meshData.bounds : Bounds::compute(meshData.vertices, meshData.vertexCount);
+		computeQuantization();
+		createVertexBuffers(meshData.vertices, meshData.vertexCount);
+		createIndexBuffers(meshData.indices, meshData.indexCount);
+		createDrawRanges(meshData);
+
+		statistics.vertexCount = vertexCount;
+		statistics.indexCount = indexCount;
+		statistics.indexType = indexType;
+		statistics.vertexBufferSize = static_cast<VkDeviceSize>(VertexLayout::STRIDE) * vertexCount;
+		statistics.indexBufferSize = static_cast<VkDeviceSize>(indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)) * indexCount;
+		statistics.lodCount = static_cast<uint32_t>(lods.size());
+		statistics.rangeCount = static_cast<uint32_t>(ranges.size());
 	}
 
 	weEngineModel::~weEngineModel()
 	{
-		vkDestroyBuffer(weEngineDevice.device(), vertexBuffer, nullptr);
-		vkFreeMemory(weEngineDevice.device(), vertexBufferMemory, nullptr);
+		//The copies into the buffers may still be running
+		weEngineDevice.getUploadManager().wait(uploadTicket);
+
+		weEngineDevice.destroyBuffer(vertexBuffer, vertexBufferAllocation);
 
 		if (hasIndices)
 		{
-			vkDestroyBuffer(weEngineDevice.device(), indexBuffer, nullptr);
-			vkFreeMemory(weEngineDevice.device(), indexBufferMemory, nullptr);
+			weEngineDevice.destroyBuffer(indexBuffer, indexBufferAllocation);
 		}
 	}
 	/*
-	* Create vertex buffers and allocate memory for it. Create staging buffer to temporarily stored the data before transferring it to the GPU
+	* Computes the bounding box of the vertices and a sphere around them centered on the box
 	*/
-	void weEngineModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+	weEngineModel::Bounds weEngineModel::Bounds::compute(const Vertex* vertices, uint32_t count)
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3.");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+		Bounds bounds{};
+		if (count == 0)
+		{
+			return bounds;
+		}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		weEngineDevice.createBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer,
-			stagingBufferMemory
-		);
+		bounds.minimum = vertices[0].position;
+		bounds.maximum = vertices[0].position;
+		for (uint32_t i = 1; i < count; i++)
+		{
+			bounds.minimum = glm::min(bounds.minimum, vertices[i].position);
+			bounds.maximum = glm::max(bounds.maximum, vertices[i].position);
+		}
 
-		/*
-		* Sends the data to the GPU
-		*/
-		void* data;
-		vkMapMemory(weEngineDevice.device(), stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(weEngineDevice.device(), stagingBufferMemory);
+		bounds.center = 0.5f * (bounds.minimum + bounds.maximum);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			bounds.radius = std::max(bounds.radius, glm::length(vertices[i].position - bounds.center));
+		}
+		return bounds;
+	}
+
+	/*
+	* When the vertex layout quantizes the positions, maps the bounding box to [-1, 1] for the encoding
+	*/
+	void weEngineModel::computeQuantization()
+	{
+		if (VertexLayout::QUANTIZED)
+		{
+			//A flat model keeps a non zero scale on its flat axis so the encoding never divides by zero
+			quantization.bias = bounds.center;
+			quantization.scale = glm::max(0.5f * (bounds.maximum - bounds.minimum), glm::vec3{ std::max(bounds.radius, 1.0f) * 1e-6f });
+
+			dequantizationMatrix = glm::mat4{ 1.0f };
+			dequantizationMatrix[0][0] = quantization.scale.x;
+			dequantizationMatrix[1][1] = quantization.scale.y;
+			dequantizationMatrix[2][2] = quantization.scale.z;
+			dequantizationMatrix[3] = glm::vec4{ quantization.bias, 1.0f };
+		}
+	}
+
+	/*
+	* Create vertex buffers and allocate memory for it. The vertices are encoded with VertexLayout straight into the staging ring
+	* of the upload manager, the copy to the GPU is submitted together with the other uploads of the batch.
+	*/
+	void weEngineModel::createVertexBuffers(const Vertex* vertices, uint32_t count)
+	{
+		vertexCount = count;
+		assert(vertexCount >= 3 && "Vertex count must be at least 3.");
+		VkDeviceSize bufferSize = static_cast<VkDeviceSize>(VertexLayout::STRIDE) * vertexCount;
 
 		weEngineDevice.createBuffer(
 			bufferSize,
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			vertexBuffer,
-			vertexBufferMemory
+			vertexBufferAllocation,
+			weEngineMemoryUsage::LONG_LIVED,
+			"vertex buffer"
 		);
 
-		weEngineDevice.copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-		vkDestroyBuffer(weEngineDevice.device(), stagingBuffer, nullptr);
-		vkFreeMemory(weEngineDevice.device(), stagingBufferMemory, nullptr);
+		/*
+		* Sends the data to the GPU
+		*/
+		const VertexQuantization& vertexQuantization = quantization;
+		uploadTicket = weEngineDevice.getUploadManager().upload(vertexBuffer, 0, vertexCount, VertexLayout::STRIDE,
+			[vertices, &vertexQuantization](uint8_t* destination, uint64_t firstVertex, uint64_t count)
+			{
+				for (uint64_t i = 0; i < count; i++)
+				{
+					VertexLayout::encode(vertices[firstVertex + i], vertexQuantization, destination + i * VertexLayout::STRIDE);
+				}
+			});
 	}
 
 	/*
-	* Creates an index buffer inside the GPU
+	* Creates an index buffer inside the GPU. The indices are stored as 16 bit values when every index fits,
+	* which is the case for meshes of up to MAX_SHORT_INDEX_VERTEX_COUNT vertices and for meshes split into draw ranges.
 	*/
-	void weEngineModel::createIndexBuffers(const std::vector<uint32_t>& indices)
+	void weEngineModel::createIndexBuffers(const uint32_t* indices, uint32_t count)
 	{
-		indexCount = static_cast<uint32_t>(indices.size());
+		indexCount = count;
 		hasIndices = indexCount > 0;
 
 		if (!hasIndices)
 		{
 			return;
 		}
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
+		const uint32_t maxIndex = *std::max_element(indices, indices + indexCount);
+		indexType = maxIndex < MAX_SHORT_INDEX_VERTEX_COUNT ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		const uint32_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSize) * indexCount;
+
 		weEngineDevice.createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer,
-			stagingBufferMemory
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBuffer,
+			indexBufferAllocation,
+			weEngineMemoryUsage::LONG_LIVED,
+			"index buffer"
 		);
 
 		/*
 		* Sends the data to the GPU
 		*/
-		void* data;
-		vkMapMemory(weEngineDevice.device(), stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(weEngineDevice.device(), stagingBufferMemory);
+		const bool shortIndices = indexType == VK_INDEX_TYPE_UINT16;
+		uploadTicket = weEngineDevice.getUploadManager().upload(indexBuffer, 0, indexCount, indexSize,
+			[indices, shortIndices](uint8_t* destination, uint64_t firstIndex, uint64_t count)
+			{
+				if (shortIndices)
+				{
+					uint16_t* shortDestination = reinterpret_cast<uint16_t*>(destination);
+					for (uint64_t i = 0; i < count; i++)
+					{
+						shortDestination[i] = static_cast<uint16_t>(indices[firstIndex + i]);
+					}
+				}
+				else
+				{
+					memcpy(destination, indices + firstIndex, static_cast<size_t>(count) * sizeof(uint32_t));
+				}
+			});
+	}
 
-		weEngineDevice.createBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			indexBuffer,
-			indexBufferMemory
-		);
+	/*
+	* Copies the detail levels and the draw ranges of the mesh. Missing levels or ranges are replaced by a single level
+	* covering the whole index buffer and a single range per level.
+	*/
+	void weEngineModel::createDrawRanges(const MeshData& meshData)
+	{
+		if (meshData.lodCount > 0)
+		{
+			lods.assign(meshData.lods, meshData.lods + meshData.lodCount);
+		}
+		else
+		{
+			lods.push_back({ 0, indexCount, 0.0f, 0, 0 });
+		}
 
-		weEngineDevice.copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+		if (meshData.rangeCount > 0)
+		{
+			ranges.assign(meshData.ranges, meshData.ranges + meshData.rangeCount);
+			return;
+		}
 
-		vkDestroyBuffer(weEngineDevice.device(), stagingBuffer, nullptr);
-		vkFreeMemory(weEngineDevice.device(), stagingBufferMemory, nullptr);
+		for (LodLevel& lod : lods)
+		{
+			lod.firstRange = static_cast<uint32_t>(ranges.size());
+			lod.rangeCount = 1;
+			ranges.push_back({ lod.firstIndex, lod.indexCount, 0 });
+		}
 	}
 
 	/*
-	* Enters the draw command into the commandbuffer
+	* Enters the draw commands of one detail level into the commandbuffer, for instanceCount instances starting at firstInstance
 	*/
-	void weEngineModel::draw(VkCommandBuffer commandBuffer)
+	void weEngineModel::draw(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance)
 	{
+		assert(lod < lods.size() && "Detail level out of range");
+
 		if (hasIndices)
 		{
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			for (uint32_t i = lods[lod].firstRange; i < lods[lod].firstRange + lods[lod].rangeCount; i++)
+			{
+				vkCmdDrawIndexed(commandBuffer, ranges[i].indexCount, instanceCount, ranges[i].firstIndex, ranges[i].vertexOffset, firstInstance);
+			}
 		}
 		else
 		{
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 		}
 		
 	}
@@ -163,55 +245,168 @@ namespace weEngine
 
 		if (hasIndices)
 		{
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
 		}
 	}
 
 	/*
-	* Returns the pointer of a weEngineModel object from a path to a 3D model (.obj file).
+	* Prints the GPU memory used by the model and the type of its indices
 	*/
-	std::unique_ptr<weEngineModel> weEngineModel::createModelFromFile(weEngine::weEngineDevice& device, const std::string& filepath)
+	void weEngineModel::printStatistics(const std::string& name) const
 	{
-		Builder builder{};
-		builder.loadModel(filepath);
-
-		return std::make_unique<weEngineModel>(device, builder);
+		std::cout << "Model: " << name
+			<< " " << statistics.vertexCount << " vertices (" << statistics.vertexBufferSize / 1024 << " KiB)"
+			<< ", " << statistics.indexCount << " indices " << (statistics.indexType == VK_INDEX_TYPE_UINT16 ? "uint16" : "uint32")
+			<< " (" << statistics.indexBufferSize / 1024 << " KiB)"
+			<< ", " << statistics.lodCount << " detail levels, " << statistics.rangeCount << " draw ranges" << std::endl;
+	}
 
+	/*
+	* Returns the pointer of a weEngineModel object from a path to a 3D model (.obj file) with the default load settings.
+	*/
+	std::unique_ptr<weEngineModel> weEngineModel::createModelFromFile(weEngine::weEngineDevice& device, const std::string& filepath)
+	{
+		return createModelFromFile(device, filepath, LoadSettings{});
 	}
+
 	/*
-	* Describes how the input binding inside the buffer data is formatted
+	* Returns the pointer of a weEngineModel object from a path to a 3D model (.obj file).
+	* Uploads straight from the memory-mapped mesh cache when it is up to date, otherwise parses the model, builds its detail levels,
+	* optimizes it and writes the cache. With createOccluder, the coarsest detail level is also kept as the occluder mesh of the model.
 	*/
-	std::vector<VkVertexInputBindingDescription> weEngineModel::Vertex::getBindingDescriptions()
+	std::unique_ptr<weEngineModel> weEngineModel::createModelFromFile(weEngine::weEngineDevice& device, const std::string& filepath, const LoadSettings& settings)
+	{
+		weEngineMeshCache meshCache{ filepath, settings.getCacheKey() };
+		std::unique_ptr<weEngineModel> model;
+		if (meshCache.load())
+		{
+			model = std::make_unique<weEngineModel>(device, meshCache.getMeshData());
+			if (settings.createOccluder)
+			{
+				model->occluderMesh = weEngineOccluderMesh::createFromMeshData(meshCache.getMeshData(), UINT32_MAX);
+			}
+		}
+		else
+		{
+			Builder builder{};
+			builder.loadModel(filepath);
+			weEngineMeshSimplifier::generateLods(builder, settings, filepath);
+			weEngineMeshOptimizer::optimize(builder, settings, filepath);
+			if (settings.splitForShortIndices && builder.vertices.size() > MAX_SHORT_INDEX_VERTEX_COUNT)
+			{
+				weEngineMeshOptimizer::splitDrawRanges(builder, MAX_SHORT_INDEX_VERTEX_COUNT);
+			}
+			meshCache.store(builder);
+
+			model = std::make_unique<weEngineModel>(device, builder);
+			if (settings.createOccluder)
+			{
+				model->occluderMesh = weEngineOccluderMesh::createFromMeshData(builder.getMeshData(), UINT32_MAX);
+			}
+		}
+
+		model->printStatistics(filepath);
+		return model;
+
+	}
+
+	uint32_t weEngineModel::LoadSettings::getCacheKey() const
+	{
+		const uint32_t flags =
+			(optimizeVertexCache ? 1u : 0u) |
+			(optimizeOverdraw ? 2u : 0u) |
+			(optimizeVertexFetch ? 4u : 0u) |
+			(splitForShortIndices ? 8u : 0u);
+
+		const uint32_t values[6] =
+		{
+			flags,
+			vertexCacheSize,
+			static_cast<uint32_t>(overdrawThreshold * 1000.0f),
+			lodLevelCount,
+			static_cast<uint32_t>(lodIndexRatio * 1000.0f),
+			static_cast<uint32_t>(lodMaxError * 100000.0f),
+		};
+		return static_cast<uint32_t>(hashBytes(values, sizeof(values)));
+	}
+
+	weEngineModel::MeshData weEngineModel::Builder::getMeshData() const
 	{
-		std::vector<VkVertexInputBindingDescription> bindingDescription(1);
-		bindingDescription[0].binding = 0;
-		bindingDescription[0].stride = sizeof(Vertex);
-		bindingDescription[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		MeshData meshData{};
+		meshData.vertices = vertices.data();
+		meshData.vertexCount = static_cast<uint32_t>(vertices.size());
+		meshData.indices = indices.data();
+		meshData.indexCount = static_cast<uint32_t>(indices.size());
+		meshData.lods = lods.data();
+		meshData.lodCount = static_cast<uint32_t>(lods.size());
+		meshData.ranges = ranges.data();
+		meshData.rangeCount = static_cast<uint32_t>(ranges.size());
+		meshData.bounds = &bounds;
+		return meshData;
+	}
 
-		return bindingDescription;
+	void weEngineModel::Builder::computeBounds()
+	{
+		bounds = Bounds::compute(vertices.data(), static_cast<uint32_t>(vertices.size()));
 	}
+
 	/*
-	* Describes how the attributes stored in the input binding 
+	* Builds the vertex referenced by one index of an .obj face
 	*/
-
-	std::vector<VkVertexInputAttributeDescription> weEngineModel::Vertex::getAttributeDescriptions()
+	static weEngineModel::Vertex readObjVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
 	{
-		std::vector<VkVertexInputAttributeDescription> attributeDescription(2);
-		attributeDescription[0].binding = 0;
-		attributeDescription[0].location = 0;
-		attributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[0].offset = offsetof(Vertex, position);
-
-		attributeDescription[1].binding = 0;
-		attributeDescription[1].location = 1;
-		attributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[1].offset = offsetof(Vertex, color);
-
-		return attributeDescription;
+		weEngineModel::Vertex vertex{};
+
+		if (index.vertex_index >= 0)
+		{
+			vertex.position =
+			{
+				attrib.vertices[3 * index.vertex_index + 0], //x component
+				attrib.vertices[3 * index.vertex_index + 1], //y component
+				attrib.vertices[3 * index.vertex_index + 2], //z component
+			};
+			auto colorIndex = 3 * index.vertex_index + 2;
+			if (colorIndex < attrib.colors.size())
+			{
+				vertex.color =
+				{
+					attrib.colors[colorIndex - 2], //x component
+					attrib.colors[colorIndex - 1], //y component
+					attrib.colors[colorIndex - 0], //z component
+				};
+			}
+			else
+			{
+				vertex.color = { 1.0f, 1.0f, 1.0f }; //default color
+			}
+		}
+
+		if (index.normal_index >= 0)
+		{
+			vertex.normal =
+			{
+				attrib.normals[3 * index.normal_index + 0], //x component
+				attrib.normals[3 * index.normal_index + 1], //y component
+				attrib.normals[3 * index.normal_index + 2], //z component
+			};
+		}
+
+		if (index.texcoord_index >= 0)
+		{
+			vertex.uv =
+			{
+				attrib.texcoords[2 * index.texcoord_index + 0], //x component
+				attrib.texcoords[2 * index.texcoord_index + 1], //y component
+			};
+		}
+
+		return vertex;
 	}
 
 	/*
-	* Loads the model use tinyobj::loadObj and storing it temporarily inside attrib, shapes and materials
+	* Loads the model use tinyobj::loadObj and storing it temporarily inside attrib, shapes and materials.
+	* The face indices of every shape are split into chunks that are deduplicated in parallel. The chunks are then merged in order,
+	* so the vertices end up in order of first use exactly like a single threaded pass would produce.
 	*/
 	void weEngineModel::Builder::loadModel(const std::string& filepath)
 	{
@@ -227,65 +422,98 @@ namespace weEngine
 
 		vertices.clear();
 		indices.clear();
+		lods.clear();
+		ranges.clear();
 
-		std::unordered_map<Vertex, uint32_t> unique_vertices{};
-		for (const auto& shape : shapes)
+		//Prefix sum of the index count of every shape, to find which shape a global index position belongs to
+		std::vector<size_t> shapeOffsets(shapes.size() + 1, 0);
+		for (size_t i = 0; i < shapes.size(); i++)
 		{
-			for (const auto& index : shape.mesh.indices)
-			{
-				Vertex vertex{};
+			shapeOffsets[i + 1] = shapeOffsets[i] + shapes[i].mesh.indices.size();
+		}
+		const size_t totalIndexCount = shapeOffsets.back();
 
-				if (index.vertex_index >= 0)
-				{
-					vertex.position =
-					{
-						attrib.vertices[3 * index.vertex_index + 0], //x component
-						attrib.vertices[3 * index.vertex_index + 1], //y component
-						attrib.vertices[3 * index.vertex_index + 2], //z component
-					};
-					auto colorIndex = 3 * index.vertex_index + 2;
-					if (colorIndex < attrib.colors.size())
-					{
-						vertex.color =
-						{
-							attrib.colors[colorIndex - 2], //x component
-							attrib.colors[colorIndex - 1], //y component
-							attrib.colors[colorIndex - 0], //z component
-						};
-					}
-					else
-					{
-						vertex.color = { 1.0f, 1.0f, 1.0f }; //default color
-					}
-				}
+		struct Chunk
+		{
+			size_t begin;
+			size_t end;
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		//A few chunks per thread keeps the threads busy when some chunks have more unique vertices than others
+		auto& jobSystem = weEngineJobSystem::shared();
+		const size_t maxChunkCount = jobSystem.getThreadCount() > 1 ? static_cast<size_t>(jobSystem.getThreadCount()) * 4 : 1;
+		const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(
+			(totalIndexCount + MIN_INDICES_PER_LOAD_CHUNK - 1) / MIN_INDICES_PER_LOAD_CHUNK,
+			maxChunkCount));
+
+		std::vector<Chunk> chunks(chunkCount);
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			chunks[i].begin = totalIndexCount * i / chunkCount;
+			chunks[i].end = totalIndexCount * (i + 1) / chunkCount;
+		}
 
-				if (index.normal_index >= 0)
-				{
-					vertex.normal =
-					{
-						attrib.normals[3 * index.normal_index + 0], //x component
-						attrib.normals[3 * index.normal_index + 1], //y component
-						attrib.normals[3 * index.normal_index + 2], //z component
-					};
-				}
+		//Deduplicate every chunk independently
+		jobSystem.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunkIndex)
+		{
+			Chunk& chunk = chunks[chunkIndex];
+			chunk.indices.reserve(chunk.end - chunk.begin);
 
-				if (index.texcoord_index >= 0)
+			weEngineVertexHashMap uniqueVertices{ chunk.end - chunk.begin };
+			size_t shape = std::upper_bound(shapeOffsets.begin(), shapeOffsets.end(), chunk.begin) - shapeOffsets.begin() - 1;
+			for (size_t position = chunk.begin; position < chunk.end; position++)
+			{
+				while (position >= shapeOffsets[shape + 1])
 				{
-					vertex.uv =
-					{
-						attrib.texcoords[2 * index.texcoord_index + 0], //x component
-						attrib.texcoords[2 * index.texcoord_index + 1], //y component
-					};
+					shape++;
 				}
 
-				if (unique_vertices.count(vertex) == 0)
-				{
-					unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
-				}
-				indices.push_back(unique_vertices[vertex]);
+				const Vertex vertex = readObjVertex(attrib, shapes[shape].mesh.indices[position - shapeOffsets[shape]]);
+				chunk.indices.push_back(uniqueVertices.findOrInsert(vertex, chunk.vertices));
+			}
+		});
+
+		if (chunkCount == 1)
+		{
+			vertices = std::move(chunks[0].vertices);
+			indices = std::move(chunks[0].indices);
+			computeBounds();
+			return;
+		}
+
+		//Merge the chunk vertices in order, a vertex keeps the slot of its first appearance
+		size_t chunkVertexCount = 0;
+		for (const Chunk& chunk : chunks)
+		{
+			chunkVertexCount += chunk.vertices.size();
+		}
+
+		std::vector<std::vector<uint32_t>> chunkRemaps(chunkCount);
+		weEngineVertexHashMap uniqueVertices{ chunkVertexCount };
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			chunkRemaps[i].resize(chunks[i].vertices.size());
+			for (size_t j = 0; j < chunks[i].vertices.size(); j++)
+			{
+				chunkRemaps[i][j] = uniqueVertices.findOrInsert(chunks[i].vertices[j], vertices);
 			}
 		}
+
+		//Rewrite the chunk indices with the merged vertex slots
+		indices.resize(totalIndexCount);
+		jobSystem.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunkIndex)
+		{
+			const Chunk& chunk = chunks[chunkIndex];
+			const std::vector<uint32_t>& remap = chunkRemaps[chunkIndex];
+			for (size_t i = 0; i < chunk.indices.size(); i++)
+			{
+				indices[chunk.begin + i] = remap[chunk.indices[i]];
+			}
+		});
+
+		computeBounds();
 	}
 	
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 */
 
 #include "weEngineDevice.hpp"
+#include "weEngineUploadManager.hpp"
+#include "weEngineVertexLayout.hpp"
 
 //glm
 #define GLM_FORCE_RADIANS
@@ -19,10 +21,12 @@
 
 namespace weEngine
 {
+	struct weEngineOccluderMesh;
+
 	class weEngineModel
 	{
 	public:
-		//Struct for storing the vertex data
+		//Struct for storing the vertex data on the CPU and in the mesh cache. The vertex buffer stores it encoded with VertexLayout.
 		struct Vertex
 		{
 			glm::vec3 position{};
@@ -30,47 +34,211 @@ namespace weEngine
 			glm::vec3 normal{};
 			glm::vec2 uv{};
 
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
 			bool operator==(const Vertex& other) const
 			{
 				return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
 			}
 		};
 
+		//Format of the vertices inside the vertex buffer
+		using VertexLayout = CompactVertexLayout;
+
+		//Processing applied to a model between loading it and uploading it
+		struct LoadSettings
+		{
+			bool optimizeVertexCache = true;
+			bool optimizeOverdraw = false;
+			bool optimizeVertexFetch = true;
+			uint32_t vertexCacheSize = 16;
+			float overdrawThreshold = 1.05f; //How much worse than the whole cluster the vertex cache efficiency of a cluster piece may get
+			uint32_t lodLevelCount = 4; //Number of detail levels including the full resolution mesh, 1 disables the simplification
+			float lodIndexRatio = 0.5f; //Fraction of the indices of the previous level that each level aims for
+			float lodMaxError = 0.05f; //Largest simplification error allowed, relative to the radius of the mesh
+			bool splitForShortIndices = true; //Splits meshes with too many vertices for 16 bit indices into draw ranges that each fit them
+			bool createOccluder = false; //Keeps the coarsest detail level on the CPU for the occlusion culling, does not change the processed mesh
+
+			//Identifies the settings that change the processed mesh, so a cache written with other settings is rejected
+			uint32_t getCacheKey() const;
+		};
+
+		//Range of the index buffer drawn for one detail level of the model
+		struct LodLevel
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error; //Largest distance to the full resolution surface, in model units
+			uint32_t firstRange; //Draw ranges of the level, only set when the mesh has draw ranges
+			uint32_t rangeCount;
+		};
+
+		//Part of the index buffer drawn with one draw call. Its indices are relative to vertexOffset.
+		struct DrawRange
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+		};
+
+		//Axis aligned box and sphere around the vertex positions, in model space. The sphere is centered on the box.
+		struct Bounds
+		{
+			glm::vec3 minimum{ 0.0f };
+			glm::vec3 maximum{ 0.0f };
+			glm::vec3 center{ 0.0f };
+			float radius = 0.0f;
+
+			static Bounds compute(const Vertex* vertices, uint32_t count);
+		};
+
+		//Largest number of vertices 16 bit indices can address
+		static constexpr uint32_t MAX_SHORT_INDEX_VERTEX_COUNT = 1 << 16;
+
+		//Smallest number of face indices handled by one loading task
+		static constexpr size_t MIN_INDICES_PER_LOAD_CHUNK = 1 << 16;
+
+		//Non owning view of the mesh data a model is created from
+		struct MeshData
+		{
+			const Vertex* vertices = nullptr;
+			uint32_t vertexCount = 0;
+			const uint32_t* indices = nullptr;
+			uint32_t indexCount = 0;
+			const LodLevel* lods = nullptr; //Without detail levels the whole index buffer is the only level
+			uint32_t lodCount = 0;
+			const DrawRange* ranges = nullptr; //Without draw ranges every level is drawn with one draw call
+			uint32_t rangeCount = 0;
+			const Bounds* bounds = nullptr; //Computed from the vertices when not given
+		};
+
 		//Holds the vertex data and the indices for each triangles
 		struct Builder
 		{
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			std::vector<LodLevel> lods{}; //Empty when the indices are a single level
+			std::vector<DrawRange> ranges{}; //Empty when every level is a single draw
+			Bounds bounds{}; //Set by loadModel, call computeBounds after changing the vertices
 
 			void loadModel(const std::string &filepath);
+			void computeBounds();
+			MeshData getMeshData() const;
+		};
+
+		//Memory used by a model on the GPU
+		struct Statistics
+		{
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			VkDeviceSize vertexBufferSize = 0;
+			VkDeviceSize indexBufferSize = 0;
+			uint32_t lodCount = 0;
+			uint32_t rangeCount = 0;
 		};
 
 		weEngineModel(weEngineDevice& device, const weEngineModel::Builder& modelBuilder);
+		weEngineModel(weEngineDevice& device, const MeshData& meshData);
 		~weEngineModel();
 
 		weEngineModel(const weEngineModel&) = delete;
 		weEngineModel& operator=(const weEngineModel&) = delete;
 
 		static std::unique_ptr<weEngineModel> createModelFromFile(weEngineDevice& device, const std::string &filepath);
+		static std::unique_ptr<weEngineModel> createModelFromFile(weEngineDevice& device, const std::string &filepath, const LoadSettings& settings);
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+		uint32_t getLodCount() const
+		{
+			return static_cast<uint32_t>(lods.size());
+		}
+
+		float getLodError(uint32_t lod) const
+		{
+			return lods[lod].error;
+		}
+
+		const LodLevel& getLod(uint32_t lod) const
+		{
+			return lods[lod];
+		}
+
+		//Draw ranges of every level, each level refers to its own with firstRange and rangeCount
+		const DrawRange& getDrawRange(uint32_t range) const
+		{
+			return ranges[range];
+		}
+
+		bool hasIndexBuffer() const
+		{
+			return hasIndices;
+		}
+
+		const Bounds& getBounds() const
+		{
+			return bounds;
+		}
+
+		const glm::vec3& getBoundingCenter() const
+		{
+			return bounds.center;
+		}
+
+		float getBoundingRadius() const
+		{
+			return bounds.radius;
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		void printStatistics(const std::string& name) const;
+
+		//Matrix turning the quantized positions of the vertex buffer back into model space, to apply before the model transform
+		const glm::mat4& getDequantizationMatrix() const
+		{
+			return dequantizationMatrix;
+		}
+
+		//Coarsest detail level kept on the CPU when the model was loaded with createOccluder, null otherwise
+		const std::shared_ptr<const weEngineOccluderMesh>& getOccluderMesh() const
+		{
+			return occluderMesh;
+		}
+
+		//Completes once the vertices and indices reached the GPU buffers, can be polled with the upload manager of the device
+		weEngineUploadTicket getUploadTicket() const
+		{
+			return uploadTicket;
+		}
 	private:
-		void createVertexBuffers(const std::vector<Vertex> &vertices);
-		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void computeQuantization();
+		void createVertexBuffers(const Vertex* vertices, uint32_t count);
+		void createIndexBuffers(const uint32_t* indices, uint32_t count);
+		void createDrawRanges(const MeshData& meshData);
 
 		weEngineDevice& weEngineDevice;
 
 		VkBuffer vertexBuffer;
-		VkDeviceMemory vertexBufferMemory;
+		weEngineAllocation vertexBufferAllocation;
 		uint32_t vertexCount;
 
 		bool hasIndices = false;
 		VkBuffer indexBuffer;
-		VkDeviceMemory indexBufferMemory;
+		weEngineAllocation indexBufferAllocation;
 		uint32_t indexCount;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		weEngineUploadTicket uploadTicket{};
+
+		std::vector<LodLevel> lods;
+		std::vector<DrawRange> ranges;
+		Statistics statistics{};
+		Bounds bounds{};
+		VertexQuantization quantization{};
+		glm::mat4 dequantizationMatrix{ 1.0f };
+		std::shared_ptr<const weEngineOccluderMesh> occluderMesh;
 	};
 }
\ No newline at end of file
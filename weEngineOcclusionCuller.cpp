@@ -0,0 +1,511 @@
+#include "weEngineOcclusionCuller.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "algorithm"
+#include "cfloat"
+#include "chrono"
+#include "cmath"
+#include "fstream"
+#include "stdexcept"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WE_ENGINE_OCCLUSION_SSE
+#include "emmintrin.h"
+#endif
+
+namespace weEngine
+{
+	std::shared_ptr<weEngineOccluderMesh> weEngineOccluderMesh::createFromMeshData(const weEngineModel::MeshData& meshData, uint32_t lod)
+	{
+		auto occluder = std::make_shared<weEngineOccluderMesh>();
+		std::vector<uint32_t> remap(meshData.vertexCount, UINT32_MAX);
+
+		auto addVertex = [&](uint32_t vertex)
+		{
+			if (remap[vertex] == UINT32_MAX)
+			{
+				remap[vertex] = static_cast<uint32_t>(occluder->positions.size());
+				occluder->positions.push_back(meshData.vertices[vertex].position);
+			}
+			occluder->indices.push_back(remap[vertex]);
+		};
+
+		auto addIndices = [&](uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset)
+		{
+			for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+			{
+				addVertex(static_cast<uint32_t>(static_cast<int32_t>(meshData.indices[i]) + vertexOffset));
+			}
+		};
+
+		if (meshData.indices == nullptr)
+		{
+			for (uint32_t vertex = 0; vertex < meshData.vertexCount; vertex++)
+			{
+				addVertex(vertex);
+			}
+		}
+		else if (meshData.lodCount == 0)
+		{
+			addIndices(0, meshData.indexCount, 0);
+		}
+		else
+		{
+			const weEngineModel::LodLevel& level = meshData.lods[std::min(lod, meshData.lodCount - 1)];
+			if (meshData.rangeCount > 0)
+			{
+				for (uint32_t range = level.firstRange; range < level.firstRange + level.rangeCount; range++)
+				{
+					addIndices(meshData.ranges[range].firstIndex, meshData.ranges[range].indexCount, meshData.ranges[range].vertexOffset);
+				}
+			}
+			else
+			{
+				addIndices(level.firstIndex, level.indexCount, 0);
+			}
+		}
+
+		occluder->indices.resize(occluder->indices.size() / 3 * 3);
+		return occluder;
+	}
+
+	weEngineOcclusionCuller::weEngineOcclusionCuller(uint32_t width, uint32_t height)
+	{
+		tileCountX = std::max(1u, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+		tileCountY = std::max(1u, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+		this->width = tileCountX * TILE_WIDTH;
+		this->height = tileCountY * TILE_HEIGHT;
+
+		depthBuffer.resize(static_cast<size_t>(this->width) * this->height, 1.0f);
+		tileMaximumDepths.resize(static_cast<size_t>(tileCountX) * tileCountY, 1.0f);
+	}
+
+	void weEngineOcclusionCuller::beginFrame(const glm::mat4& projectionView)
+	{
+		this->projectionView = projectionView;
+		occluderTransforms.clear();
+		occluderMeshes.clear();
+
+		std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+		std::fill(tileMaximumDepths.begin(), tileMaximumDepths.end(), 1.0f);
+
+		statistics = Statistics{};
+	}
+
+	void weEngineOcclusionCuller::addOccluder(const weEngineOccluderMesh& mesh, const glm::mat4& transform)
+	{
+		occluderTransforms.push_back(projectionView * transform);
+		occluderMeshes.push_back(&mesh);
+		statistics.occluderCount++;
+		statistics.occluderTriangleCount += mesh.getTriangleCount();
+	}
+
+	/*
+	* The occluders are projected in parallel, one task per occluder, then the bands of the screen are rasterized in parallel.
+	* Every band goes through the triangles of all the occluders and only touches its own rows.
+	* The triangle lists of the occluders are kept between frames for their capacity, the ones past the occluders of the frame are stale.
+	*/
+	void weEngineOcclusionCuller::rasterize()
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
+
+		const uint32_t occluderCount = static_cast<uint32_t>(occluderMeshes.size());
+		if (occluderTriangles.size() < occluderCount)
+		{
+			occluderTriangles.resize(occluderCount);
+		}
+
+		jobSystem.parallelFor(occluderCount, [this](uint32_t occluder)
+			{
+				thread_local std::vector<glm::vec4> clipPositions;
+
+				const weEngineOccluderMesh& mesh = *occluderMeshes[occluder];
+				const glm::mat4& transform = occluderTransforms[occluder];
+				clipPositions.resize(mesh.positions.size());
+				for (size_t i = 0; i < mesh.positions.size(); i++)
+				{
+					clipPositions[i] = transform * glm::vec4(mesh.positions[i], 1.0f);
+				}
+
+				std::vector<ScreenTriangle>& triangles = occluderTriangles[occluder];
+				triangles.clear();
+				for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+				{
+					setupTriangle(clipPositions[mesh.indices[i]], clipPositions[mesh.indices[i + 1]], clipPositions[mesh.indices[i + 2]], triangles);
+				}
+			});
+
+		for (uint32_t occluder = 0; occluder < occluderCount; occluder++)
+		{
+			statistics.rasterizedTriangleCount += static_cast<uint32_t>(occluderTriangles[occluder].size());
+		}
+
+		const uint32_t bandCount = (tileCountY + TILE_ROWS_PER_BAND - 1) / TILE_ROWS_PER_BAND;
+		if (statistics.rasterizedTriangleCount > 0)
+		{
+			jobSystem.parallelFor(bandCount, [this](uint32_t band) { rasterizeBand(band); });
+		}
+
+		statistics.rasterizeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	/*
+	* Clips the triangle against the near plane, which can turn it into a quad drawn as two triangles, and projects it to pixels.
+	* The triangles entirely outside of one of the other planes are dropped, the others are only clamped to the screen when rasterized.
+	*/
+	void weEngineOcclusionCuller::setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::vector<ScreenTriangle>& triangles) const
+	{
+		const glm::vec4 input[3] = { a, b, c };
+		if ((a.x < -a.w && b.x < -b.w && c.x < -c.w) || (a.x > a.w && b.x > b.w && c.x > c.w) ||
+			(a.y < -a.w && b.y < -b.w && c.y < -c.w) || (a.y > a.w && b.y > b.w && c.y > c.w) ||
+			(a.z < 0.0f && b.z < 0.0f && c.z < 0.0f) || (a.z > a.w && b.z > b.w && c.z > c.w))
+		{
+			return;
+		}
+
+		glm::vec4 clipped[4];
+		uint32_t clippedCount = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const glm::vec4& current = input[i];
+			const glm::vec4& next = input[(i + 1) % 3];
+			if (current.z >= 0.0f)
+			{
+				clipped[clippedCount++] = current;
+			}
+			if ((current.z >= 0.0f) != (next.z >= 0.0f))
+			{
+				clipped[clippedCount++] = glm::mix(current, next, current.z / (current.z - next.z));
+			}
+		}
+
+		glm::vec3 screen[4];
+		for (uint32_t i = 0; i < clippedCount; i++)
+		{
+			const float inverseW = 1.0f / clipped[i].w;
+			screen[i] = {
+				(clipped[i].x * inverseW * 0.5f + 0.5f) * static_cast<float>(width),
+				(clipped[i].y * inverseW * 0.5f + 0.5f) * static_cast<float>(height),
+				clipped[i].z * inverseW };
+		}
+
+		for (uint32_t i = 1; i + 1 < clippedCount; i++)
+		{
+			const glm::vec3& v0 = screen[0];
+			glm::vec3 v1 = screen[i];
+			glm::vec3 v2 = screen[i + 1];
+
+			//The rasterizer expects counter clockwise triangles in pixel coordinates, both windings are occluders since the pipeline does not cull faces
+			float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+			if (area < 0.0f)
+			{
+				std::swap(v1, v2);
+				area = -area;
+			}
+			if (area < 1e-6f)
+			{
+				continue;
+			}
+
+			ScreenTriangle triangle;
+			triangle.vertices[0] = glm::vec2(v0);
+			triangle.vertices[1] = glm::vec2(v1);
+			triangle.vertices[2] = glm::vec2(v2);
+
+			const float depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+			const float depthY = ((v1.x - v0.x) * (v2.z - v0.z) - (v2.x - v0.x) * (v1.z - v0.z)) / area;
+			triangle.depthPlane = { depthX, depthY, v0.z - depthX * v0.x - depthY * v0.y };
+
+			//Pixels whose center is inside the bounding rectangle
+			const glm::vec2 minimum = glm::vec2(glm::min(v0, glm::min(v1, v2)));
+			const glm::vec2 maximum = glm::vec2(glm::max(v0, glm::max(v1, v2)));
+			triangle.minimumX = std::max(0, static_cast<int>(std::ceil(minimum.x - 0.5f)));
+			triangle.minimumY = std::max(0, static_cast<int>(std::ceil(minimum.y - 0.5f)));
+			triangle.maximumX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(maximum.x - 0.5f)));
+			triangle.maximumY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(maximum.y - 0.5f)));
+			if (triangle.minimumX > triangle.maximumX || triangle.minimumY > triangle.maximumY)
+			{
+				continue;
+			}
+
+			triangles.push_back(triangle);
+		}
+	}
+
+	void weEngineOcclusionCuller::rasterizeBand(uint32_t band)
+	{
+		const uint32_t firstTileRow = band * TILE_ROWS_PER_BAND;
+		const uint32_t endTileRow = std::min(firstTileRow + TILE_ROWS_PER_BAND, tileCountY);
+		const int bandMinimumY = static_cast<int>(firstTileRow * TILE_HEIGHT);
+		const int bandMaximumY = static_cast<int>(endTileRow * TILE_HEIGHT) - 1;
+
+		//Only the occluders of this frame, the lists after them were projected with the camera of an earlier frame
+		for (size_t occluder = 0; occluder < occluderMeshes.size(); occluder++)
+		{
+			for (const ScreenTriangle& triangle : occluderTriangles[occluder])
+			{
+				if (triangle.maximumY >= bandMinimumY && triangle.minimumY <= bandMaximumY)
+				{
+					rasterizeTriangle(triangle, bandMinimumY, bandMaximumY);
+				}
+			}
+		}
+
+		//The tiles of the band keep the farthest depth of their pixels, which lets the tests skip the tiles entirely in front of a box
+		for (uint32_t tileY = firstTileRow; tileY < endTileRow; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tileCountX; tileX++)
+			{
+				const float* tile = getTile(tileX, tileY);
+				tileMaximumDepths[tileY * tileCountX + tileX] = *std::max_element(tile, tile + TILE_WIDTH * TILE_HEIGHT);
+			}
+		}
+	}
+
+	/*
+	* The edge functions and the depth are affine in the pixel position, so a row of pixels is evaluated by adding their slopes to the
+	* values of the first pixel. A pixel is covered when its center is on the inner side of the three edges, and keeps the nearest depth.
+	*/
+	void weEngineOcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int bandMinimumY, int bandMaximumY)
+	{
+		float edgeX[3], edgeY[3], edgeConstant[3];
+		for (uint32_t edge = 0; edge < 3; edge++)
+		{
+			const glm::vec2& start = triangle.vertices[edge];
+			const glm::vec2& end = triangle.vertices[(edge + 1) % 3];
+			edgeX[edge] = start.y - end.y;
+			edgeY[edge] = end.x - start.x;
+			edgeConstant[edge] = -(edgeX[edge] * start.x + edgeY[edge] * start.y);
+		}
+
+		const int minimumY = std::max(triangle.minimumY, bandMinimumY);
+		const int maximumY = std::min(triangle.maximumY, bandMaximumY);
+		const int firstColumn = triangle.minimumX / static_cast<int>(TILE_WIDTH) * static_cast<int>(TILE_WIDTH);
+
+#if defined(WE_ENGINE_OCCLUSION_SSE)
+		const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 edgeSlopes[3] = { _mm_set1_ps(edgeX[0]), _mm_set1_ps(edgeX[1]), _mm_set1_ps(edgeX[2]) };
+		const __m128 depthSlope = _mm_set1_ps(triangle.depthPlane.x);
+#endif
+
+		for (int y = minimumY; y <= maximumY; y++)
+		{
+			const float centerY = static_cast<float>(y) + 0.5f;
+			float* row = getTile(0, y / TILE_HEIGHT) + (y % TILE_HEIGHT) * TILE_WIDTH;
+
+			float rowEdges[3];
+			for (uint32_t edge = 0; edge < 3; edge++)
+			{
+				rowEdges[edge] = edgeY[edge] * centerY + edgeConstant[edge];
+			}
+			const float rowDepth = triangle.depthPlane.y * centerY + triangle.depthPlane.z;
+
+			for (int x = firstColumn; x <= triangle.maximumX; x += 4)
+			{
+				float* pixels = row + (x / TILE_WIDTH) * TILE_WIDTH * TILE_HEIGHT + (x % TILE_WIDTH);
+#if defined(WE_ENGINE_OCCLUSION_SSE)
+				const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeSlopes[0], centerX), _mm_set1_ps(rowEdges[0])), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeSlopes[1], centerX), _mm_set1_ps(rowEdges[1])), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeSlopes[2], centerX), _mm_set1_ps(rowEdges[2])), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 depth = _mm_max_ps(_mm_add_ps(_mm_mul_ps(depthSlope, centerX), _mm_set1_ps(rowDepth)), zero);
+				const __m128 current = _mm_loadu_ps(pixels);
+				const __m128 nearest = _mm_min_ps(current, depth);
+				_mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+#else
+				for (int lane = 0; lane < 4; lane++)
+				{
+					const float centerX = static_cast<float>(x + lane) + 0.5f;
+					if (edgeX[0] * centerX + rowEdges[0] >= 0.0f && edgeX[1] * centerX + rowEdges[1] >= 0.0f && edgeX[2] * centerX + rowEdges[2] >= 0.0f)
+					{
+						const float depth = std::max(triangle.depthPlane.x * centerX + rowDepth, 0.0f);
+						pixels[lane] = std::min(pixels[lane], depth);
+					}
+				}
+#endif
+			}
+		}
+	}
+
+	void weEngineOcclusionCuller::cullBoxes(const std::vector<glm::vec3>& minimums, const std::vector<glm::vec3>& maximums, std::vector<uint32_t>& visibleIndices)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		const uint32_t count = static_cast<uint32_t>(minimums.size());
+		boxVisibility.resize(count);
+
+		const uint32_t taskCount = (count + BOXES_PER_TEST_TASK - 1) / BOXES_PER_TEST_TASK;
+		weEngineJobSystem::shared().parallelFor(taskCount, [&](uint32_t task)
+			{
+				const uint32_t end = std::min(count, (task + 1) * BOXES_PER_TEST_TASK);
+				for (uint32_t i = task * BOXES_PER_TEST_TASK; i < end; i++)
+				{
+					boxVisibility[i] = isBoxVisible(minimums[i], maximums[i]) ? 1 : 0;
+				}
+			});
+
+		visibleIndices.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (boxVisibility[i] != 0)
+			{
+				visibleIndices.push_back(i);
+			}
+		}
+
+		statistics.occludeeCount += count;
+		statistics.occludedCount += count - static_cast<uint32_t>(visibleIndices.size());
+		statistics.testMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	/*
+	* The box is projected to the screen rectangle of its corners and the depth of its nearest corner.
+	* It is hidden when every pixel of that rectangle holds an occluder nearer than the nearest corner.
+	*/
+	bool weEngineOcclusionCuller::isBoxVisible(const glm::vec3& minimum, const glm::vec3& maximum) const
+	{
+		glm::vec2 screenMinimum{ FLT_MAX };
+		glm::vec2 screenMaximum{ -FLT_MAX };
+		float nearestDepth = 1.0f;
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const glm::vec3 position{
+				(corner & 1) ? maximum.x : minimum.x,
+				(corner & 2) ? maximum.y : minimum.y,
+				(corner & 4) ? maximum.z : minimum.z };
+			const glm::vec4 clip = projectionView * glm::vec4(position, 1.0f);
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+			{
+				return true;
+			}
+
+			const float inverseW = 1.0f / clip.w;
+			const glm::vec2 screen{
+				(clip.x * inverseW * 0.5f + 0.5f) * static_cast<float>(width),
+				(clip.y * inverseW * 0.5f + 0.5f) * static_cast<float>(height) };
+			screenMinimum = glm::min(screenMinimum, screen);
+			screenMaximum = glm::max(screenMaximum, screen);
+			nearestDepth = std::min(nearestDepth, clip.z * inverseW);
+		}
+
+		//The occluders only cover the pixels whose center they cover, so the rectangle is grown by half a pixel to also test
+		//the neighbours of the pixels it touches. Otherwise a box could hide behind an occluder that covers less than the whole pixel.
+		const int minimumX = std::max(0, static_cast<int>(std::floor(screenMinimum.x - 0.5f)));
+		const int minimumY = std::max(0, static_cast<int>(std::floor(screenMinimum.y - 0.5f)));
+		const int maximumX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(screenMaximum.x + 0.5f)));
+		const int maximumY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(screenMaximum.y + 0.5f)));
+		if (minimumX > maximumX || minimumY > maximumY)
+		{
+			return true; //Off the screen, left to the frustum culling
+		}
+
+		return isRectVisible(minimumX, minimumY, maximumX, maximumY, nearestDepth);
+	}
+
+	bool weEngineOcclusionCuller::isRectVisible(int minimumX, int minimumY, int maximumX, int maximumY, float nearestDepth) const
+	{
+		const int tileWidth = static_cast<int>(TILE_WIDTH);
+		const int tileHeight = static_cast<int>(TILE_HEIGHT);
+
+#if defined(WE_ENGINE_OCCLUSION_SSE)
+		const __m128 depth = _mm_set1_ps(nearestDepth);
+		const __m128i laneIndices = _mm_setr_epi32(0, 1, 2, 3);
+#endif
+
+		for (int tileY = minimumY / tileHeight; tileY <= maximumY / tileHeight; tileY++)
+		{
+			for (int tileX = minimumX / tileWidth; tileX <= maximumX / tileWidth; tileX++)
+			{
+				if (tileMaximumDepths[tileY * tileCountX + tileX] <= nearestDepth)
+				{
+					continue; //Every pixel of the tile is in front of the box
+				}
+
+				const float* tile = getTile(tileX, tileY);
+				const int firstX = std::max(minimumX - tileX * tileWidth, 0);
+				const int lastX = std::min(maximumX - tileX * tileWidth, tileWidth - 1);
+				const int firstY = std::max(minimumY - tileY * tileHeight, 0);
+				const int lastY = std::min(maximumY - tileY * tileHeight, tileHeight - 1);
+
+				for (int y = firstY; y <= lastY; y++)
+				{
+					const float* row = tile + y * tileWidth;
+#if defined(WE_ENGINE_OCCLUSION_SSE)
+					for (int x = 0; x < tileWidth; x += 4)
+					{
+						const __m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), laneIndices);
+						const __m128i inRect = _mm_andnot_si128(
+							_mm_or_si128(_mm_cmplt_epi32(lanes, _mm_set1_epi32(firstX)), _mm_cmpgt_epi32(lanes, _mm_set1_epi32(lastX))),
+							_mm_set1_epi32(-1));
+						const __m128 behind = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), depth), _mm_castsi128_ps(inRect));
+						if (_mm_movemask_ps(behind) != 0)
+						{
+							return true;
+						}
+					}
+#else
+					for (int x = firstX; x <= lastX; x++)
+					{
+						if (row[x] > nearestDepth)
+						{
+							return true;
+						}
+					}
+#endif
+				}
+			}
+		}
+
+		return false;
+	}
+
+	/*
+	* The depths of a perspective projection crowd near 1, so the covered depths are stretched over the grey levels
+	* and the pixels left on the far plane are written white.
+	*/
+	void weEngineOcclusionCuller::writeDebugImage(const std::string& filepath) const
+	{
+		std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			throw std::runtime_error("Failed to open the occlusion debug image " + filepath);
+		}
+
+		float nearest = 1.0f;
+		for (float depth : depthBuffer)
+		{
+			nearest = std::min(nearest, depth);
+		}
+		const float scale = nearest < 1.0f ? 254.0f / (1.0f - nearest) : 0.0f;
+
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const float* row = getTile(0, y / TILE_HEIGHT) + (y % TILE_HEIGHT) * TILE_WIDTH;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const float depth = row[(x / TILE_WIDTH) * TILE_WIDTH * TILE_HEIGHT + (x % TILE_WIDTH)];
+				pixels[y * width + x] = depth >= 1.0f ? 255 : static_cast<uint8_t>((depth - nearest) * scale);
+			}
+		}
+
+		file << "P5\n" << width << " " << height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	}
+
+	const char* weEngineOcclusionCuller::getKernelName()
+	{
+#if defined(WE_ENGINE_OCCLUSION_SSE)
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+}
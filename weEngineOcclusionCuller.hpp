@@ -0,0 +1,154 @@
+#pragma once
+
+/*
+* weEngineOcclusionCuller rasterizes a few designated occluder meshes into a small depth buffer on the CPU, then tests the screen space
+* bounds of the objects against it to skip the ones hidden behind the occluders.
+*
+* The depth buffer is stored in tiles of TILE_WIDTH x TILE_HEIGHT pixels, each tile keeping the farthest depth of its pixels.
+* The screen is split into horizontal bands of tiles rasterized in parallel by the worker threads, every thread owns its band
+* so no pixel is written by two threads. The pixels of a tile row are shaded and tested four at a time with SSE when available.
+* Depths follow the Vulkan convention of the projection: 0 on the near plane, 1 on the far plane.
+*/
+
+#include "weEngineModel.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "cstdint"
+#include "memory"
+#include "string"
+#include "vector"
+
+namespace weEngine
+{
+	//Simplified triangle mesh rasterized by the occlusion culler, in model space. It should not stick out of the mesh it stands for.
+	struct weEngineOccluderMesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+
+		//Builds the occluder from one detail level of the mesh data, clamped to the coarsest one, keeping only the vertices that level uses
+		static std::shared_ptr<weEngineOccluderMesh> createFromMeshData(const weEngineModel::MeshData& meshData, uint32_t lod);
+
+		uint32_t getTriangleCount() const
+		{
+			return static_cast<uint32_t>(indices.size() / 3);
+		}
+	};
+
+	class weEngineOcclusionCuller
+	{
+	public:
+		static constexpr uint32_t TILE_WIDTH = 8;
+		static constexpr uint32_t TILE_HEIGHT = 4;
+		static constexpr uint32_t DEFAULT_WIDTH = 320;
+		static constexpr uint32_t DEFAULT_HEIGHT = 192;
+
+		//Tile rows rasterized by one task, small enough to give every worker a few bands
+		static constexpr uint32_t TILE_ROWS_PER_BAND = 4;
+
+		//Boxes tested by one task of the occludee test
+		static constexpr uint32_t BOXES_PER_TEST_TASK = 256;
+
+		struct Statistics
+		{
+			uint32_t occluderCount = 0;
+			uint32_t occluderTriangleCount = 0; //Triangles of the occluders, before clipping
+			uint32_t rasterizedTriangleCount = 0; //Triangles left after clipping and rejecting the ones outside of the screen
+			uint32_t occludeeCount = 0; //Boxes tested
+			uint32_t occludedCount = 0; //Boxes found hidden
+			float rasterizeMilliseconds = 0.0f;
+			float testMilliseconds = 0.0f;
+		};
+
+		explicit weEngineOcclusionCuller(uint32_t width = DEFAULT_WIDTH, uint32_t height = DEFAULT_HEIGHT);
+
+		weEngineOcclusionCuller(const weEngineOcclusionCuller&) = delete;
+		weEngineOcclusionCuller& operator=(const weEngineOcclusionCuller&) = delete;
+
+		//Starts a new frame: forgets the occluders and clears the depth buffer to the far plane
+		void beginFrame(const glm::mat4& projectionView);
+
+		void addOccluder(const weEngineOccluderMesh& mesh, const glm::mat4& transform);
+
+		//Rasterizes the occluders added since beginFrame, on the worker threads of the shared job system
+		void rasterize();
+
+		/*
+		* Tests the world space boxes [minimums[i], maximums[i]] against the depth buffer, and writes to visibleIndices, in increasing order,
+		* the indices of the boxes that may be visible. A box crossing the near plane is always visible.
+		*/
+		void cullBoxes(const std::vector<glm::vec3>& minimums, const std::vector<glm::vec3>& maximums, std::vector<uint32_t>& visibleIndices);
+
+		//Returns true when part of the box may be in front of the occluders
+		bool isBoxVisible(const glm::vec3& minimum, const glm::vec3& maximum) const;
+
+		//Writes the depth buffer as a binary grey scale PGM image, near depths dark, far depths bright
+		void writeDebugImage(const std::string& filepath) const;
+
+		uint32_t getWidth() const
+		{
+			return width;
+		}
+
+		uint32_t getHeight() const
+		{
+			return height;
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		//Name of the instruction set the kernels were compiled for
+		static const char* getKernelName();
+
+	private:
+		//Occluder triangle after projection, in pixels, with the depth as an affine function of the pixel position
+		struct ScreenTriangle
+		{
+			glm::vec2 vertices[3];
+			glm::vec3 depthPlane; //depth = x * depthPlane.x + y * depthPlane.y + depthPlane.z
+			int minimumX, minimumY, maximumX, maximumY; //Covered pixels, clamped to the screen
+		};
+
+		void setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::vector<ScreenTriangle>& triangles) const;
+		void rasterizeBand(uint32_t band);
+		void rasterizeTriangle(const ScreenTriangle& triangle, int bandMinimumY, int bandMaximumY);
+		bool isRectVisible(int minimumX, int minimumY, int maximumX, int maximumY, float nearestDepth) const;
+
+		float* getTile(uint32_t tileX, uint32_t tileY)
+		{
+			return depthBuffer.data() + (tileY * tileCountX + tileX) * TILE_WIDTH * TILE_HEIGHT;
+		}
+
+		const float* getTile(uint32_t tileX, uint32_t tileY) const
+		{
+			return depthBuffer.data() + (tileY * tileCountX + tileX) * TILE_WIDTH * TILE_HEIGHT;
+		}
+
+		uint32_t width;
+		uint32_t height;
+		uint32_t tileCountX;
+		uint32_t tileCountY;
+
+		std::vector<float> depthBuffer; //Tile after tile, the pixels of a tile row after row
+		std::vector<float> tileMaximumDepths;
+
+		glm::mat4 projectionView{ 1.0f };
+
+		//Occluder world transforms and meshes of the frame, projected in parallel by rasterize
+		std::vector<glm::mat4> occluderTransforms;
+		std::vector<const weEngineOccluderMesh*> occluderMeshes;
+		std::vector<std::vector<ScreenTriangle>> occluderTriangles;
+
+		std::vector<uint8_t> boxVisibility; //Result of cullBoxes for every box, before compaction
+
+		Statistics statistics{};
+	};
+}
@@ -101,14 +101,14 @@ namespace weEngine
 		shaderStages[1].pSpecializationInfo = nullptr;
 
 
-		auto bindingDescriptions = weEngineModel::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = weEngineModel::Vertex::getAttributeDescriptions();
+		auto& bindingDescriptions = configInfo.bindingDescriptions;
+		auto& attributeDescriptions = configInfo.attributeDescriptions;
 		
 		//Tells vulkan how to read the vertex input buffer
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()); //From Vertex struct
-		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size()); //From Vertex struct
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()); //From the vertex layout
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size()); //From the vertex layout
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 
@@ -237,6 +237,11 @@ namespace weEngine
 		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
 
+		//Reads every attribute of the model vertex layout, pipelines replace the attribute descriptions to read less
+		constexpr auto attributeDescriptions = weEngineModel::VertexLayout::getAttributeDescriptions();
+		configInfo.bindingDescriptions = { weEngineModel::VertexLayout::getBindingDescription() };
+		configInfo.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+
 	}
 
 	//Binds the command buffer to the pipeline
@@ -244,4 +249,50 @@ namespace weEngine
 	{
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
+
+	weEngineComputePipeline::weEngineComputePipeline(
+		weEngine::weEngineDevice& device,
+		const std::string computePath,
+		VkPipelineLayout pipelineLayout) : weEngineDevice{ device }
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot Create compute pipeline:: no pipeline layout provided");
+
+		auto computeCode = weEnginePipeline::readFile(computePath);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = computeCode.size();
+		moduleInfo.pCode = reinterpret_cast<uint32_t*>(computeCode.data());
+
+		if (vkCreateShaderModule(weEngineDevice.device(), &moduleInfo, nullptr, &computeShaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = computeShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(weEngineDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Compute Pipeline.");
+		}
+	}
+
+	weEngineComputePipeline::~weEngineComputePipeline()
+	{
+		vkDestroyShaderModule(weEngineDevice.device(), computeShaderModule, nullptr);
+		vkDestroyPipeline(weEngineDevice.device(), computePipeline, nullptr);
+	}
+
+	void weEngineComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
 }
\ No newline at end of file
@@ -18,6 +18,8 @@ namespace weEngine
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 		VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -73,5 +75,32 @@ namespace weEngine
 		VkShaderModule vertShaderModule;
 		VkShaderModule fragShaderModule;
 
+		friend class weEngineComputePipeline;
+	};
+
+	/*
+	*
+	* weEngineComputePipeline handles a pipeline running a single compute shader.
+	*
+	*/
+	class weEngineComputePipeline
+	{
+	public:
+		weEngineComputePipeline(
+			weEngineDevice& device,
+			const std::string computePath,
+			VkPipelineLayout pipelineLayout);
+		~weEngineComputePipeline();
+
+		weEngineComputePipeline(const weEngineComputePipeline&) = delete;
+		weEngineComputePipeline operator=(const weEngineComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		weEngineDevice& weEngineDevice;
+
+		VkPipeline computePipeline;
+		VkShaderModule computeShaderModule;
 	};
 }
\ No newline at end of file
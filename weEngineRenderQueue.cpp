@@ -0,0 +1,151 @@
+#include "weEngineRenderQueue.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "algorithm"
+#include "chrono"
+#include "cstring"
+#include "stdexcept"
+
+namespace weEngine
+{
+	uint32_t weEngineSortKey::quantizeDepth(float depth)
+	{
+		if (!(depth > 0.0f))
+		{
+			return 0;
+		}
+
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return bits >> (31 - DEPTH_BITS); //Drops the sign, which is zero, and the low mantissa bits
+	}
+
+	void weEngineRenderQueue::clear()
+	{
+		entries.clear();
+		pipelines.clear();
+		models.clear();
+		pipelineIndices.clear();
+		modelIndices.clear();
+	}
+
+	uint32_t weEngineRenderQueue::registerPipeline(weEnginePipeline* pipeline)
+	{
+		const auto inserted = pipelineIndices.emplace(pipeline, static_cast<uint32_t>(pipelines.size()));
+		if (inserted.second)
+		{
+			if (pipelines.size() >= (1u << weEngineSortKey::PIPELINE_BITS))
+			{
+				throw std::runtime_error("Too many pipelines in the render queue");
+			}
+			pipelines.push_back(pipeline);
+		}
+		return inserted.first->second;
+	}
+
+	uint32_t weEngineRenderQueue::registerModel(weEngineModel* model)
+	{
+		const auto inserted = modelIndices.emplace(model, static_cast<uint32_t>(models.size()));
+		if (inserted.second)
+		{
+			if (models.size() >= (1u << weEngineSortKey::MODEL_BITS))
+			{
+				throw std::runtime_error("Too many models in the render queue");
+			}
+			models.push_back(model);
+		}
+		return inserted.first->second;
+	}
+
+	void weEngineRenderQueue::sort()
+	{
+		sort(weEngineJobSystem::shared());
+	}
+
+	/*
+	* Least significant digit radix sort, one pass per byte of the key. Each pass counts the digits of every task's range of entries,
+	* turns the counts into the offset where each task writes each digit, then every task scatters its range in order, which keeps the sort stable.
+	*/
+	void weEngineRenderQueue::sort(weEngineJobSystem& jobSystem)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		const uint32_t entryCount = static_cast<uint32_t>(entries.size());
+		statistics.entryCount = entryCount;
+		statistics.radixPassCount = 0;
+		statistics.sortTaskCount = 0;
+		if (entryCount < 2)
+		{
+			statistics.sortMilliseconds = 0.0f;
+			return;
+		}
+
+		//The bytes where no key differs from the first one would not move any entry
+		uint64_t varyingBits = 0;
+		const uint64_t firstKey = entries[0].key;
+		for (const Entry& entry : entries)
+		{
+			varyingBits |= entry.key ^ firstKey;
+		}
+
+		const uint32_t taskCount = std::max(1u, std::min(jobSystem.getThreadCount(), entryCount / MIN_ENTRIES_PER_SORT_TASK));
+		const uint32_t entriesPerTask = (entryCount + taskCount - 1) / taskCount;
+		statistics.sortTaskCount = taskCount;
+
+		sortedEntries.resize(entryCount);
+		digitOffsets.resize(static_cast<size_t>(taskCount) * RADIX_SIZE);
+
+		for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS)
+		{
+			if (((varyingBits >> shift) & (RADIX_SIZE - 1)) == 0)
+			{
+				continue;
+			}
+
+			const Entry* source = entries.data();
+			Entry* destination = sortedEntries.data();
+
+			jobSystem.parallelFor(taskCount, [&](uint32_t task)
+				{
+					uint32_t* counts = digitOffsets.data() + static_cast<size_t>(task) * RADIX_SIZE;
+					std::fill(counts, counts + RADIX_SIZE, 0u);
+
+					const uint32_t end = std::min(entryCount, (task + 1) * entriesPerTask);
+					for (uint32_t i = task * entriesPerTask; i < end; i++)
+					{
+						counts[(source[i].key >> shift) & (RADIX_SIZE - 1)]++;
+					}
+				});
+
+			//Digit after digit, the tasks in order, so equal digits keep the order of the entries
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < RADIX_SIZE; digit++)
+			{
+				for (uint32_t task = 0; task < taskCount; task++)
+				{
+					uint32_t& count = digitOffsets[static_cast<size_t>(task) * RADIX_SIZE + digit];
+					const uint32_t digitCount = count;
+					count = offset;
+					offset += digitCount;
+				}
+			}
+
+			jobSystem.parallelFor(taskCount, [&](uint32_t task)
+				{
+					uint32_t* offsets = digitOffsets.data() + static_cast<size_t>(task) * RADIX_SIZE;
+
+					const uint32_t end = std::min(entryCount, (task + 1) * entriesPerTask);
+					for (uint32_t i = task * entriesPerTask; i < end; i++)
+					{
+						destination[offsets[(source[i].key >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+					}
+				});
+
+			entries.swap(sortedEntries);
+			statistics.radixPassCount++;
+		}
+
+		statistics.sortMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+/*
+* weEngineRenderQueue collects the draws of a frame as 64 bit sort keys and orders them with a radix sort, so the draws sharing
+* a pipeline and a model follow each other and the recording loop only binds what changed from the previous draw.
+*
+* From the most to the least significant bits a key holds the pass, the pipeline, the material, the model, the detail level and the
+* view depth. The pipelines and models of the frame are registered in the queue and referenced by their index in the key.
+* The sort runs one pass per byte of the key, the bytes every key shares are skipped, and the passes are split across the
+* worker threads of the shared job system for large queues.
+*/
+
+//std
+#include "cstdint"
+#include "unordered_map"
+#include "vector"
+
+namespace weEngine
+{
+	class weEnginePipeline;
+	class weEngineModel;
+	class weEngineJobSystem;
+
+	struct weEngineSortKey
+	{
+		static constexpr uint32_t DEPTH_BITS = 20;
+		static constexpr uint32_t LOD_BITS = 4;
+		static constexpr uint32_t MODEL_BITS = 16;
+		static constexpr uint32_t MATERIAL_BITS = 12;
+		static constexpr uint32_t PIPELINE_BITS = 8;
+		static constexpr uint32_t PASS_BITS = 4;
+
+		static constexpr uint32_t DEPTH_SHIFT = 0;
+		static constexpr uint32_t LOD_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+		static constexpr uint32_t MODEL_SHIFT = LOD_SHIFT + LOD_BITS;
+		static constexpr uint32_t MATERIAL_SHIFT = MODEL_SHIFT + MODEL_BITS;
+		static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+		static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+		static_assert(PASS_SHIFT + PASS_BITS == 64, "The sort key fields must fill 64 bits");
+
+		//Passes drawn in increasing order
+		enum Pass : uint32_t
+		{
+			PASS_OPAQUE = 0
+		};
+
+		static uint64_t encode(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t lod, uint32_t depth)
+		{
+			return (static_cast<uint64_t>(pass) << PASS_SHIFT)
+				| (static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT)
+				| (static_cast<uint64_t>(material) << MATERIAL_SHIFT)
+				| (static_cast<uint64_t>(model) << MODEL_SHIFT)
+				| (static_cast<uint64_t>(lod) << LOD_SHIFT)
+				| (static_cast<uint64_t>(depth) << DEPTH_SHIFT);
+		}
+
+		/*
+		* Quantizes a view depth to DEPTH_BITS bits, increasing with the depth so the opaque draws of a group go front to back.
+		* The bits of a positive float sort like its value, keeping the exponent and the top of the mantissa gives about
+		* the same relative precision at every distance without knowing the depth range. Negative depths map to zero.
+		*/
+		static uint32_t quantizeDepth(float depth);
+
+		static uint32_t getPipeline(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> PIPELINE_SHIFT) & ((1u << PIPELINE_BITS) - 1);
+		}
+
+		static uint32_t getModel(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> MODEL_SHIFT) & ((1u << MODEL_BITS) - 1);
+		}
+
+		static uint32_t getLod(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> LOD_SHIFT) & ((1u << LOD_BITS) - 1);
+		}
+
+		//Keys with the same state drawn with the same instanced draw, whatever their depth
+		static bool isSameState(uint64_t a, uint64_t b)
+		{
+			return (a >> LOD_SHIFT) == (b >> LOD_SHIFT);
+		}
+	};
+
+	class weEngineRenderQueue
+	{
+	public:
+		static constexpr uint32_t RADIX_BITS = 8;
+		static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+		//Smallest number of entries a sort task works on, smaller queues are sorted on the calling thread
+		static constexpr uint32_t MIN_ENTRIES_PER_SORT_TASK = 4096;
+
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t objectIndex;
+			uint32_t padding;
+		};
+
+		struct Statistics
+		{
+			uint32_t entryCount = 0;
+			uint32_t radixPassCount = 0; //Passes run by the last sort, the bytes shared by every key are skipped
+			uint32_t sortTaskCount = 0; //Tasks each pass was split into
+			float sortMilliseconds = 0.0f;
+		};
+
+		weEngineRenderQueue() = default;
+
+		weEngineRenderQueue(const weEngineRenderQueue&) = delete;
+		weEngineRenderQueue& operator=(const weEngineRenderQueue&) = delete;
+
+		//Forgets the entries, pipelines and models of the previous frame
+		void clear();
+
+		//Indices of the pipelines and models in the keys, in the order they are first registered during the frame
+		uint32_t registerPipeline(weEnginePipeline* pipeline);
+		uint32_t registerModel(weEngineModel* model);
+
+		void push(uint64_t key, uint32_t objectIndex)
+		{
+			entries.push_back({ key, objectIndex, 0 });
+		}
+
+		//Orders the entries by increasing key, entries with equal keys keep their push order. Large queues are split across the threads of the job system
+		void sort();
+		void sort(weEngineJobSystem& jobSystem);
+
+		const std::vector<Entry>& getEntries() const
+		{
+			return entries;
+		}
+
+		weEnginePipeline* getPipeline(uint64_t key) const
+		{
+			return pipelines[weEngineSortKey::getPipeline(key)];
+		}
+
+		weEngineModel* getModel(uint64_t key) const
+		{
+			return models[weEngineSortKey::getModel(key)];
+		}
+
+		bool isEmpty() const
+		{
+			return entries.empty();
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+	private:
+		std::vector<Entry> entries;
+		std::vector<Entry> sortedEntries; //Destination of the odd sort passes
+
+		std::vector<weEnginePipeline*> pipelines;
+		std::vector<weEngineModel*> models;
+		std::unordered_map<weEnginePipeline*, uint32_t> pipelineIndices;
+		std::unordered_map<weEngineModel*, uint32_t> modelIndices;
+
+		std::vector<uint32_t> digitOffsets; //RADIX_SIZE counts, then offsets, per sort task
+
+		Statistics statistics{};
+	};
+}
@@ -0,0 +1,157 @@
+#include "weEngineRenderThread.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "cassert"
+#include "chrono"
+#include "stdexcept"
+
+namespace weEngine
+{
+	weEngineRenderThread::weEngineRenderThread(uint32_t packetCount, std::function<void(uint32_t packetIndex)> renderPacket) : renderPacket{ std::move(renderPacket) }
+	{
+		if (packetCount < 2 || packetCount > MAX_PACKET_COUNT)
+		{
+			throw std::runtime_error("The render thread needs between 2 and MAX_PACKET_COUNT frame packets");
+		}
+
+		for (uint32_t i = 0; i < packetCount; i++)
+		{
+			freePackets.tryPush(i);
+		}
+		thread = std::thread([this]() { renderLoop(); });
+	}
+
+	weEngineRenderThread::~weEngineRenderThread()
+	{
+		if (thread.joinable())
+		{
+			stop();
+		}
+	}
+
+	uint32_t weEngineRenderThread::acquirePacket()
+	{
+		uint32_t packetIndex = 0;
+		if (freePackets.tryPop(packetIndex))
+		{
+			backPressureMilliseconds = 0.0f;
+			return packetIndex;
+		}
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
+		while (!freePackets.tryPop(packetIndex))
+		{
+			if (failed.load(std::memory_order_acquire))
+			{
+				std::rethrow_exception(failure);
+			}
+
+			//The main thread jobs do not wake the game thread, it checks them every millisecond while it waits
+			jobSystem.runMainThreadJobs();
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			packetFreed.wait_for(lock, std::chrono::milliseconds(1), [this]() { return freePackets.size() > 0 || failed.load(); });
+		}
+
+		backPressureCount++;
+		backPressureMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return packetIndex;
+	}
+
+	//The lock is taken once per frame to wake the render thread, the ring itself stays lock free
+	void weEngineRenderThread::submitPacket(uint32_t packetIndex)
+	{
+		if (failed.load(std::memory_order_acquire))
+		{
+			std::rethrow_exception(failure);
+		}
+
+		const bool pushed = submittedPackets.tryPush(packetIndex);
+		assert(pushed && "The submitted ring holds every packet");
+		(void)pushed;
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+		}
+		packetSubmitted.notify_one();
+	}
+
+	void weEngineRenderThread::stop()
+	{
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
+		assert(jobSystem.isMainThread() && "The render thread is stopped by the main thread, which runs the GLFW calls it may wait on");
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopping = true;
+		}
+		packetSubmitted.notify_one();
+
+		while (!finished.load(std::memory_order_acquire))
+		{
+			jobSystem.runMainThreadJobs();
+			std::this_thread::yield();
+		}
+		thread.join();
+	}
+
+	weEngineRenderThread::Statistics weEngineRenderThread::getStatistics() const
+	{
+		Statistics statistics{};
+		statistics.renderedPacketCount = renderedPacketCount.load(std::memory_order_relaxed);
+		statistics.queuedPacketCount = submittedPackets.size();
+		statistics.renderMilliseconds = renderMilliseconds.load(std::memory_order_relaxed);
+		statistics.backPressureCount = backPressureCount;
+		statistics.backPressureMilliseconds = backPressureMilliseconds;
+		return statistics;
+	}
+
+	void weEngineRenderThread::renderLoop()
+	{
+		while (true)
+		{
+			uint32_t packetIndex = 0;
+			if (!submittedPackets.tryPop(packetIndex))
+			{
+				if (stopping.load())
+				{
+					break;
+				}
+				std::unique_lock<std::mutex> lock(wakeMutex);
+				packetSubmitted.wait(lock, [this]() { return stopping.load() || submittedPackets.size() > 0; });
+				continue;
+			}
+			if (stopping.load())
+			{
+				break;
+			}
+
+			const auto startTime = std::chrono::high_resolution_clock::now();
+			try
+			{
+				renderPacket(packetIndex);
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+				failed.store(true, std::memory_order_release);
+				break;
+			}
+			renderMilliseconds.store(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count(), std::memory_order_relaxed);
+			renderedPacketCount.fetch_add(1, std::memory_order_relaxed);
+
+			freePackets.tryPush(packetIndex);
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+			}
+			packetFreed.notify_one();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			finished = true;
+		}
+		packetFreed.notify_one();
+	}
+}
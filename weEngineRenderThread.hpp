@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+* weEngineRenderThread records and submits frames on a thread of its own, from the frame packets the game thread simulates.
+* The packets go around through two single producer single consumer rings of packet indices: the game thread pushes a simulated packet
+* into the submitted ring, the render thread pushes it back into the free ring once the frame is recorded and submitted. A packet is
+* only used by one thread at a time and is never written while it is queued, so neither thread locks the packets.
+*
+* The game thread only waits when every packet is queued or being recorded, which holds it back when the render thread falls behind,
+* and a slow simulation step leaves the render thread idle instead of delaying the frames already queued.
+*/
+
+#include "weEngineSpscRing.hpp"
+
+//std
+#include "atomic"
+#include "condition_variable"
+#include "cstdint"
+#include "exception"
+#include "functional"
+#include "mutex"
+#include "thread"
+
+namespace weEngine
+{
+	class weEngineRenderThread
+	{
+	public:
+		//Largest number of packets going around, each ring can hold all of them
+		static constexpr uint32_t MAX_PACKET_COUNT = 8;
+
+		struct Statistics
+		{
+			uint64_t renderedPacketCount = 0;
+			uint32_t queuedPacketCount = 0; //Submitted packets the render thread has not started
+			float renderMilliseconds = 0.0f; //Recording and submission of the last packet
+			uint64_t backPressureCount = 0; //Packets the game thread had to wait for
+			float backPressureMilliseconds = 0.0f; //Time the game thread waited for its last packet
+		};
+
+		//Starts the render thread, which calls renderPacket with the index of every submitted packet, in the order they were submitted
+		weEngineRenderThread(uint32_t packetCount, std::function<void(uint32_t packetIndex)> renderPacket);
+		~weEngineRenderThread();
+
+		weEngineRenderThread(const weEngineRenderThread&) = delete;
+		weEngineRenderThread& operator=(const weEngineRenderThread&) = delete;
+
+		/*
+		* Gives the game thread a packet the render thread no longer uses, waiting for one when all of them are queued or being recorded.
+		* The main thread jobs run while it waits, the render thread hands its GLFW calls to the main thread.
+		* Throws the exception that stopped the render thread, if any.
+		*/
+		uint32_t acquirePacket();
+
+		//Queues the packet for the render thread, the game thread must not touch it until it acquires it again
+		void submitPacket(uint32_t packetIndex);
+
+		//Lets the render thread finish the packet it is recording, drops the queued ones and joins the thread. Called by the main thread
+		void stop();
+
+		Statistics getStatistics() const;
+
+	private:
+		void renderLoop();
+
+		std::function<void(uint32_t packetIndex)> renderPacket;
+
+		weEngineSpscRing<uint32_t, MAX_PACKET_COUNT> submittedPackets; //Written by the game thread, read by the render thread
+		weEngineSpscRing<uint32_t, MAX_PACKET_COUNT> freePackets; //Written by the render thread, read by the game thread
+
+		//Only used to sleep, the rings are never read or written under the lock
+		std::mutex wakeMutex;
+		std::condition_variable packetSubmitted;
+		std::condition_variable packetFreed;
+
+		std::atomic<bool> stopping{ false };
+		std::atomic<bool> finished{ false };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr failure; //Written by the render thread before failed is set
+
+		std::atomic<uint64_t> renderedPacketCount{ 0 };
+		std::atomic<float> renderMilliseconds{ 0.0f };
+		uint64_t backPressureCount = 0;
+		float backPressureMilliseconds = 0.0f;
+
+		std::thread thread;
+	};
+}
@@ -1,4 +1,6 @@
 #include "weEngineRenderer.hpp"
+#include "weEngineUploadManager.hpp"
+#include "weEngineJobSystem.hpp"
 
 //std
 #include "stdexcept"
@@ -16,27 +18,43 @@ namespace weEngine
 	{
 		recreateSwapChain();
 		createCommandBuffers();
+		createSecondaryCommandPools();
 	}
 
 	weEngineRenderer::~weEngineRenderer()
 	{
+		destroySecondaryCommandPools();
 		freeCommandBuffers();
 	}
 
 
 	/*
-	* Waits for the window to end resizing and recreates the swap chain
+	* Waits for the window to end resizing and recreates the swap chain. GLFW only processes events on the main thread,
+	* a frame recorded by a worker hands the wait to the main thread, which runs it while it executes the frame.
 	*/
 	void weEngineRenderer::recreateSwapChain()
 	{
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
 		auto extent = weEngineWindow.getExtent();
 		while (extent.width == 0 || extent.height == 0)
 		{
 			extent = weEngineWindow.getExtent();
-			glfwWaitEvents();
+			if (jobSystem.isMainThread())
+			{
+				glfwWaitEvents();
+			}
+			else
+			{
+				weEngineJobCounter counter;
+				jobSystem.runOnMainThread([]() { glfwWaitEvents(); }, &counter);
+				jobSystem.wait(counter);
+			}
 		}
 
-		vkDeviceWaitIdle(weEngineDevice.device());
+		{
+			std::lock_guard<std::mutex> queueLock{ weEngineDevice.queueMutex() };
+			vkDeviceWaitIdle(weEngineDevice.device());
+		}
 
 		if (weEngineSwapChain == nullptr)
 		{
@@ -92,6 +110,39 @@ namespace weEngine
 		);
 		commandBuffers.clear();
 	}
+
+	/*
+	* Creates a command pool per recording slot and frame in flight. Command pools are not thread safe,
+	* so every thread recording at the same time needs its own, and a frame resets its pools once the GPU is done with them.
+	*/
+	void weEngineRenderer::createSecondaryCommandPools()
+	{
+		recordingSlotCount = weEngineJobSystem::shared().getThreadCount();
+		secondaryCommandPools.resize(static_cast<size_t>(recordingSlotCount) * weEngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = weEngineDevice.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (SecondaryCommandPool& pool : secondaryCommandPools)
+		{
+			if (vkCreateCommandPool(weEngineDevice.device(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create secondary command pool");
+			}
+		}
+	}
+
+	//Destroying a pool frees its command buffers
+	void weEngineRenderer::destroySecondaryCommandPools()
+	{
+		for (SecondaryCommandPool& pool : secondaryCommandPools)
+		{
+			vkDestroyCommandPool(weEngineDevice.device(), pool.commandPool, nullptr);
+		}
+		secondaryCommandPools.clear();
+	}
 	
 	/*
 	* function that begins the frame to be drawn. Then creates a command buffer
@@ -116,6 +167,17 @@ namespace weEngine
 		isFrameStarted = true;
 		auto commandBuffer = getCurrentCommandBuffer();
 
+		//The swap chain waited for the previous submission of the frame, its secondary command buffers can be recorded again
+		for (uint32_t slot = 0; slot < recordingSlotCount; slot++)
+		{
+			SecondaryCommandPool& pool = secondaryCommandPools[currentFrameIndex * recordingSlotCount + slot];
+			if (pool.usedCount > 0)
+			{
+				vkResetCommandPool(weEngineDevice.device(), pool.commandPool, 0);
+				pool.usedCount = 0;
+			}
+		}
+
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -139,6 +201,9 @@ namespace weEngine
 			throw std::runtime_error("Failed to end recording command buffer");
 		}
 
+		//Buffers uploaded while recording the frame have to be copied before the frame is drawn
+		weEngineDevice.getUploadManager().flush();
+
 		auto result = weEngineSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || weEngineWindow.wasWindowResized())
@@ -158,7 +223,7 @@ namespace weEngine
 	/*
 	* Starts the rendering pass of the swap chain
 	*/
-	void weEngineRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void weEngineRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass function while the frame is not in progress.");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't call beginSwapChainRenderPass function with a command buffer from a different frame.");
@@ -178,8 +243,34 @@ namespace weEngine
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		if (contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			setViewportAndScissor(commandBuffer);
+		}
+	}
+
+	/*
+	* Starts the resume render pass of the swap chain, which loads the color and depth of the main pass instead of clearing them
+	*/
+	void weEngineRenderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	{
+		assert(isFrameStarted && "Can't call resumeSwapChainRenderPass function while the frame is not in progress.");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't call resumeSwapChainRenderPass function with a command buffer from a different frame.");
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = weEngineSwapChain->getResumeRenderPass();
+		renderPassInfo.framebuffer = weEngineSwapChain->getFrameBuffer(currentImageIndex);
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = weEngineSwapChain->getSwapChainExtent();
+
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		setViewportAndScissor(commandBuffer);
+	}
 
+	void weEngineRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer)
+	{
 		//Add a dynamically created viewport+scissor
 		VkViewport viewport{};
 		viewport.x = 0;
@@ -201,5 +292,58 @@ namespace weEngine
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	VkCommandBuffer weEngineRenderer::beginSecondaryCommandBuffer(uint32_t slot)
+	{
+		assert(isFrameStarted && "Can't call beginSecondaryCommandBuffer function while the frame is not in progress.");
+		assert(slot < recordingSlotCount && "Recording slot out of range");
+
+		SecondaryCommandPool& pool = secondaryCommandPools[currentFrameIndex * recordingSlotCount + slot];
+		if (pool.usedCount == pool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = pool.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer newCommandBuffer;
+			if (vkAllocateCommandBuffers(weEngineDevice.device(), &allocInfo, &newCommandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate secondary command buffer");
+			}
+			pool.commandBuffers.push_back(newCommandBuffer);
+		}
+		VkCommandBuffer commandBuffer = pool.commandBuffers[pool.usedCount++];
+
+		//The resume render pass is compatible with the main one, so the command buffer can run in either
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = weEngineSwapChain->getRenderPass();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = weEngineSwapChain->getFrameBuffer(currentImageIndex);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording secondary command buffer");
+		}
+
+		//Dynamic states are not inherited from the primary command buffer
+		setViewportAndScissor(commandBuffer);
+		return commandBuffer;
+	}
+
+	void weEngineRenderer::endSecondaryCommandBuffer(VkCommandBuffer commandBuffer)
+	{
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to end recording secondary command buffer");
+		}
+	}
+
 
 }
\ No newline at end of file
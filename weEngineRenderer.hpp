@@ -34,6 +34,11 @@ namespace weEngine
 		{
 			return weEngineSwapChain->extentAspectRatio();
 		}
+
+		VkExtent2D getSwapChainExtent() const
+		{
+			return weEngineSwapChain->getSwapChainExtent();
+		}
 		bool isFrameInProgress() const
 		{
 			return isFrameStarted;
@@ -45,19 +50,66 @@ namespace weEngine
 			return commandBuffers[currentFrameIndex];
 		}
 
+		//Depth attachment of the swap chain image being drawn, in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL outside of the render passes
+		VkImage getCurrentDepthImage() const
+		{
+			assert(isFrameStarted && "Cannot retrieve the depth image while the frame is not in progress");
+			return weEngineSwapChain->getDepthImage(currentImageIndex);
+		}
+
+		VkImageView getCurrentDepthImageView() const
+		{
+			assert(isFrameStarted && "Cannot retrieve the depth image view while the frame is not in progress");
+			return weEngineSwapChain->getDepthImageView(currentImageIndex);
+		}
+
+		bool isDepthSampleable() const
+		{
+			return weEngineSwapChain->isDepthSampleable();
+		}
+
 		int getCurrentFrameIndex() const
 		{
 			assert(isFrameStarted && "Cannot retrieve currentFrameIndex while the frame is not in progress");
 			return currentFrameIndex;
 		}
 
+		//Command pools each recording thread can use at once, one per thread of the shared job system
+		uint32_t getRecordingSlotCount() const
+		{
+			return recordingSlotCount;
+		}
+
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		//Passes begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS only take secondary command buffers, which set their own viewport and scissor
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		//Starts another render pass on the swap chain image, keeping what the previous pass of the frame drew
+		void resumeSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+		/*
+		* Begins a secondary command buffer continuing the swap chain render pass, from the command pool of the slot for the current frame.
+		* Different slots can record on different threads at the same time, a slot must only be used by one thread at a time.
+		* The command buffer is valid until the frame is recorded again, and can be executed in the main or the resume render pass.
+		*/
+		VkCommandBuffer beginSecondaryCommandBuffer(uint32_t slot);
+		void endSecondaryCommandBuffer(VkCommandBuffer commandBuffer);
 	private:
+		//Command pool of one recording slot for one frame in flight, reset when the frame starts again
+		struct SecondaryCommandPool
+		{
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+
 		void createCommandBuffers();
 		void freeCommandBuffers();
+		void createSecondaryCommandPools();
+		void destroySecondaryCommandPools();
 		void recreateSwapChain();
 
 		weEngineWindow& weEngineWindow;
@@ -65,6 +117,9 @@ namespace weEngine
 		std::unique_ptr<weEngineSwapChain> weEngineSwapChain; // weEngineDevice, weEngineWindow.getExtent()
 		std::vector<VkCommandBuffer> commandBuffers;
 
+		uint32_t recordingSlotCount = 1;
+		std::vector<SecondaryCommandPool> secondaryCommandPools; //recordingSlotCount pools per frame in flight, frame after frame
+
 		uint32_t currentImageIndex;
 		int currentFrameIndex{ 0 };
 		bool isFrameStarted{ false };
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+* weEngineSpscRing is a bounded lock free queue between one producer thread and one consumer thread. The producer only writes the head
+* and the consumer only writes the tail, each keeps a copy of the index of the other side and only reloads it when the ring looks full
+* or empty, so a push or a pop does not touch the cache line of the other thread most of the time.
+*/
+
+//std
+#include "atomic"
+#include "cstdint"
+#include "utility"
+
+namespace weEngine
+{
+	template<typename T, uint32_t CAPACITY>
+	class weEngineSpscRing
+	{
+	public:
+		static_assert((CAPACITY & (CAPACITY - 1)) == 0, "The capacity of the ring must be a power of two");
+
+		weEngineSpscRing() = default;
+
+		weEngineSpscRing(const weEngineSpscRing&) = delete;
+		weEngineSpscRing& operator=(const weEngineSpscRing&) = delete;
+
+		//Called by the producer only, false when the ring is full
+		bool tryPush(T item)
+		{
+			const uint32_t currentHead = head.load(std::memory_order_relaxed);
+			if (currentHead - producerTail == CAPACITY)
+			{
+				producerTail = tail.load(std::memory_order_acquire);
+				if (currentHead - producerTail == CAPACITY)
+				{
+					return false;
+				}
+			}
+
+			items[currentHead & (CAPACITY - 1)] = std::move(item);
+			head.store(currentHead + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Called by the consumer only, false when the ring is empty
+		bool tryPop(T& item)
+		{
+			const uint32_t currentTail = tail.load(std::memory_order_relaxed);
+			if (consumerHead == currentTail)
+			{
+				consumerHead = head.load(std::memory_order_acquire);
+				if (consumerHead == currentTail)
+				{
+					return false;
+				}
+			}
+
+			item = std::move(items[currentTail & (CAPACITY - 1)]);
+			tail.store(currentTail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Items in the ring, only exact when neither side is pushing or popping
+		uint32_t size() const
+		{
+			return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		//The indices only grow and wrap around, the slot of an index is index % CAPACITY
+		alignas(64) std::atomic<uint32_t> head{ 0 }; //Next slot the producer writes
+		uint32_t producerTail = 0; //Last tail seen by the producer
+
+		alignas(64) std::atomic<uint32_t> tail{ 0 }; //Next slot the consumer reads
+		uint32_t consumerHead = 0; //Last head seen by the consumer
+
+		alignas(64) T items[CAPACITY]{};
+	};
+}
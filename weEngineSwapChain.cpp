@@ -36,6 +36,7 @@ namespace weEngine {
         createSwapChain();
         createImageViews();
         createRenderPass();
+        createResumeRenderPass();
         createDepthResources();
         createFramebuffers();
         createSyncObjects();
@@ -54,8 +55,7 @@ namespace weEngine {
 
       for (int i = 0; i < depthImages.size(); i++) {
         vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-        vkDestroyImage(device.device(), depthImages[i], nullptr);
-        vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        device.destroyImage(depthImages[i], depthImageAllocations[i]);
       }
 
       for (auto framebuffer : swapChainFramebuffers) {
@@ -63,6 +63,7 @@ namespace weEngine {
       }
 
       vkDestroyRenderPass(device.device(), renderPass, nullptr);
+      vkDestroyRenderPass(device.device(), resumeRenderPass, nullptr);
 
       // cleanup synchronization objects
       for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -121,6 +122,8 @@ namespace weEngine {
       submitInfo.pSignalSemaphores = signalSemaphores;
 
       vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+      // The present queue is usually the graphics queue, so both calls stay under the lock
+      std::lock_guard<std::mutex> queueLock{device.queueMutex()};
       if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
           VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
@@ -242,7 +245,7 @@ namespace weEngine {
       depthAttachment.format = findDepthFormat();
       depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
       depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Kept for the depth pyramid of the occlusion culling
       depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
       depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
       depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -298,6 +301,74 @@ namespace weEngine {
       }
     }
 
+    /*
+    * Same attachments as the main render pass, loaded instead of cleared. Drawing after the main pass, for example the objects
+    * found visible once the depth of the main pass is known, reuses its framebuffers with this render pass.
+    */
+    void weEngineSwapChain::createResumeRenderPass() {
+      VkAttachmentDescription depthAttachment{};
+      depthAttachment.format = findDepthFormat();
+      depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+      VkAttachmentReference depthAttachmentRef{};
+      depthAttachmentRef.attachment = 1;
+      depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+      VkAttachmentDescription colorAttachment = {};
+      colorAttachment.format = getSwapChainImageFormat();
+      colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+      colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+      VkAttachmentReference colorAttachmentRef = {};
+      colorAttachmentRef.attachment = 0;
+      colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+      VkSubpassDescription subpass = {};
+      subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpass.colorAttachmentCount = 1;
+      subpass.pColorAttachments = &colorAttachmentRef;
+      subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+      // Waits for the writes of the main pass to the attachments before loading them
+      VkSubpassDependency dependency = {};
+      dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+      dependency.srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      dependency.srcStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      dependency.dstSubpass = 0;
+      dependency.dstStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependency.dstAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+      std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+      VkRenderPassCreateInfo renderPassInfo = {};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+      renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+      renderPassInfo.pAttachments = attachments.data();
+      renderPassInfo.subpassCount = 1;
+      renderPassInfo.pSubpasses = &subpass;
+      renderPassInfo.dependencyCount = 1;
+      renderPassInfo.pDependencies = &dependency;
+
+      if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &resumeRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create resume render pass!");
+      }
+    }
+
     /*
     * Creates currently two framebuffers for the swapchain to switch over
     */
@@ -330,9 +401,12 @@ namespace weEngine {
       VkFormat depthFormat = findDepthFormat();
       swapChainDepthFormat = depthFormat;
       VkExtent2D swapChainExtent = getSwapChainExtent();
+      // Only a depth format without stencil, so the depth aspect alone can be transitioned and sampled
+      depthSampleable = depthFormat == VK_FORMAT_D32_SFLOAT &&
+          device.isFormatSupported(depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 
       depthImages.resize(imageCount());
-      depthImageMemorys.resize(imageCount());
+      depthImageAllocations.resize(imageCount());
       depthImageViews.resize(imageCount());
 
       for (int i = 0; i < depthImages.size(); i++) {
@@ -348,6 +422,9 @@ namespace weEngine {
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (depthSampleable) {
+          imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -356,7 +433,8 @@ namespace weEngine {
             imageInfo,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             depthImages[i],
-            depthImageMemorys[i]);
+            depthImageAllocations[i],
+            "depth image");
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
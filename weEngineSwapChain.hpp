@@ -33,7 +33,13 @@ class weEngineSwapChain {
 
   VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkRenderPass getRenderPass() { return renderPass; }
+  // Compatible with getRenderPass, keeps the color and depth drawn by a previous pass instead of clearing them
+  VkRenderPass getResumeRenderPass() { return resumeRenderPass; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  VkImage getDepthImage(int index) { return depthImages[index]; }
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+  // The depth images can be sampled once the render pass ended, they are left in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+  bool isDepthSampleable() const { return depthSampleable; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -62,6 +68,7 @@ class weEngineSwapChain {
   void createImageViews();
   void createDepthResources();
   void createRenderPass();
+  void createResumeRenderPass();
   void createFramebuffers();
   void createSyncObjects();
 
@@ -78,9 +85,11 @@ class weEngineSwapChain {
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
+  VkRenderPass resumeRenderPass;
+  bool depthSampleable = false;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<weEngineAllocation> depthImageAllocations;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
@@ -0,0 +1,166 @@
+#include "weEngineTaskGraph.hpp"
+
+//std
+#include "algorithm"
+#include "cassert"
+#include "chrono"
+
+namespace weEngine
+{
+	weEngineTaskGraph::ResourceId weEngineTaskGraph::addResource()
+	{
+		resources.push_back({});
+		return static_cast<ResourceId>(resources.size() - 1);
+	}
+
+	weEngineTaskGraph::TaskId weEngineTaskGraph::addTask(std::initializer_list<ResourceId> reads, std::initializer_list<ResourceId> writes, std::function<void()> function, TaskAffinity affinity)
+	{
+		const TaskId task = static_cast<TaskId>(tasks.size());
+		tasks.push_back({});
+		tasks.back().function = std::move(function);
+		tasks.back().affinity = affinity;
+		tasks.back().pendingDependencies = std::make_unique<std::atomic<uint32_t>>(0);
+
+		for (ResourceId resource : reads)
+		{
+			assert(resource < resources.size() && "Reading an undeclared resource");
+			assert(std::find(writes.begin(), writes.end(), resource) == writes.end() && "A resource both read and written is only given as written");
+
+			ResourceState& state = resources[resource];
+			addDependency(state.lastWriter, task);
+			state.readers.push_back(task);
+		}
+
+		for (ResourceId resource : writes)
+		{
+			assert(resource < resources.size() && "Writing an undeclared resource");
+
+			ResourceState& state = resources[resource];
+			addDependency(state.lastWriter, task);
+			for (TaskId reader : state.readers)
+			{
+				addDependency(reader, task);
+			}
+			state.lastWriter = task;
+			state.readers.clear();
+		}
+		return task;
+	}
+
+	//A task reaching the same dependency through several resources depends on it once
+	void weEngineTaskGraph::addDependency(TaskId dependency, TaskId task)
+	{
+		if (dependency == NO_TASK || dependency == task)
+		{
+			return;
+		}
+
+		std::vector<TaskId>& dependents = tasks[dependency].dependents;
+		if (!dependents.empty() && dependents.back() == task)
+		{
+			return;
+		}
+		if (std::find(dependents.begin(), dependents.end(), task) != dependents.end())
+		{
+			return;
+		}
+		dependents.push_back(task);
+		tasks[task].dependencyCount++;
+	}
+
+	void weEngineTaskGraph::clear()
+	{
+		tasks.clear();
+		for (ResourceState& state : resources)
+		{
+			state.lastWriter = NO_TASK;
+			state.readers.clear();
+		}
+	}
+
+	/*
+	* The tasks without dependencies are scheduled first, every task then schedules the dependents it was the last dependency of.
+	* A task is counted by the counter before the task scheduling it finishes, so the counter only reaches zero after the last task.
+	*/
+	void weEngineTaskGraph::execute(weEngineJobSystem& jobSystem)
+	{
+		assert(jobSystem.isMainThread() && "The graph is executed by the main thread, which runs its main thread tasks");
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		statistics = Statistics{};
+		statistics.taskCount = static_cast<uint32_t>(tasks.size());
+		for (Task& task : tasks)
+		{
+			task.pendingDependencies->store(task.dependencyCount, std::memory_order_relaxed);
+			statistics.dependencyCount += task.dependencyCount;
+			statistics.mainThreadTaskCount += task.affinity == TaskAffinity::MAIN_THREAD ? 1 : 0;
+		}
+
+		weEngineJobCounter counter;
+		executionCounter = &counter;
+		taskNanoseconds.store(0, std::memory_order_relaxed);
+		failed.store(false, std::memory_order_relaxed);
+		failure = nullptr;
+
+		for (TaskId task = 0; task < tasks.size(); task++)
+		{
+			if (tasks[task].dependencyCount == 0)
+			{
+				schedule(jobSystem, task);
+			}
+		}
+		jobSystem.wait(counter);
+		executionCounter = nullptr;
+
+		statistics.taskMilliseconds = static_cast<float>(taskNanoseconds.load(std::memory_order_relaxed)) / 1000000.0f;
+		statistics.executeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	void weEngineTaskGraph::schedule(weEngineJobSystem& jobSystem, TaskId task)
+	{
+		auto job = [this, &jobSystem, task]() { runTask(jobSystem, task); };
+		if (tasks[task].affinity == TaskAffinity::MAIN_THREAD)
+		{
+			jobSystem.runOnMainThread(job, executionCounter);
+		}
+		else
+		{
+			jobSystem.run(job, executionCounter);
+		}
+	}
+
+	void weEngineTaskGraph::runTask(weEngineJobSystem& jobSystem, TaskId task)
+	{
+		if (!failed.load(std::memory_order_relaxed))
+		{
+			const auto startTime = std::chrono::high_resolution_clock::now();
+			try
+			{
+				tasks[task].function();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(failureMutex);
+				if (!failure)
+				{
+					failure = std::current_exception();
+				}
+				failed.store(true, std::memory_order_relaxed);
+			}
+			taskNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime).count(), std::memory_order_relaxed);
+		}
+
+		for (TaskId dependent : tasks[task].dependents)
+		{
+			if (tasks[dependent].pendingDependencies->fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				schedule(jobSystem, dependent);
+			}
+		}
+	}
+}
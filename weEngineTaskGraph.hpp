@@ -0,0 +1,117 @@
+#pragma once
+
+/*
+* weEngineTaskGraph runs a set of tasks on the job system in the order their data needs. Every task declares the resources it reads
+* and the ones it writes, and runs after the tasks added before it that write what it reads, or read or write what it writes.
+* Tasks without such a hazard between them run at the same time, so a frame can simulate the next frame while it records the current
+* one as long as both work on different resources.
+*
+* The resources are only names for data, the graph never touches them. They are declared once and kept when the tasks are cleared,
+* so the same graph can be filled again every frame.
+*/
+
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "atomic"
+#include "cstdint"
+#include "exception"
+#include "functional"
+#include "initializer_list"
+#include "memory"
+#include "mutex"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineTaskGraph
+	{
+	public:
+		using ResourceId = uint32_t;
+		using TaskId = uint32_t;
+
+		enum class TaskAffinity
+		{
+			ANY_THREAD,
+			MAIN_THREAD, //For the tasks calling GLFW, run by the main thread while it executes the graph
+		};
+
+		//Counts and timings of the last execution
+		struct Statistics
+		{
+			uint32_t taskCount = 0;
+			uint32_t dependencyCount = 0; //Edges between the tasks, found from the hazards on their resources
+			uint32_t mainThreadTaskCount = 0;
+			float executeMilliseconds = 0.0f;
+			float taskMilliseconds = 0.0f; //Time spent in the tasks, above executeMilliseconds when tasks overlapped
+		};
+
+		weEngineTaskGraph() = default;
+
+		weEngineTaskGraph(const weEngineTaskGraph&) = delete;
+		weEngineTaskGraph& operator=(const weEngineTaskGraph&) = delete;
+
+		ResourceId addResource();
+
+		/*
+		* Adds a task reading and writing the resources, a resource both read and written is only given as written.
+		* The task depends on the last task writing a resource it reads, and on the last writer and the readers since then of a resource it writes.
+		*/
+		TaskId addTask(std::initializer_list<ResourceId> reads, std::initializer_list<ResourceId> writes, std::function<void()> function, TaskAffinity affinity = TaskAffinity::ANY_THREAD);
+
+		//Removes the tasks, the resources are kept
+		void clear();
+
+		/*
+		* Runs every task and returns once they all finished, called by the main thread so it can run the main thread tasks meanwhile.
+		* A task throwing skips the tasks not started yet, the first exception is thrown again once the running tasks are done.
+		*/
+		void execute(weEngineJobSystem& jobSystem);
+
+		uint32_t getTaskCount() const
+		{
+			return static_cast<uint32_t>(tasks.size());
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+	private:
+		static constexpr TaskId NO_TASK = UINT32_MAX;
+
+		struct Task
+		{
+			std::function<void()> function;
+			TaskAffinity affinity = TaskAffinity::ANY_THREAD;
+			std::vector<TaskId> dependents; //Tasks waiting on this one
+			uint32_t dependencyCount = 0;
+			std::unique_ptr<std::atomic<uint32_t>> pendingDependencies; //Dependencies left during an execution
+		};
+
+		//Tasks the next task touching the resource depends on
+		struct ResourceState
+		{
+			TaskId lastWriter = NO_TASK;
+			std::vector<TaskId> readers; //Tasks reading the resource since its last writer
+		};
+
+		void addDependency(TaskId dependency, TaskId task);
+
+		//Hands the task to the job system, once its dependencies are done
+		void schedule(weEngineJobSystem& jobSystem, TaskId task);
+		void runTask(weEngineJobSystem& jobSystem, TaskId task);
+
+		std::vector<Task> tasks;
+		std::vector<ResourceState> resources;
+
+		weEngineJobCounter* executionCounter = nullptr; //Counter of the running execution
+		std::atomic<int64_t> taskNanoseconds{ 0 }; //Summed by the tasks of the running execution
+		std::atomic<bool> failed{ false };
+		std::mutex failureMutex;
+		std::exception_ptr failure;
+
+		Statistics statistics{};
+	};
+}
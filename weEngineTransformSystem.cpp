@@ -0,0 +1,321 @@
+#include "weEngineTransformSystem.hpp"
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "algorithm"
+#include "atomic"
+#include "chrono"
+#include "cmath"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WE_ENGINE_TRANSFORM_SSE
+#include "emmintrin.h"
+#endif
+
+namespace weEngine
+{
+#if defined(WE_ENGINE_TRANSFORM_SSE)
+	namespace
+	{
+		/*
+		* Sine and cosine of four angles with the polynomials of the Cephes library. The angle is reduced to [-pi/4, pi/4] around the
+		* nearest multiple j of pi/4 in three steps to keep the precision, j picks which polynomial gives the sine and the signs.
+		* The error stays around one unit in the last place up to MAX_KERNEL_ANGLE.
+		*/
+		inline void sinCos(__m128 angle, __m128& sine, __m128& cosine)
+		{
+			const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+			const __m128i one = _mm_set1_epi32(1);
+			const __m128i two = _mm_set1_epi32(2);
+			const __m128i four = _mm_set1_epi32(4);
+
+			__m128 sineSign = _mm_and_ps(angle, signMask);
+			__m128 x = _mm_andnot_ps(signMask, angle);
+
+			//j is the even octant nearest to the angle
+			__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+			octant = _mm_and_si128(_mm_add_epi32(octant, one), _mm_set1_epi32(~1));
+			const __m128 y = _mm_cvtepi32_ps(octant);
+
+			sineSign = _mm_xor_ps(sineSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, four), 29)));
+			const __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, two), four), 29));
+			const __m128 sinePolynomial = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, two), _mm_setzero_si128()));
+
+			x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+			x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+			x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+			const __m128 z = _mm_mul_ps(x, x);
+
+			__m128 cosineValue = _mm_set1_ps(2.443315711809948e-5f);
+			cosineValue = _mm_add_ps(_mm_mul_ps(cosineValue, z), _mm_set1_ps(-1.388731625493765e-3f));
+			cosineValue = _mm_add_ps(_mm_mul_ps(cosineValue, z), _mm_set1_ps(4.166664568298827e-2f));
+			cosineValue = _mm_mul_ps(_mm_mul_ps(cosineValue, z), z);
+			cosineValue = _mm_sub_ps(cosineValue, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+			cosineValue = _mm_add_ps(cosineValue, _mm_set1_ps(1.0f));
+
+			__m128 sineValue = _mm_set1_ps(-1.9515295891e-4f);
+			sineValue = _mm_add_ps(_mm_mul_ps(sineValue, z), _mm_set1_ps(8.3321608736e-3f));
+			sineValue = _mm_add_ps(_mm_mul_ps(sineValue, z), _mm_set1_ps(-1.6666654611e-1f));
+			sineValue = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sineValue, z), x), x);
+
+			const __m128 sineResult = _mm_or_ps(_mm_and_ps(sinePolynomial, sineValue), _mm_andnot_ps(sinePolynomial, cosineValue));
+			const __m128 cosineResult = _mm_or_ps(_mm_and_ps(sinePolynomial, cosineValue), _mm_andnot_ps(sinePolynomial, sineValue));
+			sine = _mm_xor_ps(sineResult, sineSign);
+			cosine = _mm_xor_ps(cosineResult, cosineSign);
+		}
+
+		//Past this the reduction of sinCos loses its precision, and past 2^31 / (4 / pi) the octant overflows
+		constexpr float MAX_KERNEL_ANGLE = 8192.0f;
+
+		//False when an angle is too large for sinCos, or not a number
+		inline bool isKernelAngle(__m128 angle)
+		{
+			const __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), angle);
+			return _mm_movemask_ps(_mm_cmple_ps(magnitude, _mm_set1_ps(MAX_KERNEL_ANGLE))) == 0xF;
+		}
+	}
+#endif
+
+	uint32_t weEngineTransformSystem::add(const TransformComponent& transform)
+	{
+		const uint32_t index = count;
+		resize(count + 1);
+		set(index, transform);
+		return index;
+	}
+
+	void weEngineTransformSystem::resize(uint32_t newCount)
+	{
+		if (newCount <= count)
+		{
+			return;
+		}
+
+		if (newCount > translationX.size())
+		{
+			//Padding transforms are identities, their matrices are built with the dirty ones of their group but never read
+			const size_t paddedSize = (static_cast<size_t>(newCount) + BITS_PER_WORD - 1) / BITS_PER_WORD * BITS_PER_WORD;
+			for (std::vector<float>* component : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ })
+			{
+				component->resize(paddedSize, 0.0f);
+			}
+			for (std::vector<float>* component : { &scaleX, &scaleY, &scaleZ })
+			{
+				component->resize(paddedSize, 1.0f);
+			}
+			worldMatrices.resize(paddedSize, glm::mat4{ 1.0f });
+			dirtyBits.resize(paddedSize / BITS_PER_WORD, 0);
+		}
+
+		for (uint32_t index = count; index < newCount; index++)
+		{
+			markDirty(index);
+		}
+		count = newCount;
+	}
+
+	void weEngineTransformSystem::clear()
+	{
+		count = 0;
+		for (std::vector<float>* component : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ })
+		{
+			component->clear();
+		}
+		worldMatrices.clear();
+		dirtyBits.clear();
+		updatedIndices.clear();
+	}
+
+	void weEngineTransformSystem::set(uint32_t index, const TransformComponent& transform)
+	{
+		if (translationX[index] == transform.translation.x && translationY[index] == transform.translation.y && translationZ[index] == transform.translation.z &&
+			rotationX[index] == transform.rotation.x && rotationY[index] == transform.rotation.y && rotationZ[index] == transform.rotation.z &&
+			scaleX[index] == transform.scale.x && scaleY[index] == transform.scale.y && scaleZ[index] == transform.scale.z)
+		{
+			return;
+		}
+
+		translationX[index] = transform.translation.x;
+		translationY[index] = transform.translation.y;
+		translationZ[index] = transform.translation.z;
+		rotationX[index] = transform.rotation.x;
+		rotationY[index] = transform.rotation.y;
+		rotationZ[index] = transform.rotation.z;
+		scaleX[index] = transform.scale.x;
+		scaleY[index] = transform.scale.y;
+		scaleZ[index] = transform.scale.z;
+		markDirty(index);
+	}
+
+	TransformComponent weEngineTransformSystem::get(uint32_t index) const
+	{
+		TransformComponent transform{};
+		transform.translation = { translationX[index], translationY[index], translationZ[index] };
+		transform.rotation = { rotationX[index], rotationY[index], rotationZ[index] };
+		transform.scale = { scaleX[index], scaleY[index], scaleZ[index] };
+		return transform;
+	}
+
+	/*
+	* The dirty indices are gathered first, on the calling thread, so the tasks only have to build matrices.
+	* The tasks get the same number of bitset words, each word is only read and cleared by its task.
+	*/
+	void weEngineTransformSystem::updateMatrices()
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		const uint32_t wordCount = static_cast<uint32_t>(dirtyBits.size());
+		updatedIndices.clear();
+		for (uint32_t word = 0; word < wordCount; word++)
+		{
+			uint64_t bits = dirtyBits[word];
+			for (uint32_t bit = 0; bits != 0; bit++, bits >>= 1)
+			{
+				if (bits & 1)
+				{
+					updatedIndices.push_back(word * BITS_PER_WORD + bit);
+				}
+			}
+		}
+
+		const uint32_t updatedCount = static_cast<uint32_t>(updatedIndices.size());
+		statistics.transformCount = count;
+		statistics.updatedCount = updatedCount;
+		statistics.batchCount = 0;
+		statistics.updateTaskCount = 0;
+		if (updatedCount == 0)
+		{
+			statistics.updateMilliseconds = 0.0f;
+			return;
+		}
+
+		weEngineJobSystem& jobSystem = weEngineJobSystem::shared();
+		const uint32_t taskCount = std::max(1u, std::min(jobSystem.getThreadCount(), updatedCount / MIN_TRANSFORMS_PER_TASK));
+		const uint32_t wordsPerTask = (wordCount + taskCount - 1) / taskCount;
+
+		std::atomic<uint32_t> batchCount{ 0 };
+		jobSystem.parallelFor(taskCount, [&](uint32_t task)
+			{
+				const uint32_t firstWord = task * wordsPerTask;
+				const uint32_t endWord = std::min(wordCount, firstWord + wordsPerTask);
+				if (firstWord < endWord)
+				{
+					batchCount += updateWords(firstWord, endWord);
+				}
+			});
+
+		statistics.batchCount = batchCount;
+		statistics.updateTaskCount = taskCount;
+		statistics.updateMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	uint32_t weEngineTransformSystem::updateWords(uint32_t firstWord, uint32_t endWord)
+	{
+		constexpr uint64_t batchMask = (uint64_t{ 1 } << BATCH_SIZE) - 1;
+
+		uint32_t batchCount = 0;
+		for (uint32_t word = firstWord; word < endWord; word++)
+		{
+			const uint64_t bits = dirtyBits[word];
+			if (bits == 0)
+			{
+				continue;
+			}
+
+			for (uint32_t bit = 0; bit < BITS_PER_WORD; bit += BATCH_SIZE)
+			{
+				if ((bits >> bit) & batchMask)
+				{
+					buildBatch(word * BITS_PER_WORD + bit);
+					batchCount++;
+				}
+			}
+			dirtyBits[word] = 0;
+		}
+		return batchCount;
+	}
+
+	/*
+	* Same matrix as TransformComponent::mat4, rotations with the Tait-Bryan angles Y1X2Z3 scaled per column.
+	* The kernel builds each column for the four transforms, one register per row, and transposes the registers into the four matrices.
+	* A group with an angle the kernel cannot reduce is built by TransformComponent::mat4 instead.
+	*/
+	void weEngineTransformSystem::buildBatch(uint32_t first)
+	{
+#if defined(WE_ENGINE_TRANSFORM_SSE)
+		const __m128 angleY = _mm_loadu_ps(rotationY.data() + first);
+		const __m128 angleX = _mm_loadu_ps(rotationX.data() + first);
+		const __m128 angleZ = _mm_loadu_ps(rotationZ.data() + first);
+		if (!isKernelAngle(angleY) || !isKernelAngle(angleX) || !isKernelAngle(angleZ))
+		{
+			for (uint32_t index = first; index < first + BATCH_SIZE; index++)
+			{
+				worldMatrices[index] = get(index).mat4();
+			}
+			return;
+		}
+
+		__m128 s1, c1, s2, c2, s3, c3;
+		sinCos(angleY, s1, c1);
+		sinCos(angleX, s2, c2);
+		sinCos(angleZ, s3, c3);
+
+		const __m128 sx = _mm_loadu_ps(scaleX.data() + first);
+		const __m128 sy = _mm_loadu_ps(scaleY.data() + first);
+		const __m128 sz = _mm_loadu_ps(scaleZ.data() + first);
+		const __m128 s1s2 = _mm_mul_ps(s1, s2);
+		const __m128 c1s2 = _mm_mul_ps(c1, s2);
+
+		__m128 columns[4][4] = {
+			{
+				_mm_mul_ps(sx, _mm_add_ps(_mm_mul_ps(c1, c3), _mm_mul_ps(s1s2, s3))),
+				_mm_mul_ps(sx, _mm_mul_ps(c2, s3)),
+				_mm_mul_ps(sx, _mm_sub_ps(_mm_mul_ps(c1s2, s3), _mm_mul_ps(c3, s1))),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_mul_ps(sy, _mm_sub_ps(_mm_mul_ps(c3, s1s2), _mm_mul_ps(c1, s3))),
+				_mm_mul_ps(sy, _mm_mul_ps(c2, c3)),
+				_mm_mul_ps(sy, _mm_add_ps(_mm_mul_ps(c1s2, c3), _mm_mul_ps(s1, s3))),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_mul_ps(sz, _mm_mul_ps(c2, s1)),
+				_mm_mul_ps(sz, _mm_xor_ps(s2, _mm_set1_ps(-0.0f))),
+				_mm_mul_ps(sz, _mm_mul_ps(c1, c2)),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_loadu_ps(translationX.data() + first),
+				_mm_loadu_ps(translationY.data() + first),
+				_mm_loadu_ps(translationZ.data() + first),
+				_mm_set1_ps(1.0f),
+			},
+		};
+
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			__m128* rows = columns[column];
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+			for (uint32_t lane = 0; lane < BATCH_SIZE; lane++)
+			{
+				_mm_storeu_ps(&worldMatrices[first + lane][column][0], rows[lane]);
+			}
+		}
+#else
+		for (uint32_t index = first; index < first + BATCH_SIZE; index++)
+		{
+			worldMatrices[index] = get(index).mat4();
+		}
+#endif
+	}
+
+	const char* weEngineTransformSystem::getKernelName()
+	{
+#if defined(WE_ENGINE_TRANSFORM_SSE)
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+* weEngineTransformSystem keeps the transforms of the entities as structure of arrays, one array per component of the
+* translation, rotation and scale, next to the world matrix built from them on the last update.
+*
+* Writing a transform that differs from the stored one sets its bit in a dirty bitset. updateMatrices only rebuilds the dirty
+* matrices: the bitset is walked one word at a time and every group of four transforms with a dirty bit is built at once with SSE,
+* from four contiguous entries of each array, with a vectorized sine and cosine. Large updates are split across the shared job system.
+* Groups with an angle past a few thousand radians, where the vectorized sine loses its precision, are built with TransformComponent::mat4.
+*/
+
+#include "weEngineComponents.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+//std
+#include "cstdint"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineTransformSystem
+	{
+	public:
+		//Transforms built together by the kernel, the arrays are padded to a whole number of bitset words so a group never reads past them
+		static constexpr uint32_t BATCH_SIZE = 4;
+		static constexpr uint32_t BITS_PER_WORD = 64;
+
+		//Smallest number of dirty transforms an update task works on, smaller updates run on the calling thread
+		static constexpr uint32_t MIN_TRANSFORMS_PER_TASK = 8192;
+
+		struct Statistics
+		{
+			uint32_t transformCount = 0;
+			uint32_t updatedCount = 0; //Dirty transforms whose matrix was rebuilt by the last update
+			uint32_t batchCount = 0; //Groups of BATCH_SIZE transforms the kernel built
+			uint32_t updateTaskCount = 0;
+			float updateMilliseconds = 0.0f;
+		};
+
+		weEngineTransformSystem() = default;
+
+		weEngineTransformSystem(const weEngineTransformSystem&) = delete;
+		weEngineTransformSystem& operator=(const weEngineTransformSystem&) = delete;
+
+		//Appends a dirty transform and returns its index
+		uint32_t add(const TransformComponent& transform);
+
+		//Grows to newCount identity transforms, the new ones are dirty
+		void resize(uint32_t newCount);
+
+		//Forgets every transform
+		void clear();
+
+		//Stores the transform, marking it dirty only when it differs from the stored one
+		void set(uint32_t index, const TransformComponent& transform);
+
+		TransformComponent get(uint32_t index) const;
+
+		void markDirty(uint32_t index)
+		{
+			dirtyBits[index / BITS_PER_WORD] |= uint64_t{ 1 } << (index % BITS_PER_WORD);
+		}
+
+		bool isDirty(uint32_t index) const
+		{
+			return (dirtyBits[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1;
+		}
+
+		//Rebuilds the matrices of the dirty transforms and clears their bits
+		void updateMatrices();
+
+		//World matrix of the transform as of the last update, the same as TransformComponent::mat4
+		const glm::mat4& getMatrix(uint32_t index) const
+		{
+			return worldMatrices[index];
+		}
+
+		//Transforms whose matrix changed on the last update, in increasing order
+		const std::vector<uint32_t>& getUpdatedIndices() const
+		{
+			return updatedIndices;
+		}
+
+		uint32_t size() const
+		{
+			return count;
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+		//Name of the instruction set the kernel was compiled for
+		static const char* getKernelName();
+
+	private:
+		//Builds the matrices of the dirty transforms in words [firstWord, endWord) and clears their bits, returns the groups built
+		uint32_t updateWords(uint32_t firstWord, uint32_t endWord);
+
+		//Builds the BATCH_SIZE matrices starting at first
+		void buildBatch(uint32_t first);
+
+		uint32_t count = 0;
+
+		std::vector<float> translationX, translationY, translationZ;
+		std::vector<float> rotationX, rotationY, rotationZ;
+		std::vector<float> scaleX, scaleY, scaleZ;
+		std::vector<glm::mat4> worldMatrices;
+
+		std::vector<uint64_t> dirtyBits; //One bit per transform, set when its matrix is out of date
+		std::vector<uint32_t> updatedIndices;
+
+		Statistics statistics{};
+	};
+}
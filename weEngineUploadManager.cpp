@@ -0,0 +1,501 @@
+#include "weEngineUploadManager.hpp"
+#include "weEngineDevice.hpp"
+
+//std
+#include "algorithm"
+#include "cstring"
+#include "stdexcept"
+
+namespace weEngine
+{
+	weEngineUploadManager::weEngineUploadManager(weEngine::weEngineDevice& device) : weEngineDevice{ device }
+	{
+		const QueueFamilyIndices queueFamilies = weEngineDevice.findPhysicalQueueFamilies();
+		transferQueue = weEngineDevice.transferQueue();
+		graphicsQueue = weEngineDevice.graphicsQueue();
+		transferFamily = queueFamilies.transferFamily;
+		graphicsFamily = queueFamilies.graphicsFamily;
+		transferOwnership = queueFamilies.hasDedicatedTransferFamily();
+
+		weEngineDevice.createBuffer(
+			RING_SIZE,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			ringBuffer,
+			ringAllocation,
+			weEngineMemoryUsage::LONG_LIVED,
+			"upload staging ring"
+		);
+		ringData = static_cast<uint8_t*>(ringAllocation.mappedData);
+
+		createCommandBuffers();
+	}
+
+	weEngineUploadManager::~weEngineUploadManager()
+	{
+		waitIdle();
+
+		for (Batch& batch : batches)
+		{
+			vkDestroyFence(weEngineDevice.device(), batch.fence, nullptr);
+			if (transferOwnership)
+			{
+				vkDestroySemaphore(weEngineDevice.device(), batch.transferFinished, nullptr);
+			}
+		}
+		vkDestroyCommandPool(weEngineDevice.device(), commandPool, nullptr);
+		if (transferOwnership)
+		{
+			vkDestroyCommandPool(weEngineDevice.device(), acquireCommandPool, nullptr);
+		}
+		weEngineDevice.destroyBuffer(ringBuffer, ringAllocation);
+	}
+
+	void weEngineUploadManager::createCommandBuffers()
+	{
+		commandPool = createCommandPool(transferFamily);
+		if (transferOwnership)
+		{
+			acquireCommandPool = createCommandPool(graphicsFamily);
+		}
+
+		batches.resize(BATCH_COUNT);
+		for (Batch& batch : batches)
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(weEngineDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate upload command buffers");
+			}
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(weEngineDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create upload fence");
+			}
+
+			if (!transferOwnership)
+			{
+				continue;
+			}
+
+			allocInfo.commandPool = acquireCommandPool;
+			if (vkAllocateCommandBuffers(weEngineDevice.device(), &allocInfo, &batch.acquireCommandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate upload command buffers");
+			}
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(weEngineDevice.device(), &semaphoreInfo, nullptr, &batch.transferFinished) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create upload semaphore");
+			}
+		}
+	}
+
+	VkCommandPool weEngineUploadManager::createCommandPool(uint32_t queueFamilyIndex)
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(weEngineDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload command pool");
+		}
+		return pool;
+	}
+
+	weEngineUploadTicket weEngineUploadManager::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, uint64_t elementCount, uint32_t elementSize, const WriteFunction& write)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (elementCount == 0)
+		{
+			return {};
+		}
+
+		if (elementSize == 0 || elementSize > RING_SIZE)
+		{
+			throw std::runtime_error("Upload element size does not fit into the staging ring");
+		}
+
+		uint64_t firstElement = 0;
+		while (firstElement < elementCount)
+		{
+			const VkDeviceSize remainingSize = (elementCount - firstElement) * elementSize;
+
+			VkDeviceSize ringOffset;
+			VkDeviceSize chunkSize;
+			while (!allocateRingSpace(elementSize, remainingSize, ringOffset, chunkSize))
+			{
+				//The ring is full of copies which have not completed yet, submit what is recorded and wait for the oldest batch
+				submitBatch();
+				statistics.stallCount++;
+				retireOldestBatch(true);
+			}
+
+			const uint64_t chunkCount = chunkSize / elementSize;
+			write(ringData + ringOffset, firstElement, chunkCount);
+
+			Batch& batch = getRecordingBatch();
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = ringOffset;
+			copyRegion.dstOffset = dstOffset + firstElement * elementSize;
+			copyRegion.size = chunkCount * elementSize;
+			vkCmdCopyBuffer(batch.commandBuffer, ringBuffer, dstBuffer, 1, &copyRegion);
+			if (transferOwnership)
+			{
+				addOwnershipBarrier(batch, dstBuffer, copyRegion.dstOffset, copyRegion.size);
+			}
+
+			batch.copyCount++;
+			firstElement += chunkCount;
+
+			//The ticket has to name the batch of the last copy, so the batch is only flushed once the copy is recorded
+			if (batch.copyCount >= MAX_COPIES_PER_BATCH && firstElement < elementCount)
+			{
+				submitBatch();
+			}
+		}
+
+		const weEngineUploadTicket ticket{ batches[recordingBatch].serial };
+		statistics.uploadCount++;
+		statistics.uploadedBytes += elementCount * elementSize;
+
+		if (batches[recordingBatch].copyCount >= MAX_COPIES_PER_BATCH)
+		{
+			submitBatch();
+		}
+		return ticket;
+	}
+
+	weEngineUploadTicket weEngineUploadManager::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		const uint8_t* source = static_cast<const uint8_t*>(data);
+		return upload(dstBuffer, dstOffset, size, 1,
+			[source](uint8_t* destination, uint64_t firstElement, uint64_t count)
+			{
+				std::memcpy(destination, source + firstElement, static_cast<size_t>(count));
+			});
+	}
+
+	void weEngineUploadManager::flush()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		submitBatch();
+	}
+
+	/*
+	* Ends the recording batch and submits it. Without a dedicated transfer queue, a barrier at the end of the batch makes the copied data
+	* visible to every later command on the queue. Otherwise the copied ranges are handed over to the graphics queue family.
+	*/
+	void weEngineUploadManager::submitBatch()
+	{
+		if (!isRecording)
+		{
+			return;
+		}
+
+		Batch& batch = batches[recordingBatch];
+
+		if (transferOwnership)
+		{
+			//Release half of the ownership transfer, the acquire half repeats the same barriers on the graphics queue
+			vkCmdPipelineBarrier(
+				batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(batch.ownershipBarriers.size()), batch.ownershipBarriers.data(),
+				0, nullptr);
+		}
+		else
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(
+				batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0,
+				1, &barrier,
+				0, nullptr,
+				0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to end recording upload command buffer");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		if (transferOwnership)
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &batch.transferFinished;
+		}
+
+		{
+			std::lock_guard<std::mutex> queueLock{ weEngineDevice.queueMutex() };
+			if (vkQueueSubmit(transferQueue, 1, &submitInfo, transferOwnership ? VK_NULL_HANDLE : batch.fence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to submit upload command buffer");
+			}
+		}
+
+		if (transferOwnership)
+		{
+			submitOwnershipTransfer(batch);
+		}
+
+		submittedBatches.push_back(recordingBatch);
+		recordingBatch = (recordingBatch + 1) % BATCH_COUNT;
+		isRecording = false;
+		statistics.submitCount++;
+	}
+
+	/*
+	* Acquires the copied ranges on the graphics queue once the transfer batch signaled its semaphore. The fence of the batch is signaled
+	* by this submit, so a completed ticket means the data is both copied and owned by the graphics queue family.
+	* Graphics work submitted later is ordered after the acquire barrier by the submission order.
+	*/
+	void weEngineUploadManager::submitOwnershipTransfer(Batch& batch)
+	{
+		for (VkBufferMemoryBarrier& barrier : batch.ownershipBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo);
+
+		vkCmdPipelineBarrier(
+			batch.acquireCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(batch.ownershipBarriers.size()), batch.ownershipBarriers.data(),
+			0, nullptr);
+
+		if (vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to end recording upload command buffer");
+		}
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &batch.transferFinished;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+
+		std::lock_guard<std::mutex> queueLock{ weEngineDevice.queueMutex() };
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload ownership transfer");
+		}
+	}
+
+	/*
+	* Adds the copied range to the ownership transfer of the batch, merged with the previous range when it directly follows it
+	*/
+	void weEngineUploadManager::addOwnershipBarrier(Batch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (!batch.ownershipBarriers.empty())
+		{
+			VkBufferMemoryBarrier& previous = batch.ownershipBarriers.back();
+			if (previous.buffer == buffer && previous.offset + previous.size == offset)
+			{
+				previous.size += size;
+				return;
+			}
+		}
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+		batch.ownershipBarriers.push_back(barrier);
+	}
+
+	bool weEngineUploadManager::isComplete(weEngineUploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		while (ticket.serial > completedSerial && retireOldestBatch(false))
+		{
+		}
+		return ticket.serial <= completedSerial;
+	}
+
+	/*
+	* Waits until the batch of the ticket completed, submitting it first when it is still being recorded
+	*/
+	void weEngineUploadManager::wait(weEngineUploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (ticket.serial <= completedSerial)
+		{
+			return;
+		}
+
+		if (isRecording && ticket.serial == batches[recordingBatch].serial)
+		{
+			submitBatch();
+		}
+
+		while (ticket.serial > completedSerial && retireOldestBatch(true))
+		{
+		}
+	}
+
+	void weEngineUploadManager::waitIdle()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		submitBatch();
+		while (retireOldestBatch(true))
+		{
+		}
+	}
+
+	/*
+	* Returns the batch copies are recorded into, starting it when needed. Waits for the batch to complete when it is still in flight.
+	*/
+	weEngineUploadManager::Batch& weEngineUploadManager::getRecordingBatch()
+	{
+		Batch& batch = batches[recordingBatch];
+		if (isRecording)
+		{
+			return batch;
+		}
+
+		while (std::find(submittedBatches.begin(), submittedBatches.end(), recordingBatch) != submittedBatches.end())
+		{
+			statistics.stallCount++;
+			retireOldestBatch(true);
+		}
+
+		vkResetFences(weEngineDevice.device(), 1, &batch.fence);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		if (transferOwnership)
+		{
+			vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+			batch.ownershipBarriers.clear();
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		batch.serial = ++lastSerial;
+		batch.ringBytes = 0;
+		batch.copyCount = 0;
+		isRecording = true;
+		return batch;
+	}
+
+	/*
+	* Takes between minimumSize and maximumSize contiguous bytes (whole elements) at the head of the ring.
+	* Wraps around to the start when the end of the ring is too small. Returns false when the ring has no room left.
+	*/
+	bool weEngineUploadManager::allocateRingSpace(VkDeviceSize minimumSize, VkDeviceSize maximumSize, VkDeviceSize& offset, VkDeviceSize& size)
+	{
+		if (ringUsedBytes == 0)
+		{
+			ringHead = 0;
+		}
+
+		//The used part of the ring always ends at the head, the oldest copy still in flight starts at the tail
+		const VkDeviceSize alignedHead = (ringHead + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+		const VkDeviceSize tail = (ringHead + RING_SIZE - ringUsedBytes) % RING_SIZE;
+
+		VkDeviceSize available;
+		offset = alignedHead;
+		if (ringUsedBytes == 0)
+		{
+			available = RING_SIZE;
+		}
+		else if (ringHead > tail)
+		{
+			available = RING_SIZE - std::min(alignedHead, RING_SIZE);
+			if (available < minimumSize)
+			{
+				//Skip the end of the ring and continue at its start, in front of the oldest copy
+				offset = 0;
+				available = tail;
+			}
+		}
+		else
+		{
+			available = tail > alignedHead ? tail - alignedHead : 0;
+		}
+
+		if (available < minimumSize)
+		{
+			return false;
+		}
+
+		size = std::min(available, maximumSize);
+		size -= size % minimumSize;
+
+		//The skipped bytes are released together with the batch, like the copy itself
+		const VkDeviceSize usedBytes = offset >= ringHead ? offset + size - ringHead : RING_SIZE - ringHead + offset + size;
+		getRecordingBatch().ringBytes += usedBytes;
+		ringUsedBytes += usedBytes;
+		ringHead = (offset + size) % RING_SIZE;
+		return true;
+	}
+
+	/*
+	* Releases the ring space of the oldest submitted batch once it completed. Returns false when no batch is in flight,
+	* or when waitForCompletion is false and the oldest batch is still running.
+	*/
+	bool weEngineUploadManager::retireOldestBatch(bool waitForCompletion)
+	{
+		if (submittedBatches.empty())
+		{
+			return false;
+		}
+
+		Batch& batch = batches[submittedBatches.front()];
+		if (waitForCompletion)
+		{
+			vkWaitForFences(weEngineDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		}
+		else if (vkGetFenceStatus(weEngineDevice.device(), batch.fence) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		ringUsedBytes -= batch.ringBytes;
+		completedSerial = batch.serial;
+		submittedBatches.pop_front();
+		return true;
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+/*
+* weEngineUploadManager copies data into device local buffers through a persistently mapped staging ring buffer.
+* Copies are recorded into the current batch and many of them share a single submit, completion is tracked with one fence per batch.
+* Every upload returns a ticket which can be polled or waited on, so loading models never has to wait for the queue to go idle.
+*
+* Batches are submitted by flush, or automatically when the ring or the batch runs out of room. weEngineRenderer flushes before
+* submitting every frame, so a buffer uploaded while recording a frame is always written before the frame reads it.
+* Every public function locks the manager, so models can be loaded on other threads than the render thread. The queue submits
+* also lock the queue mutex of the device, which the frame submits and presents share.
+*
+* When the device has a dedicated transfer queue family the copies run on it, so uploads do not compete with rendering.
+* The copied ranges are then released by the transfer family and acquired by the graphics family in a small command buffer
+* submitted to the graphics queue right after the transfer batch, waiting on its semaphore. Uploads should only target buffers
+* (or ranges of them) whose previous contents do not have to be kept, since the graphics family never releases them.
+*/
+
+#include "weEngineMemoryAllocator.hpp"
+
+//std
+#include "cstdint"
+#include "deque"
+#include "functional"
+#include "mutex"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineDevice;
+
+	//Identifies the batch holding the last copy of an upload. A default ticket refers to no upload and is always complete.
+	struct weEngineUploadTicket
+	{
+		uint64_t serial = 0;
+	};
+
+	class weEngineUploadManager
+	{
+	public:
+		struct Statistics
+		{
+			uint64_t uploadCount = 0;
+			uint64_t uploadedBytes = 0;
+			uint64_t submitCount = 0; //Batches submitted, not counting the ownership acquires
+			uint64_t stallCount = 0; //Times the ring or every batch was in use and the CPU had to wait for the GPU
+		};
+
+		static constexpr VkDeviceSize RING_SIZE = 32ull * 1024 * 1024;
+		static constexpr uint32_t BATCH_COUNT = 4;
+		static constexpr uint32_t MAX_COPIES_PER_BATCH = 1024;
+		static constexpr VkDeviceSize RING_ALIGNMENT = 16;
+
+		//Writes count elements, starting at firstElement of the upload, to destination
+		using WriteFunction = std::function<void(uint8_t* destination, uint64_t firstElement, uint64_t count)>;
+
+		explicit weEngineUploadManager(weEngineDevice& device);
+		~weEngineUploadManager();
+
+		weEngineUploadManager(const weEngineUploadManager&) = delete;
+		weEngineUploadManager& operator=(const weEngineUploadManager&) = delete;
+
+		/*
+		* Copies elementCount elements of elementSize bytes into dstBuffer at dstOffset. The elements are written straight into the staging ring
+		* by the write function, in chunks of whole elements when the upload does not fit into the free part of the ring at once.
+		* The write function runs with the manager locked and must not call it.
+		*/
+		weEngineUploadTicket upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, uint64_t elementCount, uint32_t elementSize, const WriteFunction& write);
+		weEngineUploadTicket upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+		//Submits the copies recorded since the last flush
+		void flush();
+
+		bool isComplete(weEngineUploadTicket ticket);
+		void wait(weEngineUploadTicket ticket);
+		void waitIdle();
+
+		Statistics getStatistics() const
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			return statistics;
+		}
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+
+			//Only used with a dedicated transfer queue family
+			VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+			VkSemaphore transferFinished = VK_NULL_HANDLE;
+			std::vector<VkBufferMemoryBarrier> ownershipBarriers;
+
+			uint64_t serial = 0;
+			VkDeviceSize ringBytes = 0; //Ring space used by the batch, including the padding skipped when wrapping around
+			uint32_t copyCount = 0;
+		};
+
+		void createCommandBuffers();
+		VkCommandPool createCommandPool(uint32_t queueFamilyIndex);
+		void addOwnershipBarrier(Batch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		void submitBatch();
+		void submitOwnershipTransfer(Batch& batch);
+		Batch& getRecordingBatch();
+		bool allocateRingSpace(VkDeviceSize minimumSize, VkDeviceSize maximumSize, VkDeviceSize& offset, VkDeviceSize& size);
+		bool retireOldestBatch(bool waitForCompletion);
+
+		weEngineDevice& weEngineDevice;
+		VkQueue transferQueue;
+		VkQueue graphicsQueue;
+		uint32_t transferFamily;
+		uint32_t graphicsFamily;
+		bool transferOwnership; //The copies run on a different queue family than the rendering
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandPool acquireCommandPool = VK_NULL_HANDLE;
+
+		VkBuffer ringBuffer = VK_NULL_HANDLE;
+		weEngineAllocation ringAllocation;
+		uint8_t* ringData = nullptr;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringUsedBytes = 0;
+
+		std::vector<Batch> batches;
+		uint32_t recordingBatch = 0;
+		bool isRecording = false;
+		std::deque<uint32_t> submittedBatches; //Oldest first, they complete in this order since they share one queue
+
+		uint64_t lastSerial = 0;
+		uint64_t completedSerial = 0;
+		Statistics statistics{};
+
+		//Held by every public function, the private ones expect it to be held already
+		mutable std::mutex mutex;
+	};
+}
@@ -4,6 +4,16 @@
 * Provides hashCombine function to use index buffer with our models
 * author: Brendan Galea
 */
+
+//std
+#include "cstdint"
+#include "cstring"
+#include "functional"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include "intrin.h"
+#endif
+
 namespace weEngine
 {
 	// from: https://stackoverflow.com/a/57595105
@@ -12,4 +22,109 @@ namespace weEngine
 		seed ^= std::hash<T>{}(v)+0x9e3779b9 + (seed << 6) + (seed >> 2);
 		(hashCombine(seed, rest), ...);
 	};
+
+	namespace detail
+	{
+		//Multiplies two 64 bit values, leaving the low half of the 128 bit product in a and the high half in b
+		inline void hashMultiply(uint64_t& a, uint64_t& b)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			uint64_t high;
+			a = _umul128(a, b, &high);
+			b = high;
+#elif defined(__SIZEOF_INT128__)
+			__uint128_t result = static_cast<__uint128_t>(a) * b;
+			a = static_cast<uint64_t>(result);
+			b = static_cast<uint64_t>(result >> 64);
+#else
+			const uint64_t aHigh = a >> 32, aLow = static_cast<uint32_t>(a);
+			const uint64_t bHigh = b >> 32, bLow = static_cast<uint32_t>(b);
+			const uint64_t hh = aHigh * bHigh, hl = aHigh * bLow, lh = aLow * bHigh, ll = aLow * bLow;
+			const uint64_t middle = (ll >> 32) + static_cast<uint32_t>(hl) + static_cast<uint32_t>(lh);
+			a = (middle << 32) | static_cast<uint32_t>(ll);
+			b = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+#endif
+		}
+
+		//Multiplies two 64 bit values and folds the 128 bit product
+		inline uint64_t hashMix(uint64_t a, uint64_t b)
+		{
+			hashMultiply(a, b);
+			return a ^ b;
+		}
+
+		inline uint64_t hashRead8(const uint8_t* p)
+		{
+			uint64_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		inline uint64_t hashRead4(const uint8_t* p)
+		{
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+	}
+
+	/*
+	* Hashes a block of memory. Follows the structure of wyhash (https://github.com/wangyi-fudan/wyhash, public domain),
+	* which processes 48 bytes per iteration and is much faster than chaining std::hash over every field.
+	*/
+	inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0)
+	{
+		constexpr uint64_t secret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		seed ^= detail::hashMix(seed ^ secret[0], secret[1]);
+
+		uint64_t a = 0;
+		uint64_t b = 0;
+		if (length <= 16)
+		{
+			if (length >= 4)
+			{
+				a = (detail::hashRead4(p) << 32) | detail::hashRead4(p + ((length >> 3) << 2));
+				b = (detail::hashRead4(p + length - 4) << 32) | detail::hashRead4(p + length - 4 - ((length >> 3) << 2));
+			}
+			else if (length > 0)
+			{
+				a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+			}
+		}
+		else
+		{
+			size_t remaining = length;
+			if (remaining > 48)
+			{
+				uint64_t seed1 = seed;
+				uint64_t seed2 = seed;
+				do
+				{
+					seed = detail::hashMix(detail::hashRead8(p) ^ secret[1], detail::hashRead8(p + 8) ^ seed);
+					seed1 = detail::hashMix(detail::hashRead8(p + 16) ^ secret[2], detail::hashRead8(p + 24) ^ seed1);
+					seed2 = detail::hashMix(detail::hashRead8(p + 32) ^ secret[3], detail::hashRead8(p + 40) ^ seed2);
+					p += 48;
+					remaining -= 48;
+				} while (remaining > 48);
+				seed ^= seed1 ^ seed2;
+			}
+
+			while (remaining > 16)
+			{
+				seed = detail::hashMix(detail::hashRead8(p) ^ secret[1], detail::hashRead8(p + 8) ^ seed);
+				p += 16;
+				remaining -= 16;
+			}
+
+			a = detail::hashRead8(p + remaining - 16);
+			b = detail::hashRead8(p + remaining - 8);
+		}
+
+		a ^= secret[1];
+		b ^= seed;
+		detail::hashMultiply(a, b);
+		return detail::hashMix(a ^ secret[0] ^ length, b ^ secret[1]);
+	}
 }
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+* weEngineVertexHashMap welds identical vertices while loading a model. It is a flat open-addressing table (linear probing)
+* where every slot only holds a 32 bit hash and the index of the vertex inside the output vertex array,
+* so inserting never allocates a node and probing stays inside a few cache lines.
+*/
+
+#include "weEngineModel.hpp"
+#include "weEngineUtils.hpp"
+
+//std
+#include "cstdint"
+#include "cstring"
+#include "vector"
+
+namespace weEngine
+{
+	class weEngineVertexHashMap
+	{
+	public:
+		//Sizes the table so expectedCount vertices fit without growing
+		explicit weEngineVertexHashMap(size_t expectedCount)
+		{
+			size_t capacity = 16;
+			while (capacity < expectedCount + expectedCount / 4)
+			{
+				capacity *= 2;
+			}
+			slots.assign(capacity, Slot{ 0, EMPTY });
+			mask = static_cast<uint32_t>(capacity - 1);
+		}
+
+		weEngineVertexHashMap(const weEngineVertexHashMap&) = delete;
+		weEngineVertexHashMap& operator=(const weEngineVertexHashMap&) = delete;
+
+		/*
+		* Returns the index of the vertex inside vertices. The vertex is appended to vertices when it is not there yet.
+		*/
+		uint32_t findOrInsert(const weEngineModel::Vertex& vertex, std::vector<weEngineModel::Vertex>& vertices)
+		{
+			const uint32_t hash = hashVertex(vertex);
+
+			for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+			{
+				Slot& entry = slots[slot];
+				if (entry.vertexIndex == EMPTY)
+				{
+					entry.hash = hash;
+					entry.vertexIndex = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
+
+					if (++count * 5 > slots.size() * 4)
+					{
+						grow();
+					}
+					return static_cast<uint32_t>(vertices.size() - 1);
+				}
+
+				if (entry.hash == hash && vertices[entry.vertexIndex] == vertex)
+				{
+					return entry.vertexIndex;
+				}
+			}
+		}
+
+		/*
+		* Hashes the packed bytes of the vertex. -0.0 is folded into 0.0 first so the hash agrees with Vertex::operator==.
+		*/
+		static uint32_t hashVertex(const weEngineModel::Vertex& vertex)
+		{
+			static_assert(sizeof(weEngineModel::Vertex) == 11 * sizeof(float), "Vertex must be tightly packed to be hashed bytewise");
+
+			uint32_t bits[11];
+			std::memcpy(bits, &vertex, sizeof(bits));
+			for (uint32_t& component : bits)
+			{
+				component = (component << 1) == 0 ? 0 : component;
+			}
+
+			const uint64_t hash = hashBytes(bits, sizeof(bits));
+			return static_cast<uint32_t>(hash ^ (hash >> 32));
+		}
+
+	private:
+		static constexpr uint32_t EMPTY = ~0u;
+
+		struct Slot
+		{
+			uint32_t hash;
+			uint32_t vertexIndex;
+		};
+
+		//Doubles the table. Slots are placed again from their stored hash, the vertices are never hashed twice.
+		void grow()
+		{
+			std::vector<Slot> oldSlots(slots.size() * 2, Slot{ 0, EMPTY });
+			oldSlots.swap(slots);
+			mask = static_cast<uint32_t>(slots.size() - 1);
+
+			for (const Slot& entry : oldSlots)
+			{
+				if (entry.vertexIndex == EMPTY)
+				{
+					continue;
+				}
+
+				uint32_t slot = entry.hash & mask;
+				while (slots[slot].vertexIndex != EMPTY)
+				{
+					slot = (slot + 1) & mask;
+				}
+				slots[slot] = entry;
+			}
+		}
+
+		std::vector<Slot> slots;
+		uint32_t mask = 0;
+		size_t count = 0;
+	};
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+/*
+* weEngineVertexLayout describes the vertex format stored inside a vertex buffer as a list of attribute encodings.
+* The stride, the attribute offsets and the Vulkan binding and attribute descriptions are all computed at compile time,
+* and a pipeline can ask for the descriptions of only the attributes its vertex shader reads.
+*
+* Every attribute encoding defines the shader location it feeds (LOCATION), its Vulkan format (FORMAT), its size in bytes (SIZE)
+* and an encode function writing the attribute of a source vertex. Sizes are multiples of 4 bytes so every attribute stays aligned.
+*/
+
+#include "weEngineDevice.hpp"
+
+//glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+//std
+#include "array"
+#include "cstdint"
+#include "cstring"
+
+namespace weEngine
+{
+	//Shader inputs a vertex can provide, the bit index is the shader location of the attribute
+	enum VertexAttributeBits : uint32_t
+	{
+		VERTEX_POSITION_BIT = 1u << 0,
+		VERTEX_COLOR_BIT = 1u << 1,
+		VERTEX_NORMAL_BIT = 1u << 2,
+		VERTEX_UV_BIT = 1u << 3,
+	};
+
+	//Maps the positions of a model into [-1, 1] before encoding them: encoded = (position - bias) / scale
+	struct VertexQuantization
+	{
+		glm::vec3 scale{ 1.0f };
+		glm::vec3 bias{ 0.0f };
+	};
+
+	namespace VertexAttributes
+	{
+		struct PositionFloat3
+		{
+			static constexpr uint32_t LOCATION = 0;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+			static constexpr uint32_t SIZE = 12;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				std::memcpy(destination, &vertex.position, SIZE);
+			}
+		};
+
+		//Half floats of the quantized position, w is 1. Precision is about 1/2048 of the model extent near its bounds.
+		struct PositionHalf4
+		{
+			static constexpr uint32_t LOCATION = 0;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+			static constexpr uint32_t SIZE = 8;
+			static constexpr bool QUANTIZED = true;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization& quantization, uint8_t* destination)
+			{
+				const glm::vec3 position = (vertex.position - quantization.bias) / quantization.scale;
+				const uint32_t packed[2] =
+				{
+					glm::packHalf2x16(glm::vec2(position.x, position.y)),
+					glm::packHalf2x16(glm::vec2(position.z, 1.0f)),
+				};
+				std::memcpy(destination, packed, SIZE);
+			}
+		};
+
+		struct ColorFloat3
+		{
+			static constexpr uint32_t LOCATION = 1;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+			static constexpr uint32_t SIZE = 12;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				std::memcpy(destination, &vertex.color, SIZE);
+			}
+		};
+
+		//8 bit per channel color, alpha is 1
+		struct ColorUnorm8
+		{
+			static constexpr uint32_t LOCATION = 1;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+			static constexpr uint32_t SIZE = 4;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				const uint32_t packed = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+				std::memcpy(destination, &packed, SIZE);
+			}
+		};
+
+		struct NormalFloat3
+		{
+			static constexpr uint32_t LOCATION = 2;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+			static constexpr uint32_t SIZE = 12;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				std::memcpy(destination, &vertex.normal, SIZE);
+			}
+		};
+
+		/*
+		* Octahedral encoded normal in two 16 bit snorm values. The shader decodes it with:
+		* vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y)); if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy); n = normalize(n);
+		*/
+		struct NormalOctahedral16
+		{
+			static constexpr uint32_t LOCATION = 2;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_SNORM;
+			static constexpr uint32_t SIZE = 4;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				const glm::vec3& normal = vertex.normal;
+				const float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+
+				glm::vec2 encoded{ 0.0f };
+				if (length > 0.0f)
+				{
+					encoded = glm::vec2(normal.x, normal.y) / length;
+					if (normal.z < 0.0f)
+					{
+						const glm::vec2 folded = 1.0f - glm::abs(glm::vec2(encoded.y, encoded.x));
+						encoded = glm::vec2(
+							encoded.x >= 0.0f ? folded.x : -folded.x,
+							encoded.y >= 0.0f ? folded.y : -folded.y);
+					}
+				}
+
+				const uint32_t packed = glm::packSnorm2x16(encoded);
+				std::memcpy(destination, &packed, SIZE);
+			}
+		};
+
+		struct UvFloat2
+		{
+			static constexpr uint32_t LOCATION = 3;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R32G32_SFLOAT;
+			static constexpr uint32_t SIZE = 8;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				std::memcpy(destination, &vertex.uv, SIZE);
+			}
+		};
+
+		//Half float texture coordinates, exact for texels up to 2048 when the coordinates stay inside [0, 1]
+		struct UvHalf2
+		{
+			static constexpr uint32_t LOCATION = 3;
+			static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_SFLOAT;
+			static constexpr uint32_t SIZE = 4;
+			static constexpr bool QUANTIZED = false;
+
+			template<typename SourceVertex>
+			static void encode(const SourceVertex& vertex, const VertexQuantization&, uint8_t* destination)
+			{
+				const uint32_t packed = glm::packHalf2x16(vertex.uv);
+				std::memcpy(destination, &packed, SIZE);
+			}
+		};
+	}
+
+	template<typename... Attributes>
+	struct weEngineVertexLayout
+	{
+		static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr uint32_t STRIDE = (Attributes::SIZE + ... + 0);
+		static constexpr uint32_t ATTRIBUTE_MASK = ((1u << Attributes::LOCATION) | ... | 0u);
+		static constexpr bool QUANTIZED = (Attributes::QUANTIZED || ... || false);
+
+		static_assert(ATTRIBUTE_COUNT > 0, "A vertex layout needs at least one attribute");
+		static_assert(((Attributes::SIZE % 4 == 0) && ...), "Attribute sizes must keep the next attribute 4 byte aligned");
+
+		//Offset of every attribute inside a vertex, in declaration order
+		static constexpr std::array<uint32_t, ATTRIBUTE_COUNT> getOffsets()
+		{
+			std::array<uint32_t, ATTRIBUTE_COUNT> offsets{};
+			const uint32_t sizes[] = { Attributes::SIZE... };
+			uint32_t offset = 0;
+			for (uint32_t i = 0; i < ATTRIBUTE_COUNT; i++)
+			{
+				offsets[i] = offset;
+				offset += sizes[i];
+			}
+			return offsets;
+		}
+
+		static constexpr VkVertexInputBindingDescription getBindingDescription(uint32_t binding = 0)
+		{
+			VkVertexInputBindingDescription description{};
+			description.binding = binding;
+			description.stride = STRIDE;
+			description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			return description;
+		}
+
+		/*
+		* Returns the descriptions of the attributes of UsedAttributes (VertexAttributeBits) this layout provides.
+		* Attributes the pipeline does not read are left out, their bytes are skipped by the stride.
+		*/
+		template<uint32_t UsedAttributes = ATTRIBUTE_MASK>
+		static constexpr auto getAttributeDescriptions(uint32_t binding = 0)
+		{
+			constexpr uint32_t usedMask = UsedAttributes & ATTRIBUTE_MASK;
+			static_assert(usedMask == UsedAttributes, "The vertex layout does not provide every attribute the pipeline uses");
+
+			constexpr std::array<uint32_t, ATTRIBUTE_COUNT> offsets = getOffsets();
+			const uint32_t locations[] = { Attributes::LOCATION... };
+			const VkFormat formats[] = { Attributes::FORMAT... };
+
+			std::array<VkVertexInputAttributeDescription, countBits(usedMask)> descriptions{};
+			uint32_t count = 0;
+			for (uint32_t i = 0; i < ATTRIBUTE_COUNT; i++)
+			{
+				if ((usedMask & (1u << locations[i])) == 0)
+				{
+					continue;
+				}
+
+				descriptions[count].binding = binding;
+				descriptions[count].location = locations[i];
+				descriptions[count].format = formats[i];
+				descriptions[count].offset = offsets[i];
+				count++;
+			}
+			return descriptions;
+		}
+
+		//Writes the attributes of the vertex to destination, which must have room for STRIDE bytes
+		template<typename SourceVertex>
+		static void encode(const SourceVertex& vertex, const VertexQuantization& quantization, uint8_t* destination)
+		{
+			constexpr std::array<uint32_t, ATTRIBUTE_COUNT> offsets = getOffsets();
+			uint32_t attribute = 0;
+			(Attributes::encode(vertex, quantization, destination + offsets[attribute++]), ...);
+		}
+
+	private:
+		static constexpr uint32_t countBits(uint32_t mask)
+		{
+			uint32_t count = 0;
+			for (; mask != 0; mask &= mask - 1)
+			{
+				count++;
+			}
+			return count;
+		}
+	};
+
+	//Same format as weEngineModel::Vertex, 44 bytes
+	using FullPrecisionVertexLayout = weEngineVertexLayout<
+		VertexAttributes::PositionFloat3,
+		VertexAttributes::ColorFloat3,
+		VertexAttributes::NormalFloat3,
+		VertexAttributes::UvFloat2>;
+
+	//Quantized format, 20 bytes
+	using CompactVertexLayout = weEngineVertexLayout<
+		VertexAttributes::PositionHalf4,
+		VertexAttributes::ColorUnorm8,
+		VertexAttributes::NormalOctahedral16,
+		VertexAttributes::UvHalf2>;
+}
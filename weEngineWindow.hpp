@@ -2,6 +2,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
+#include "atomic"
 #include "string"
 
 /*
@@ -30,7 +31,7 @@ namespace weEngine {
 
 		VkExtent2D getExtent() 
 		{ 
-			return { static_cast<uint32_t>(widthWindow), static_cast<uint32_t>(heightWindow) };
+			return { static_cast<uint32_t>(widthWindow.load()), static_cast<uint32_t>(heightWindow.load()) };
 		}
 
 		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
@@ -52,9 +53,10 @@ namespace weEngine {
 		static void framebufferResizedCallback(GLFWwindow* window, int width, int height);
 		void initWindow();
 
-		int heightWindow;
-		int widthWindow;
-		bool framebufferResized = false;
+		//Written by the resize callback on the main thread, read by the thread recording the frames
+		std::atomic<int> heightWindow;
+		std::atomic<int> widthWindow;
+		std::atomic<bool> framebufferResized{ false };
 
 		std::string windowTitle;
 		GLFWwindow* window;
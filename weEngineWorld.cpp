@@ -0,0 +1,221 @@
+#include "weEngineWorld.hpp"
+
+//std
+#include "mutex"
+#include "stdexcept"
+
+namespace weEngine
+{
+	weEngineWorld::~weEngineWorld()
+	{
+		for (Archetype& archetype : archetypes)
+		{
+			for (Chunk& chunk : archetype.chunks)
+			{
+				for (uint32_t componentId : archetype.componentIds)
+				{
+					const ComponentInfo& info = getComponentInfos()[componentId];
+					unsigned char* column = static_cast<unsigned char*>(getColumn(archetype, chunk, componentId));
+					for (uint32_t row = 0; row < chunk.count; row++)
+					{
+						info.destroy(column + info.size * row);
+					}
+				}
+			}
+		}
+	}
+
+	std::array<weEngineWorld::ComponentInfo, weEngineWorld::MAX_COMPONENT_TYPES>& weEngineWorld::getComponentInfos()
+	{
+		static std::array<ComponentInfo, MAX_COMPONENT_TYPES> componentInfos{};
+		return componentInfos;
+	}
+
+	/*
+	* Called once per type, by the first thread asking for its id. Tasks of the frame graph may be the first to use a type,
+	* so two types can be registered at the same time. The id is published by the static of getComponentId after the entry is written.
+	*/
+	uint32_t weEngineWorld::registerComponent(size_t size, size_t alignment, void (*moveConstruct)(void*, void*), void (*destroy)(void*))
+	{
+		static std::mutex registryMutex;
+		static uint32_t componentCount = 0;
+
+		std::lock_guard<std::mutex> lock{ registryMutex };
+		if (componentCount >= MAX_COMPONENT_TYPES)
+		{
+			throw std::runtime_error("Too many component types");
+		}
+		getComponentInfos()[componentCount] = { size, alignment, moveConstruct, destroy };
+		return componentCount++;
+	}
+
+	weEngineEntity weEngineWorld::allocateEntity()
+	{
+		if (!freeIndices.empty())
+		{
+			const uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+			return weEngineEntity{ index, records[index].generation };
+		}
+
+		records.push_back({});
+		return weEngineEntity{ static_cast<uint32_t>(records.size() - 1), 0 };
+	}
+
+	/*
+	* A chunk starts with the entity handles, followed by the array of every component type, each aligned for its type.
+	* The capacity is the number of entities whose handle and components fit in a chunk with the padding.
+	*/
+	uint32_t weEngineWorld::getArchetype(ComponentMask mask)
+	{
+		const auto found = archetypeIndices.find(mask);
+		if (found != archetypeIndices.end())
+		{
+			return found->second;
+		}
+
+		const std::array<ComponentInfo, MAX_COMPONENT_TYPES>& componentInfos = getComponentInfos();
+
+		Archetype archetype{};
+		archetype.mask = mask;
+		archetype.columnOffsets.assign(MAX_COMPONENT_TYPES, NULL_COLUMN);
+
+		size_t entitySize = sizeof(weEngineEntity);
+		for (uint32_t componentId = 0; componentId < MAX_COMPONENT_TYPES; componentId++)
+		{
+			if (mask & (ComponentMask{ 1 } << componentId))
+			{
+				archetype.componentIds.push_back(componentId);
+				entitySize += componentInfos[componentId].size;
+			}
+		}
+
+		for (size_t capacity = CHUNK_SIZE / entitySize; capacity > 0; capacity--)
+		{
+			size_t offset = sizeof(weEngineEntity) * capacity;
+			for (uint32_t componentId : archetype.componentIds)
+			{
+				const ComponentInfo& info = componentInfos[componentId];
+				offset = (offset + info.alignment - 1) / info.alignment * info.alignment;
+				archetype.columnOffsets[componentId] = static_cast<uint32_t>(offset);
+				offset += info.size * capacity;
+			}
+
+			if (offset <= CHUNK_SIZE)
+			{
+				archetype.chunkCapacity = static_cast<uint32_t>(capacity);
+				break;
+			}
+		}
+
+		if (archetype.chunkCapacity == 0)
+		{
+			throw std::runtime_error("The components of an entity do not fit in a chunk");
+		}
+
+		archetypes.push_back(std::move(archetype));
+		const uint32_t archetypeIndex = static_cast<uint32_t>(archetypes.size() - 1);
+		archetypeIndices.emplace(mask, archetypeIndex);
+		return archetypeIndex;
+	}
+
+	void weEngineWorld::addRow(uint32_t archetypeIndex, weEngineEntity entity)
+	{
+		Archetype& archetype = archetypes[archetypeIndex];
+		if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.chunkCapacity)
+		{
+			Chunk chunk{};
+			chunk.data.reset(new unsigned char[CHUNK_SIZE]);
+			archetype.chunks.push_back(std::move(chunk));
+		}
+
+		Chunk& chunk = archetype.chunks.back();
+		const uint32_t row = chunk.count++;
+		getEntities(chunk)[row] = entity;
+		archetype.entityCount++;
+
+		EntityRecord& record = records[entity.index];
+		record.archetype = archetypeIndex;
+		record.chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+		record.row = row;
+	}
+
+	void weEngineWorld::removeRow(const EntityRecord& location)
+	{
+		Archetype& archetype = archetypes[location.archetype];
+		const uint32_t lastChunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+		Chunk& lastChunk = archetype.chunks[lastChunkIndex];
+		const uint32_t lastRow = lastChunk.count - 1;
+
+		if (location.chunk != lastChunkIndex || location.row != lastRow)
+		{
+			const weEngineEntity movedEntity = getEntities(lastChunk)[lastRow];
+			EntityRecord& movedRecord = records[movedEntity.index];
+			for (uint32_t componentId : archetype.componentIds)
+			{
+				const ComponentInfo& info = getComponentInfos()[componentId];
+				void* source = getComponentPointer(movedRecord, componentId);
+				info.moveConstruct(getComponentPointer(location, componentId), source);
+				info.destroy(source);
+			}
+
+			getEntities(archetype.chunks[location.chunk])[location.row] = movedEntity;
+			movedRecord.chunk = location.chunk;
+			movedRecord.row = location.row;
+		}
+
+		lastChunk.count--;
+		archetype.entityCount--;
+		if (lastChunk.count == 0)
+		{
+			archetype.chunks.pop_back();
+		}
+	}
+
+	void weEngineWorld::moveEntity(weEngineEntity entity, ComponentMask mask)
+	{
+		const uint32_t archetypeIndex = getArchetype(mask);
+		const EntityRecord oldLocation = records[entity.index];
+		addRow(archetypeIndex, entity);
+
+		for (uint32_t componentId : archetypes[oldLocation.archetype].componentIds)
+		{
+			const ComponentInfo& info = getComponentInfos()[componentId];
+			void* source = getComponentPointer(oldLocation, componentId);
+			if (mask & (ComponentMask{ 1 } << componentId))
+			{
+				info.moveConstruct(getComponentPointer(records[entity.index], componentId), source);
+			}
+			info.destroy(source);
+		}
+
+		removeRow(oldLocation);
+	}
+
+	void weEngineWorld::destroyEntity(weEngineEntity entity)
+	{
+		assert(isAlive(entity) && "Destroying a dead entity");
+		EntityRecord& record = records[entity.index];
+		for (uint32_t componentId : archetypes[record.archetype].componentIds)
+		{
+			getComponentInfos()[componentId].destroy(getComponentPointer(record, componentId));
+		}
+
+		removeRow(record);
+		record.archetype = NULL_ARCHETYPE;
+		record.generation++;
+		freeIndices.push_back(entity.index);
+	}
+
+	weEngineWorld::Statistics weEngineWorld::getStatistics() const
+	{
+		Statistics statistics{};
+		statistics.archetypeCount = static_cast<uint32_t>(archetypes.size());
+		for (const Archetype& archetype : archetypes)
+		{
+			statistics.entityCount += archetype.entityCount;
+			statistics.chunkCount += static_cast<uint32_t>(archetype.chunks.size());
+		}
+		return statistics;
+	}
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+/*
+* weEngineWorld is an archetype based entity component system. The entities with the same set of component types form an archetype,
+* whose entities are stored in fixed size chunks: a chunk holds an array of entity handles followed by one array per component type,
+* so a query only reads the arrays of the components it asks for.
+*
+* Entities are handles made of an index and a generation. The index is stable for the life of the entity, even when adding or removing
+* a component moves it to another archetype, and is reused once the entity is destroyed with the next generation, so a handle of
+* a destroyed entity is never mistaken for the new one.
+*
+* Adding or removing components and creating or destroying entities must not happen while a query runs. The world is only changed from
+* the thread that owns it, the parallel queries only run the callbacks on the job system. Component types are registered on first use
+* by any thread, into a registry shared by the worlds.
+*/
+
+#include "weEngineJobSystem.hpp"
+
+//std
+#include "array"
+#include "cassert"
+#include "cstddef"
+#include "cstdint"
+#include "initializer_list"
+#include "memory"
+#include "new"
+#include "type_traits"
+#include "unordered_map"
+#include "utility"
+#include "vector"
+
+namespace weEngine
+{
+	struct weEngineEntity
+	{
+		static constexpr uint32_t NULL_INDEX = UINT32_MAX;
+
+		uint32_t index = NULL_INDEX;
+		uint32_t generation = 0;
+
+		bool isNull() const
+		{
+			return index == NULL_INDEX;
+		}
+
+		bool operator==(const weEngineEntity& other) const
+		{
+			return index == other.index && generation == other.generation;
+		}
+
+		bool operator!=(const weEngineEntity& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	class weEngineWorld
+	{
+	public:
+		using ComponentMask = uint64_t;
+
+		static constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+		static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+		struct Statistics
+		{
+			uint32_t entityCount = 0;
+			uint32_t archetypeCount = 0;
+			uint32_t chunkCount = 0;
+		};
+
+		weEngineWorld() = default;
+		~weEngineWorld();
+
+		weEngineWorld(const weEngineWorld&) = delete;
+		weEngineWorld& operator=(const weEngineWorld&) = delete;
+
+		//Id of the component type, registered on first use
+		template<typename T>
+		static uint32_t getComponentId()
+		{
+			static_assert(alignof(T) <= alignof(std::max_align_t), "Component types cannot be over aligned");
+			static const uint32_t id = registerComponent(sizeof(T), alignof(T), &moveConstruct<T>, &destroy<T>);
+			return id;
+		}
+
+		template<typename... Ts>
+		static ComponentMask getMask()
+		{
+			ComponentMask mask = 0;
+			(void)std::initializer_list<int>{ (mask |= ComponentMask{ 1 } << getComponentId<Ts>(), 0)... };
+			return mask;
+		}
+
+		//Creates an entity with the given components, constructed in place in the chunk of their archetype
+		template<typename... Ts>
+		weEngineEntity createEntity(Ts&&... components)
+		{
+			const weEngineEntity entity = allocateEntity();
+			const uint32_t archetypeIndex = getArchetype(getMask<std::decay_t<Ts>...>());
+			addRow(archetypeIndex, entity);
+
+			const EntityRecord& record = records[entity.index];
+			(void)std::initializer_list<int>{ (new (getComponentPointer(record, getComponentId<std::decay_t<Ts>>())) std::decay_t<Ts>(std::forward<Ts>(components)), 0)... };
+			return entity;
+		}
+
+		//Destroys the components of the entity, its handle is no longer alive
+		void destroyEntity(weEngineEntity entity);
+
+		bool isAlive(weEngineEntity entity) const
+		{
+			return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype != NULL_ARCHETYPE;
+		}
+
+		//Handle of the entity living at the index, null when no entity uses it
+		weEngineEntity getEntity(uint32_t index) const
+		{
+			if (index >= records.size() || records[index].archetype == NULL_ARCHETYPE)
+			{
+				return weEngineEntity{};
+			}
+			return weEngineEntity{ index, records[index].generation };
+		}
+
+		//Adds the component or replaces the one the entity has, moving the entity to the archetype with the component
+		template<typename T>
+		T& addComponent(weEngineEntity entity, T component)
+		{
+			assert(isAlive(entity) && "Adding a component to a dead entity");
+			const uint32_t componentId = getComponentId<T>();
+			if (T* existing = getComponent<T>(entity))
+			{
+				*existing = std::move(component);
+				return *existing;
+			}
+
+			moveEntity(entity, archetypes[records[entity.index].archetype].mask | (ComponentMask{ 1 } << componentId));
+			return *new (getComponentPointer(records[entity.index], componentId)) T(std::move(component));
+		}
+
+		template<typename T>
+		void removeComponent(weEngineEntity entity)
+		{
+			assert(isAlive(entity) && "Removing a component from a dead entity");
+			if (hasComponent<T>(entity))
+			{
+				moveEntity(entity, archetypes[records[entity.index].archetype].mask & ~(ComponentMask{ 1 } << getComponentId<T>()));
+			}
+		}
+
+		//Component of the entity, null when the entity is dead or does not have it
+		template<typename T>
+		T* getComponent(weEngineEntity entity)
+		{
+			if (!isAlive(entity))
+			{
+				return nullptr;
+			}
+			return static_cast<T*>(getComponentPointer(records[entity.index], getComponentId<T>()));
+		}
+
+		template<typename T>
+		bool hasComponent(weEngineEntity entity) const
+		{
+			return hasComponents<T>(entity);
+		}
+
+		//Whether the entity is alive with all the component types
+		template<typename... Ts>
+		bool hasComponents(weEngineEntity entity) const
+		{
+			const ComponentMask mask = getMask<Ts...>();
+			return isAlive(entity) && (archetypes[records[entity.index].archetype].mask & mask) == mask;
+		}
+
+		/*
+		* Calls function(const weEngineEntity* entities, uint32_t count, Ts*... components) for every chunk of the archetypes with
+		* all the component types, the arrays hold count entries. The chunks are visited in the same order by every query with the same types.
+		*/
+		template<typename... Ts, typename Function>
+		void forEachChunk(Function&& function)
+		{
+			const ComponentMask mask = getMask<Ts...>();
+			for (Archetype& archetype : archetypes)
+			{
+				if ((archetype.mask & mask) != mask)
+				{
+					continue;
+				}
+				for (Chunk& chunk : archetype.chunks)
+				{
+					function(getEntities(chunk), chunk.count, static_cast<Ts*>(getColumn(archetype, chunk, getComponentId<Ts>()))...);
+				}
+			}
+		}
+
+		//Calls function(weEngineEntity entity, Ts&... components) for every entity with all the component types
+		template<typename... Ts, typename Function>
+		void forEach(Function&& function)
+		{
+			forEachChunk<Ts...>([&](const weEngineEntity* entities, uint32_t count, Ts*... components)
+				{
+					for (uint32_t i = 0; i < count; i++)
+					{
+						function(entities[i], components[i]...);
+					}
+				});
+		}
+
+		/*
+		* Calls function(uint32_t chunkIndex, const weEngineEntity* entities, uint32_t count, Ts*... components) for the chunks of forEachChunk
+		* as jobs of the shared job system, chunkIndex being the position of the chunk in the order of forEachChunk.
+		* The callbacks must only write to the components of their chunk or to data owned by their chunk index.
+		*/
+		template<typename... Ts, typename Function>
+		void parallelForEachChunk(Function&& function)
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> chunks; //Archetype and chunk of every chunk of the query
+			const ComponentMask mask = getMask<Ts...>();
+			for (uint32_t archetypeIndex = 0; archetypeIndex < archetypes.size(); archetypeIndex++)
+			{
+				if ((archetypes[archetypeIndex].mask & mask) != mask)
+				{
+					continue;
+				}
+				for (uint32_t chunkIndex = 0; chunkIndex < archetypes[archetypeIndex].chunks.size(); chunkIndex++)
+				{
+					chunks.push_back({ archetypeIndex, chunkIndex });
+				}
+			}
+
+			weEngineJobSystem::shared().parallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t task)
+				{
+					Archetype& archetype = archetypes[chunks[task].first];
+					Chunk& chunk = archetype.chunks[chunks[task].second];
+					function(task, getEntities(chunk), chunk.count, static_cast<Ts*>(getColumn(archetype, chunk, getComponentId<Ts>()))...);
+				});
+		}
+
+		//Number of entities with all the component types
+		template<typename... Ts>
+		uint32_t count() const
+		{
+			const ComponentMask mask = getMask<Ts...>();
+			uint32_t entityCount = 0;
+			for (const Archetype& archetype : archetypes)
+			{
+				if ((archetype.mask & mask) == mask)
+				{
+					entityCount += archetype.entityCount;
+				}
+			}
+			return entityCount;
+		}
+
+		//Entity indices are below this bound, so arrays indexed by entity can be sized with it
+		uint32_t getIndexCapacity() const
+		{
+			return static_cast<uint32_t>(records.size());
+		}
+
+		Statistics getStatistics() const;
+
+	private:
+		static constexpr uint32_t NULL_ARCHETYPE = UINT32_MAX;
+		static constexpr uint32_t NULL_COLUMN = UINT32_MAX;
+
+		struct ComponentInfo
+		{
+			size_t size;
+			size_t alignment;
+			void (*moveConstruct)(void* destination, void* source);
+			void (*destroy)(void* component);
+		};
+
+		struct Chunk
+		{
+			std::unique_ptr<unsigned char[]> data;
+			uint32_t count = 0;
+		};
+
+		//The chunks are full but the last one, so removing an entity moves the last entity of the archetype into its row
+		struct Archetype
+		{
+			ComponentMask mask = 0;
+			std::vector<uint32_t> componentIds;
+			std::vector<uint32_t> columnOffsets; //Byte offset of the array of every component type in a chunk, NULL_COLUMN when absent
+			uint32_t chunkCapacity = 0;
+			uint32_t entityCount = 0;
+			std::vector<Chunk> chunks;
+		};
+
+		struct EntityRecord
+		{
+			uint32_t generation = 0;
+			uint32_t archetype = NULL_ARCHETYPE;
+			uint32_t chunk = 0;
+			uint32_t row = 0;
+		};
+
+		template<typename T>
+		static void moveConstruct(void* destination, void* source)
+		{
+			new (destination) T(std::move(*static_cast<T*>(source)));
+		}
+
+		template<typename T>
+		static void destroy(void* component)
+		{
+			static_cast<T*>(component)->~T();
+		}
+
+		//Registering locks the registry. Its entries never move, so they are read without the lock once their id is known
+		static uint32_t registerComponent(size_t size, size_t alignment, void (*moveConstruct)(void*, void*), void (*destroy)(void*));
+		static std::array<ComponentInfo, MAX_COMPONENT_TYPES>& getComponentInfos();
+
+		weEngineEntity allocateEntity();
+		uint32_t getArchetype(ComponentMask mask);
+
+		//Gives the entity the next row of the archetype, its components are left unconstructed
+		void addRow(uint32_t archetypeIndex, weEngineEntity entity);
+
+		//Fills the row, whose components were destroyed or moved from, with the last entity of its archetype
+		void removeRow(const EntityRecord& location);
+
+		//Moves the components the entity keeps to the archetype of the mask and destroys the ones it loses
+		void moveEntity(weEngineEntity entity, ComponentMask mask);
+
+		static weEngineEntity* getEntities(Chunk& chunk)
+		{
+			return reinterpret_cast<weEngineEntity*>(chunk.data.get());
+		}
+
+		static void* getColumn(const Archetype& archetype, Chunk& chunk, uint32_t componentId)
+		{
+			return chunk.data.get() + archetype.columnOffsets[componentId];
+		}
+
+		//Component of the entity of the record, null when its archetype does not have the component type
+		void* getComponentPointer(const EntityRecord& record, uint32_t componentId)
+		{
+			Archetype& archetype = archetypes[record.archetype];
+			if (archetype.columnOffsets[componentId] == NULL_COLUMN)
+			{
+				return nullptr;
+			}
+			return static_cast<unsigned char*>(getColumn(archetype, archetype.chunks[record.chunk], componentId)) + getComponentInfos()[componentId].size * record.row;
+		}
+
+		std::vector<Archetype> archetypes;
+		std::unordered_map<ComponentMask, uint32_t> archetypeIndices;
+
+		std::vector<EntityRecord> records; //Location of every entity, at its index
+		std::vector<uint32_t> freeIndices;
+	};
+}